@@ -13,7 +13,7 @@
 
 #include "ethernet.h"
 #include <libnm/NetworkManager.h>
-#include <uuid/uuid.h>
+#include "../nm-connection.h"
 
 struct _EthernetConnection {
     NMDevice *device;
@@ -45,42 +45,14 @@ initialize_ethernet_connection(NMDevice *device) {
 
 GVariant *ethernet_create_connection_gvariant(const gchar *id)
 {
-    GVariantBuilder connection_builder;
-    GVariant *connection_dict;
-    gchar *uuid;
-
-    uuid = g_new0(gchar, 37);
-    uuid_t uuid_bin;
-    uuid_generate(uuid_bin);
-    uuid_unparse(uuid_bin, uuid);
-
-    g_variant_builder_init(&connection_builder, G_VARIANT_TYPE("a{sa{sv}}"));
+    NMProfileBuilder profile;
+    GVariantBuilder ethernet_section_builder;
 
-    GVariantBuilder connection_section_builder;
-    g_variant_builder_init(&connection_section_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&connection_section_builder, "{sv}", "type", g_variant_new_string("802-3-ethernet"));
-    g_variant_builder_add(&connection_section_builder, "{sv}", "id", g_variant_new_string(id));
-    g_variant_builder_add(&connection_section_builder, "{sv}", "uuid", g_variant_new_string(uuid));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "connection", &connection_section_builder);
+    nm_profile_builder_init(&profile, "802-3-ethernet", id);
 
-    GVariantBuilder ethernet_section_builder;
     g_variant_builder_init(&ethernet_section_builder, G_VARIANT_TYPE("a{sv}"));
     g_variant_builder_add(&ethernet_section_builder, "{sv}", "auto-negotiate", g_variant_new_boolean(TRUE));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "802-3-ethernet", &ethernet_section_builder);
-
-    GVariantBuilder ipv4_section_builder;
-    g_variant_builder_init(&ipv4_section_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&ipv4_section_builder, "{sv}", "method", g_variant_new_string("auto"));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv4", &ipv4_section_builder);
-
-    GVariantBuilder ipv6_section_builder;
-    g_variant_builder_init(&ipv6_section_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&ipv6_section_builder, "{sv}", "method", g_variant_new_string("auto"));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv6", &ipv6_section_builder);
-
-    connection_dict = g_variant_builder_end(&connection_builder);
-
-    g_free(uuid);
+    nm_profile_builder_add_section(&profile, "802-3-ethernet", &ethernet_section_builder);
 
-    return connection_dict;
+    return nm_profile_builder_end(&profile);
 }
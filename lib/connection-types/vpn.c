@@ -13,6 +13,7 @@
 
 #include "vpn.h"
 #include <libnm/NetworkManager.h>
+#include "../nm-connection.h"
 
 struct _VpnConnection {
     NMDevice *device;
@@ -51,43 +52,15 @@ initialize_vpn_connection(NMDevice *device, const gchar *vpn_type) {
 
 GVariant *vpn_create_connection_gvariant(const gchar *id, const gchar *server)
 {
-    GVariantBuilder connection_builder;
-    GVariant *connection_dict;
-    gchar *uuid;
-
-    uuid = g_new0(gchar, 37);
-    uuid_t uuid_bin;
-    uuid_generate(uuid_bin);
-    uuid_unparse(uuid_bin, uuid);
-
-    g_variant_builder_init(&connection_builder, G_VARIANT_TYPE("a{sa{sv}}"));
+    NMProfileBuilder profile;
+    GVariantBuilder vpn_section_builder;
 
-    GVariantBuilder connection_section_builder;
-    g_variant_builder_init(&connection_section_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&connection_section_builder, "{sv}", "type", g_variant_new_string("vpn"));
-    g_variant_builder_add(&connection_section_builder, "{sv}", "id", g_variant_new_string(id));
-    g_variant_builder_add(&connection_section_builder, "{sv}", "uuid", g_variant_new_string(uuid));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "connection", &connection_section_builder);
+    nm_profile_builder_init(&profile, "vpn", id);
 
-    GVariantBuilder vpn_section_builder;
     g_variant_builder_init(&vpn_section_builder, G_VARIANT_TYPE("a{sv}"));
     g_variant_builder_add(&vpn_section_builder, "{sv}", "service-type", g_variant_new_string("org.freedesktop.NetworkManager.openvpn"));
     g_variant_builder_add(&vpn_section_builder, "{sv}", "remote", g_variant_new_string(server));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "vpn", &vpn_section_builder);
-
-    GVariantBuilder ipv4_section_builder;
-    g_variant_builder_init(&ipv4_section_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&ipv4_section_builder, "{sv}", "method", g_variant_new_string("auto"));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv4", &ipv4_section_builder);
-
-    GVariantBuilder ipv6_section_builder;
-    g_variant_builder_init(&ipv6_section_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&ipv6_section_builder, "{sv}", "method", g_variant_new_string("auto"));
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv6", &ipv6_section_builder);
-
-    connection_dict = g_variant_builder_end(&connection_builder);
-
-    g_free(uuid);
+    nm_profile_builder_add_section(&profile, "vpn", &vpn_section_builder);
 
-    return connection_dict;
+    return nm_profile_builder_end(&profile);
 }
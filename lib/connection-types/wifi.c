@@ -12,5 +12,72 @@
 #endif
 
 #include "wifi.h"
+#include "../nm-connection.h"
+#include <string.h>
 
-/* TODO: Implement wifi connection type */
+static void
+wifi_profile_init(NMProfileBuilder *profile, const gchar *ssid)
+{
+    GVariantBuilder wireless_builder;
+
+    nm_profile_builder_init(profile, "802-11-wireless", ssid);
+
+    g_variant_builder_init(&wireless_builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&wireless_builder, "{sv}", "ssid",
+                          g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                    ssid, strlen(ssid), 1));
+    g_variant_builder_add(&wireless_builder, "{sv}", "mode", g_variant_new_string("infrastructure"));
+    nm_profile_builder_add_section(profile, "802-11-wireless", &wireless_builder);
+}
+
+/* Profile for an open or pre-shared-key network; security is the AP's security string */
+GVariant *
+wifi_create_connection_gvariant(const gchar *ssid, const gchar *security, const gchar *password)
+{
+    NMProfileBuilder profile;
+    GVariantBuilder wireless_security_builder;
+
+    wifi_profile_init(&profile, ssid);
+
+    /* 802-11-wireless-security section if password is provided */
+    if (password && *password) {
+        g_variant_builder_init(&wireless_security_builder, G_VARIANT_TYPE("a{sv}"));
+
+        if (g_strcmp0(security, "WPA") == 0 || g_strcmp0(security, "WPA2") == 0) {
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("wpa-psk"));
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "auth-alg", g_variant_new_string("open"));
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "psk", g_variant_new_string(password));
+
+        } else if (g_strcmp0(security, "WPA3") == 0) {
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("sae")); /* WPA3 supports SAE */
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "psk", g_variant_new_string(password));
+
+        } else if (g_strcmp0(security, "WEP") == 0) {
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("none"));
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "wep-key-type", g_variant_new_uint32(0));
+            g_variant_builder_add(&wireless_security_builder, "{sv}", "wep-key0", g_variant_new_string(password));
+        }
+
+        nm_profile_builder_add_section(&profile, "802-11-wireless-security", &wireless_security_builder);
+    }
+
+    return nm_profile_builder_end(&profile);
+}
+
+/* Profile for a WPA-EAP network; dot1x_setting is the 802-1x a{sv} (floating is consumed) */
+GVariant *
+wifi_create_enterprise_connection_gvariant(const gchar *ssid, GVariant *dot1x_setting)
+{
+    NMProfileBuilder profile;
+    GVariantBuilder wireless_security_builder;
+
+    wifi_profile_init(&profile, ssid);
+
+    g_variant_builder_init(&wireless_security_builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("wpa-eap"));
+    nm_profile_builder_add_section(&profile, "802-11-wireless-security", &wireless_security_builder);
+
+    nm_profile_builder_add_setting(&profile, "802-1x", dot1x_setting);
+
+    return nm_profile_builder_end(&profile);
+}
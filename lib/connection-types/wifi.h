@@ -14,7 +14,11 @@
 
 G_BEGIN_DECLS
 
-/* TODO: Implement wifi connection type */
+GVariant *wifi_create_connection_gvariant            (const gchar *ssid,
+                                                      const gchar *security,
+                                                      const gchar *password);
+GVariant *wifi_create_enterprise_connection_gvariant (const gchar *ssid,
+                                                      GVariant *dot1x_setting);
 
 G_END_DECLS
 
@@ -12,5 +12,103 @@
 #endif
 
 #include "nm-connection.h"
+#include <uuid/uuid.h>
 
-/* TODO: Implement connection abstraction */
+/* Length of a textual UUID including the terminating NUL */
+#define PROFILE_UUID_LEN 37
+
+static GVariant *
+profile_method_auto_new(void)
+{
+    GVariantBuilder section;
+
+    g_variant_builder_init(&section, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&section, "{sv}", "method", g_variant_new_string("auto"));
+
+    return g_variant_ref_sink(g_variant_builder_end(&section));
+}
+
+/* Built once and never freed; every profile holds a reference to the same instance */
+GVariant *
+nm_profile_ipv4_auto(void)
+{
+    static GVariant *ipv4_auto = NULL;
+
+    if (g_once_init_enter(&ipv4_auto))
+        g_once_init_leave(&ipv4_auto, profile_method_auto_new());
+
+    return ipv4_auto;
+}
+
+GVariant *
+nm_profile_ipv6_auto(void)
+{
+    static GVariant *ipv6_auto = NULL;
+
+    if (g_once_init_enter(&ipv6_auto))
+        g_once_init_leave(&ipv6_auto, profile_method_auto_new());
+
+    return ipv6_auto;
+}
+
+void
+nm_profile_builder_init(NMProfileBuilder *profile, const gchar *type, const gchar *id)
+{
+    GVariantBuilder section;
+    gchar uuid[PROFILE_UUID_LEN];
+    uuid_t uuid_bin;
+
+    uuid_generate(uuid_bin);
+    uuid_unparse_lower(uuid_bin, uuid);
+
+    g_variant_builder_init(&profile->builder, G_VARIANT_TYPE("a{sa{sv}}"));
+    profile->has_ipv4 = FALSE;
+    profile->has_ipv6 = FALSE;
+
+    g_variant_builder_init(&section, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&section, "{sv}", "type", g_variant_new_string(type));
+    g_variant_builder_add(&section, "{sv}", "id", g_variant_new_string(id));
+    g_variant_builder_add(&section, "{sv}", "uuid", g_variant_new_string(uuid));
+    g_variant_builder_add(&section, "{sv}", "autoconnect", g_variant_new_boolean(TRUE));
+    nm_profile_builder_add_section(profile, "connection", &section);
+}
+
+/* Add a finished a{sv} setting; a floating reference is consumed */
+void
+nm_profile_builder_add_setting(NMProfileBuilder *profile, const gchar *name, GVariant *setting)
+{
+    g_return_if_fail(g_variant_is_of_type(setting, G_VARIANT_TYPE_VARDICT));
+
+    if (g_strcmp0(name, "ipv4") == 0)
+        profile->has_ipv4 = TRUE;
+    else if (g_strcmp0(name, "ipv6") == 0)
+        profile->has_ipv6 = TRUE;
+
+    g_variant_builder_add(&profile->builder, "{s@a{sv}}", name, setting);
+}
+
+/* Close a stack-allocated a{sv} builder and add it as a setting */
+void
+nm_profile_builder_add_section(NMProfileBuilder *profile, const gchar *name, GVariantBuilder *section)
+{
+    nm_profile_builder_add_setting(profile, name, g_variant_builder_end(section));
+}
+
+/* Returns a floating a{sa{sv}} dictionary */
+GVariant *
+nm_profile_builder_end(NMProfileBuilder *profile)
+{
+    if (!profile->has_ipv4)
+        nm_profile_builder_add_setting(profile, "ipv4", nm_profile_ipv4_auto());
+    if (!profile->has_ipv6)
+        nm_profile_builder_add_setting(profile, "ipv6", nm_profile_ipv6_auto());
+
+    return g_variant_builder_end(&profile->builder);
+}
+
+/* Abandon a profile without ending it */
+void
+nm_profile_builder_clear(NMProfileBuilder *profile)
+{
+    g_variant_builder_clear(&profile->builder);
+}
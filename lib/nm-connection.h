@@ -7,15 +7,42 @@
  * (at your option) any later version.
  */
 
-#ifndef __NM_CONNECTION_H__
-#define __NM_CONNECTION_H__
+/* Guard differs from libnm's own nm-connection.h, which is often included too */
+#ifndef __XFCE_NM_CONNECTION_H__
+#define __XFCE_NM_CONNECTION_H__
 
 #include <glib.h>
 
 G_BEGIN_DECLS
 
-/* TODO: Implement connection abstraction */
+/*
+ * Builder for the a{sa{sv}} settings dictionary handed to
+ * AddAndActivateConnection. It lives on the caller's stack; the
+ * "connection" section is written by init and the ipv4/ipv6 sections
+ * default to shared "auto" dictionaries when the caller adds none.
+ */
+typedef struct {
+    GVariantBuilder builder;
+    gboolean        has_ipv4;
+    gboolean        has_ipv6;
+} NMProfileBuilder;
+
+void      nm_profile_builder_init        (NMProfileBuilder *profile,
+                                          const gchar *type,
+                                          const gchar *id);
+void      nm_profile_builder_add_setting (NMProfileBuilder *profile,
+                                          const gchar *name,
+                                          GVariant *setting);
+void      nm_profile_builder_add_section (NMProfileBuilder *profile,
+                                          const gchar *name,
+                                          GVariantBuilder *section);
+GVariant *nm_profile_builder_end         (NMProfileBuilder *profile);
+void      nm_profile_builder_clear       (NMProfileBuilder *profile);
+
+/* Shared, immutable setting dictionaries */
+GVariant *nm_profile_ipv4_auto           (void);
+GVariant *nm_profile_ipv6_auto           (void);
 
 G_END_DECLS
 
-#endif /* __NM_CONNECTION_H__ */
+#endif /* __XFCE_NM_CONNECTION_H__ */
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+
+#include "connection-tooltip.h"
+#include "utils.h"
+
+struct _ConnectionTooltip {
+    GtkWidget    *widget;         /* not owned */
+    NMInterface  *nm_interface;
+    guint         changed_listener;
+
+    /* When the primary connection was seen to come up, 0 if that was before we started */
+    gchar        *active_path;
+    gint64        active_since;
+
+    UsageLedger  *ledger;         /* not owned, NULL for none */
+    guint         billing_day;
+};
+
+/* The interface's IPv4 address, or else a global IPv6 one; NULL if it has none */
+static gchar *
+connection_tooltip_read_address(const gchar *interface)
+{
+    struct ifaddrs *addrs, *ifa;
+    gchar buffer[INET6_ADDRSTRLEN];
+    gchar *ipv6 = NULL, *address = NULL;
+
+    if (!interface || getifaddrs(&addrs) != 0)
+        return NULL;
+
+    for (ifa = addrs; ifa != NULL && !address; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || g_strcmp0(ifa->ifa_name, interface) != 0)
+            continue;
+
+        if (ifa->ifa_addr->sa_family == AF_INET) {
+            struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
+
+            if (inet_ntop(AF_INET, &sin->sin_addr, buffer, sizeof(buffer)))
+                address = g_strdup(buffer);
+        } else if (ifa->ifa_addr->sa_family == AF_INET6 && !ipv6) {
+            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
+
+            if (!IN6_IS_ADDR_LINKLOCAL(&sin6->sin6_addr) &&
+                inet_ntop(AF_INET6, &sin6->sin6_addr, buffer, sizeof(buffer)))
+                ipv6 = g_strdup(buffer);
+        }
+    }
+    freeifaddrs(addrs);
+
+    if (address) {
+        g_free(ipv6);
+        return address;
+    }
+
+    return ipv6;
+}
+
+/* Link speed in Mbit/s from sysfs, 0 if the driver does not say */
+static guint
+connection_tooltip_read_speed(const gchar *interface)
+{
+    gchar *filename, *contents = NULL;
+    gint64 speed = 0;
+
+    if (!interface)
+        return 0;
+
+    filename = g_strdup_printf("/sys/class/net/%s/speed", interface);
+    if (g_file_get_contents(filename, &contents, NULL, NULL))
+        speed = g_ascii_strtoll(contents, NULL, 10);
+    g_free(contents);
+    g_free(filename);
+
+    return speed > 0 ? (guint)speed : 0;
+}
+
+static NMAccessPointInfo *
+connection_tooltip_find_active_ap(NMInterface *nm_interface, NMDeviceInfo *device_info)
+{
+    GList *access_points, *ap;
+    NMAccessPointInfo *found = NULL;
+
+    if (!device_info->specific.wifi.active_ap)
+        return NULL;
+
+    access_points = nm_interface_get_access_points(nm_interface, device_info->path);
+    for (ap = access_points; ap != NULL; ap = ap->next) {
+        NMAccessPointInfo *ap_info = ap->data;
+
+        if (g_strcmp0(ap_info->path, device_info->specific.wifi.active_ap) == 0) {
+            found = nm_interface_copy_ap_info(ap_info);
+            break;
+        }
+    }
+    g_list_free_full(access_points, (GDestroyNotify)nm_interface_free_ap_info);
+
+    return found;
+}
+
+static void
+connection_tooltip_append_device(ConnectionTooltip *tooltip, GString *markup, NMDeviceInfo *device_info)
+{
+    gchar *address, *line;
+
+    line = g_markup_printf_escaped("\nDevice: %s (%s)",
+                                   device_info->interface ? device_info->interface : "unknown",
+                                   nm_interface_device_type_to_string(device_info->type));
+    g_string_append(markup, line);
+    g_free(line);
+
+    address = connection_tooltip_read_address(device_info->interface);
+    if (address) {
+        line = g_markup_printf_escaped("\nAddress: %s", address);
+        g_string_append(markup, line);
+        g_free(line);
+        g_free(address);
+    }
+
+    if (device_info->type == NM_DEVICE_TYPE_WIFI) {
+        NMAccessPointInfo *ap_info = connection_tooltip_find_active_ap(tooltip->nm_interface, device_info);
+        guint channel;
+
+        if (!ap_info)
+            return;
+
+        g_string_append_printf(markup, "\nSignal: %u%%", ap_info->strength);
+        channel = nm_interface_ap_channel(ap_info->frequency);
+        if (channel)
+            g_string_append_printf(markup, ", %s channel %u", nm_interface_ap_band(ap_info->frequency), channel);
+        nm_interface_free_ap_info(ap_info);
+
+        if (device_info->specific.wifi.bitrate)
+            g_string_append_printf(markup, "\nBitrate: %u Mbit/s", device_info->specific.wifi.bitrate / 1000);
+    } else {
+        guint speed = connection_tooltip_read_speed(device_info->interface);
+
+        if (speed) {
+            /* Mbit/s to bytes per second */
+            gchar *rate = utils_format_bandwidth((guint64)speed * 1000000 / 8);
+
+            g_string_append_printf(markup, "\nLink speed: %s/s", rate);
+            g_free(rate);
+        }
+    }
+}
+
+/* Built from scratch on every call */
+gchar *
+connection_tooltip_get_markup(ConnectionTooltip *tooltip)
+{
+    NMActiveConnectionInfo *primary;
+    NMDeviceInfo *device_info = NULL;
+    GString *markup;
+    gchar *line;
+
+    if (!tooltip->nm_interface)
+        return g_strdup("NetworkManager is not available");
+
+    primary = nm_interface_get_primary_connection(tooltip->nm_interface);
+    if (!primary)
+        return g_strdup("Not connected");
+
+    markup = g_string_new(NULL);
+    line = g_markup_printf_escaped("<b>%s</b>", primary->id ? primary->id : "Connected");
+    g_string_append(markup, line);
+    g_free(line);
+
+    if (primary->vpn)
+        g_string_append(markup, " (VPN)");
+
+    if (primary->devices && primary->devices[0])
+        device_info = nm_interface_get_device_info(tooltip->nm_interface, primary->devices[0]);
+    if (device_info)
+        connection_tooltip_append_device(tooltip, markup, device_info);
+
+    if (tooltip->active_since &&
+        g_strcmp0(tooltip->active_path, primary->path) == 0) {
+        gchar *span = utils_format_time_span((g_get_monotonic_time() - tooltip->active_since) /
+                                             G_USEC_PER_SEC);
+
+        g_string_append_printf(markup, "\nConnected for %s", span);
+        g_free(span);
+    }
+
+    if (tooltip->ledger && usage_ledger_is_metered_type(primary->type) && primary->uuid) {
+        guint32 first_day, last_day;
+        guint64 rx_bytes, tx_bytes;
+        gchar *used;
+
+        usage_ledger_billing_period(usage_ledger_today(), tooltip->billing_day, &first_day, &last_day);
+        usage_ledger_get_usage(tooltip->ledger, primary->uuid, first_day, last_day, &rx_bytes, &tx_bytes);
+        used = utils_format_bandwidth(rx_bytes + tx_bytes);
+        g_string_append_printf(markup, "\nData used this period: %s", used);
+        g_free(used);
+    }
+
+    return g_string_free(markup, FALSE);
+}
+
+static gboolean
+on_query_tooltip(GtkWidget *widget, gint x, gint y, gboolean keyboard_mode,
+                 GtkTooltip *gtk_tooltip, ConnectionTooltip *tooltip)
+{
+    gchar *markup = connection_tooltip_get_markup(tooltip);
+
+    gtk_tooltip_set_markup(gtk_tooltip, markup);
+    g_free(markup);
+
+    return TRUE;
+}
+
+/*
+ * Note when the primary connection changes so the tooltip can say how long
+ * it has been up. A connection already up at startup has no known start.
+ */
+static void
+connection_tooltip_track_primary(ConnectionTooltip *tooltip, gboolean startup)
+{
+    NMActiveConnectionInfo *primary = nm_interface_get_primary_connection(tooltip->nm_interface);
+
+    if (!primary || primary->state != NM_ACTIVE_CONNECTION_STATE_ACTIVATED) {
+        g_clear_pointer(&tooltip->active_path, g_free);
+        tooltip->active_since = 0;
+        return;
+    }
+
+    if (g_strcmp0(tooltip->active_path, primary->path) == 0)
+        return;
+
+    g_free(tooltip->active_path);
+    tooltip->active_path = g_strdup(primary->path);
+    tooltip->active_since = startup ? 0 : g_get_monotonic_time();
+}
+
+static void
+on_nm_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data)
+{
+    connection_tooltip_track_primary((ConnectionTooltip *)user_data, FALSE);
+}
+
+ConnectionTooltip *
+connection_tooltip_new(GtkWidget *widget, NMInterface *nm_interface)
+{
+    ConnectionTooltip *tooltip;
+
+    tooltip = g_new0(ConnectionTooltip, 1);
+    tooltip->widget = widget;
+    tooltip->nm_interface = nm_interface;
+
+    if (nm_interface) {
+        connection_tooltip_track_primary(tooltip, TRUE);
+        tooltip->changed_listener = nm_interface_add_changed_listener(nm_interface,
+                                                                      NM_INTERFACE_CHANGED_STATE |
+                                                                      NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS,
+                                                                      on_nm_changed, tooltip);
+    }
+
+    gtk_widget_set_has_tooltip(widget, TRUE);
+    g_signal_connect(widget, "query-tooltip", G_CALLBACK(on_query_tooltip), tooltip);
+
+    return tooltip;
+}
+
+void
+connection_tooltip_set_usage_ledger(ConnectionTooltip *tooltip, UsageLedger *ledger, guint billing_day)
+{
+    tooltip->ledger = ledger;
+    tooltip->billing_day = billing_day;
+}
+
+void
+connection_tooltip_free(ConnectionTooltip *tooltip)
+{
+    if (!tooltip)
+        return;
+
+    if (tooltip->changed_listener)
+        nm_interface_remove_changed_listener(tooltip->nm_interface, tooltip->changed_listener);
+    g_signal_handlers_disconnect_by_data(tooltip->widget, tooltip);
+    g_free(tooltip->active_path);
+    g_free(tooltip);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __CONNECTION_TOOLTIP_H__
+#define __CONNECTION_TOOLTIP_H__
+
+#include <gtk/gtk.h>
+#include "nm-interface.h"
+#include "usage-ledger.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The panel button's tooltip: details of the primary connection, built
+ * from the interface's cached state when GTK asks for the tooltip and
+ * not kept up to date in between. Address and link speed are read from
+ * the kernel at that moment.
+ */
+typedef struct _ConnectionTooltip ConnectionTooltip;
+
+ConnectionTooltip *connection_tooltip_new        (GtkWidget *widget,
+                                                  NMInterface *nm_interface);
+void               connection_tooltip_free       (ConnectionTooltip *tooltip);
+gchar             *connection_tooltip_get_markup (ConnectionTooltip *tooltip);
+
+/* Show the data a metered connection used in the current billing period */
+void               connection_tooltip_set_usage_ledger (ConnectionTooltip *tooltip,
+                                                        UsageLedger *ledger,
+                                                        guint billing_day);
+
+G_END_DECLS
+
+#endif /* __CONNECTION_TOOLTIP_H__ */
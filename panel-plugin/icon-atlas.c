@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "icon-atlas.h"
+#include "icon-cache.h"
+
+#define ICON_ATLAS_DEFAULT_SIZE 16
+
+typedef struct {
+    gchar           *icon_name;
+    gchar           *emblem_name;   /* NULL for none */
+    cairo_surface_t *surface;       /* NULL if the theme lacks the icon */
+} AtlasVariant;
+
+struct _IconAtlas {
+    IconCache            *cache;
+    GArray               *variants;
+    gint                  pixel_size;
+
+    IconAtlasChangedFunc  changed_func;
+    gpointer              user_data;
+
+    guint                 n_renders;
+};
+
+static void
+icon_atlas_variant_clear(gpointer data)
+{
+    AtlasVariant *variant = data;
+
+    g_free(variant->icon_name);
+    g_free(variant->emblem_name);
+    g_clear_pointer(&variant->surface, cairo_surface_destroy);
+}
+
+/* base with emblem drawn at half size over its lower right corner */
+static cairo_surface_t *
+icon_atlas_compose(IconAtlas *atlas, cairo_surface_t *base, cairo_surface_t *emblem)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    gdouble scale_x, scale_y;
+    gint offset = atlas->pixel_size - MAX(atlas->pixel_size / 2, 1);
+
+    cairo_surface_get_device_scale(base, &scale_x, &scale_y);
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                         atlas->pixel_size * scale_x,
+                                         atlas->pixel_size * scale_y);
+    cairo_surface_set_device_scale(surface, scale_x, scale_y);
+
+    cr = cairo_create(surface);
+    cairo_set_source_surface(cr, base, 0, 0);
+    cairo_paint(cr);
+    cairo_set_source_surface(cr, emblem, offset, offset);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+
+    return surface;
+}
+
+static void
+icon_atlas_render_variant(IconAtlas *atlas, AtlasVariant *variant)
+{
+    cairo_surface_t *base, *emblem = NULL;
+
+    g_clear_pointer(&variant->surface, cairo_surface_destroy);
+
+    base = icon_cache_lookup_for_size(atlas->cache, variant->icon_name, atlas->pixel_size);
+    if (!base)
+        return;
+
+    if (variant->emblem_name)
+        emblem = icon_cache_lookup_for_size(atlas->cache, variant->emblem_name,
+                                            MAX(atlas->pixel_size / 2, 1));
+
+    /* A missing emblem leaves the plain icon */
+    if (emblem)
+        variant->surface = icon_atlas_compose(atlas, base, emblem);
+    else
+        variant->surface = cairo_surface_reference(base);
+}
+
+static void
+icon_atlas_render(IconAtlas *atlas)
+{
+    guint i;
+
+    for (i = 0; i < atlas->variants->len; i++)
+        icon_atlas_render_variant(atlas, &g_array_index(atlas->variants, AtlasVariant, i));
+
+    atlas->n_renders++;
+}
+
+/* The size, or the theme, scale or color of the widget changed */
+static void
+on_cache_invalidated(gpointer user_data)
+{
+    IconAtlas *atlas = (IconAtlas *)user_data;
+
+    icon_atlas_render(atlas);
+
+    if (atlas->changed_func)
+        atlas->changed_func(atlas->user_data);
+}
+
+IconAtlas *
+icon_atlas_new(GtkWidget *widget, IconAtlasChangedFunc changed_func, gpointer user_data)
+{
+    IconAtlas *atlas;
+
+    atlas = g_new0(IconAtlas, 1);
+    atlas->cache = icon_cache_new(widget, on_cache_invalidated, atlas);
+    atlas->variants = g_array_new(FALSE, TRUE, sizeof(AtlasVariant));
+    g_array_set_clear_func(atlas->variants, icon_atlas_variant_clear);
+    atlas->pixel_size = ICON_ATLAS_DEFAULT_SIZE;
+    atlas->changed_func = changed_func;
+    atlas->user_data = user_data;
+
+    return atlas;
+}
+
+void
+icon_atlas_free(IconAtlas *atlas)
+{
+    if (!atlas)
+        return;
+
+    g_array_free(atlas->variants, TRUE);
+    icon_cache_free(atlas->cache);
+    g_free(atlas);
+}
+
+/* Add a variant, rendered straight away; returns its index for icon_atlas_get */
+guint
+icon_atlas_add(IconAtlas *atlas, const gchar *icon_name, const gchar *emblem_name)
+{
+    AtlasVariant variant = { 0 };
+
+    variant.icon_name = g_strdup(icon_name);
+    variant.emblem_name = g_strdup(emblem_name);
+    g_array_append_val(atlas->variants, variant);
+
+    icon_atlas_render_variant(atlas, &g_array_index(atlas->variants, AtlasVariant,
+                                                    atlas->variants->len - 1));
+
+    return atlas->variants->len - 1;
+}
+
+/* Render every variant for pixel_size, unless that is the size already */
+void
+icon_atlas_set_size(IconAtlas *atlas, gint pixel_size)
+{
+    pixel_size = MAX(pixel_size, 1);
+    if (pixel_size == atlas->pixel_size)
+        return;
+
+    /* Dropping the cache's icons at the old size renders the new ones */
+    atlas->pixel_size = pixel_size;
+    icon_cache_invalidate(atlas->cache);
+}
+
+gint
+icon_atlas_get_size(IconAtlas *atlas)
+{
+    return atlas->pixel_size;
+}
+
+/* Owned by the atlas and valid until the changed function is called */
+cairo_surface_t *
+icon_atlas_get(IconAtlas *atlas, guint variant)
+{
+    g_return_val_if_fail(variant < atlas->variants->len, NULL);
+
+    return g_array_index(atlas->variants, AtlasVariant, variant).surface;
+}
+
+guint
+icon_atlas_get_n_renders(IconAtlas *atlas)
+{
+    return atlas->n_renders;
+}
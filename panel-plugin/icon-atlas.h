@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __ICON_ATLAS_H__
+#define __ICON_ATLAS_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A fixed set of icons, each optionally with an emblem in its lower right
+ * corner, rendered together for one pixel size. Getting a variant is an
+ * array lookup. Everything is rendered again when the size changes or
+ * when the icon theme, scale factor or color of the widget does, after
+ * which the changed function is called.
+ */
+typedef struct _IconAtlas IconAtlas;
+
+typedef void (*IconAtlasChangedFunc) (gpointer user_data);
+
+IconAtlas       *icon_atlas_new           (GtkWidget *widget,
+                                           IconAtlasChangedFunc changed_func,
+                                           gpointer user_data);
+void             icon_atlas_free          (IconAtlas *atlas);
+guint            icon_atlas_add           (IconAtlas *atlas,
+                                           const gchar *icon_name,
+                                           const gchar *emblem_name);
+void             icon_atlas_set_size      (IconAtlas *atlas,
+                                           gint pixel_size);
+gint             icon_atlas_get_size      (IconAtlas *atlas);
+cairo_surface_t *icon_atlas_get           (IconAtlas *atlas,
+                                           guint variant);
+
+/* Counter for tests: times the whole set was rendered */
+guint            icon_atlas_get_n_renders (IconAtlas *atlas);
+
+G_END_DECLS
+
+#endif /* __ICON_ATLAS_H__ */
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "icon-cache.h"
+
+struct _IconCache {
+    GtkWidget               *widget;        /* not owned */
+    GtkIconTheme            *icon_theme;    /* ref held */
+
+    /* "name:size" -> cairo_surface_t, NULL for icons the theme lacks */
+    GHashTable              *surfaces;
+    gint                     scale;
+    GdkRGBA                  color;
+
+    IconCacheInvalidateFunc  invalidate_func;
+    gpointer                 user_data;
+
+    guint                    hits;
+    guint                    misses;
+};
+
+static void
+icon_cache_surface_free(gpointer surface)
+{
+    if (surface)
+        cairo_surface_destroy(surface);
+}
+
+static void
+icon_cache_get_color(IconCache *cache, GdkRGBA *color)
+{
+    GtkStyleContext *context = gtk_widget_get_style_context(cache->widget);
+
+    gtk_style_context_get_color(context, gtk_style_context_get_state(context), color);
+}
+
+static void
+icon_cache_set_icon_theme(IconCache *cache)
+{
+    GtkIconTheme *icon_theme = gtk_icon_theme_get_for_screen(gtk_widget_get_screen(cache->widget));
+
+    if (icon_theme == cache->icon_theme)
+        return;
+
+    if (cache->icon_theme) {
+        g_signal_handlers_disconnect_by_data(cache->icon_theme, cache);
+        g_object_unref(cache->icon_theme);
+    }
+
+    cache->icon_theme = g_object_ref(icon_theme);
+    g_signal_connect_swapped(cache->icon_theme, "changed",
+                             G_CALLBACK(icon_cache_invalidate), cache);
+}
+
+static void
+on_scale_factor_changed(GtkWidget *widget, GParamSpec *pspec, IconCache *cache)
+{
+    if (gtk_widget_get_scale_factor(widget) != cache->scale)
+        icon_cache_invalidate(cache);
+}
+
+static void
+on_screen_changed(GtkWidget *widget, GdkScreen *previous_screen, IconCache *cache)
+{
+    icon_cache_set_icon_theme(cache);
+    icon_cache_invalidate(cache);
+}
+
+/* Style updates are frequent (classes, states); only a new color matters */
+static void
+on_style_updated(GtkWidget *widget, IconCache *cache)
+{
+    GdkRGBA color;
+
+    icon_cache_get_color(cache, &color);
+    if (!gdk_rgba_equal(&color, &cache->color))
+        icon_cache_invalidate(cache);
+}
+
+IconCache *
+icon_cache_new(GtkWidget *widget, IconCacheInvalidateFunc invalidate_func, gpointer user_data)
+{
+    IconCache *cache;
+
+    cache = g_new0(IconCache, 1);
+    cache->widget = widget;
+    cache->surfaces = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            g_free, icon_cache_surface_free);
+    cache->scale = gtk_widget_get_scale_factor(widget);
+    icon_cache_get_color(cache, &cache->color);
+    cache->invalidate_func = invalidate_func;
+    cache->user_data = user_data;
+
+    icon_cache_set_icon_theme(cache);
+
+    g_signal_connect(widget, "notify::scale-factor",
+                     G_CALLBACK(on_scale_factor_changed), cache);
+    g_signal_connect(widget, "screen-changed",
+                     G_CALLBACK(on_screen_changed), cache);
+    g_signal_connect(widget, "style-updated",
+                     G_CALLBACK(on_style_updated), cache);
+
+    return cache;
+}
+
+void
+icon_cache_free(IconCache *cache)
+{
+    if (!cache)
+        return;
+
+    g_signal_handlers_disconnect_by_data(cache->widget, cache);
+    g_signal_handlers_disconnect_by_data(cache->icon_theme, cache);
+    g_object_unref(cache->icon_theme);
+    g_hash_table_destroy(cache->surfaces);
+    g_free(cache);
+}
+
+/* Drop every surface; images keep theirs until they are set again */
+void
+icon_cache_invalidate(IconCache *cache)
+{
+    cache->scale = gtk_widget_get_scale_factor(cache->widget);
+    icon_cache_get_color(cache, &cache->color);
+
+    if (g_hash_table_size(cache->surfaces) == 0)
+        return;
+
+    g_hash_table_remove_all(cache->surfaces);
+
+    if (cache->invalidate_func)
+        cache->invalidate_func(cache->user_data);
+}
+
+static cairo_surface_t *
+icon_cache_render(IconCache *cache, const gchar *icon_name, gint pixel_size)
+{
+    GtkIconInfo *info;
+    GdkPixbuf *pixbuf;
+    cairo_surface_t *surface;
+    GError *error = NULL;
+
+    info = gtk_icon_theme_lookup_icon_for_scale(cache->icon_theme, icon_name, pixel_size,
+                                                cache->scale, GTK_ICON_LOOKUP_FORCE_SIZE);
+    if (!info)
+        return NULL;
+
+    /* Symbolic icons are recolored for the widget, others load as they are */
+    pixbuf = gtk_icon_info_load_symbolic_for_context(info, gtk_widget_get_style_context(cache->widget),
+                                                     NULL, &error);
+    g_object_unref(info);
+
+    if (!pixbuf) {
+        g_warning("Failed to load icon %s: %s", icon_name, error->message);
+        g_error_free(error);
+        return NULL;
+    }
+
+    surface = gdk_cairo_surface_create_from_pixbuf(pixbuf, cache->scale,
+                                                   gtk_widget_get_window(cache->widget));
+    g_object_unref(pixbuf);
+
+    return surface;
+}
+
+/*
+ * The surface for icon_name at size, rendered on first use. Owned by the
+ * cache and valid until the next invalidation. NULL if the theme has no
+ * such icon.
+ */
+cairo_surface_t *
+icon_cache_lookup(IconCache *cache, const gchar *icon_name, GtkIconSize size)
+{
+    gint width, height;
+
+    if (!gtk_icon_size_lookup(size, &width, &height))
+        width = height = 16;
+
+    return icon_cache_lookup_for_size(cache, icon_name, MAX(width, height));
+}
+
+/* As icon_cache_lookup, for a size in pixels such as the panel's */
+cairo_surface_t *
+icon_cache_lookup_for_size(IconCache *cache, const gchar *icon_name, gint pixel_size)
+{
+    gchar *key;
+    gpointer surface;
+
+    key = g_strdup_printf("%s:%d", icon_name, pixel_size);
+
+    if (g_hash_table_lookup_extended(cache->surfaces, key, NULL, &surface)) {
+        cache->hits++;
+        g_free(key);
+        return surface;
+    }
+
+    cache->misses++;
+    surface = icon_cache_render(cache, icon_name, pixel_size);
+    g_hash_table_insert(cache->surfaces, key, surface);
+
+    return surface;
+}
+
+/* Show icon_name in image, doing nothing if it already shows that surface */
+void
+icon_cache_set_image(IconCache *cache, GtkWidget *image, const gchar *icon_name, GtkIconSize size)
+{
+    cairo_surface_t *surface = icon_cache_lookup(cache, icon_name, size);
+
+    if (!surface) {
+        const gchar *current = NULL;
+
+        /* Let GtkImage show the theme's missing-image icon */
+        if (gtk_image_get_storage_type(GTK_IMAGE(image)) == GTK_IMAGE_ICON_NAME)
+            gtk_image_get_icon_name(GTK_IMAGE(image), &current, NULL);
+        if (g_strcmp0(current, icon_name) != 0)
+            gtk_image_set_from_icon_name(GTK_IMAGE(image), icon_name, size);
+        g_object_set_data(G_OBJECT(image), "icon-cache-surface", NULL);
+        return;
+    }
+
+    if (g_object_get_data(G_OBJECT(image), "icon-cache-surface") == surface)
+        return;
+
+    gtk_image_set_from_surface(GTK_IMAGE(image), surface);
+    g_object_set_data(G_OBJECT(image), "icon-cache-surface", surface);
+}
+
+guint
+icon_cache_get_hits(IconCache *cache)
+{
+    return cache->hits;
+}
+
+guint
+icon_cache_get_misses(IconCache *cache)
+{
+    return cache->misses;
+}
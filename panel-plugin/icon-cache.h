@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __ICON_CACHE_H__
+#define __ICON_CACHE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Icons rendered once for a widget's screen, scale and foreground color
+ * and shared by every image that shows them. The cache empties itself
+ * when the icon theme, the scale factor or the color changes, and calls
+ * the invalidate function so images can pick up the new surfaces.
+ */
+typedef struct _IconCache IconCache;
+
+typedef void (*IconCacheInvalidateFunc) (gpointer user_data);
+
+IconCache       *icon_cache_new           (GtkWidget *widget,
+                                           IconCacheInvalidateFunc invalidate_func,
+                                           gpointer user_data);
+void             icon_cache_free          (IconCache *cache);
+cairo_surface_t *icon_cache_lookup        (IconCache *cache,
+                                           const gchar *icon_name,
+                                           GtkIconSize size);
+cairo_surface_t *icon_cache_lookup_for_size (IconCache *cache,
+                                           const gchar *icon_name,
+                                           gint pixel_size);
+void             icon_cache_set_image     (IconCache *cache,
+                                           GtkWidget *image,
+                                           const gchar *icon_name,
+                                           GtkIconSize size);
+void             icon_cache_invalidate    (IconCache *cache);
+
+/* Counters for debugging */
+guint            icon_cache_get_hits      (IconCache *cache);
+guint            icon_cache_get_misses    (IconCache *cache);
+
+G_END_DECLS
+
+#endif /* __ICON_CACHE_H__ */
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+#include <gio/gio.h>
+
+#include "netlink-monitor.h"
+
+/* In linux/if.h, which does not mix with net/if.h */
+#ifndef IFF_LOWER_UP
+#define IFF_LOWER_UP 0x10000
+#endif
+
+/* Large enough for any message of a link dump */
+#define NETLINK_MONITOR_BUFFER_SIZE 32768
+
+typedef struct {
+    GSource          source;
+    NetlinkMonitor  *monitor;
+    gpointer         tag;
+} NetlinkSource;
+
+struct _NetlinkMonitor {
+    gint             fd;
+    GSource         *source;
+    guint32          seq;
+    guint32          dump_seq;      /* 0 while no dump is running */
+    gboolean         dump_again;    /* asked for while one was running */
+
+    NetlinkLinkFunc  callback;
+    gpointer         user_data;
+
+    GHashTable      *links;         /* ifindex -> NetlinkLink, last seen state */
+    guint8          *buffer;
+};
+
+static void netlink_monitor_receive (NetlinkMonitor *monitor);
+
+static gboolean
+netlink_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data)
+{
+    netlink_monitor_receive(((NetlinkSource *)source)->monitor);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs netlink_source_funcs = {
+    NULL,
+    NULL,
+    netlink_source_dispatch,
+    NULL
+};
+
+static void
+netlink_monitor_parse_link(NetlinkMonitor *monitor, struct nlmsghdr *header)
+{
+    struct ifinfomsg *ifi = NLMSG_DATA(header);
+    struct rtattr *attr;
+    NetlinkLink parsed, *link;
+    gint length;
+    gboolean have_carrier = FALSE;
+
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi)))
+        return;
+
+    memset(&parsed, 0, sizeof(parsed));
+    parsed.ifindex = ifi->ifi_index;
+    parsed.removed = header->nlmsg_type == RTM_DELLINK;
+    parsed.up = (ifi->ifi_flags & IFF_UP) != 0;
+    parsed.carrier = (ifi->ifi_flags & IFF_LOWER_UP) != 0;
+
+    length = IFLA_PAYLOAD(header);
+    for (attr = IFLA_RTA(ifi); RTA_OK(attr, length); attr = RTA_NEXT(attr, length)) {
+        switch (attr->rta_type) {
+            case IFLA_IFNAME:
+                g_strlcpy(parsed.name, RTA_DATA(attr), MIN(sizeof(parsed.name), RTA_PAYLOAD(attr)));
+                break;
+            case IFLA_CARRIER:
+                if (RTA_PAYLOAD(attr) >= 1) {
+                    parsed.carrier = *(guint8 *)RTA_DATA(attr) != 0;
+                    have_carrier = TRUE;
+                }
+                break;
+            case IFLA_STATS64:
+                if (RTA_PAYLOAD(attr) >= sizeof(struct rtnl_link_stats64)) {
+                    struct rtnl_link_stats64 stats;
+
+                    /* Attributes are only 4-byte aligned */
+                    memcpy(&stats, RTA_DATA(attr), sizeof(stats));
+                    parsed.rx_bytes = stats.rx_bytes;
+                    parsed.rx_packets = stats.rx_packets;
+                    parsed.tx_bytes = stats.tx_bytes;
+                    parsed.tx_packets = stats.tx_packets;
+                    parsed.have_stats = TRUE;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    /* IFF_LOWER_UP says nothing about a link that is down */
+    if (!have_carrier && !parsed.up)
+        parsed.carrier = FALSE;
+
+    if (parsed.removed) {
+        monitor->callback(monitor, &parsed, monitor->user_data);
+        g_hash_table_remove(monitor->links, GUINT_TO_POINTER(parsed.ifindex));
+        return;
+    }
+
+    link = g_hash_table_lookup(monitor->links, GUINT_TO_POINTER(parsed.ifindex));
+    if (!link) {
+        link = g_new(NetlinkLink, 1);
+        g_hash_table_insert(monitor->links, GUINT_TO_POINTER(parsed.ifindex), link);
+    } else if (!parsed.have_stats && link->have_stats) {
+        /* Keep the last counters rather than losing them */
+        parsed.have_stats = TRUE;
+        parsed.rx_bytes = link->rx_bytes;
+        parsed.rx_packets = link->rx_packets;
+        parsed.tx_bytes = link->tx_bytes;
+        parsed.tx_packets = link->tx_packets;
+    }
+    *link = parsed;
+
+    monitor->callback(monitor, link, monitor->user_data);
+}
+
+static void
+netlink_monitor_dump_done(NetlinkMonitor *monitor)
+{
+    monitor->dump_seq = 0;
+
+    if (monitor->dump_again) {
+        GError *error = NULL;
+
+        monitor->dump_again = FALSE;
+        if (!netlink_monitor_request_dump(monitor, &error)) {
+            g_warning("Failed to request link state: %s", error->message);
+            g_error_free(error);
+        }
+    }
+}
+
+/* Everything queued on the socket, without blocking */
+static void
+netlink_monitor_receive(NetlinkMonitor *monitor)
+{
+    for (;;) {
+        struct nlmsghdr *header;
+        struct sockaddr_nl sender;
+        struct iovec iov = { monitor->buffer, NETLINK_MONITOR_BUFFER_SIZE };
+        struct msghdr message;
+        ssize_t received;
+        gint length;
+
+        memset(&sender, 0, sizeof(sender));
+        memset(&message, 0, sizeof(message));
+        message.msg_name = &sender;
+        message.msg_namelen = sizeof(sender);
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+
+        received = recvmsg(monitor->fd, &message, MSG_DONTWAIT);
+        if (received < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                /* Notifications were dropped; fetch the whole state again */
+                g_debug("Link notifications overran the socket, resynchronizing");
+                monitor->dump_seq = 0;
+                netlink_monitor_request_dump(monitor, NULL);
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                g_warning("Failed to receive link notifications: %s", g_strerror(errno));
+            return;
+        }
+
+        /* Only the kernel gets to tell us about links */
+        if (message.msg_namelen != sizeof(sender) || sender.nl_pid != 0) {
+            g_debug("Ignoring a netlink message from port %u", sender.nl_pid);
+            continue;
+        }
+
+        length = received;
+        for (header = (struct nlmsghdr *)monitor->buffer; NLMSG_OK(header, length);
+             header = NLMSG_NEXT(header, length)) {
+            switch (header->nlmsg_type) {
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                    netlink_monitor_parse_link(monitor, header);
+                    break;
+                case NLMSG_DONE:
+                    if (monitor->dump_seq && header->nlmsg_seq == monitor->dump_seq)
+                        netlink_monitor_dump_done(monitor);
+                    break;
+                case NLMSG_ERROR:
+                    if (header->nlmsg_len >= NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+                        struct nlmsgerr *err = NLMSG_DATA(header);
+
+                        if (err->error)
+                            g_warning("Link request failed: %s", g_strerror(-err->error));
+                    }
+                    if (monitor->dump_seq && header->nlmsg_seq == monitor->dump_seq)
+                        netlink_monitor_dump_done(monitor);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+/*
+ * Ask for every link's state and counters. The answer arrives through the
+ * callback from the main loop; asking again while a dump is still running
+ * starts another one once it is done.
+ */
+gboolean
+netlink_monitor_request_dump(NetlinkMonitor *monitor, GError **error)
+{
+    struct {
+        struct nlmsghdr   header;
+        struct ifinfomsg  ifi;
+    } request;
+
+    if (monitor->dump_seq) {
+        monitor->dump_again = TRUE;
+        return TRUE;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(request.ifi));
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++monitor->seq;
+    request.ifi.ifi_family = AF_UNSPEC;
+
+    if (send(monitor->fd, &request, request.header.nlmsg_len, 0) < 0) {
+        gint saved_errno = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                    "Failed to request link state: %s", g_strerror(saved_errno));
+        return FALSE;
+    }
+
+    monitor->dump_seq = request.header.nlmsg_seq;
+
+    return TRUE;
+}
+
+/* Subscribes to link notifications and requests the current state */
+NetlinkMonitor *
+netlink_monitor_new(NetlinkLinkFunc callback, gpointer user_data, GError **error)
+{
+    NetlinkMonitor *monitor;
+    struct sockaddr_nl address;
+    NetlinkSource *source;
+    gint fd;
+
+    g_return_val_if_fail(callback != NULL, NULL);
+
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (fd < 0) {
+        gint saved_errno = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                    "Failed to open rtnetlink socket: %s", g_strerror(saved_errno));
+        return NULL;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = RTMGRP_LINK;
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        gint saved_errno = errno;
+
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(saved_errno),
+                    "Failed to subscribe to link notifications: %s", g_strerror(saved_errno));
+        close(fd);
+        return NULL;
+    }
+
+    monitor = g_new0(NetlinkMonitor, 1);
+    monitor->fd = fd;
+    monitor->callback = callback;
+    monitor->user_data = user_data;
+    monitor->links = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    monitor->buffer = g_malloc(NETLINK_MONITOR_BUFFER_SIZE);
+
+    monitor->source = g_source_new(&netlink_source_funcs, sizeof(NetlinkSource));
+    source = (NetlinkSource *)monitor->source;
+    source->monitor = monitor;
+    source->tag = g_source_add_unix_fd(monitor->source, fd, G_IO_IN | G_IO_ERR | G_IO_HUP);
+    g_source_set_name(monitor->source, "NetlinkMonitor");
+    g_source_attach(monitor->source, NULL);
+
+    if (!netlink_monitor_request_dump(monitor, error)) {
+        netlink_monitor_free(monitor);
+        return NULL;
+    }
+
+    return monitor;
+}
+
+void
+netlink_monitor_free(NetlinkMonitor *monitor)
+{
+    if (!monitor)
+        return;
+
+    g_source_destroy(monitor->source);
+    g_source_unref(monitor->source);
+    close(monitor->fd);
+    g_hash_table_destroy(monitor->links);
+    g_free(monitor->buffer);
+    g_free(monitor);
+}
+
+/* The last state seen of a link, NULL if it is unknown or gone */
+const NetlinkLink *
+netlink_monitor_lookup(NetlinkMonitor *monitor, guint ifindex)
+{
+    return g_hash_table_lookup(monitor->links, GUINT_TO_POINTER(ifindex));
+}
+
+const NetlinkLink *
+netlink_monitor_lookup_name(NetlinkMonitor *monitor, const gchar *name)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    if (!name)
+        return NULL;
+
+    g_hash_table_iter_init(&iter, monitor->links);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        NetlinkLink *link = value;
+
+        if (strcmp(link->name, name) == 0)
+            return link;
+    }
+
+    return NULL;
+}
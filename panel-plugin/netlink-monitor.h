@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __NETLINK_MONITOR_H__
+#define __NETLINK_MONITOR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Link notifications straight from the kernel over rtnetlink. The socket
+ * is polled by a GSource on the default main context, so a pulled cable is
+ * seen without waiting for NetworkManager to process it. Every
+ * RTM_NEWLINK also carries the link's 64-bit counters; the kernel does not
+ * announce counter changes, so netlink_monitor_request_dump() asks for
+ * fresh ones.
+ */
+#define NETLINK_MONITOR_NAME_MAX 16   /* IFNAMSIZ */
+
+typedef struct {
+    guint     ifindex;
+    gchar     name[NETLINK_MONITOR_NAME_MAX];
+    gboolean  removed;      /* RTM_DELLINK */
+    gboolean  up;           /* administratively up */
+    gboolean  carrier;      /* lower layer up */
+
+    gboolean  have_stats;
+    guint64   rx_bytes;
+    guint64   rx_packets;
+    guint64   tx_bytes;
+    guint64   tx_packets;
+} NetlinkLink;
+
+typedef struct _NetlinkMonitor NetlinkMonitor;
+
+typedef void (*NetlinkLinkFunc) (NetlinkMonitor *monitor,
+                                 const NetlinkLink *link,
+                                 gpointer user_data);
+
+NetlinkMonitor    *netlink_monitor_new          (NetlinkLinkFunc callback,
+                                                 gpointer user_data,
+                                                 GError **error);
+void               netlink_monitor_free         (NetlinkMonitor *monitor);
+gboolean           netlink_monitor_request_dump (NetlinkMonitor *monitor,
+                                                 GError **error);
+const NetlinkLink *netlink_monitor_lookup       (NetlinkMonitor *monitor,
+                                                 guint ifindex);
+const NetlinkLink *netlink_monitor_lookup_name  (NetlinkMonitor *monitor,
+                                                 const gchar *name);
+
+G_END_DECLS
+
+#endif /* __NETLINK_MONITOR_H__ */
@@ -0,0 +1,862 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "network-list-model.h"
+#include "network-sort-policy.h"
+#include <string.h>
+
+/* Wired entries are keyed by device, Wi-Fi entries by security and SSID */
+#define WIRED_KEY_PREFIX "wired:"
+#define WIFI_KEY_PREFIX  "wifi:"
+
+/* One BSSID of a Wi-Fi entry */
+typedef struct {
+    NMAccessPointInfo *ap_info;
+    gchar             *device_path;
+    gboolean           connected;
+    guint              generation;   /* last update that listed it */
+} NetworkMember;
+
+struct _NetworkEntry {
+    GObject            parent_instance;
+
+    gchar             *key;
+    NetworkEntryKind   kind;
+    gchar             *name;
+    gchar             *search_key;   /* name, normalized and case-folded */
+    guint              strength;
+    gboolean           secure;
+    gboolean           connected;
+    gchar             *device_path;
+    NetworkSortKey     sort_key;
+    gboolean           has_bucket;   /* sort_key.bucket was set once */
+
+    /* Wi-Fi only: every AP broadcasting this network */
+    GHashTable        *members;      /* AP path -> NetworkMember */
+    NetworkMember     *best;         /* strongest member */
+    guint              n_connected;  /* members that are the active AP */
+
+    guint              generation;   /* last update that listed it */
+    gboolean           dirty;        /* fields changed during this update */
+    gboolean           visible;      /* passes the current filter */
+};
+
+enum {
+    ENTRY_CHANGED,
+    N_ENTRY_SIGNALS
+};
+
+static guint entry_signals[N_ENTRY_SIGNALS];
+
+G_DEFINE_TYPE(NetworkEntry, network_entry, G_TYPE_OBJECT)
+
+static void
+network_entry_finalize(GObject *object)
+{
+    NetworkEntry *entry = NETWORK_ENTRY(object);
+
+    g_free(entry->key);
+    g_free(entry->name);
+    g_free(entry->search_key);
+    g_free(entry->device_path);
+    if (entry->members)
+        g_hash_table_destroy(entry->members);
+
+    G_OBJECT_CLASS(network_entry_parent_class)->finalize(object);
+}
+
+static void
+network_entry_class_init(NetworkEntryClass *klass)
+{
+    G_OBJECT_CLASS(klass)->finalize = network_entry_finalize;
+
+    entry_signals[ENTRY_CHANGED] = g_signal_new("changed",
+                                                G_TYPE_FROM_CLASS(klass),
+                                                G_SIGNAL_RUN_LAST,
+                                                0, NULL, NULL, NULL,
+                                                G_TYPE_NONE, 0);
+}
+
+static void
+network_entry_init(NetworkEntry *entry)
+{
+}
+
+const gchar *
+network_entry_get_key(NetworkEntry *entry)
+{
+    return entry->key;
+}
+
+NetworkEntryKind
+network_entry_get_kind(NetworkEntry *entry)
+{
+    return entry->kind;
+}
+
+const gchar *
+network_entry_get_name(NetworkEntry *entry)
+{
+    return entry->name;
+}
+
+guint
+network_entry_get_strength(NetworkEntry *entry)
+{
+    return entry->strength;
+}
+
+gboolean
+network_entry_get_secure(NetworkEntry *entry)
+{
+    return entry->secure;
+}
+
+gboolean
+network_entry_get_connected(NetworkEntry *entry)
+{
+    return entry->connected;
+}
+
+const gchar *
+network_entry_get_device_path(NetworkEntry *entry)
+{
+    return entry->device_path;
+}
+
+/* The strongest BSSID of a Wi-Fi entry, NULL for wired entries */
+const NMAccessPointInfo *
+network_entry_get_ap_info(NetworkEntry *entry)
+{
+    return entry->best ? entry->best->ap_info : NULL;
+}
+
+/* A copy that stays valid across refreshes, e.g. while a dialog is open */
+NMAccessPointInfo *
+network_entry_dup_ap_info(NetworkEntry *entry)
+{
+    return nm_interface_copy_ap_info(network_entry_get_ap_info(entry));
+}
+
+guint
+network_entry_get_n_bssids(NetworkEntry *entry)
+{
+    return entry->members ? g_hash_table_size(entry->members) : 0;
+}
+
+static gint
+network_bssid_compare(gconstpointer a, gconstpointer b)
+{
+    const NMAccessPointInfo *ap_a = *(const NMAccessPointInfo **)a;
+    const NMAccessPointInfo *ap_b = *(const NMAccessPointInfo **)b;
+
+    if (ap_a->strength != ap_b->strength)
+        return ap_a->strength > ap_b->strength ? -1 : 1;
+
+    return g_strcmp0(ap_a->path, ap_b->path);
+}
+
+/* The entry's access points, strongest first; free the array, not the items */
+GPtrArray *
+network_entry_get_bssids(NetworkEntry *entry)
+{
+    GPtrArray *bssids = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer value;
+
+    if (!entry->members)
+        return bssids;
+
+    g_hash_table_iter_init(&iter, entry->members);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_ptr_array_add(bssids, ((NetworkMember *)value)->ap_info);
+    g_ptr_array_sort(bssids, network_bssid_compare);
+
+    return bssids;
+}
+
+/* Search keys are compared after NFKC normalization and case folding */
+static gchar *
+network_search_key(const gchar *text)
+{
+    gchar *normalized, *folded;
+
+    normalized = g_utf8_normalize(text, -1, G_NORMALIZE_ALL);
+    if (!normalized) {
+        /* SSIDs are not guaranteed to be UTF-8 */
+        return g_ascii_strdown(text, -1);
+    }
+
+    folded = g_utf8_casefold(normalized, -1);
+    g_free(normalized);
+
+    return folded;
+}
+
+static void
+network_entry_set_string(NetworkEntry *entry, gchar **field, const gchar *value)
+{
+    if (g_strcmp0(*field, value) != 0) {
+        g_free(*field);
+        *field = g_strdup(value);
+        entry->dirty = TRUE;
+    }
+}
+
+static void
+network_entry_set_values(NetworkEntry *entry,
+                         const gchar *name,
+                         guint strength,
+                         gboolean secure,
+                         gboolean connected,
+                         const gchar *device_path)
+{
+    if (g_strcmp0(entry->name, name) != 0) {
+        g_free(entry->name);
+        entry->name = g_strdup(name);
+        g_free(entry->search_key);
+        entry->search_key = network_search_key(name);
+        entry->dirty = TRUE;
+    }
+    network_entry_set_string(entry, &entry->device_path, device_path);
+
+    if (entry->strength != strength || entry->secure != secure || entry->connected != connected) {
+        entry->strength = strength;
+        entry->secure = secure;
+        entry->connected = connected;
+        entry->dirty = TRUE;
+    }
+}
+
+static void
+network_member_free(NetworkMember *member)
+{
+    nm_interface_free_ap_info(member->ap_info);
+    g_free(member->device_path);
+    g_free(member);
+}
+
+/* A full scan is only needed when the best member weakens or goes away */
+static void
+network_entry_find_best(NetworkEntry *entry)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    entry->best = NULL;
+    g_hash_table_iter_init(&iter, entry->members);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        NetworkMember *member = value;
+
+        if (!entry->best || member->ap_info->strength > entry->best->ap_info->strength)
+            entry->best = member;
+    }
+}
+
+/* Show the group through its best member */
+static void
+network_entry_sync_group(NetworkEntry *entry)
+{
+    const NMAccessPointInfo *ap_info = entry->best->ap_info;
+
+    network_entry_set_values(entry, ap_info->ssid ? ap_info->ssid : "", ap_info->strength,
+                             g_strcmp0(ap_info->security, "None") != 0,
+                             entry->n_connected > 0, entry->best->device_path);
+}
+
+/* Takes ownership of ap_info */
+static void
+network_entry_update_member(NetworkEntry *entry,
+                            const gchar *device_path,
+                            NMAccessPointInfo *ap_info,
+                            gboolean connected,
+                            guint generation)
+{
+    NetworkMember *member = g_hash_table_lookup(entry->members, ap_info->path);
+    guint old_strength = 0;
+
+    if (!member) {
+        member = g_new0(NetworkMember, 1);
+        g_hash_table_insert(entry->members, g_strdup(ap_info->path), member);
+        entry->dirty = TRUE;
+    } else {
+        old_strength = member->ap_info->strength;
+        if (old_strength != ap_info->strength)
+            entry->dirty = TRUE;
+        nm_interface_free_ap_info(member->ap_info);
+    }
+
+    member->ap_info = ap_info;
+    member->generation = generation;
+    if (g_strcmp0(member->device_path, device_path) != 0) {
+        g_free(member->device_path);
+        member->device_path = g_strdup(device_path);
+    }
+    if (member->connected != connected) {
+        member->connected = connected;
+        if (connected)
+            entry->n_connected++;
+        else
+            entry->n_connected--;
+    }
+
+    if (!entry->best || ap_info->strength > entry->best->ap_info->strength)
+        entry->best = member;
+    else if (member == entry->best && ap_info->strength < old_strength)
+        network_entry_find_best(entry);
+
+    network_entry_sync_group(entry);
+}
+
+/* Drop members an update did not list; FALSE once the group is empty */
+static gboolean
+network_entry_drop_stale_members(NetworkEntry *entry, guint generation)
+{
+    GHashTableIter iter;
+    gpointer value;
+    gboolean lost_best = FALSE;
+
+    g_hash_table_iter_init(&iter, entry->members);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        NetworkMember *member = value;
+
+        if (member->generation == generation)
+            continue;
+
+        if (member->connected)
+            entry->n_connected--;
+        if (member == entry->best)
+            lost_best = TRUE;
+        g_hash_table_iter_remove(&iter);
+        entry->dirty = TRUE;
+    }
+
+    if (g_hash_table_size(entry->members) == 0)
+        return FALSE;
+
+    if (lost_best)
+        network_entry_find_best(entry);
+    network_entry_sync_group(entry);
+
+    return TRUE;
+}
+
+struct _NetworkListModel {
+    GObject     parent_instance;
+
+    GHashTable *entries;     /* key -> NetworkEntry, every known network */
+    GPtrArray  *visible;     /* NetworkEntry, sorted and filtered */
+    gchar      *filter_key;  /* search key of the filter text */
+    guint       generation;
+
+    /* SSID -> last use (guint64), saved connections listed this update */
+    GHashTable *known;
+    guint       n_moves;     /* entries that changed places last update */
+};
+
+static void network_list_model_iface_init(GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(NetworkListModel, network_list_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, network_list_model_iface_init))
+
+static GType
+network_list_model_get_item_type(GListModel *list)
+{
+    return NETWORK_TYPE_ENTRY;
+}
+
+static guint
+network_list_model_get_n_items(GListModel *list)
+{
+    return NETWORK_LIST_MODEL(list)->visible->len;
+}
+
+static gpointer
+network_list_model_get_item(GListModel *list, guint position)
+{
+    NetworkListModel *model = NETWORK_LIST_MODEL(list);
+
+    if (position >= model->visible->len)
+        return NULL;
+
+    return g_object_ref(g_ptr_array_index(model->visible, position));
+}
+
+static void
+network_list_model_iface_init(GListModelInterface *iface)
+{
+    iface->get_item_type = network_list_model_get_item_type;
+    iface->get_n_items = network_list_model_get_n_items;
+    iface->get_item = network_list_model_get_item;
+}
+
+static void
+network_list_model_finalize(GObject *object)
+{
+    NetworkListModel *model = NETWORK_LIST_MODEL(object);
+
+    g_ptr_array_unref(model->visible);
+    g_hash_table_destroy(model->entries);
+    g_hash_table_destroy(model->known);
+    g_free(model->filter_key);
+
+    G_OBJECT_CLASS(network_list_model_parent_class)->finalize(object);
+}
+
+static void
+network_list_model_class_init(NetworkListModelClass *klass)
+{
+    G_OBJECT_CLASS(klass)->finalize = network_list_model_finalize;
+}
+
+static void
+network_list_model_init(NetworkListModel *model)
+{
+    model->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_object_unref);
+    model->visible = g_ptr_array_new_with_free_func(g_object_unref);
+    model->filter_key = g_strdup("");
+    model->known = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+}
+
+NetworkListModel *
+network_list_model_new(void)
+{
+    return g_object_new(NETWORK_TYPE_LIST_MODEL, NULL);
+}
+
+/* As the sort policy says, then by name */
+static gint
+network_entry_compare(gconstpointer a, gconstpointer b)
+{
+    NetworkEntry *entry_a = *(NetworkEntry **)a;
+    NetworkEntry *entry_b = *(NetworkEntry **)b;
+    gint result;
+
+    result = network_sort_policy_compare(&entry_a->sort_key, &entry_b->sort_key);
+    if (result != 0)
+        return result;
+
+    result = g_utf8_collate(entry_a->name, entry_b->name);
+    if (result != 0)
+        return result;
+
+    return strcmp(entry_a->key, entry_b->key);
+}
+
+static gboolean
+network_list_model_matches(NetworkListModel *model, NetworkEntry *entry)
+{
+    return !*model->filter_key || strstr(entry->search_key, model->filter_key) != NULL;
+}
+
+static void
+network_entry_clear_visible(gpointer data, gpointer user_data)
+{
+    NETWORK_ENTRY(data)->visible = FALSE;
+}
+
+static void
+network_entry_set_visible(gpointer data, gpointer user_data)
+{
+    NETWORK_ENTRY(data)->visible = TRUE;
+}
+
+/*
+ * Entries in both lists a user would see jump: all but the longest run
+ * of them that keeps its order, found by patience sorting their old
+ * ranks in new order.
+ */
+static guint
+network_list_model_count_moves(GPtrArray *old_visible, GPtrArray *new_visible)
+{
+    GHashTable *in_new = g_hash_table_new(NULL, NULL);
+    GHashTable *old_ranks = g_hash_table_new(NULL, NULL);
+    guint *tails = g_new(guint, MAX(new_visible->len, 1));
+    guint i, rank = 0, common = 0, n_tails = 0;
+
+    for (i = 0; i < new_visible->len; i++)
+        g_hash_table_add(in_new, g_ptr_array_index(new_visible, i));
+
+    for (i = 0; i < old_visible->len; i++) {
+        gpointer entry = g_ptr_array_index(old_visible, i);
+
+        if (g_hash_table_contains(in_new, entry))
+            g_hash_table_insert(old_ranks, entry, GUINT_TO_POINTER(++rank));
+    }
+
+    /* tails[k] is the smallest rank ending an increasing run of k + 1 */
+    for (i = 0; i < new_visible->len; i++) {
+        guint old_rank = GPOINTER_TO_UINT(g_hash_table_lookup(old_ranks, g_ptr_array_index(new_visible, i)));
+        guint low = 0, high = n_tails;
+
+        if (old_rank == 0)
+            continue;
+
+        common++;
+        while (low < high) {
+            guint middle = (low + high) / 2;
+
+            if (tails[middle] < old_rank)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        tails[low] = old_rank;
+        if (low == n_tails)
+            n_tails++;
+    }
+
+    g_free(tails);
+    g_hash_table_destroy(old_ranks);
+    g_hash_table_destroy(in_new);
+
+    return common - n_tails;
+}
+
+/*
+ * Rebuild the visible array and tell views about the smallest range that
+ * differs: rows shared at the start and end of the old and new lists are
+ * left alone.
+ */
+static void
+network_list_model_update_visible(NetworkListModel *model)
+{
+    GPtrArray *visible;
+    GHashTableIter iter;
+    gpointer value;
+    guint old_len, new_len, prefix, suffix;
+
+    visible = g_ptr_array_new_with_free_func(g_object_unref);
+    g_hash_table_iter_init(&iter, model->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (network_list_model_matches(model, value))
+            g_ptr_array_add(visible, g_object_ref(value));
+    }
+    g_ptr_array_sort(visible, network_entry_compare);
+
+    model->n_moves = network_list_model_count_moves(model->visible, visible);
+
+    old_len = model->visible->len;
+    new_len = visible->len;
+
+    for (prefix = 0; prefix < old_len && prefix < new_len; prefix++) {
+        if (g_ptr_array_index(model->visible, prefix) != g_ptr_array_index(visible, prefix))
+            break;
+    }
+    for (suffix = 0; suffix < old_len - prefix && suffix < new_len - prefix; suffix++) {
+        if (g_ptr_array_index(model->visible, old_len - 1 - suffix) !=
+            g_ptr_array_index(visible, new_len - 1 - suffix))
+            break;
+    }
+
+    g_ptr_array_foreach(model->visible, network_entry_clear_visible, NULL);
+    g_ptr_array_foreach(visible, network_entry_set_visible, NULL);
+    g_ptr_array_unref(model->visible);
+    model->visible = visible;
+
+    if (prefix != old_len || old_len != new_len)
+        g_list_model_items_changed(G_LIST_MODEL(model), prefix,
+                                   old_len - prefix - suffix,
+                                   new_len - prefix - suffix);
+}
+
+void
+network_list_model_begin_update(NetworkListModel *model)
+{
+    model->generation++;
+    g_hash_table_remove_all(model->known);
+}
+
+static NetworkEntry *
+network_list_model_lookup(NetworkListModel *model, const gchar *key, NetworkEntryKind kind)
+{
+    NetworkEntry *entry = g_hash_table_lookup(model->entries, key);
+
+    if (!entry) {
+        entry = g_object_new(NETWORK_TYPE_ENTRY, NULL);
+        entry->key = g_strdup(key);
+        entry->kind = kind;
+        if (kind == NETWORK_ENTRY_WIFI)
+            entry->members = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                   (GDestroyNotify)network_member_free);
+        g_hash_table_insert(model->entries, entry->key, entry);
+    }
+    entry->generation = model->generation;
+
+    return entry;
+}
+
+/* Takes ownership of ap_info */
+void
+network_list_model_add_access_point(NetworkListModel *model,
+                                    const gchar *device_path,
+                                    NMAccessPointInfo *ap_info,
+                                    gboolean connected)
+{
+    NetworkEntry *entry;
+    gchar *key;
+
+    g_return_if_fail(ap_info != NULL && ap_info->path != NULL);
+
+    /* Every BSSID of a network shares one entry */
+    key = g_strconcat(WIFI_KEY_PREFIX, ap_info->security ? ap_info->security : "", ":",
+                      ap_info->ssid ? ap_info->ssid : "", NULL);
+    entry = network_list_model_lookup(model, key, NETWORK_ENTRY_WIFI);
+    network_entry_update_member(entry, device_path, ap_info, connected, model->generation);
+    g_free(key);
+}
+
+void
+network_list_model_add_wired(NetworkListModel *model,
+                             const gchar *device_path,
+                             gboolean connected)
+{
+    NetworkEntry *entry;
+    gchar *key;
+
+    key = g_strconcat(WIRED_KEY_PREFIX, device_path, NULL);
+    entry = network_list_model_lookup(model, key, NETWORK_ENTRY_WIRED);
+    network_entry_set_values(entry, "Wired Connection", 100, FALSE, connected, device_path);
+    g_free(key);
+}
+
+/* A saved Wi-Fi connection for ssid, last used at timestamp (0 for never) */
+void
+network_list_model_add_known(NetworkListModel *model,
+                             const gchar *ssid,
+                             guint64 timestamp)
+{
+    guint64 *last_used = g_hash_table_lookup(model->known, ssid);
+
+    if (!last_used) {
+        last_used = g_new0(guint64, 1);
+        g_hash_table_insert(model->known, g_strdup(ssid), last_used);
+    }
+    *last_used = MAX(*last_used, timestamp);
+}
+
+void
+network_list_model_end_update(NetworkListModel *model)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    /* Drop what was not listed this time */
+    g_hash_table_iter_init(&iter, model->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        NetworkEntry *entry = value;
+
+        if (entry->generation != model->generation ||
+            (entry->members && !network_entry_drop_stale_members(entry, model->generation))) {
+            g_hash_table_iter_remove(&iter);
+            continue;
+        }
+
+        /* The list position follows the bucket, not the raw strength */
+        entry->sort_key.connected = entry->connected;
+        if (!entry->has_bucket) {
+            entry->sort_key.bucket = network_sort_policy_bucket(entry->strength);
+            entry->has_bucket = TRUE;
+        } else {
+            network_sort_policy_update_bucket(&entry->sort_key.bucket, entry->strength);
+        }
+
+        if (entry->kind == NETWORK_ENTRY_WIFI) {
+            guint64 *last_used = g_hash_table_lookup(model->known, entry->name);
+
+            entry->sort_key.known = last_used != NULL;
+            entry->sort_key.last_used = last_used ? *last_used : 0;
+        }
+    }
+
+    network_list_model_update_visible(model);
+
+    /* Rows that did not move still need their contents refreshed */
+    g_hash_table_iter_init(&iter, model->entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        NetworkEntry *entry = value;
+
+        if (entry->dirty) {
+            entry->dirty = FALSE;
+            g_signal_emit(entry, entry_signals[ENTRY_CHANGED], 0);
+        }
+    }
+}
+
+/* Read the current devices and access points from NetworkManager */
+void
+network_list_model_refresh(NetworkListModel *model, NMInterface *nm_interface)
+{
+    GList *devices, *device;
+    GList *access_points, *ap;
+    GList *connections, *connection;
+
+    network_list_model_begin_update(model);
+
+    /* Saved Wi-Fi connections are named after their SSID */
+    connections = nm_interface_get_connections(nm_interface);
+    for (connection = connections; connection != NULL; connection = connection->next) {
+        NMConnectionInfo *connection_info = connection->data;
+
+        if (g_strcmp0(connection_info->type, "802-11-wireless") == 0 && connection_info->id)
+            network_list_model_add_known(model, connection_info->id, connection_info->timestamp);
+    }
+    g_list_free(connections);
+
+    devices = nm_interface_get_devices(nm_interface);
+    for (device = devices; device != NULL; device = device->next) {
+        NMDeviceInfo *device_info = device->data;
+
+        if (device_info->type == NM_DEVICE_TYPE_WIFI) {
+            access_points = nm_interface_get_access_points(nm_interface, device_info->path);
+
+            for (ap = access_points; ap != NULL; ap = ap->next) {
+                NMAccessPointInfo *ap_info = ap->data;
+
+                if (ap_info && ap_info->ssid) {
+                    gboolean connected = g_strcmp0(ap_info->path, device_info->specific.wifi.active_ap) == 0;
+
+                    /* The entry takes the AP info over */
+                    ap->data = NULL;
+                    network_list_model_add_access_point(model, device_info->path, ap_info, connected);
+                }
+            }
+
+            g_list_free_full(access_points, (GDestroyNotify)nm_interface_free_ap_info);
+        }
+
+        if (device_info->type == NM_DEVICE_TYPE_ETHERNET &&
+            device_info->state == NM_DEVICE_STATE_ACTIVATED) {
+            network_list_model_add_wired(model, device_info->path, TRUE);
+        }
+    }
+    g_list_free(devices);
+
+    network_list_model_end_update(model);
+}
+
+/*
+ * Move the visible array to visible, which must be sorted the same way.
+ * Only the filter changed, so entries either drop out or come in; each run
+ * of them is reported as its own items-changed.
+ */
+static void
+network_list_model_apply_filtered(NetworkListModel *model, GPtrArray *visible)
+{
+    GPtrArray *current = model->visible;
+    guint pos = 0, next = 0, n, i;
+
+    while (pos < current->len || next < visible->len) {
+        /* Entries that no longer match */
+        for (n = 0; pos + n < current->len; n++) {
+            if (next < visible->len &&
+                network_entry_compare(&g_ptr_array_index(current, pos + n),
+                                      &g_ptr_array_index(visible, next)) >= 0)
+                break;
+            NETWORK_ENTRY(g_ptr_array_index(current, pos + n))->visible = FALSE;
+        }
+        if (n > 0) {
+            g_ptr_array_remove_range(current, pos, n);
+            g_list_model_items_changed(G_LIST_MODEL(model), pos, n, 0);
+            continue;
+        }
+
+        /* Entries that match now */
+        for (n = 0; next + n < visible->len; n++) {
+            if (pos < current->len &&
+                network_entry_compare(&g_ptr_array_index(current, pos),
+                                      &g_ptr_array_index(visible, next + n)) <= 0)
+                break;
+        }
+        if (n > 0) {
+            for (i = 0; i < n; i++) {
+                NetworkEntry *entry = g_ptr_array_index(visible, next + i);
+
+                entry->visible = TRUE;
+                g_ptr_array_insert(current, pos + i, g_object_ref(entry));
+            }
+            g_list_model_items_changed(G_LIST_MODEL(model), pos, 0, n);
+            pos += n;
+            next += n;
+            continue;
+        }
+
+        /* Same entry on both sides */
+        pos++;
+        next++;
+    }
+
+    g_ptr_array_unref(visible);
+}
+
+/*
+ * Filter the cached entries. Typing one more character can only hide
+ * entries, so only the visible ones are checked; deleting one can only
+ * reveal entries, so only the hidden ones are.
+ */
+void
+network_list_model_set_filter(NetworkListModel *model, const gchar *filter_text)
+{
+    gchar *filter_key = network_search_key(filter_text ? filter_text : "");
+    GPtrArray *visible;
+    GHashTableIter iter;
+    gpointer value;
+    gboolean narrowed, widened;
+    guint i;
+
+    if (strcmp(model->filter_key, filter_key) == 0) {
+        g_free(filter_key);
+        return;
+    }
+
+    narrowed = strstr(filter_key, model->filter_key) != NULL;
+    widened = strstr(model->filter_key, filter_key) != NULL;
+
+    g_free(model->filter_key);
+    model->filter_key = filter_key;
+
+    visible = g_ptr_array_new_with_free_func(g_object_unref);
+
+    if (narrowed) {
+        for (i = 0; i < model->visible->len; i++) {
+            NetworkEntry *entry = g_ptr_array_index(model->visible, i);
+
+            if (network_list_model_matches(model, entry))
+                g_ptr_array_add(visible, g_object_ref(entry));
+        }
+    } else {
+        g_hash_table_iter_init(&iter, model->entries);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            NetworkEntry *entry = value;
+
+            if ((widened && entry->visible) || network_list_model_matches(model, entry))
+                g_ptr_array_add(visible, g_object_ref(entry));
+        }
+        g_ptr_array_sort(visible, network_entry_compare);
+    }
+
+    network_list_model_apply_filtered(model, visible);
+}
+
+guint
+network_list_model_get_n_entries(NetworkListModel *model)
+{
+    return g_hash_table_size(model->entries);
+}
+
+/* Visible entries that changed places in the last update */
+guint
+network_list_model_get_n_moves(NetworkListModel *model)
+{
+    return model->n_moves;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __NETWORK_LIST_MODEL_H__
+#define __NETWORK_LIST_MODEL_H__
+
+#include <gio/gio.h>
+#include "nm-interface.h"
+
+G_BEGIN_DECLS
+
+typedef enum {
+    NETWORK_ENTRY_WIFI,
+    NETWORK_ENTRY_WIRED
+} NetworkEntryKind;
+
+/*
+ * One network shown in the popup: a wired device, or every BSSID sharing an
+ * SSID and security type. Emits "changed" when its fields change.
+ */
+#define NETWORK_TYPE_ENTRY (network_entry_get_type())
+G_DECLARE_FINAL_TYPE(NetworkEntry, network_entry, NETWORK, ENTRY, GObject)
+
+const gchar         *network_entry_get_key           (NetworkEntry *entry);
+NetworkEntryKind     network_entry_get_kind          (NetworkEntry *entry);
+const gchar         *network_entry_get_name          (NetworkEntry *entry);
+guint                network_entry_get_strength      (NetworkEntry *entry);
+gboolean             network_entry_get_secure        (NetworkEntry *entry);
+gboolean             network_entry_get_connected     (NetworkEntry *entry);
+const gchar         *network_entry_get_device_path   (NetworkEntry *entry);
+const NMAccessPointInfo *network_entry_get_ap_info   (NetworkEntry *entry);
+NMAccessPointInfo   *network_entry_dup_ap_info       (NetworkEntry *entry);
+guint                network_entry_get_n_bssids      (NetworkEntry *entry);
+GPtrArray           *network_entry_get_bssids        (NetworkEntry *entry);
+
+/*
+ * Sorted, filtered list of NetworkEntry. Refreshes are bracketed by
+ * begin_update/end_update; entries not added again in between are dropped,
+ * and a single items-changed covering only the rows that moved is emitted.
+ * The order is set by network-sort-policy.h.
+ */
+#define NETWORK_TYPE_LIST_MODEL (network_list_model_get_type())
+G_DECLARE_FINAL_TYPE(NetworkListModel, network_list_model, NETWORK, LIST_MODEL, GObject)
+
+NetworkListModel    *network_list_model_new          (void);
+void                 network_list_model_begin_update (NetworkListModel *model);
+void                 network_list_model_add_access_point (NetworkListModel *model,
+                                                     const gchar *device_path,
+                                                     NMAccessPointInfo *ap_info,
+                                                     gboolean connected);
+void                 network_list_model_add_wired    (NetworkListModel *model,
+                                                     const gchar *device_path,
+                                                     gboolean connected);
+void                 network_list_model_add_known    (NetworkListModel *model,
+                                                     const gchar *ssid,
+                                                     guint64 timestamp);
+void                 network_list_model_end_update   (NetworkListModel *model);
+void                 network_list_model_refresh      (NetworkListModel *model,
+                                                     NMInterface *nm_interface);
+void                 network_list_model_set_filter   (NetworkListModel *model,
+                                                     const gchar *filter_text);
+guint                network_list_model_get_n_entries (NetworkListModel *model);
+guint                network_list_model_get_n_moves  (NetworkListModel *model);
+
+G_END_DECLS
+
+#endif /* __NETWORK_LIST_MODEL_H__ */
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "network-list-view.h"
+
+/* Rows kept bound above and below the viewport */
+#define NETWORK_LIST_VIEW_OVERSCAN 4
+
+typedef struct {
+    GtkWidget *widget;
+    gint       index;       /* bound model position, -1 if unused */
+} ViewSlot;
+
+struct _NetworkListView {
+    GtkWidget                   *layout;
+    GtkAdjustment               *vadjustment;
+    GListModel                  *model;
+
+    /* Position i is shown by slot i % slots->len */
+    GArray                      *slots;
+    gint                         row_height;
+    gint                         width;
+
+    NetworkListViewCreateFunc    create_func;
+    NetworkListViewBindFunc      bind_func;
+    NetworkListViewActivateFunc  activate_func;
+    gpointer                     user_data;
+
+    guint                        n_binds;
+};
+
+static void
+network_list_view_add_slot(NetworkListView *view)
+{
+    ViewSlot slot;
+
+    slot.widget = view->create_func(view->user_data);
+    slot.index = -1;
+
+    gtk_widget_set_size_request(slot.widget, view->width, view->row_height);
+    gtk_layout_put(GTK_LAYOUT(view->layout), slot.widget, 0, 0);
+    gtk_widget_hide(slot.widget);
+
+    g_array_append_val(view->slots, slot);
+}
+
+static void
+network_list_view_bind(NetworkListView *view, ViewSlot *slot, guint position)
+{
+    gpointer item = g_list_model_get_item(view->model, position);
+
+    view->bind_func(slot->widget, item, view->user_data);
+    g_object_unref(item);
+
+    gtk_layout_move(GTK_LAYOUT(view->layout), slot->widget, 0, position * view->row_height);
+    gtk_widget_show(slot->widget);
+
+    slot->index = position;
+    view->n_binds++;
+}
+
+/*
+ * Bind the rows around the viewport. Slots already showing the right
+ * position are left alone, so scrolling by one row rebinds one slot.
+ * Slots bound at invalid_from or later are rebound regardless.
+ */
+static void
+network_list_view_relayout(NetworkListView *view, guint invalid_from)
+{
+    guint n_items = g_list_model_get_n_items(view->model);
+    gdouble top = 0, page = 0;
+    guint first, last, needed, i;
+
+    if (view->row_height == 0) {
+        gint natural = 0;
+
+        /* All rows share the height of the first one */
+        network_list_view_add_slot(view);
+        gtk_widget_get_preferred_height(g_array_index(view->slots, ViewSlot, 0).widget, NULL, &natural);
+        view->row_height = MAX(natural, 1);
+        gtk_widget_set_size_request(g_array_index(view->slots, ViewSlot, 0).widget,
+                                    view->width, view->row_height);
+    }
+
+    gtk_layout_set_size(GTK_LAYOUT(view->layout), MAX(view->width, 1), n_items * view->row_height);
+
+    if (view->vadjustment) {
+        top = gtk_adjustment_get_value(view->vadjustment);
+        page = gtk_adjustment_get_page_size(view->vadjustment);
+    }
+    if (page <= 0)
+        page = gtk_widget_get_allocated_height(view->layout);
+
+    first = (guint)(top / view->row_height);
+    first = first > NETWORK_LIST_VIEW_OVERSCAN ? first - NETWORK_LIST_VIEW_OVERSCAN : 0;
+    last = MIN((guint)((top + page) / view->row_height) + 1 + NETWORK_LIST_VIEW_OVERSCAN, n_items);
+
+    /* Enough slots for any window of that size */
+    needed = (guint)(page / view->row_height) + 2 + 2 * NETWORK_LIST_VIEW_OVERSCAN;
+    while (view->slots->len < needed)
+        network_list_view_add_slot(view);
+
+    /* Park slots that are out of range or in the wrong place */
+    for (i = 0; i < view->slots->len; i++) {
+        ViewSlot *slot = &g_array_index(view->slots, ViewSlot, i);
+
+        if (slot->index < 0)
+            continue;
+
+        if ((guint)slot->index < first || (guint)slot->index >= last ||
+            (guint)slot->index >= invalid_from || (guint)slot->index % view->slots->len != i) {
+            gtk_widget_hide(slot->widget);
+            slot->index = -1;
+        }
+    }
+
+    for (i = first; i < last; i++) {
+        ViewSlot *slot = &g_array_index(view->slots, ViewSlot, i % view->slots->len);
+
+        if (slot->index != (gint)i)
+            network_list_view_bind(view, slot, i);
+    }
+}
+
+static void
+on_model_items_changed(GListModel *model, guint position, guint removed, guint added,
+                       NetworkListView *view)
+{
+    /* Everything from position on may now show a different item */
+    network_list_view_relayout(view, position);
+}
+
+static void
+on_adjustment_changed(GtkAdjustment *adjustment, NetworkListView *view)
+{
+    network_list_view_relayout(view, G_MAXUINT);
+}
+
+static void
+on_vadjustment_set(GObject *object, GParamSpec *pspec, NetworkListView *view)
+{
+    if (view->vadjustment) {
+        g_signal_handlers_disconnect_by_data(view->vadjustment, view);
+        g_clear_object(&view->vadjustment);
+    }
+
+    view->vadjustment = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(view->layout));
+    if (view->vadjustment) {
+        g_object_ref(view->vadjustment);
+        g_signal_connect(view->vadjustment, "value-changed",
+                         G_CALLBACK(on_adjustment_changed), view);
+        g_signal_connect(view->vadjustment, "changed",
+                         G_CALLBACK(on_adjustment_changed), view);
+    }
+}
+
+static void
+on_layout_size_allocate(GtkWidget *widget, GdkRectangle *allocation, NetworkListView *view)
+{
+    guint i;
+
+    if (allocation->width == view->width)
+        return;
+
+    view->width = allocation->width;
+    for (i = 0; i < view->slots->len; i++)
+        gtk_widget_set_size_request(g_array_index(view->slots, ViewSlot, i).widget,
+                                    view->width, view->row_height);
+
+    network_list_view_relayout(view, G_MAXUINT);
+}
+
+static gboolean
+on_layout_button_release(GtkWidget *widget, GdkEventButton *event, NetworkListView *view)
+{
+    guint position;
+    gpointer item;
+
+    if (event->button != GDK_BUTTON_PRIMARY ||
+        event->window != gtk_layout_get_bin_window(GTK_LAYOUT(view->layout)) ||
+        view->row_height == 0)
+        return FALSE;
+
+    /* The bin window spans the whole list, so y is already scrolled */
+    position = (guint)(event->y / view->row_height);
+    if (position >= g_list_model_get_n_items(view->model))
+        return FALSE;
+
+    item = g_list_model_get_item(view->model, position);
+    view->activate_func(item, view->user_data);
+    g_object_unref(item);
+
+    return TRUE;
+}
+
+NetworkListView *
+network_list_view_new(GListModel *model,
+                      NetworkListViewCreateFunc create_func,
+                      NetworkListViewBindFunc bind_func,
+                      NetworkListViewActivateFunc activate_func,
+                      gpointer user_data)
+{
+    NetworkListView *view;
+
+    view = g_new0(NetworkListView, 1);
+    view->model = g_object_ref(model);
+    view->slots = g_array_new(FALSE, FALSE, sizeof(ViewSlot));
+    view->create_func = create_func;
+    view->bind_func = bind_func;
+    view->activate_func = activate_func;
+    view->user_data = user_data;
+
+    view->layout = g_object_ref_sink(gtk_layout_new(NULL, NULL));
+    gtk_widget_add_events(view->layout, GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK);
+    gtk_style_context_add_class(gtk_widget_get_style_context(view->layout), "nm-network-list");
+
+    g_signal_connect(view->layout, "notify::vadjustment",
+                     G_CALLBACK(on_vadjustment_set), view);
+    g_signal_connect(view->layout, "size-allocate",
+                     G_CALLBACK(on_layout_size_allocate), view);
+    g_signal_connect(view->layout, "button-release-event",
+                     G_CALLBACK(on_layout_button_release), view);
+    g_signal_connect(view->model, "items-changed",
+                     G_CALLBACK(on_model_items_changed), view);
+
+    gtk_widget_show(view->layout);
+
+    return view;
+}
+
+void
+network_list_view_free(NetworkListView *view)
+{
+    if (!view)
+        return;
+
+    g_signal_handlers_disconnect_by_data(view->model, view);
+    g_signal_handlers_disconnect_by_data(view->layout, view);
+    if (view->vadjustment) {
+        g_signal_handlers_disconnect_by_data(view->vadjustment, view);
+        g_object_unref(view->vadjustment);
+    }
+
+    /* The slot widgets are children of the layout */
+    gtk_widget_destroy(view->layout);
+    g_object_unref(view->layout);
+    g_object_unref(view->model);
+    g_array_free(view->slots, TRUE);
+    g_free(view);
+}
+
+GtkWidget *
+network_list_view_get_widget(NetworkListView *view)
+{
+    return view->layout;
+}
+
+/* Row widgets that exist, bound or parked */
+guint
+network_list_view_get_n_realized(NetworkListView *view)
+{
+    return view->slots->len;
+}
+
+/* Times a row was bound to a model item */
+guint
+network_list_view_get_n_binds(NetworkListView *view)
+{
+    return view->n_binds;
+}
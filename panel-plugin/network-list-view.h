@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __NETWORK_LIST_VIEW_H__
+#define __NETWORK_LIST_VIEW_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A list for long models: only the rows in the viewport plus a few above
+ * and below exist as widgets, and scrolling rebinds them to other items.
+ * All rows have the height of the first one created.
+ */
+typedef struct _NetworkListView NetworkListView;
+
+typedef GtkWidget *(*NetworkListViewCreateFunc)   (gpointer user_data);
+typedef void       (*NetworkListViewBindFunc)     (GtkWidget *row,
+                                                  gpointer item,
+                                                  gpointer user_data);
+typedef void       (*NetworkListViewActivateFunc) (gpointer item,
+                                                  gpointer user_data);
+
+NetworkListView *network_list_view_new            (GListModel *model,
+                                                  NetworkListViewCreateFunc create_func,
+                                                  NetworkListViewBindFunc bind_func,
+                                                  NetworkListViewActivateFunc activate_func,
+                                                  gpointer user_data);
+void             network_list_view_free           (NetworkListView *view);
+GtkWidget       *network_list_view_get_widget     (NetworkListView *view);
+
+/* Counters for benchmarks */
+guint            network_list_view_get_n_realized (NetworkListView *view);
+guint            network_list_view_get_n_binds    (NetworkListView *view);
+
+G_END_DECLS
+
+#endif /* __NETWORK_LIST_VIEW_H__ */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "network-sort-policy.h"
+
+/* The bucket for strength, without hysteresis; for new networks */
+guint
+network_sort_policy_bucket(guint strength)
+{
+    return MIN(strength / NETWORK_SORT_BUCKET_WIDTH, NETWORK_SORT_N_BUCKETS - 1);
+}
+
+/*
+ * Move *bucket to the bucket of strength if the strength is far enough
+ * past the edge of the current one. TRUE if it moved.
+ */
+gboolean
+network_sort_policy_update_bucket(guint *bucket, guint strength)
+{
+    guint candidate = network_sort_policy_bucket(strength);
+
+    if (candidate == *bucket)
+        return FALSE;
+
+    if (candidate > *bucket &&
+        strength < (*bucket + 1) * NETWORK_SORT_BUCKET_WIDTH + NETWORK_SORT_HYSTERESIS)
+        return FALSE;
+
+    if (candidate < *bucket &&
+        strength + NETWORK_SORT_HYSTERESIS >= *bucket * NETWORK_SORT_BUCKET_WIDTH)
+        return FALSE;
+
+    *bucket = candidate;
+    return TRUE;
+}
+
+/* Negative if a goes above b, 0 if the policy does not tell them apart */
+gint
+network_sort_policy_compare(const NetworkSortKey *a, const NetworkSortKey *b)
+{
+    if (a->connected != b->connected)
+        return a->connected ? -1 : 1;
+
+    if (a->known != b->known)
+        return a->known ? -1 : 1;
+
+    if (a->known && a->last_used != b->last_used)
+        return a->last_used > b->last_used ? -1 : 1;
+
+    if (a->bucket != b->bucket)
+        return a->bucket > b->bucket ? -1 : 1;
+
+    return 0;
+}
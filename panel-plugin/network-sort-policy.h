@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __NETWORK_SORT_POLICY_H__
+#define __NETWORK_SORT_POLICY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Order of the popup's network list: the connected network, then saved
+ * networks from most to least recently used, then the rest by signal
+ * bucket. Buckets match the signal icons and only change once the
+ * strength is past a bucket edge by NETWORK_SORT_HYSTERESIS, so a signal
+ * wobbling around an edge does not reorder the list.
+ */
+#define NETWORK_SORT_BUCKET_WIDTH 20
+#define NETWORK_SORT_N_BUCKETS    5
+#define NETWORK_SORT_HYSTERESIS   5
+
+typedef struct {
+    gboolean connected;
+    gboolean known;       /* a saved connection exists */
+    guint64  last_used;   /* its timestamp, 0 if never used */
+    guint    bucket;      /* from network_sort_policy_update_bucket */
+} NetworkSortKey;
+
+guint    network_sort_policy_bucket        (guint strength);
+gboolean network_sort_policy_update_bucket (guint *bucket,
+                                            guint strength);
+gint     network_sort_policy_compare       (const NetworkSortKey *a,
+                                            const NetworkSortKey *b);
+
+G_END_DECLS
+
+#endif /* __NETWORK_SORT_POLICY_H__ */
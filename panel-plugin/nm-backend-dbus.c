@@ -0,0 +1,802 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "nm-interface-private.h"
+#include "nm-dbus-generated.h"
+#include <string.h>
+
+/*
+ * GDBus backend built on the typed proxies gdbus-codegen generates from
+ * dbus/org.freedesktop.NetworkManager.xml. The object manager client holds
+ * one proxy per NetworkManager object and keeps their properties current, so
+ * reads are plain getter calls on cached proxies.
+ */
+
+/* NetworkManager exports its object manager at the parent of NM_DBUS_PATH */
+#define NM_DBUS_OBJECT_MANAGER_PATH "/org/freedesktop"
+
+/* Activation can wait on the user or a DHCP server */
+#define NM_DBUS_ACTIVATION_TIMEOUT  30000
+
+typedef struct {
+    GDBusObjectManager *object_manager;
+    NMDBusManager      *manager;
+    NMDBusSettings     *settings;
+} DBusBackend;
+
+/* Forward declarations */
+static void dbus_backend_update_state(NMInterface *nm_interface);
+static void dbus_backend_load_devices(NMInterface *nm_interface);
+static void dbus_backend_load_connections(NMInterface *nm_interface);
+static void dbus_backend_load_active_connections(NMInterface *nm_interface);
+static void dbus_backend_setup_signals(NMInterface *nm_interface);
+static NMDeviceInfo *dbus_backend_create_device_info(NMInterface *nm_interface, NMDBusObject *object);
+static NMConnectionInfo *dbus_backend_create_connection_info(NMInterface *nm_interface, const gchar *connection_path);
+
+/* Look up the generated object wrapper for a path; returns a new reference */
+static NMDBusObject *
+dbus_backend_get_object(NMInterface *nm_interface, const gchar *object_path)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+    GDBusObject *object;
+
+    if (!object_path || g_strcmp0(object_path, "/") == 0)
+        return NULL;
+
+    object = g_dbus_object_manager_get_object(priv->object_manager, object_path);
+
+    return object ? NMDBUS_OBJECT(object) : NULL;
+}
+
+static gboolean
+dbus_backend_init(NMInterface *nm_interface, GError **error)
+{
+    DBusBackend *priv = g_new0(DBusBackend, 1);
+    NMDBusObject *object;
+
+    nm_interface->backend_data = priv;
+
+    priv->object_manager = nmdbus_object_manager_client_new_for_bus_sync(
+        G_BUS_TYPE_SYSTEM,
+        G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+        NM_DBUS_SERVICE,
+        NM_DBUS_OBJECT_MANAGER_PATH,
+        NULL,
+        error);
+
+    if (!priv->object_manager) {
+        return FALSE;
+    }
+
+    object = dbus_backend_get_object(nm_interface, NM_DBUS_PATH);
+    if (object) {
+        priv->manager = nmdbus_object_get_manager(object);
+        g_object_unref(object);
+    }
+
+    object = dbus_backend_get_object(nm_interface, NM_DBUS_PATH_SETTINGS);
+    if (object) {
+        priv->settings = nmdbus_object_get_settings(object);
+        g_object_unref(object);
+    }
+
+    if (!priv->manager || !priv->settings) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN,
+                    "NetworkManager is not running");
+        return FALSE;
+    }
+
+    g_dbus_proxy_set_default_timeout(G_DBUS_PROXY(priv->manager), NM_DBUS_ACTIVATION_TIMEOUT);
+
+    /* Get initial state */
+    dbus_backend_update_state(nm_interface);
+
+    /* Load devices */
+    dbus_backend_load_devices(nm_interface);
+
+    /* Load connections */
+    dbus_backend_load_connections(nm_interface);
+
+    /* Load active connections */
+    dbus_backend_load_active_connections(nm_interface);
+
+    /* Setup signal handlers */
+    dbus_backend_setup_signals(nm_interface);
+
+    return TRUE;
+}
+
+static void
+dbus_backend_shutdown(NMInterface *nm_interface)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+
+    if (!priv)
+        return;
+
+    /* Disconnect signal handlers */
+    if (priv->object_manager) {
+        GList *objects = g_dbus_object_manager_get_objects(priv->object_manager);
+        GList *l;
+
+        for (l = objects; l != NULL; l = l->next) {
+            NMDBusDevice *device = nmdbus_object_peek_device(NMDBUS_OBJECT(l->data));
+            NMDBusSettingsConnection *connection = nmdbus_object_peek_settings_connection(NMDBUS_OBJECT(l->data));
+
+            if (device)
+                g_signal_handlers_disconnect_by_data(device, nm_interface);
+            if (connection)
+                g_signal_handlers_disconnect_by_data(connection, nm_interface);
+        }
+        g_list_free_full(objects, g_object_unref);
+
+        g_signal_handlers_disconnect_by_data(priv->object_manager, nm_interface);
+    }
+    if (priv->manager) {
+        g_signal_handlers_disconnect_by_data(priv->manager, nm_interface);
+    }
+    if (priv->settings) {
+        g_signal_handlers_disconnect_by_data(priv->settings, nm_interface);
+    }
+
+    /* Clear proxies */
+    g_clear_object(&priv->manager);
+    g_clear_object(&priv->settings);
+    g_clear_object(&priv->object_manager);
+
+    g_free(priv);
+    nm_interface->backend_data = NULL;
+}
+
+/* Update NetworkManager state */
+static void
+dbus_backend_update_state(NMInterface *nm_interface)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+
+    nm_interface->nm_state = nmdbus_manager_get_state(priv->manager);
+    nm_interface->connectivity = nmdbus_manager_get_connectivity(priv->manager);
+    nm_interface->wireless_enabled = nmdbus_manager_get_wireless_enabled(priv->manager);
+    nm_interface->networking_enabled = nmdbus_manager_get_networking_enabled(priv->manager);
+}
+
+/* Load devices from NetworkManager */
+static void
+dbus_backend_load_devices(NMInterface *nm_interface)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+    const gchar *const *device_paths;
+    guint i;
+
+    device_paths = nmdbus_manager_get_devices(priv->manager);
+    for (i = 0; device_paths && device_paths[i] != NULL; i++) {
+        NMDBusObject *object = dbus_backend_get_object(nm_interface, device_paths[i]);
+        NMDeviceInfo *device_info;
+
+        if (!object)
+            continue;
+
+        device_info = dbus_backend_create_device_info(nm_interface, object);
+        if (device_info) {
+            g_hash_table_insert(nm_interface->devices, g_strdup(device_info->path), device_info);
+        }
+        g_object_unref(object);
+    }
+}
+
+static void
+dbus_backend_load_connections(NMInterface *nm_interface)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+    gchar **connection_paths = NULL;
+    GError *error = NULL;
+    guint i;
+
+    if (!nmdbus_settings_call_list_connections_sync(priv->settings, &connection_paths, NULL, &error)) {
+        g_warning("Failed to get connections: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    for (i = 0; connection_paths[i] != NULL; i++) {
+        NMConnectionInfo *connection_info = dbus_backend_create_connection_info(nm_interface, connection_paths[i]);
+        if (connection_info) {
+            g_hash_table_insert(nm_interface->connections, g_strdup(connection_paths[i]), connection_info);
+        }
+    }
+    g_strfreev(connection_paths);
+}
+
+static NMActiveConnectionInfo *
+dbus_backend_create_active_info(NMInterface *nm_interface, const gchar *active_path)
+{
+    NMDBusObject *object;
+    NMDBusActiveConnection *proxy;
+    NMActiveConnectionInfo *active;
+
+    object = dbus_backend_get_object(nm_interface, active_path);
+    if (!object)
+        return NULL;
+
+    proxy = nmdbus_object_peek_active_connection(object);
+    if (!proxy) {
+        g_object_unref(object);
+        return NULL;
+    }
+
+    active = g_new0(NMActiveConnectionInfo, 1);
+    active->path = g_strdup(active_path);
+    active->connection = g_strdup(nmdbus_active_connection_get_connection(proxy));
+    active->uuid = g_strdup(nmdbus_active_connection_get_uuid(proxy));
+    active->id = g_strdup(nmdbus_active_connection_get_id(proxy));
+    active->type = g_strdup(nmdbus_active_connection_get_type_(proxy));
+    active->specific_object = g_strdup(nmdbus_active_connection_get_specific_object(proxy));
+    active->devices = g_strdupv((gchar **)nmdbus_active_connection_get_devices(proxy));
+    active->state = nmdbus_active_connection_get_state(proxy);
+    active->is_default = nmdbus_active_connection_get_default(proxy) ||
+                         nmdbus_active_connection_get_default6(proxy);
+    active->vpn = nmdbus_active_connection_get_vpn(proxy);
+
+    g_object_unref(object);
+    return active;
+}
+
+/* Reload active connections and the primary connection from the manager */
+static void
+dbus_backend_load_active_connections(NMInterface *nm_interface)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+    const gchar *const *active_paths;
+    guint i;
+
+    g_hash_table_remove_all(nm_interface->active_connections);
+
+    active_paths = nmdbus_manager_get_active_connections(priv->manager);
+    for (i = 0; active_paths && active_paths[i] != NULL; i++) {
+        NMActiveConnectionInfo *active = dbus_backend_create_active_info(nm_interface, active_paths[i]);
+        if (active) {
+            g_hash_table_insert(nm_interface->active_connections, g_strdup(active_paths[i]), active);
+        }
+    }
+
+    nm_interface_set_primary_connection(nm_interface,
+                                        nmdbus_manager_get_primary_connection(priv->manager));
+}
+
+static NMConnectionInfo *
+dbus_backend_create_connection_info(NMInterface *nm_interface, const gchar *connection_path)
+{
+    NMConnectionInfo *connection_info;
+    NMDBusObject *object;
+    NMDBusSettingsConnection *proxy;
+    GVariant *settings = NULL;
+    GVariant *group_settings;
+    GError *error = NULL;
+
+    object = dbus_backend_get_object(nm_interface, connection_path);
+    proxy = object ? nmdbus_object_peek_settings_connection(object) : NULL;
+    if (!proxy) {
+        g_warning("No settings connection object for %s", connection_path);
+        g_clear_object(&object);
+        return NULL;
+    }
+
+    /* Get connection settings */
+    if (!nmdbus_settings_connection_call_get_settings_sync(proxy, &settings, NULL, &error)) {
+        g_warning("Failed to get connection settings for %s: %s", connection_path, error->message);
+        g_error_free(error);
+        g_object_unref(object);
+        return NULL;
+    }
+
+    connection_info = g_new0(NMConnectionInfo, 1);
+    connection_info->path = g_strdup(connection_path);
+
+    group_settings = g_variant_lookup_value(settings, "connection", G_VARIANT_TYPE_VARDICT);
+    if (group_settings) {
+        /* Extract connection properties; "s" hands back owned copies */
+        g_variant_lookup(group_settings, "uuid", "s", &connection_info->uuid);
+        g_variant_lookup(group_settings, "id", "s", &connection_info->id);
+        g_variant_lookup(group_settings, "type", "s", &connection_info->type);
+        g_variant_lookup(group_settings, "timestamp", "t", &connection_info->timestamp);
+        g_variant_unref(group_settings);
+    }
+
+    g_variant_unref(settings);
+    g_object_unref(object);
+    return connection_info;
+}
+
+/* Manager property changes */
+static void
+on_manager_state_changed(NMDBusManager *manager, GParamSpec *pspec, gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+
+    nm_interface_notify_state_changed(nm_interface, nmdbus_manager_get_state(manager));
+}
+
+static void
+on_manager_connectivity_changed(NMDBusManager *manager, GParamSpec *pspec, gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+
+    nm_interface->connectivity = nmdbus_manager_get_connectivity(manager);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_STATE);
+}
+
+static void
+on_manager_active_changed(NMDBusManager *manager, GParamSpec *pspec, gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+
+    dbus_backend_load_active_connections(nm_interface);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+}
+
+/* Settings connections come and go as profiles are added or deleted */
+static void
+on_settings_new_connection(NMDBusSettings *settings, const gchar *connection_path, gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+    NMConnectionInfo *connection_info;
+
+    connection_info = dbus_backend_create_connection_info(nm_interface, connection_path);
+    if (connection_info) {
+        g_hash_table_replace(nm_interface->connections, g_strdup(connection_path), connection_info);
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_CONNECTIONS);
+    }
+}
+
+static void
+on_settings_connection_removed(NMDBusSettings *settings, const gchar *connection_path, gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+
+    if (g_hash_table_remove(nm_interface->connections, connection_path))
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_CONNECTIONS);
+}
+
+/* Create device info from the cached device proxy */
+static NMDeviceInfo *
+dbus_backend_create_device_info(NMInterface *nm_interface, NMDBusObject *object)
+{
+    NMDeviceInfo *device_info;
+    NMDBusDevice *device;
+    NMDBusDeviceWifi *wifi;
+
+    device = nmdbus_object_peek_device(object);
+    if (!device)
+        return NULL;
+
+    device_info = g_new0(NMDeviceInfo, 1);
+    device_info->path = g_strdup(g_dbus_object_get_object_path(G_DBUS_OBJECT(object)));
+
+    /* Map NetworkManager device types to our enum */
+    switch (nmdbus_device_get_device_type(device)) {
+        case NM_DEVICE_TYPE_ETHERNET:
+            device_info->type = NM_DEVICE_TYPE_ETHERNET;
+            break;
+        case NM_DEVICE_TYPE_WIFI:
+            device_info->type = NM_DEVICE_TYPE_WIFI;
+            break;
+        case NM_DEVICE_TYPE_MODEM:
+            device_info->type = NM_DEVICE_TYPE_MODEM;
+            break;
+        case NM_DEVICE_TYPE_BT:
+            device_info->type = NM_DEVICE_TYPE_BT;
+            break;
+        default:
+            device_info->type = NM_DEVICE_TYPE_UNKNOWN;
+            break;
+    }
+
+    device_info->interface = g_strdup(nmdbus_device_get_interface(device));
+    device_info->state = nmdbus_device_get_state(device);
+    device_info->managed = nmdbus_device_get_managed(device);
+
+    /* Get the active access point of Wi-Fi devices */
+    wifi = nmdbus_object_peek_device_wifi(object);
+    if (wifi) {
+        const gchar *ap_path = nmdbus_device_wifi_get_active_access_point(wifi);
+        if (ap_path && g_strcmp0(ap_path, "/") != 0)
+            device_info->specific.wifi.active_ap = g_strdup(ap_path);
+        device_info->specific.wifi.bitrate = nmdbus_device_wifi_get_bitrate(wifi);
+    }
+
+    return device_info;
+}
+
+/* Function to get access point properties */
+static NMAccessPointInfo *
+dbus_backend_get_ap_info(NMInterface *nm_interface, const gchar *ap_path)
+{
+    NMAccessPointInfo *ap_info;
+    NMDBusObject *object;
+    NMDBusAccessPoint *ap;
+    GVariant *ssid;
+
+    object = dbus_backend_get_object(nm_interface, ap_path);
+    if (!object)
+        return NULL;
+
+    ap = nmdbus_object_peek_access_point(object);
+    if (!ap) {
+        g_object_unref(object);
+        return NULL;
+    }
+
+    /* Store the AP path */
+    ap_info = g_new0(NMAccessPointInfo, 1);
+    ap_info->path = g_strdup(ap_path);
+
+    /* Get SSID */
+    ssid = nmdbus_access_point_get_ssid(ap);
+    if (ssid) {
+        gsize length;
+        const guchar *ssid_data = g_variant_get_fixed_array(ssid, &length, sizeof(guchar));
+        if (length > 0) {
+            ap_info->ssid = g_strndup((const gchar *)ssid_data, length);
+        } else {
+            ap_info->ssid = g_strdup("(hidden)");
+        }
+    }
+
+    ap_info->strength = nmdbus_access_point_get_strength(ap);
+    ap_info->bssid = g_strdup(nmdbus_access_point_get_hw_address(ap));
+    ap_info->frequency = nmdbus_access_point_get_frequency(ap);
+    ap_info->security = g_strdup(nm_interface_security_from_flags(nmdbus_access_point_get_flags(ap),
+                                                                   nmdbus_access_point_get_wpa_flags(ap),
+                                                                   nmdbus_access_point_get_rsn_flags(ap)));
+
+    g_object_unref(object);
+    return ap_info;
+}
+
+/* Get access points for a Wi-Fi device */
+static GList *
+dbus_backend_get_access_points(NMInterface *nm_interface, const gchar *device_path)
+{
+    GList *access_points = NULL;
+    NMDBusObject *object;
+    NMDBusDeviceWifi *wifi;
+    const gchar *const *ap_paths;
+    guint i;
+
+    object = dbus_backend_get_object(nm_interface, device_path);
+    if (!object)
+        return NULL;
+
+    wifi = nmdbus_object_peek_device_wifi(object);
+    if (!wifi) {
+        g_object_unref(object);
+        return NULL;
+    }
+
+    /* AccessPoints lists hidden networks too, like GetAllAccessPoints */
+    ap_paths = nmdbus_device_wifi_get_access_points(wifi);
+    for (i = 0; ap_paths && ap_paths[i] != NULL; i++) {
+        NMAccessPointInfo *ap_info = dbus_backend_get_ap_info(nm_interface, ap_paths[i]);
+        if (ap_info) {
+            access_points = g_list_prepend(access_points, ap_info);
+        }
+    }
+
+    g_object_unref(object);
+
+    return g_list_reverse(access_points);
+}
+
+/* Request a Wi-Fi scan */
+static gboolean
+dbus_backend_request_scan(NMInterface *nm_interface, const gchar *device_path, GError **error)
+{
+    NMDBusObject *object;
+    NMDBusDeviceWifi *wifi;
+    gboolean success;
+
+    object = dbus_backend_get_object(nm_interface, device_path);
+    wifi = object ? nmdbus_object_peek_device_wifi(object) : NULL;
+    if (!wifi) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+                    "%s is not a Wi-Fi device", device_path);
+        g_clear_object(&object);
+        return FALSE;
+    }
+
+    success = nmdbus_device_wifi_call_request_scan_sync(wifi,
+                                                        g_variant_new("a{sv}", NULL),
+                                                        NULL,
+                                                        error);
+
+    g_object_unref(object);
+
+    return success;
+}
+
+/* Activate connection */
+static gboolean
+dbus_backend_activate_connection(NMInterface *nm_interface,
+                                 const gchar *connection_path,
+                                 const gchar *device_path,
+                                 GError **error)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+    gchar *active_path = NULL;
+
+    if (!nmdbus_manager_call_activate_connection_sync(priv->manager,
+                                                      connection_path,
+                                                      device_path,
+                                                      "/",
+                                                      &active_path,
+                                                      NULL,
+                                                      error)) {
+        return FALSE;
+    }
+
+    g_free(active_path);
+    return TRUE;
+}
+
+/* Add and activate a new connection */
+static gboolean
+dbus_backend_add_and_activate(NMInterface *nm_interface,
+                              GVariant *connection_dict,
+                              const gchar *device_path,
+                              const gchar *specific_object,
+                              GError **error)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+    gchar *connection_path = NULL;
+    gchar *active_path = NULL;
+
+    if (!nmdbus_manager_call_add_and_activate_connection_sync(priv->manager,
+                                                              connection_dict,
+                                                              device_path,
+                                                              specific_object,
+                                                              &connection_path,
+                                                              &active_path,
+                                                              NULL,
+                                                              error)) {
+        return FALSE;
+    }
+
+    g_debug("Created connection: %s, Active: %s", connection_path, active_path);
+    g_free(connection_path);
+    g_free(active_path);
+    return TRUE;
+}
+
+/* Deactivate connection */
+static gboolean
+dbus_backend_deactivate_connection(NMInterface *nm_interface,
+                                   const gchar *active_path,
+                                   GError **error)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+
+    return nmdbus_manager_call_deactivate_connection_sync(priv->manager, active_path, NULL, error);
+}
+
+/* The proxy writes the property back to NetworkManager asynchronously */
+static gboolean
+dbus_backend_set_statistics_rate(NMInterface *nm_interface, const gchar *device_path, guint rate_ms)
+{
+    NMDBusObject *object = dbus_backend_get_object(nm_interface, device_path);
+    NMDBusDeviceStatistics *statistics;
+
+    if (!object)
+        return FALSE;
+
+    statistics = nmdbus_object_peek_device_statistics(object);
+    if (statistics)
+        nmdbus_device_statistics_set_refresh_rate_ms(statistics, rate_ms);
+    g_object_unref(object);
+
+    return statistics != NULL;
+}
+
+/* Signal handler for device state changes */
+static void
+on_device_state_changed(NMDBusDevice *device,
+                        guint new_state,
+                        guint old_state,
+                        guint reason,
+                        gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+    NMDeviceInfo *device_info;
+    const gchar *object_path = g_dbus_proxy_get_object_path(G_DBUS_PROXY(device));
+
+    /* Update device info */
+    device_info = g_hash_table_lookup(nm_interface->devices, object_path);
+    if (device_info) {
+        device_info->state = new_state;
+
+        /* Notify callback if set */
+        if (nm_interface->device_added_cb) {
+            nm_interface->device_added_cb(nm_interface, device_info, nm_interface->user_data);
+        }
+
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES);
+    }
+
+    g_debug("Device %s state changed from %u to %u (reason: %u)",
+            object_path, old_state, new_state, reason);
+}
+
+/* A profile was edited or used: its id and timestamp may have changed */
+static void
+on_settings_connection_updated(NMDBusSettingsConnection *proxy, gpointer user_data)
+{
+    on_settings_new_connection(NULL, g_dbus_proxy_get_object_path(G_DBUS_PROXY(proxy)), user_data);
+}
+
+static void
+dbus_backend_watch_object(NMInterface *nm_interface, NMDBusObject *object)
+{
+    NMDBusDevice *device = nmdbus_object_peek_device(object);
+    NMDBusSettingsConnection *connection = nmdbus_object_peek_settings_connection(object);
+
+    if (device)
+        g_signal_connect(device, "state-changed",
+                         G_CALLBACK(on_device_state_changed), nm_interface);
+    if (connection)
+        g_signal_connect(connection, "updated",
+                         G_CALLBACK(on_settings_connection_updated), nm_interface);
+}
+
+/* Objects appearing on the bus: devices and late active connections */
+static void
+on_object_added(GDBusObjectManager *object_manager,
+                GDBusObject *object,
+                gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+    NMDeviceInfo *device_info;
+
+    if (nmdbus_object_peek_active_connection(NMDBUS_OBJECT(object))) {
+        dbus_backend_load_active_connections(nm_interface);
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+        return;
+    }
+
+    /* The profile itself arrives through the NewConnection signal */
+    if (nmdbus_object_peek_settings_connection(NMDBUS_OBJECT(object))) {
+        dbus_backend_watch_object(nm_interface, NMDBUS_OBJECT(object));
+        return;
+    }
+
+    device_info = dbus_backend_create_device_info(nm_interface, NMDBUS_OBJECT(object));
+    if (device_info) {
+        dbus_backend_watch_object(nm_interface, NMDBUS_OBJECT(object));
+        nm_interface_notify_device_added(nm_interface, device_info);
+    }
+}
+
+static void
+on_object_removed(GDBusObjectManager *object_manager,
+                  GDBusObject *object,
+                  gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+    NMDBusDevice *device = nmdbus_object_peek_device(NMDBUS_OBJECT(object));
+
+    if (device) {
+        g_signal_handlers_disconnect_by_data(device, nm_interface);
+        nm_interface_notify_device_removed(nm_interface, g_dbus_object_get_object_path(object));
+    }
+}
+
+/* One handler for property changes on every proxy the object manager holds */
+static void
+on_proxy_properties_changed(GDBusObjectManagerClient *object_manager,
+                            GDBusObjectProxy *object_proxy,
+                            GDBusProxy *interface_proxy,
+                            GVariant *changed_properties,
+                            const gchar *const *invalidated_properties,
+                            gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+
+    if (NMDBUS_IS_ACCESS_POINT(interface_proxy)) {
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACCESS_POINTS);
+    } else if (NMDBUS_IS_DEVICE_WIFI(interface_proxy)) {
+        NMDeviceInfo *device_info;
+        const gchar *ap_path;
+
+        /* Keep the cached active access point and bitrate current */
+        device_info = g_hash_table_lookup(nm_interface->devices,
+                                          g_dbus_proxy_get_object_path(interface_proxy));
+        if (device_info) {
+            ap_path = nmdbus_device_wifi_get_active_access_point(NMDBUS_DEVICE_WIFI(interface_proxy));
+            g_free(device_info->specific.wifi.active_ap);
+            device_info->specific.wifi.active_ap =
+                (ap_path && g_strcmp0(ap_path, "/") != 0) ? g_strdup(ap_path) : NULL;
+            device_info->specific.wifi.bitrate = nmdbus_device_wifi_get_bitrate(NMDBUS_DEVICE_WIFI(interface_proxy));
+        }
+
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES |
+                                                  NM_INTERFACE_CHANGED_ACCESS_POINTS);
+    } else if (NMDBUS_IS_ACTIVE_CONNECTION(interface_proxy)) {
+        const gchar *active_path = g_dbus_proxy_get_object_path(interface_proxy);
+        NMActiveConnectionInfo *active;
+
+        /* The manager's list only changes when one comes or goes, not on State */
+        if (!g_hash_table_contains(nm_interface->active_connections, active_path))
+            return;
+
+        active = dbus_backend_create_active_info(nm_interface, active_path);
+        if (active) {
+            g_hash_table_replace(nm_interface->active_connections, g_strdup(active_path), active);
+            nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+        }
+    } else if (NMDBUS_IS_DEVICE_STATISTICS(interface_proxy)) {
+        NMDBusDeviceStatistics *statistics = NMDBUS_DEVICE_STATISTICS(interface_proxy);
+
+        /* Skip the echo of our own RefreshRateMs change */
+        if (g_variant_lookup(changed_properties, "RxBytes", "t", NULL) ||
+            g_variant_lookup(changed_properties, "TxBytes", "t", NULL))
+            nm_statistics_add_sample(nm_interface, g_dbus_proxy_get_object_path(interface_proxy),
+                                     nmdbus_device_statistics_get_rx_bytes(statistics),
+                                     nmdbus_device_statistics_get_tx_bytes(statistics));
+    }
+}
+
+/* Setup D-Bus signal handlers */
+static void
+dbus_backend_setup_signals(NMInterface *nm_interface)
+{
+    DBusBackend *priv = nm_interface->backend_data;
+    GList *objects, *l;
+
+    g_signal_connect(priv->manager, "notify::state",
+                     G_CALLBACK(on_manager_state_changed), nm_interface);
+    g_signal_connect(priv->manager, "notify::connectivity",
+                     G_CALLBACK(on_manager_connectivity_changed), nm_interface);
+    g_signal_connect(priv->manager, "notify::active-connections",
+                     G_CALLBACK(on_manager_active_changed), nm_interface);
+    g_signal_connect(priv->manager, "notify::primary-connection",
+                     G_CALLBACK(on_manager_active_changed), nm_interface);
+
+    g_signal_connect(priv->object_manager, "object-added",
+                     G_CALLBACK(on_object_added), nm_interface);
+    g_signal_connect(priv->object_manager, "object-removed",
+                     G_CALLBACK(on_object_removed), nm_interface);
+    g_signal_connect(priv->object_manager, "interface-proxy-properties-changed",
+                     G_CALLBACK(on_proxy_properties_changed), nm_interface);
+
+    g_signal_connect(priv->settings, "new-connection",
+                     G_CALLBACK(on_settings_new_connection), nm_interface);
+    g_signal_connect(priv->settings, "connection-removed",
+                     G_CALLBACK(on_settings_connection_removed), nm_interface);
+
+    /* Device state changes and profile updates for the objects known so far */
+    objects = g_dbus_object_manager_get_objects(priv->object_manager);
+    for (l = objects; l != NULL; l = l->next) {
+        dbus_backend_watch_object(nm_interface, NMDBUS_OBJECT(l->data));
+    }
+    g_list_free_full(objects, g_object_unref);
+}
+
+const NMInterfaceBackend nm_interface_dbus_backend = {
+    .name                  = "dbus",
+    .init                  = dbus_backend_init,
+    .shutdown              = dbus_backend_shutdown,
+    .get_access_points     = dbus_backend_get_access_points,
+    .request_scan          = dbus_backend_request_scan,
+    .activate_connection   = dbus_backend_activate_connection,
+    .add_and_activate      = dbus_backend_add_and_activate,
+    .deactivate_connection = dbus_backend_deactivate_connection,
+    .set_statistics_rate   = dbus_backend_set_statistics_rate,
+};
@@ -0,0 +1,717 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "nm-interface-private.h"
+#include <string.h>
+
+/*
+ * libnm backend. NMClient keeps a cache of every NetworkManager object and
+ * keeps it current from PropertiesChanged signals, so reads never touch the
+ * bus. libnm only offers asynchronous variants of the activation methods;
+ * those go out as plain D-Bus calls on the connection NMClient already uses
+ * so that the synchronous nm_interface_* semantics stay unchanged.
+ */
+
+typedef struct {
+    NMClient        *client;
+    GDBusConnection *connection;
+
+    /*
+     * libnm reads the counters but cannot set RefreshRateMs and has no signal
+     * for new values; device path -> PropertiesChanged subscription
+     */
+    GHashTable      *statistics_subscriptions;
+
+    /* Active connections whose state we follow, with a reference each */
+    GPtrArray       *active_connections;
+} LibnmBackend;
+
+static NMDeviceInfo *
+libnm_backend_create_device_info(NMDevice *device)
+{
+    NMDeviceInfo *device_info;
+
+    device_info = g_new0(NMDeviceInfo, 1);
+    device_info->path = g_strdup(nm_object_get_path(NM_OBJECT(device)));
+    device_info->interface = g_strdup(nm_device_get_iface(device));
+    device_info->state = nm_device_get_state(device);
+    device_info->managed = nm_device_get_managed(device);
+
+    switch (nm_device_get_device_type(device)) {
+        case NM_DEVICE_TYPE_ETHERNET:
+        case NM_DEVICE_TYPE_WIFI:
+        case NM_DEVICE_TYPE_MODEM:
+        case NM_DEVICE_TYPE_BT:
+            device_info->type = nm_device_get_device_type(device);
+            break;
+        default:
+            device_info->type = NM_DEVICE_TYPE_UNKNOWN;
+            break;
+    }
+
+    if (NM_IS_DEVICE_WIFI(device)) {
+        NMAccessPoint *ap = nm_device_wifi_get_active_access_point(NM_DEVICE_WIFI(device));
+        if (ap)
+            device_info->specific.wifi.active_ap = g_strdup(nm_object_get_path(NM_OBJECT(ap)));
+        device_info->specific.wifi.bitrate = nm_device_wifi_get_bitrate(NM_DEVICE_WIFI(device));
+    }
+
+    return device_info;
+}
+
+static NMConnectionInfo *
+libnm_backend_create_connection_info(NMRemoteConnection *remote)
+{
+    NMConnection *connection = NM_CONNECTION(remote);
+    NMSettingConnection *s_con;
+    NMConnectionInfo *connection_info;
+
+    connection_info = g_new0(NMConnectionInfo, 1);
+    connection_info->path = g_strdup(nm_connection_get_path(connection));
+    connection_info->uuid = g_strdup(nm_connection_get_uuid(connection));
+    connection_info->id = g_strdup(nm_connection_get_id(connection));
+    connection_info->type = g_strdup(nm_connection_get_connection_type(connection));
+
+    s_con = nm_connection_get_setting_connection(connection);
+    if (s_con)
+        connection_info->timestamp = nm_setting_connection_get_timestamp(s_con);
+
+    return connection_info;
+}
+
+static NMActiveConnectionInfo *
+libnm_backend_create_active_info(NMActiveConnection *ac)
+{
+    NMActiveConnectionInfo *active;
+    NMRemoteConnection *remote;
+    const GPtrArray *devices;
+    guint i;
+
+    active = g_new0(NMActiveConnectionInfo, 1);
+    active->path = g_strdup(nm_object_get_path(NM_OBJECT(ac)));
+    active->uuid = g_strdup(nm_active_connection_get_uuid(ac));
+    active->id = g_strdup(nm_active_connection_get_id(ac));
+    active->type = g_strdup(nm_active_connection_get_connection_type(ac));
+    active->specific_object = g_strdup(nm_active_connection_get_specific_object_path(ac));
+    active->state = nm_active_connection_get_state(ac);
+    active->is_default = nm_active_connection_get_default(ac) || nm_active_connection_get_default6(ac);
+    active->vpn = nm_active_connection_get_vpn(ac);
+
+    remote = nm_active_connection_get_connection(ac);
+    if (remote)
+        active->connection = g_strdup(nm_connection_get_path(NM_CONNECTION(remote)));
+
+    devices = nm_active_connection_get_devices(ac);
+    active->devices = g_new0(gchar *, (devices ? devices->len : 0) + 1);
+    for (i = 0; devices && i < devices->len; i++) {
+        active->devices[i] = g_strdup(nm_object_get_path(g_ptr_array_index(devices, i)));
+    }
+
+    return active;
+}
+
+/* An active connection went from activating to activated, or on to deactivating */
+static void
+on_active_connection_state_changed(NMActiveConnection *ac, GParamSpec *pspec, NMInterface *nm_interface)
+{
+    NMActiveConnectionInfo *active = libnm_backend_create_active_info(ac);
+
+    g_hash_table_replace(nm_interface->active_connections, g_strdup(active->path), active);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+}
+
+static void
+libnm_backend_unwatch_active_connections(NMInterface *nm_interface)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    guint i;
+
+    for (i = 0; i < priv->active_connections->len; i++)
+        g_signal_handlers_disconnect_by_data(g_ptr_array_index(priv->active_connections, i), nm_interface);
+    g_ptr_array_set_size(priv->active_connections, 0);
+}
+
+/* Mirror active connections and the primary connection from the cache */
+static void
+libnm_backend_load_active_connections(NMInterface *nm_interface, NMClient *client)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    const GPtrArray *actives;
+    NMActiveConnection *primary;
+    guint i;
+
+    g_hash_table_remove_all(nm_interface->active_connections);
+    libnm_backend_unwatch_active_connections(nm_interface);
+
+    actives = nm_client_get_active_connections(client);
+    for (i = 0; actives && i < actives->len; i++) {
+        NMActiveConnection *ac = g_ptr_array_index(actives, i);
+        NMActiveConnectionInfo *active = libnm_backend_create_active_info(ac);
+
+        g_hash_table_insert(nm_interface->active_connections, g_strdup(active->path), active);
+        g_ptr_array_add(priv->active_connections, g_object_ref(ac));
+        g_signal_connect(ac, "notify::" NM_ACTIVE_CONNECTION_STATE,
+                         G_CALLBACK(on_active_connection_state_changed), nm_interface);
+    }
+
+    primary = nm_client_get_primary_connection(client);
+    nm_interface_set_primary_connection(nm_interface,
+                                        primary ? nm_object_get_path(NM_OBJECT(primary)) : NULL);
+}
+
+static void
+on_client_active_changed(NMClient *client, GParamSpec *pspec, NMInterface *nm_interface)
+{
+    libnm_backend_load_active_connections(nm_interface, client);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+}
+
+static void
+on_client_connectivity_changed(NMClient *client, GParamSpec *pspec, NMInterface *nm_interface)
+{
+    nm_interface->connectivity = nm_client_get_connectivity(client);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_STATE);
+}
+
+/* A profile was edited or used: its id and timestamp may have changed */
+static void
+on_remote_connection_changed(NMConnection *connection, NMInterface *nm_interface)
+{
+    NMConnectionInfo *connection_info = libnm_backend_create_connection_info(NM_REMOTE_CONNECTION(connection));
+
+    g_hash_table_replace(nm_interface->connections, g_strdup(connection_info->path), connection_info);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_CONNECTIONS);
+}
+
+static void
+on_client_connection_added(NMClient *client, NMRemoteConnection *remote, NMInterface *nm_interface)
+{
+    NMConnectionInfo *connection_info = libnm_backend_create_connection_info(remote);
+
+    g_signal_connect(remote, "changed", G_CALLBACK(on_remote_connection_changed), nm_interface);
+    g_hash_table_replace(nm_interface->connections, g_strdup(connection_info->path), connection_info);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_CONNECTIONS);
+}
+
+static void
+on_client_connection_removed(NMClient *client, NMRemoteConnection *remote, NMInterface *nm_interface)
+{
+    g_signal_handlers_disconnect_by_data(remote, nm_interface);
+    if (g_hash_table_remove(nm_interface->connections, nm_object_get_path(NM_OBJECT(remote))))
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_CONNECTIONS);
+}
+
+static void
+on_client_state_changed(NMClient *client, GParamSpec *pspec, NMInterface *nm_interface)
+{
+    nm_interface_notify_state_changed(nm_interface, nm_client_get_state(client));
+}
+
+static void
+on_device_state_changed(NMDevice *device,
+                        guint new_state,
+                        guint old_state,
+                        guint reason,
+                        NMInterface *nm_interface)
+{
+    NMDeviceInfo *device_info;
+    const gchar *path = nm_object_get_path(NM_OBJECT(device));
+
+    device_info = g_hash_table_lookup(nm_interface->devices, path);
+    if (device_info) {
+        device_info->state = new_state;
+
+        /* Notify callback if set */
+        if (nm_interface->device_added_cb) {
+            nm_interface->device_added_cb(nm_interface, device_info, nm_interface->user_data);
+        }
+    }
+
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES);
+
+    g_debug("Device %s state changed from %u to %u (reason: %u)",
+            path, old_state, new_state, reason);
+}
+
+static void
+on_ap_strength_changed(NMAccessPoint *ap, GParamSpec *pspec, NMInterface *nm_interface)
+{
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACCESS_POINTS);
+}
+
+static void
+libnm_backend_watch_ap(NMInterface *nm_interface, NMAccessPoint *ap)
+{
+    g_signal_connect(ap, "notify::" NM_ACCESS_POINT_STRENGTH,
+                     G_CALLBACK(on_ap_strength_changed), nm_interface);
+}
+
+static void
+on_wifi_ap_added(NMDeviceWifi *wifi, NMAccessPoint *ap, NMInterface *nm_interface)
+{
+    libnm_backend_watch_ap(nm_interface, ap);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACCESS_POINTS);
+}
+
+static void
+on_wifi_ap_removed(NMDeviceWifi *wifi, NMAccessPoint *ap, NMInterface *nm_interface)
+{
+    g_signal_handlers_disconnect_by_data(ap, nm_interface);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACCESS_POINTS);
+}
+
+static void
+on_wifi_active_ap_changed(NMDeviceWifi *wifi, GParamSpec *pspec, NMInterface *nm_interface)
+{
+    NMDeviceInfo *device_info;
+    NMAccessPoint *active_ap;
+
+    device_info = g_hash_table_lookup(nm_interface->devices, nm_object_get_path(NM_OBJECT(wifi)));
+    if (device_info) {
+        active_ap = nm_device_wifi_get_active_access_point(wifi);
+        g_free(device_info->specific.wifi.active_ap);
+        device_info->specific.wifi.active_ap =
+            active_ap ? g_strdup(nm_object_get_path(NM_OBJECT(active_ap))) : NULL;
+    }
+
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES |
+                                              NM_INTERFACE_CHANGED_ACCESS_POINTS);
+}
+
+static void
+on_wifi_bitrate_changed(NMDeviceWifi *wifi, GParamSpec *pspec, NMInterface *nm_interface)
+{
+    NMDeviceInfo *device_info;
+
+    device_info = g_hash_table_lookup(nm_interface->devices, nm_object_get_path(NM_OBJECT(wifi)));
+    if (device_info)
+        device_info->specific.wifi.bitrate = nm_device_wifi_get_bitrate(wifi);
+
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES);
+}
+
+static void
+libnm_backend_watch_device(NMInterface *nm_interface, NMDevice *device)
+{
+    g_signal_connect(device, "state-changed",
+                     G_CALLBACK(on_device_state_changed), nm_interface);
+
+    if (NM_IS_DEVICE_WIFI(device)) {
+        const GPtrArray *aps = nm_device_wifi_get_access_points(NM_DEVICE_WIFI(device));
+        guint i;
+
+        for (i = 0; aps && i < aps->len; i++)
+            libnm_backend_watch_ap(nm_interface, g_ptr_array_index(aps, i));
+
+        g_signal_connect(device, "access-point-added",
+                         G_CALLBACK(on_wifi_ap_added), nm_interface);
+        g_signal_connect(device, "access-point-removed",
+                         G_CALLBACK(on_wifi_ap_removed), nm_interface);
+        g_signal_connect(device, "notify::" NM_DEVICE_WIFI_ACTIVE_ACCESS_POINT,
+                         G_CALLBACK(on_wifi_active_ap_changed), nm_interface);
+        g_signal_connect(device, "notify::" NM_DEVICE_WIFI_BITRATE,
+                         G_CALLBACK(on_wifi_bitrate_changed), nm_interface);
+    }
+}
+
+static void
+libnm_backend_unwatch_device(NMInterface *nm_interface, NMDevice *device)
+{
+    if (NM_IS_DEVICE_WIFI(device)) {
+        const GPtrArray *aps = nm_device_wifi_get_access_points(NM_DEVICE_WIFI(device));
+        guint i;
+
+        for (i = 0; aps && i < aps->len; i++)
+            g_signal_handlers_disconnect_by_data(g_ptr_array_index(aps, i), nm_interface);
+    }
+
+    g_signal_handlers_disconnect_by_data(device, nm_interface);
+}
+
+static void
+on_client_device_added(NMClient *client, NMDevice *device, NMInterface *nm_interface)
+{
+    libnm_backend_watch_device(nm_interface, device);
+    nm_interface_notify_device_added(nm_interface, libnm_backend_create_device_info(device));
+}
+
+static void
+on_client_device_removed(NMClient *client, NMDevice *device, NMInterface *nm_interface)
+{
+    libnm_backend_unwatch_device(nm_interface, device);
+    nm_interface_notify_device_removed(nm_interface, nm_object_get_path(NM_OBJECT(device)));
+}
+
+static gboolean
+libnm_backend_init(NMInterface *nm_interface, GError **error)
+{
+    LibnmBackend *priv = g_new0(LibnmBackend, 1);
+    const GPtrArray *devices;
+    const GPtrArray *connections;
+    guint i;
+
+    nm_interface->backend_data = priv;
+    priv->active_connections = g_ptr_array_new_with_free_func(g_object_unref);
+
+    priv->client = nm_client_new(NULL, error);
+    if (!priv->client) {
+        return FALSE;
+    }
+
+    priv->connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, error);
+    if (!priv->connection) {
+        return FALSE;
+    }
+
+    /* Initial state comes straight from the object cache */
+    nm_interface->nm_state = nm_client_get_state(priv->client);
+    nm_interface->wireless_enabled = nm_client_wireless_get_enabled(priv->client);
+    nm_interface->networking_enabled = nm_client_networking_get_enabled(priv->client);
+    nm_interface->connectivity = nm_client_get_connectivity(priv->client);
+
+    devices = nm_client_get_devices(priv->client);
+    for (i = 0; devices && i < devices->len; i++) {
+        NMDevice *device = g_ptr_array_index(devices, i);
+        NMDeviceInfo *device_info = libnm_backend_create_device_info(device);
+
+        g_hash_table_insert(nm_interface->devices, g_strdup(device_info->path), device_info);
+        libnm_backend_watch_device(nm_interface, device);
+    }
+
+    connections = nm_client_get_connections(priv->client);
+    for (i = 0; connections && i < connections->len; i++) {
+        NMRemoteConnection *remote = g_ptr_array_index(connections, i);
+        NMConnectionInfo *connection_info = libnm_backend_create_connection_info(remote);
+
+        g_signal_connect(remote, "changed", G_CALLBACK(on_remote_connection_changed), nm_interface);
+        g_hash_table_insert(nm_interface->connections, g_strdup(connection_info->path), connection_info);
+    }
+
+    libnm_backend_load_active_connections(nm_interface, priv->client);
+
+    g_signal_connect(priv->client, "notify::" NM_CLIENT_STATE,
+                     G_CALLBACK(on_client_state_changed), nm_interface);
+    g_signal_connect(priv->client, "notify::" NM_CLIENT_CONNECTIVITY,
+                     G_CALLBACK(on_client_connectivity_changed), nm_interface);
+    g_signal_connect(priv->client, "notify::" NM_CLIENT_ACTIVE_CONNECTIONS,
+                     G_CALLBACK(on_client_active_changed), nm_interface);
+    g_signal_connect(priv->client, "notify::" NM_CLIENT_PRIMARY_CONNECTION,
+                     G_CALLBACK(on_client_active_changed), nm_interface);
+    g_signal_connect(priv->client, "device-added",
+                     G_CALLBACK(on_client_device_added), nm_interface);
+    g_signal_connect(priv->client, "device-removed",
+                     G_CALLBACK(on_client_device_removed), nm_interface);
+    g_signal_connect(priv->client, "connection-added",
+                     G_CALLBACK(on_client_connection_added), nm_interface);
+    g_signal_connect(priv->client, "connection-removed",
+                     G_CALLBACK(on_client_connection_removed), nm_interface);
+
+    return TRUE;
+}
+
+static void
+libnm_backend_shutdown(NMInterface *nm_interface)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+
+    if (!priv)
+        return;
+
+    if (priv->client) {
+        const GPtrArray *devices = nm_client_get_devices(priv->client);
+        const GPtrArray *connections = nm_client_get_connections(priv->client);
+        guint i;
+
+        for (i = 0; devices && i < devices->len; i++) {
+            libnm_backend_unwatch_device(nm_interface, g_ptr_array_index(devices, i));
+        }
+        for (i = 0; connections && i < connections->len; i++)
+            g_signal_handlers_disconnect_by_data(g_ptr_array_index(connections, i), nm_interface);
+        g_signal_handlers_disconnect_by_data(priv->client, nm_interface);
+    }
+
+    libnm_backend_unwatch_active_connections(nm_interface);
+    g_ptr_array_unref(priv->active_connections);
+
+    if (priv->statistics_subscriptions) {
+        GHashTableIter iter;
+        gpointer id;
+
+        g_hash_table_iter_init(&iter, priv->statistics_subscriptions);
+        while (g_hash_table_iter_next(&iter, NULL, &id))
+            g_dbus_connection_signal_unsubscribe(priv->connection, GPOINTER_TO_UINT(id));
+        g_hash_table_destroy(priv->statistics_subscriptions);
+    }
+
+    g_clear_object(&priv->client);
+    g_clear_object(&priv->connection);
+
+    g_free(priv);
+    nm_interface->backend_data = NULL;
+}
+
+static NMAccessPointInfo *
+libnm_backend_create_ap_info(NMAccessPoint *ap)
+{
+    NMAccessPointInfo *ap_info;
+    GBytes *ssid;
+
+    ap_info = g_new0(NMAccessPointInfo, 1);
+    ap_info->path = g_strdup(nm_object_get_path(NM_OBJECT(ap)));
+
+    ssid = nm_access_point_get_ssid(ap);
+    if (ssid && g_bytes_get_size(ssid) > 0) {
+        gsize length;
+        const gchar *ssid_data = g_bytes_get_data(ssid, &length);
+        ap_info->ssid = g_strndup(ssid_data, length);
+    } else {
+        ap_info->ssid = g_strdup("(hidden)");
+    }
+
+    ap_info->strength = nm_access_point_get_strength(ap);
+    ap_info->bssid = g_strdup(nm_access_point_get_bssid(ap));
+    ap_info->frequency = nm_access_point_get_frequency(ap);
+    ap_info->security = g_strdup(nm_interface_security_from_flags(nm_access_point_get_flags(ap),
+                                                                   nm_access_point_get_wpa_flags(ap),
+                                                                   nm_access_point_get_rsn_flags(ap)));
+
+    return ap_info;
+}
+
+static GList *
+libnm_backend_get_access_points(NMInterface *nm_interface, const gchar *device_path)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    GList *access_points = NULL;
+    const GPtrArray *aps;
+    NMDevice *device;
+    guint i;
+
+    device = nm_client_get_device_by_path(priv->client, device_path);
+    if (!NM_IS_DEVICE_WIFI(device)) {
+        return NULL;
+    }
+
+    aps = nm_device_wifi_get_access_points(NM_DEVICE_WIFI(device));
+    for (i = 0; aps && i < aps->len; i++) {
+        access_points = g_list_prepend(access_points,
+                                       libnm_backend_create_ap_info(g_ptr_array_index(aps, i)));
+    }
+
+    return g_list_reverse(access_points);
+}
+
+static gboolean
+libnm_backend_request_scan(NMInterface *nm_interface, const gchar *device_path, GError **error)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    NMDevice *device;
+
+    device = nm_client_get_device_by_path(priv->client, device_path);
+    if (!NM_IS_DEVICE_WIFI(device)) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    "%s is not a Wi-Fi device", device_path);
+        return FALSE;
+    }
+
+    /* Scan results arrive through the object cache, nothing to wait for */
+    nm_device_wifi_request_scan_async(NM_DEVICE_WIFI(device), NULL, NULL, NULL);
+
+    return TRUE;
+}
+
+static gboolean
+libnm_backend_activate_connection(NMInterface *nm_interface,
+                                  const gchar *connection_path,
+                                  const gchar *device_path,
+                                  GError **error)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    GVariant *result;
+
+    result = g_dbus_connection_call_sync(priv->connection,
+                                         NM_DBUS_SERVICE,
+                                         NM_DBUS_PATH,
+                                         NM_DBUS_INTERFACE,
+                                         "ActivateConnection",
+                                         g_variant_new("(ooo)", connection_path, device_path, "/"),
+                                         G_VARIANT_TYPE("(o)"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         30000,  /* 30 second timeout */
+                                         NULL,
+                                         error);
+    if (result) {
+        g_variant_unref(result);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+libnm_backend_add_and_activate(NMInterface *nm_interface,
+                               GVariant *connection_dict,
+                               const gchar *device_path,
+                               const gchar *specific_object,
+                               GError **error)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    GVariant *result;
+
+    result = g_dbus_connection_call_sync(priv->connection,
+                                         NM_DBUS_SERVICE,
+                                         NM_DBUS_PATH,
+                                         NM_DBUS_INTERFACE,
+                                         "AddAndActivateConnection",
+                                         g_variant_new("(@a{sa{sv}}oo)",
+                                                       connection_dict,
+                                                       device_path,
+                                                       specific_object),
+                                         G_VARIANT_TYPE("(oo)"),
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         30000,  /* 30 second timeout */
+                                         NULL,
+                                         error);
+    if (result) {
+        const gchar *connection_path, *active_path;
+        g_variant_get(result, "(&o&o)", &connection_path, &active_path);
+        g_debug("Created connection: %s, Active: %s", connection_path, active_path);
+        g_variant_unref(result);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static gboolean
+libnm_backend_deactivate_connection(NMInterface *nm_interface,
+                                    const gchar *active_path,
+                                    GError **error)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    GVariant *result;
+
+    result = g_dbus_connection_call_sync(priv->connection,
+                                         NM_DBUS_SERVICE,
+                                         NM_DBUS_PATH,
+                                         NM_DBUS_INTERFACE,
+                                         "DeactivateConnection",
+                                         g_variant_new("(o)", active_path),
+                                         NULL,
+                                         G_DBUS_CALL_FLAGS_NONE,
+                                         -1,
+                                         NULL,
+                                         error);
+    if (result) {
+        g_variant_unref(result);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+on_statistics_properties_changed(GDBusConnection *connection,
+                                 const gchar *sender_name,
+                                 const gchar *object_path,
+                                 const gchar *interface_name,
+                                 const gchar *signal_name,
+                                 GVariant *parameters,
+                                 gpointer user_data)
+{
+    NMInterface *nm_interface = (NMInterface *)user_data;
+    LibnmBackend *priv = nm_interface->backend_data;
+    NMDevice *device;
+    GVariant *changed;
+    guint64 rx_bytes, tx_bytes;
+    gboolean have_rx, have_tx;
+
+    g_variant_get(parameters, "(&s@a{sv}@as)", NULL, &changed, NULL);
+    have_rx = g_variant_lookup(changed, "RxBytes", "t", &rx_bytes);
+    have_tx = g_variant_lookup(changed, "TxBytes", "t", &tx_bytes);
+    g_variant_unref(changed);
+
+    if (!have_rx && !have_tx)
+        return;
+
+    /* A counter that did not change is left out; NMClient still has its value */
+    device = nm_client_get_device_by_path(priv->client, object_path);
+    if (!device)
+        return;
+    if (!have_rx)
+        rx_bytes = nm_device_statistics_get_rx_bytes(device);
+    if (!have_tx)
+        tx_bytes = nm_device_statistics_get_tx_bytes(device);
+
+    nm_statistics_add_sample(nm_interface, object_path, rx_bytes, tx_bytes);
+}
+
+static gboolean
+libnm_backend_set_statistics_rate(NMInterface *nm_interface, const gchar *device_path, guint rate_ms)
+{
+    LibnmBackend *priv = nm_interface->backend_data;
+    gpointer id;
+
+    if (!nm_client_get_device_by_path(priv->client, device_path))
+        return FALSE;
+
+    if (!priv->statistics_subscriptions)
+        priv->statistics_subscriptions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    id = g_hash_table_lookup(priv->statistics_subscriptions, device_path);
+    if (rate_ms && !id) {
+        id = GUINT_TO_POINTER(g_dbus_connection_signal_subscribe(priv->connection,
+                                                                 NM_DBUS_SERVICE,
+                                                                 "org.freedesktop.DBus.Properties",
+                                                                 "PropertiesChanged",
+                                                                 device_path,
+                                                                 NM_DBUS_INTERFACE_DEVICE_STATISTICS,
+                                                                 G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                 on_statistics_properties_changed,
+                                                                 nm_interface,
+                                                                 NULL));
+        g_hash_table_insert(priv->statistics_subscriptions, g_strdup(device_path), id);
+    } else if (!rate_ms && id) {
+        g_dbus_connection_signal_unsubscribe(priv->connection, GPOINTER_TO_UINT(id));
+        g_hash_table_remove(priv->statistics_subscriptions, device_path);
+    }
+
+    /* Fire and forget, like the proxies of the dbus backend */
+    g_dbus_connection_call(priv->connection,
+                           NM_DBUS_SERVICE,
+                           device_path,
+                           "org.freedesktop.DBus.Properties",
+                           "Set",
+                           g_variant_new("(ssv)", NM_DBUS_INTERFACE_DEVICE_STATISTICS,
+                                         "RefreshRateMs", g_variant_new_uint32(rate_ms)),
+                           NULL,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           NULL,
+                           NULL,
+                           NULL);
+
+    return TRUE;
+}
+
+const NMInterfaceBackend nm_interface_libnm_backend = {
+    .name                  = "libnm",
+    .init                  = libnm_backend_init,
+    .shutdown              = libnm_backend_shutdown,
+    .get_access_points     = libnm_backend_get_access_points,
+    .request_scan          = libnm_backend_request_scan,
+    .activate_connection   = libnm_backend_activate_connection,
+    .add_and_activate      = libnm_backend_add_and_activate,
+    .deactivate_connection = libnm_backend_deactivate_connection,
+    .set_statistics_rate   = libnm_backend_set_statistics_rate,
+};
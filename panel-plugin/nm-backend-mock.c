@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "nm-interface-private.h"
+#include <string.h>
+
+/*
+ * In-process mock backend. The whole NetworkManager state is loaded from a
+ * snapshot key file so the popup and status logic can be exercised and
+ * profiled without a running NetworkManager. The same format is written by
+ * nm_interface_save_snapshot() from any backend, e.g.:
+ *
+ *   [NetworkManager]
+ *   State=70
+ *   Connectivity=4
+ *   WirelessEnabled=true
+ *   NetworkingEnabled=true
+ *   PrimaryConnection=/org/freedesktop/NetworkManager/ActiveConnection/1
+ *
+ *   [Device /org/freedesktop/NetworkManager/Devices/2]
+ *   Interface=wlan0
+ *   Type=2
+ *   State=100
+ *   Managed=true
+ *   ActiveAccessPoint=/org/freedesktop/NetworkManager/AccessPoint/1
+ *   Bitrate=866700
+ *   AccessPoints=/org/freedesktop/NetworkManager/AccessPoint/1;
+ *
+ *   [AccessPoint /org/freedesktop/NetworkManager/AccessPoint/1]
+ *   Ssid=Office
+ *   Strength=72
+ *   Security=WPA2
+ *   Bssid=00:11:22:33:44:55
+ *   Frequency=5180
+ *
+ *   [Connection /org/freedesktop/NetworkManager/Settings/1]
+ *   Uuid=...
+ *   Id=Office
+ *   Type=802-11-wireless
+ *   Timestamp=1700000000
+ *
+ *   [ActiveConnection /org/freedesktop/NetworkManager/ActiveConnection/1]
+ *   Connection=/org/freedesktop/NetworkManager/Settings/1
+ *   SpecificObject=/org/freedesktop/NetworkManager/AccessPoint/1
+ *   Devices=/org/freedesktop/NetworkManager/Devices/2;
+ *   State=2
+ *   Default=true
+ *   Vpn=false
+ */
+
+#define SNAPSHOT_GROUP_MANAGER     "NetworkManager"
+#define SNAPSHOT_PREFIX_DEVICE     "Device "
+#define SNAPSHOT_PREFIX_AP         "AccessPoint "
+#define SNAPSHOT_PREFIX_CONNECTION "Connection "
+#define SNAPSHOT_PREFIX_ACTIVE     "ActiveConnection "
+
+typedef struct {
+    GHashTable *access_points;    /* AP path -> NMAccessPointInfo */
+    GHashTable *device_aps;       /* device path -> GPtrArray of AP paths */
+} MockBackend;
+
+static void
+mock_backend_load_device(NMInterface *nm_interface, GKeyFile *key_file,
+                         const gchar *group, const gchar *path)
+{
+    MockBackend *priv = nm_interface->backend_data;
+    NMDeviceInfo *device_info;
+    gchar **aps;
+
+    device_info = g_new0(NMDeviceInfo, 1);
+    device_info->path = g_strdup(path);
+    device_info->interface = g_key_file_get_string(key_file, group, "Interface", NULL);
+    device_info->type = g_key_file_get_integer(key_file, group, "Type", NULL);
+    device_info->state = g_key_file_get_integer(key_file, group, "State", NULL);
+    device_info->managed = g_key_file_get_boolean(key_file, group, "Managed", NULL);
+
+    if (device_info->type == NM_DEVICE_TYPE_WIFI) {
+        device_info->specific.wifi.active_ap =
+            g_key_file_get_string(key_file, group, "ActiveAccessPoint", NULL);
+        device_info->specific.wifi.bitrate = g_key_file_get_integer(key_file, group, "Bitrate", NULL);
+
+        aps = g_key_file_get_string_list(key_file, group, "AccessPoints", NULL, NULL);
+        if (aps) {
+            GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+            guint i;
+
+            /* The array takes over the strings, only the vector is freed */
+            for (i = 0; aps[i] != NULL; i++)
+                g_ptr_array_add(paths, aps[i]);
+            g_free(aps);
+
+            g_hash_table_insert(priv->device_aps, g_strdup(path), paths);
+        }
+    }
+
+    g_hash_table_insert(nm_interface->devices, g_strdup(path), device_info);
+}
+
+static void
+mock_backend_load_ap(NMInterface *nm_interface, GKeyFile *key_file,
+                     const gchar *group, const gchar *path)
+{
+    MockBackend *priv = nm_interface->backend_data;
+    NMAccessPointInfo *ap_info;
+
+    ap_info = g_new0(NMAccessPointInfo, 1);
+    ap_info->path = g_strdup(path);
+    ap_info->ssid = g_key_file_get_string(key_file, group, "Ssid", NULL);
+    ap_info->strength = CLAMP(g_key_file_get_integer(key_file, group, "Strength", NULL), 0, 100);
+    ap_info->security = g_key_file_get_string(key_file, group, "Security", NULL);
+    if (!ap_info->security)
+        ap_info->security = g_strdup("None");
+    ap_info->bssid = g_key_file_get_string(key_file, group, "Bssid", NULL);
+    ap_info->frequency = g_key_file_get_integer(key_file, group, "Frequency", NULL);
+
+    g_hash_table_insert(priv->access_points, ap_info->path, ap_info);
+}
+
+static void
+mock_backend_load_connection(NMInterface *nm_interface, GKeyFile *key_file,
+                             const gchar *group, const gchar *path)
+{
+    NMConnectionInfo *connection_info;
+
+    connection_info = g_new0(NMConnectionInfo, 1);
+    connection_info->path = g_strdup(path);
+    connection_info->uuid = g_key_file_get_string(key_file, group, "Uuid", NULL);
+    connection_info->id = g_key_file_get_string(key_file, group, "Id", NULL);
+    connection_info->type = g_key_file_get_string(key_file, group, "Type", NULL);
+    connection_info->timestamp = g_key_file_get_uint64(key_file, group, "Timestamp", NULL);
+
+    g_hash_table_insert(nm_interface->connections, g_strdup(path), connection_info);
+}
+
+static void
+mock_backend_load_active(NMInterface *nm_interface, GKeyFile *key_file,
+                         const gchar *group, const gchar *path)
+{
+    NMActiveConnectionInfo *active;
+    NMConnectionInfo *connection_info;
+
+    active = g_new0(NMActiveConnectionInfo, 1);
+    active->path = g_strdup(path);
+    active->connection = g_key_file_get_string(key_file, group, "Connection", NULL);
+    active->specific_object = g_key_file_get_string(key_file, group, "SpecificObject", NULL);
+    active->devices = g_key_file_get_string_list(key_file, group, "Devices", NULL, NULL);
+    active->state = g_key_file_get_integer(key_file, group, "State", NULL);
+    active->is_default = g_key_file_get_boolean(key_file, group, "Default", NULL);
+    active->vpn = g_key_file_get_boolean(key_file, group, "Vpn", NULL);
+
+    /* Uuid, Id and Type default to the settings connection they refer to */
+    connection_info = g_hash_table_lookup(nm_interface->connections, active->connection ? active->connection : "");
+    active->uuid = g_key_file_get_string(key_file, group, "Uuid", NULL);
+    if (!active->uuid && connection_info)
+        active->uuid = g_strdup(connection_info->uuid);
+    active->id = g_key_file_get_string(key_file, group, "Id", NULL);
+    if (!active->id && connection_info)
+        active->id = g_strdup(connection_info->id);
+    active->type = g_key_file_get_string(key_file, group, "Type", NULL);
+    if (!active->type && connection_info)
+        active->type = g_strdup(connection_info->type);
+
+    g_hash_table_insert(nm_interface->active_connections, g_strdup(path), active);
+}
+
+static gboolean
+mock_backend_init(NMInterface *nm_interface, GError **error)
+{
+    MockBackend *priv = g_new0(MockBackend, 1);
+    GKeyFile *key_file;
+    gchar **groups;
+    gchar *primary;
+    guint i;
+
+    nm_interface->backend_data = priv;
+    priv->access_points = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                (GDestroyNotify)nm_interface_free_ap_info);
+    priv->device_aps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)g_ptr_array_unref);
+
+    if (!nm_interface->snapshot_path) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "No snapshot file given for the mock backend");
+        return FALSE;
+    }
+
+    key_file = g_key_file_new();
+    if (!g_key_file_load_from_file(key_file, nm_interface->snapshot_path, G_KEY_FILE_NONE, error)) {
+        g_key_file_free(key_file);
+        return FALSE;
+    }
+
+    nm_interface->nm_state = g_key_file_get_integer(key_file, SNAPSHOT_GROUP_MANAGER, "State", NULL);
+    nm_interface->connectivity = g_key_file_get_integer(key_file, SNAPSHOT_GROUP_MANAGER, "Connectivity", NULL);
+    nm_interface->wireless_enabled = g_key_file_get_boolean(key_file, SNAPSHOT_GROUP_MANAGER, "WirelessEnabled", NULL);
+    nm_interface->networking_enabled = g_key_file_get_boolean(key_file, SNAPSHOT_GROUP_MANAGER, "NetworkingEnabled", NULL);
+
+    /* Connections first so active connections can inherit their names */
+    groups = g_key_file_get_groups(key_file, NULL);
+    for (i = 0; groups[i] != NULL; i++) {
+        if (g_str_has_prefix(groups[i], SNAPSHOT_PREFIX_DEVICE))
+            mock_backend_load_device(nm_interface, key_file, groups[i],
+                                     groups[i] + strlen(SNAPSHOT_PREFIX_DEVICE));
+        else if (g_str_has_prefix(groups[i], SNAPSHOT_PREFIX_AP))
+            mock_backend_load_ap(nm_interface, key_file, groups[i],
+                                 groups[i] + strlen(SNAPSHOT_PREFIX_AP));
+        else if (g_str_has_prefix(groups[i], SNAPSHOT_PREFIX_CONNECTION))
+            mock_backend_load_connection(nm_interface, key_file, groups[i],
+                                         groups[i] + strlen(SNAPSHOT_PREFIX_CONNECTION));
+    }
+    for (i = 0; groups[i] != NULL; i++) {
+        if (g_str_has_prefix(groups[i], SNAPSHOT_PREFIX_ACTIVE))
+            mock_backend_load_active(nm_interface, key_file, groups[i],
+                                     groups[i] + strlen(SNAPSHOT_PREFIX_ACTIVE));
+    }
+    g_strfreev(groups);
+
+    primary = g_key_file_get_string(key_file, SNAPSHOT_GROUP_MANAGER, "PrimaryConnection", NULL);
+    nm_interface_set_primary_connection(nm_interface, primary);
+    g_free(primary);
+
+    g_key_file_free(key_file);
+
+    return TRUE;
+}
+
+static void
+mock_backend_shutdown(NMInterface *nm_interface)
+{
+    MockBackend *priv = nm_interface->backend_data;
+
+    if (!priv)
+        return;
+
+    g_hash_table_destroy(priv->device_aps);
+    g_hash_table_destroy(priv->access_points);
+    g_free(priv);
+    nm_interface->backend_data = NULL;
+}
+
+static GList *
+mock_backend_get_access_points(NMInterface *nm_interface, const gchar *device_path)
+{
+    MockBackend *priv = nm_interface->backend_data;
+    GList *access_points = NULL;
+    GPtrArray *paths;
+    guint i;
+
+    paths = g_hash_table_lookup(priv->device_aps, device_path);
+    if (!paths)
+        return NULL;
+
+    for (i = paths->len; i > 0; i--) {
+        NMAccessPointInfo *ap_info = g_hash_table_lookup(priv->access_points,
+                                                         g_ptr_array_index(paths, i - 1));
+        if (ap_info)
+            access_points = g_list_prepend(access_points, nm_interface_copy_ap_info(ap_info));
+    }
+
+    return access_points;
+}
+
+static gboolean
+mock_backend_request_scan(NMInterface *nm_interface, const gchar *device_path, GError **error)
+{
+    g_debug("Mock scan requested on %s", device_path);
+    return TRUE;
+}
+
+/* Snapshots have no counters; tests feed samples through nm_statistics_add_sample() */
+static gboolean
+mock_backend_set_statistics_rate(NMInterface *nm_interface, const gchar *device_path, guint rate_ms)
+{
+    g_debug("Mock statistics refresh rate of %s set to %u ms", device_path, rate_ms);
+    return g_hash_table_contains(nm_interface->devices, device_path);
+}
+
+static gboolean
+mock_backend_activate_connection(NMInterface *nm_interface,
+                                 const gchar *connection_path,
+                                 const gchar *device_path,
+                                 GError **error)
+{
+    g_debug("Mock activation of %s on %s", connection_path, device_path);
+    return TRUE;
+}
+
+static gboolean
+mock_backend_add_and_activate(NMInterface *nm_interface,
+                              GVariant *connection_dict,
+                              const gchar *device_path,
+                              const gchar *specific_object,
+                              GError **error)
+{
+    g_debug("Mock add-and-activate on %s (%s)", device_path, specific_object);
+    return TRUE;
+}
+
+static gboolean
+mock_backend_deactivate_connection(NMInterface *nm_interface,
+                                   const gchar *active_path,
+                                   GError **error)
+{
+    g_debug("Mock deactivation of %s", active_path);
+    return TRUE;
+}
+
+/* Write the current state of any backend in the snapshot format */
+gboolean
+nm_interface_save_snapshot(NMInterface *nm_interface, const gchar *filename, GError **error)
+{
+    GKeyFile *key_file;
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean success;
+
+    key_file = g_key_file_new();
+
+    g_key_file_set_integer(key_file, SNAPSHOT_GROUP_MANAGER, "State", nm_interface->nm_state);
+    g_key_file_set_integer(key_file, SNAPSHOT_GROUP_MANAGER, "Connectivity", nm_interface->connectivity);
+    g_key_file_set_boolean(key_file, SNAPSHOT_GROUP_MANAGER, "WirelessEnabled", nm_interface->wireless_enabled);
+    g_key_file_set_boolean(key_file, SNAPSHOT_GROUP_MANAGER, "NetworkingEnabled", nm_interface->networking_enabled);
+    if (nm_interface->primary_connection)
+        g_key_file_set_string(key_file, SNAPSHOT_GROUP_MANAGER, "PrimaryConnection",
+                              nm_interface->primary_connection);
+
+    g_hash_table_iter_init(&iter, nm_interface->devices);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        NMDeviceInfo *device_info = value;
+        gchar *group = g_strconcat(SNAPSHOT_PREFIX_DEVICE, device_info->path, NULL);
+
+        if (device_info->interface)
+            g_key_file_set_string(key_file, group, "Interface", device_info->interface);
+        g_key_file_set_integer(key_file, group, "Type", device_info->type);
+        g_key_file_set_integer(key_file, group, "State", device_info->state);
+        g_key_file_set_boolean(key_file, group, "Managed", device_info->managed);
+
+        if (device_info->type == NM_DEVICE_TYPE_WIFI) {
+            GList *aps, *l;
+            GPtrArray *paths = g_ptr_array_new();
+
+            if (device_info->specific.wifi.active_ap)
+                g_key_file_set_string(key_file, group, "ActiveAccessPoint",
+                                      device_info->specific.wifi.active_ap);
+            if (device_info->specific.wifi.bitrate)
+                g_key_file_set_integer(key_file, group, "Bitrate", device_info->specific.wifi.bitrate);
+
+            aps = nm_interface_get_access_points(nm_interface, device_info->path);
+            for (l = aps; l != NULL; l = l->next) {
+                NMAccessPointInfo *ap_info = l->data;
+                gchar *ap_group = g_strconcat(SNAPSHOT_PREFIX_AP, ap_info->path, NULL);
+
+                if (ap_info->ssid)
+                    g_key_file_set_string(key_file, ap_group, "Ssid", ap_info->ssid);
+                g_key_file_set_integer(key_file, ap_group, "Strength", ap_info->strength);
+                if (ap_info->security)
+                    g_key_file_set_string(key_file, ap_group, "Security", ap_info->security);
+                if (ap_info->bssid)
+                    g_key_file_set_string(key_file, ap_group, "Bssid", ap_info->bssid);
+                if (ap_info->frequency)
+                    g_key_file_set_integer(key_file, ap_group, "Frequency", ap_info->frequency);
+
+                g_ptr_array_add(paths, ap_info->path);
+                g_free(ap_group);
+            }
+
+            g_key_file_set_string_list(key_file, group, "AccessPoints",
+                                       (const gchar * const *)paths->pdata, paths->len);
+            g_ptr_array_free(paths, TRUE);
+            g_list_free_full(aps, (GDestroyNotify)nm_interface_free_ap_info);
+        }
+
+        g_free(group);
+    }
+
+    g_hash_table_iter_init(&iter, nm_interface->connections);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        NMConnectionInfo *connection_info = value;
+        gchar *group = g_strconcat(SNAPSHOT_PREFIX_CONNECTION, connection_info->path, NULL);
+
+        if (connection_info->uuid)
+            g_key_file_set_string(key_file, group, "Uuid", connection_info->uuid);
+        if (connection_info->id)
+            g_key_file_set_string(key_file, group, "Id", connection_info->id);
+        if (connection_info->type)
+            g_key_file_set_string(key_file, group, "Type", connection_info->type);
+        g_key_file_set_uint64(key_file, group, "Timestamp", connection_info->timestamp);
+
+        g_free(group);
+    }
+
+    g_hash_table_iter_init(&iter, nm_interface->active_connections);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        NMActiveConnectionInfo *active = value;
+        gchar *group = g_strconcat(SNAPSHOT_PREFIX_ACTIVE, active->path, NULL);
+
+        if (active->connection)
+            g_key_file_set_string(key_file, group, "Connection", active->connection);
+        if (active->uuid)
+            g_key_file_set_string(key_file, group, "Uuid", active->uuid);
+        if (active->id)
+            g_key_file_set_string(key_file, group, "Id", active->id);
+        if (active->type)
+            g_key_file_set_string(key_file, group, "Type", active->type);
+        if (active->specific_object)
+            g_key_file_set_string(key_file, group, "SpecificObject", active->specific_object);
+        if (active->devices)
+            g_key_file_set_string_list(key_file, group, "Devices",
+                                       (const gchar * const *)active->devices,
+                                       g_strv_length(active->devices));
+        g_key_file_set_integer(key_file, group, "State", active->state);
+        g_key_file_set_boolean(key_file, group, "Default", active->is_default);
+        g_key_file_set_boolean(key_file, group, "Vpn", active->vpn);
+
+        g_free(group);
+    }
+
+    success = g_key_file_save_to_file(key_file, filename, error);
+    g_key_file_free(key_file);
+
+    return success;
+}
+
+const NMInterfaceBackend nm_interface_mock_backend = {
+    .name                  = "mock",
+    .init                  = mock_backend_init,
+    .shutdown              = mock_backend_shutdown,
+    .get_access_points     = mock_backend_get_access_points,
+    .request_scan          = mock_backend_request_scan,
+    .activate_connection   = mock_backend_activate_connection,
+    .add_and_activate      = mock_backend_add_and_activate,
+    .deactivate_connection = mock_backend_deactivate_connection,
+    .set_statistics_rate   = mock_backend_set_statistics_rate,
+};
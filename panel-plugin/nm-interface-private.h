@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __NM_INTERFACE_PRIVATE_H__
+#define __NM_INTERFACE_PRIVATE_H__
+
+#include "nm-interface.h"
+
+G_BEGIN_DECLS
+
+typedef struct _NMInterfaceBackend NMInterfaceBackend;
+
+/*
+ * Backend vtable. A backend owns the transport to NetworkManager and keeps
+ * the device and connection tables of NMInterface up to date; everything
+ * in the public nm_interface_* API dispatches through this table.
+ */
+struct _NMInterfaceBackend {
+    const gchar *name;
+
+    gboolean  (*init)                  (NMInterface *nm_interface,
+                                        GError **error);
+    void      (*shutdown)              (NMInterface *nm_interface);
+
+    GList    *(*get_access_points)     (NMInterface *nm_interface,
+                                        const gchar *device_path);
+    gboolean  (*request_scan)          (NMInterface *nm_interface,
+                                        const gchar *device_path,
+                                        GError **error);
+
+    gboolean  (*activate_connection)   (NMInterface *nm_interface,
+                                        const gchar *connection_path,
+                                        const gchar *device_path,
+                                        GError **error);
+    gboolean  (*add_and_activate)      (NMInterface *nm_interface,
+                                        GVariant *connection_dict,
+                                        const gchar *device_path,
+                                        const gchar *specific_object,
+                                        GError **error);
+    gboolean  (*deactivate_connection) (NMInterface *nm_interface,
+                                        const gchar *active_path,
+                                        GError **error);
+
+    /* Optional; rate 0 stops the counters. Samples go to nm_statistics_add_sample() */
+    gboolean  (*set_statistics_rate)   (NMInterface *nm_interface,
+                                        const gchar *device_path,
+                                        guint rate_ms);
+};
+
+/* NMInterface structure */
+struct _NMInterface {
+    const NMInterfaceBackend *backend;
+    gpointer                  backend_data;
+    gboolean                  initialized;
+
+    GHashTable              *devices;        /* object path -> NMDeviceInfo */
+    GHashTable              *connections;    /* object path -> NMConnectionInfo */
+    GHashTable              *active_connections; /* object path -> NMActiveConnectionInfo */
+
+    /* Snapshot file for the mock backend */
+    gchar                   *snapshot_path;
+
+    /* Current state */
+    NMState                  nm_state;
+    NMConnectivityState      connectivity;
+    gboolean                 wireless_enabled;
+    gboolean                 networking_enabled;
+    gchar                   *primary_connection; /* active connection path */
+
+    /* Signal handlers */
+    NMStateChangedCallback   state_changed_cb;
+    NMDeviceCallback         device_added_cb;
+    NMDeviceCallback         device_removed_cb;
+    gpointer                 user_data;
+
+    /* Change listeners; removal while notifying only marks them */
+    GList                   *listeners;
+    guint                    next_listener_id;
+    guint                    notify_depth;
+    gboolean                 listeners_removed;
+
+    /* Traffic statistics, see nm-statistics.c */
+    GHashTable              *statistics;     /* device path -> NMDeviceStatistics, watched only */
+    GList                   *statistics_watches;
+    guint                    next_statistics_watch_id;
+    guint                    statistics_dispatch_depth;
+    gboolean                 statistics_watches_removed;
+
+    /* NetlinkMonitor updating the devices' link state, if enabled */
+    gpointer                 link_monitor;
+};
+
+/* Available backends */
+extern const NMInterfaceBackend nm_interface_dbus_backend;
+extern const NMInterfaceBackend nm_interface_libnm_backend;
+extern const NMInterfaceBackend nm_interface_mock_backend;
+
+/* Helpers shared by the backends */
+const gchar *nm_interface_security_from_flags   (guint32 flags,
+                                                 guint32 wpa_flags,
+                                                 guint32 rsn_flags);
+void         nm_interface_notify_state_changed  (NMInterface *nm_interface,
+                                                 NMState state);
+void         nm_interface_notify_device_added   (NMInterface *nm_interface,
+                                                 NMDeviceInfo *device_info);
+void         nm_interface_notify_device_removed (NMInterface *nm_interface,
+                                                 const gchar *device_path);
+void         nm_interface_set_primary_connection (NMInterface *nm_interface,
+                                                 const gchar *active_path);
+void         nm_interface_notify_changed        (NMInterface *nm_interface,
+                                                 NMInterfaceChangeFlags changes);
+
+/* Statistics bookkeeping, see nm-statistics.h */
+void         nm_statistics_add_sample           (NMInterface *nm_interface,
+                                                 const gchar *device_path,
+                                                 guint64 rx_bytes,
+                                                 guint64 tx_bytes);
+guint        nm_statistics_get_refresh_rate     (NMInterface *nm_interface,
+                                                 const gchar *device_path);
+void         nm_statistics_resume               (NMInterface *nm_interface,
+                                                 const gchar *device_path);
+void         nm_statistics_stop                 (NMInterface *nm_interface);
+void         nm_statistics_clear                (NMInterface *nm_interface);
+
+G_END_DECLS
+
+#endif /* __NM_INTERFACE_PRIVATE_H__ */
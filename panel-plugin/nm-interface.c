@@ -8,66 +8,101 @@
  */
 
 #ifdef HAVE_CONFIG_H
-#include config.h
+#include <config.h>
 #endif
 
-#include "nm-interface.h"
+#include "nm-interface-private.h"
+#include "netlink-monitor.h"
 #include "utils.h"
 #include <string.h>
 #include "connection-types/ethernet.h"
+#include "connection-types/wifi.h"
 
-/* D-Bus paths and interfaces */
-#define NM_DBUS_SERVICE                   "org.freedesktop.NetworkManager"
-#define NM_DBUS_PATH                      "/org/freedesktop/NetworkManager"
-#define NM_DBUS_INTERFACE                 "org.freedesktop.NetworkManager"
-#define NM_DBUS_INTERFACE_DEVICE          "org.freedesktop.NetworkManager.Device"
-#define NM_DBUS_INTERFACE_DEVICE_WIRELESS "org.freedesktop.NetworkManager.Device.Wireless"
-#define NM_DBUS_INTERFACE_ACCESS_POINT    "org.freedesktop.NetworkManager.AccessPoint"
-#define NM_DBUS_INTERFACE_SETTINGS        "org.freedesktop.NetworkManager.Settings"
-#define NM_DBUS_INTERFACE_CONNECTION      "org.freedesktop.NetworkManager.Settings.Connection"
-
-/* Forward declarations */
-static void nm_interface_update_state(NMInterface *nm_interface);
-static void nm_interface_load_devices(NMInterface *nm_interface);
-static void nm_interface_load_connections(NMInterface *nm_interface);
-static void nm_interface_setup_signals(NMInterface *nm_interface);
-static NMDeviceInfo *nm_interface_create_device_info(NMInterface *nm_interface, const gchar *device_path);
-static NMConnectionInfo *nm_interface_create_connection_info(NMInterface *nm_interface, const gchar *connection_path);
-
-/* NMInterface structure */
-struct _NMInterface {
-    GDBusConnection         *connection;
-    GDBusProxy              *nm_proxy;
-    GDBusProxy              *settings_proxy;
-    GHashTable              *devices;
-    GHashTable              *connections;
-    
-    /* Current state */
-    NMState                  nm_state;
-    gboolean                 wireless_enabled;
-    gboolean                 networking_enabled;
-
-    /* Signal handlers */
-    NMStateChangedCallback   state_changed_cb;
-    NMDeviceCallback         device_added_cb;
-    NMDeviceCallback         device_removed_cb;
-    gpointer                 user_data;
-    
-    /* Signal subscription IDs */
-    guint                    state_changed_id;
-    guint                    device_added_id;
-    guint                    device_removed_id;
+/* Backend used by nm_interface_new(), selected with -Dbackend= */
+#ifndef NM_INTERFACE_DEFAULT_BACKEND
+#define NM_INTERFACE_DEFAULT_BACKEND "dbus"
+#endif
+
+typedef struct {
+    guint                  id;
+    NMInterfaceChangeFlags mask;
+    NMChangedCallback      callback;
+    gpointer               user_data;
+    gboolean               removed;
+} NMInterfaceListener;
+
+static const NMInterfaceBackend *nm_interface_backends[] = {
+    &nm_interface_dbus_backend,
+    &nm_interface_libnm_backend,
+    &nm_interface_mock_backend,
+    NULL
 };
 
+static const NMInterfaceBackend *
+nm_interface_lookup_backend(const gchar *backend_name)
+{
+    guint i;
+
+    for (i = 0; nm_interface_backends[i] != NULL; i++) {
+        if (g_strcmp0(nm_interface_backends[i]->name, backend_name) == 0)
+            return nm_interface_backends[i];
+    }
+
+    return NULL;
+}
 
 NMInterface *
 nm_interface_new(void)
+{
+    const gchar *backend_name;
+    const gchar *snapshot;
+
+    /* Replay a recorded state instead of talking to NetworkManager */
+    snapshot = g_getenv("XFCE_NM_SNAPSHOT");
+    if (snapshot && *snapshot)
+        return nm_interface_new_for_snapshot(snapshot);
+
+    /* Allow switching backends at runtime for debugging and benchmarking */
+    backend_name = g_getenv("XFCE_NM_BACKEND");
+    if (!backend_name || !*backend_name)
+        backend_name = NM_INTERFACE_DEFAULT_BACKEND;
+
+    return nm_interface_new_for_backend(backend_name);
+}
+
+NMInterface *
+nm_interface_new_for_backend(const gchar *backend_name)
 {
     NMInterface *nm_interface;
+    const NMInterfaceBackend *backend;
+
+    backend = nm_interface_lookup_backend(backend_name);
+    if (!backend) {
+        g_warning("Unknown NetworkManager backend '%s', using '%s'",
+                  backend_name, NM_INTERFACE_DEFAULT_BACKEND);
+        backend = nm_interface_lookup_backend(NM_INTERFACE_DEFAULT_BACKEND);
+    }
 
     nm_interface = g_new0(NMInterface, 1);
-    nm_interface->devices = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-    nm_interface->connections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    nm_interface->backend = backend;
+    nm_interface->devices = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                  (GDestroyNotify)nm_interface_free_device_info);
+    nm_interface->connections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                      (GDestroyNotify)nm_interface_free_connection_info);
+    nm_interface->active_connections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                             (GDestroyNotify)nm_interface_free_active_connection_info);
+
+    return nm_interface;
+}
+
+/* Create an interface backed by a snapshot written by nm_interface_save_snapshot() */
+NMInterface *
+nm_interface_new_for_snapshot(const gchar *filename)
+{
+    NMInterface *nm_interface;
+
+    nm_interface = nm_interface_new_for_backend("mock");
+    nm_interface->snapshot_path = g_strdup(filename);
 
     return nm_interface;
 }
@@ -75,63 +110,38 @@ nm_interface_new(void)
 void
 nm_interface_free(NMInterface *nm_interface)
 {
-    g_clear_object(&nm_interface->connection);
+    if (!nm_interface)
+        return;
+
+    nm_interface_shutdown(nm_interface);
+    nm_statistics_clear(nm_interface);
     g_hash_table_destroy(nm_interface->devices);
     g_hash_table_destroy(nm_interface->connections);
+    g_hash_table_destroy(nm_interface->active_connections);
+    g_list_free_full(nm_interface->listeners, g_free);
+    g_free(nm_interface->snapshot_path);
     g_free(nm_interface);
 }
 
+const gchar *
+nm_interface_get_backend_name(NMInterface *nm_interface)
+{
+    return nm_interface->backend->name;
+}
+
 /* Initialize NMInterface */
 gboolean
 nm_interface_init(NMInterface *nm_interface, GError **error)
 {
-    nm_interface->connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, error);
-    if (!nm_interface->connection) {
-        return FALSE;
-    }
-    
-    /* Create NetworkManager proxy */
-    nm_interface->nm_proxy = g_dbus_proxy_new_sync(
-        nm_interface->connection,
-        G_DBUS_PROXY_FLAGS_NONE,
-        NULL,
-        NM_DBUS_SERVICE,
-        NM_DBUS_PATH,
-        NM_DBUS_INTERFACE,
-        NULL,
-        error);
-    
-    if (!nm_interface->nm_proxy) {
+    if (!nm_interface->backend->init(nm_interface, error)) {
+        nm_interface->backend->shutdown(nm_interface);
         return FALSE;
     }
-    
-    /* Create Settings proxy */
-    nm_interface->settings_proxy = g_dbus_proxy_new_sync(
-        nm_interface->connection,
-        G_DBUS_PROXY_FLAGS_NONE,
-        NULL,
-        NM_DBUS_SERVICE,
-        "/org/freedesktop/NetworkManager/Settings",
-        NM_DBUS_INTERFACE_SETTINGS,
-        NULL,
-        error);
-    
-    if (!nm_interface->settings_proxy) {
-        g_clear_object(&nm_interface->nm_proxy);
-        return FALSE;
-    }
-    
-    /* Get initial state */
-    nm_interface_update_state(nm_interface);
-    
-    /* Load devices */
-    nm_interface_load_devices(nm_interface);
-    
-    /* Load connections */
-    nm_interface_load_connections(nm_interface);
-    
-    /* Setup signal handlers */
-    nm_interface_setup_signals(nm_interface);
+
+    nm_interface->initialized = TRUE;
+
+    /* Watches outlive a shutdown; turn their counters back on */
+    nm_statistics_resume(nm_interface, NULL);
 
     return TRUE;
 }
@@ -139,21 +149,28 @@ nm_interface_init(NMInterface *nm_interface, GError **error)
 void
 nm_interface_shutdown(NMInterface *nm_interface)
 {
-    /* Disconnect signal handlers */
-    if (nm_interface->state_changed_id > 0) {
-        g_dbus_connection_signal_unsubscribe(nm_interface->connection, nm_interface->state_changed_id);
-    }
-    if (nm_interface->device_added_id > 0) {
-        g_dbus_connection_signal_unsubscribe(nm_interface->connection, nm_interface->device_added_id);
-    }
-    if (nm_interface->device_removed_id > 0) {
-        g_dbus_connection_signal_unsubscribe(nm_interface->connection, nm_interface->device_removed_id);
-    }
-    
-    /* Clear proxies */
-    g_clear_object(&nm_interface->nm_proxy);
-    g_clear_object(&nm_interface->settings_proxy);
-    g_clear_object(&nm_interface->connection);
+    nm_interface_disable_link_monitor(nm_interface);
+    nm_statistics_stop(nm_interface);
+    nm_interface->backend->shutdown(nm_interface);
+    nm_interface->initialized = FALSE;
+
+    /* Drop everything the backend cached */
+    g_hash_table_remove_all(nm_interface->devices);
+    g_hash_table_remove_all(nm_interface->connections);
+    g_hash_table_remove_all(nm_interface->active_connections);
+    g_clear_pointer(&nm_interface->primary_connection, g_free);
+}
+
+NMState
+nm_interface_get_state(NMInterface *nm_interface)
+{
+    return nm_interface->nm_state;
+}
+
+NMConnectivityState
+nm_interface_get_connectivity(NMInterface *nm_interface)
+{
+    return nm_interface->connectivity;
 }
 
 /* Retrieve devices */
@@ -198,188 +215,256 @@ nm_interface_state_to_string(XfceNMConnectionState state)
     }
 }
 
-/* Update NetworkManager state */
-static void
-nm_interface_update_state(NMInterface *nm_interface)
+/* Map access point Flags, WpaFlags and RsnFlags to our security names */
+const gchar *
+nm_interface_security_from_flags(guint32 flags, guint32 wpa_flags, guint32 rsn_flags)
 {
-    GVariant *state_variant;
-    GVariant *wireless_enabled_variant;
-    GVariant *networking_enabled_variant;
-    
-    if (!nm_interface->nm_proxy)
-        return;
-    
-    /* Get State property */
-    state_variant = g_dbus_proxy_get_cached_property(nm_interface->nm_proxy, "State");
-    if (state_variant) {
-        nm_interface->nm_state = g_variant_get_uint32(state_variant);
-        g_variant_unref(state_variant);
+    if ((flags == 0x01) && (wpa_flags == 0) && (rsn_flags == 0)) {
+        return "None";
+    } else if ((rsn_flags & 0x00000200) || (wpa_flags & 0x00000200)) { /* 802.1X Enterprise */
+        return "802.1X";
+    } else if (rsn_flags & 0x00000400) { /* SAE (WPA3) */
+        return "WPA3";
+    } else if (rsn_flags & 0x00000100 || wpa_flags & 0x00000100) { /* WPA2 */
+        return "WPA2";
+    } else if (wpa_flags != 0) { /* WPA */
+        return "WPA";
+    } else if (flags & 0x01) { /* WEP */
+        return "WEP";
     }
-    
-    /* Get WirelessEnabled property */
-    wireless_enabled_variant = g_dbus_proxy_get_cached_property(nm_interface->nm_proxy, "WirelessEnabled");
-    if (wireless_enabled_variant) {
-        nm_interface->wireless_enabled = g_variant_get_boolean(wireless_enabled_variant);
-        g_variant_unref(wireless_enabled_variant);
+
+    return "Unknown";
+}
+
+void
+nm_interface_notify_state_changed(NMInterface *nm_interface, NMState state)
+{
+    nm_interface->nm_state = state;
+
+    if (nm_interface->state_changed_cb) {
+        nm_interface->state_changed_cb(nm_interface, nm_interface->nm_state, nm_interface->user_data);
     }
-    
-    /* Get NetworkingEnabled property */
-    networking_enabled_variant = g_dbus_proxy_get_cached_property(nm_interface->nm_proxy, "NetworkingEnabled");
-    if (networking_enabled_variant) {
-        nm_interface->networking_enabled = g_variant_get_boolean(networking_enabled_variant);
-        g_variant_unref(networking_enabled_variant);
+
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_STATE);
+}
+
+static NMDeviceInfo *
+nm_interface_find_device_by_interface(NMInterface *nm_interface, const gchar *interface)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, nm_interface->devices);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        NMDeviceInfo *device_info = value;
+
+        if (g_strcmp0(device_info->interface, interface) == 0)
+            return device_info;
     }
+
+    return NULL;
 }
 
-/* Load devices from NetworkManager */
-static void
-nm_interface_load_devices(NMInterface *nm_interface)
+/* Returns TRUE if the carrier of device_info changed */
+static gboolean
+nm_interface_apply_link(NMDeviceInfo *device_info, const NetlinkLink *link)
 {
-    GVariant *result;
-    GVariantIter *iter;
-    const gchar *device_path;
-    GError *error = NULL;
-    if (!nm_interface->nm_proxy)
-        return;
-    /* Call GetDevices method */
-    result = g_dbus_proxy_call_sync(
-        nm_interface->nm_proxy,
-        "GetDevices",
-        NULL,
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
-        
-    if (error) {
-        g_warning("Failed to get devices: %s", error->message);
-        g_error_free(error);
-        return;
+    gboolean changed;
+
+    if (!link || link->removed) {
+        changed = device_info->link_known;
+        device_info->link_known = FALSE;
+        device_info->link_carrier = FALSE;
+        return changed;
     }
-        
-    if (result) {
-        g_variant_get(result, "(ao)", &iter);
-        while (g_variant_iter_next(iter, "o", &device_path)) {
-            NMDeviceInfo *device_info = nm_interface_create_device_info(nm_interface, device_path);
-            if (device_info) {
-                g_hash_table_insert(nm_interface->devices, g_strdup(device_path), device_info);
-            }
-        }
-        g_variant_iter_free(iter);
-        g_variant_unref(result);
+
+    changed = !device_info->link_known || device_info->link_carrier != link->carrier;
+    device_info->link_known = TRUE;
+    device_info->link_carrier = link->carrier;
+    if (link->have_stats) {
+        device_info->link_rx_bytes = link->rx_bytes;
+        device_info->link_tx_bytes = link->tx_bytes;
     }
+
+    return changed;
 }
 
+/* Counters change all the time; only carrier changes are announced */
 static void
-nm_interface_load_connections(NMInterface *nm_interface)
+on_link_changed(NetlinkMonitor *monitor, const NetlinkLink *link, gpointer user_data)
+{
+    NMInterface *nm_interface = user_data;
+    NMDeviceInfo *device_info;
+
+    device_info = nm_interface_find_device_by_interface(nm_interface, link->name);
+    if (device_info && nm_interface_apply_link(device_info, link)) {
+        g_debug("Link %s: carrier %s", link->name, device_info->link_carrier ? "on" : "off");
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES);
+    }
+}
+
+/*
+ * Follow the kernel's link notifications, so a cable pull shows up before
+ * NetworkManager has processed it. Fills link_carrier and the link_*_bytes
+ * counters of every device.
+ */
+gboolean
+nm_interface_enable_link_monitor(NMInterface *nm_interface, GError **error)
+{
+    if (nm_interface->link_monitor)
+        return TRUE;
+
+    nm_interface->link_monitor = netlink_monitor_new(on_link_changed, nm_interface, error);
+
+    return nm_interface->link_monitor != NULL;
+}
+
+void
+nm_interface_disable_link_monitor(NMInterface *nm_interface)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    if (!nm_interface->link_monitor)
+        return;
+
+    g_clear_pointer(&nm_interface->link_monitor, netlink_monitor_free);
+
+    g_hash_table_iter_init(&iter, nm_interface->devices);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        nm_interface_apply_link(value, NULL);
+}
+
+/* Fetch fresh counters; they arrive from the main loop */
+void
+nm_interface_refresh_links(NMInterface *nm_interface)
 {
-    GVariant *result;
-    GVariantIter *iter;
-    const gchar *connection_path;
     GError *error = NULL;
-    if (!nm_interface->settings_proxy)
+
+    if (!nm_interface->link_monitor)
         return;
-    /* Call ListConnections method */
-    result = g_dbus_proxy_call_sync(
-        nm_interface->settings_proxy,
-        "ListConnections",
-        NULL,
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
-    if (error) {
-        g_warning("Failed to get connections: %s", error->message);
+
+    if (!netlink_monitor_request_dump(nm_interface->link_monitor, &error)) {
+        g_warning("Failed to refresh link state: %s", error->message);
         g_error_free(error);
-        return;
     }
-    if (result) {
-        g_variant_get(result, "(ao)", &iter);
-        while (g_variant_iter_next(iter, "o", &connection_path)) {
-            NMConnectionInfo *connection_info = nm_interface_create_connection_info(nm_interface, connection_path);
-            if (connection_info) {
-                g_hash_table_insert(nm_interface->connections, g_strdup(connection_path), connection_info);
-            }
+}
+
+/* Takes ownership of device_info */
+void
+nm_interface_notify_device_added(NMInterface *nm_interface, NMDeviceInfo *device_info)
+{
+    g_hash_table_replace(nm_interface->devices, g_strdup(device_info->path), device_info);
+
+    if (nm_interface->link_monitor)
+        nm_interface_apply_link(device_info, netlink_monitor_lookup_name(nm_interface->link_monitor,
+                                                                         device_info->interface));
+
+    /* A watch may have come before the device */
+    nm_statistics_resume(nm_interface, device_info->path);
+
+    /* Notify callback if set */
+    if (nm_interface->device_added_cb) {
+        nm_interface->device_added_cb(nm_interface, device_info, nm_interface->user_data);
+    }
+
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES);
+}
+
+void
+nm_interface_notify_device_removed(NMInterface *nm_interface, const gchar *device_path)
+{
+    NMDeviceInfo *device_info;
+
+    /* Get device info before removing */
+    device_info = g_hash_table_lookup(nm_interface->devices, device_path);
+    if (device_info) {
+        /* Notify callback if set */
+        if (nm_interface->device_removed_cb) {
+            nm_interface->device_removed_cb(nm_interface, device_info, nm_interface->user_data);
         }
-        g_variant_iter_free(iter);
-        g_variant_unref(result);
+
+        /* Remove from hash table, this frees the device info */
+        g_hash_table_remove(nm_interface->devices, device_path);
+
+        nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_DEVICES |
+                                                  NM_INTERFACE_CHANGED_ACCESS_POINTS);
     }
 }
 
-static NMConnectionInfo *
-nm_interface_create_connection_info(NMInterface *nm_interface, const gchar *connection_path)
+/* Drop the listeners removed while notifying */
+static void
+nm_interface_sweep_listeners(NMInterface *nm_interface)
 {
-    NMConnectionInfo *connection_info;
-    GDBusProxy *connection_proxy;
-    GVariant *variant;
-    GVariant *settings;
-    GError *error = NULL;
-    /* Create connection proxy */
-    connection_proxy = g_dbus_proxy_new_sync(
-        nm_interface->connection,
-        G_DBUS_PROXY_FLAGS_NONE,
-        NULL,
-        NM_DBUS_SERVICE,
-        connection_path,
-        NM_DBUS_INTERFACE_CONNECTION,
-        NULL,
-        &error);
-        
-    if (error) {
-        g_warning("Failed to create connection proxy for %s: %s", connection_path, error->message);
-        g_error_free(error);
-        return NULL;
+    GList *l = nm_interface->listeners;
+
+    while (l != NULL) {
+        GList *next = l->next;
+        NMInterfaceListener *listener = l->data;
+
+        if (listener->removed) {
+            nm_interface->listeners = g_list_delete_link(nm_interface->listeners, l);
+            g_free(listener);
+        }
+        l = next;
     }
-    connection_info = g_new0(NMConnectionInfo, 1);
-    connection_info->path = g_strdup(connection_path);
-    
-    /* Get connection settings */
-    settings = g_dbus_proxy_call_sync(
-        connection_proxy,
-        "GetSettings",
-        NULL,
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
-    
-    if (error) {
-        g_warning("Failed to get connection settings for %s: %s", connection_path, error->message);
-        g_error_free(error);
-        g_object_unref(connection_proxy);
-        g_free(connection_info);
-        return NULL;
+    nm_interface->listeners_removed = FALSE;
+}
+
+/* Listeners may add or remove any listener, themselves included */
+void
+nm_interface_notify_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes)
+{
+    GList *l;
+
+    nm_interface->notify_depth++;
+    for (l = nm_interface->listeners; l != NULL; l = l->next) {
+        NMInterfaceListener *listener = l->data;
+
+        if (!listener->removed && (listener->mask & changes))
+            listener->callback(nm_interface, listener->mask & changes, listener->user_data);
     }
-    
-    if (settings) {
-        GVariantIter *iter;
-        const gchar *group_name;
-        GVariant *group_settings;
-        
-        g_variant_get(settings, "(a{sa{sv}})", &iter);
-        while (g_variant_iter_next(iter, "{&s@a{sv}}", &group_name, &group_settings)) {
-            if (g_strcmp0(group_name, "connection") == 0) {
-                /* Extract connection properties */
-                g_variant_lookup(group_settings, "uuid", "s", &connection_info->uuid);
-                g_variant_lookup(group_settings, "id", "s", &connection_info->id);
-                g_variant_lookup(group_settings, "type", "s", &connection_info->type);
-            }
-            g_variant_unref(group_settings);
-        }
-        g_variant_iter_free(iter);
-        g_variant_unref(settings);
+
+    if (--nm_interface->notify_depth == 0 && nm_interface->listeners_removed)
+        nm_interface_sweep_listeners(nm_interface);
+}
+
+void
+nm_interface_set_primary_connection(NMInterface *nm_interface, const gchar *active_path)
+{
+    /* "/" is how NetworkManager spells "no primary connection" */
+    if (g_strcmp0(active_path, "/") == 0)
+        active_path = NULL;
+
+    g_free(nm_interface->primary_connection);
+    nm_interface->primary_connection = g_strdup(active_path);
+}
+
+/* Turn raw D-Bus errors from the backends into messages for the user */
+static void
+nm_interface_propagate_error(GError *local_error, GError **error)
+{
+    if (!local_error)
+        return;
+
+    if (g_error_matches(local_error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT)) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT,
+                    "Connection attempt timed out. Please try again.");
+    } else if (strstr(local_error->message, "Secrets were required")) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_AUTH_FAILED,
+                    "Authentication failed. Please check your password.");
+    } else if (strstr(local_error->message, "No suitable device")) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                    "No suitable network device found");
+    } else if (strstr(local_error->message, "access-denied")) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
+                    "Access denied. Please check your network permissions.");
+    } else {
+        g_propagate_error(error, local_error);
+        return;
     }
-    
-    /* Duplicate the strings to ensure they're owned by the structure */
-    if (connection_info->uuid)
-        connection_info->uuid = g_strdup(connection_info->uuid);
-    if (connection_info->id)
-        connection_info->id = g_strdup(connection_info->id);
-    if (connection_info->type)
-        connection_info->type = g_strdup(connection_info->type);
-    
-    g_object_unref(connection_proxy);
-    return connection_info;
+
+    g_error_free(local_error);
 }
 
 void
@@ -396,108 +481,6 @@ nm_interface_free_connection_info(NMConnectionInfo *info)
     g_free(info);
 }
 
-/* Signal handler for StateChanged signal */
-static void
-on_state_changed(GDBusProxy *proxy,
-                 GVariant   *changed_properties,
-                 GStrv       invalidated_properties,
-                 gpointer    user_data)
-{
-    NMInterface *nm_interface = (NMInterface *)user_data;
-    GVariant *state_variant;
-    
-    state_variant = g_variant_lookup_value(changed_properties, "State", G_VARIANT_TYPE_UINT32);
-    if (state_variant) {
-        nm_interface->nm_state = g_variant_get_uint32(state_variant);
-        g_variant_unref(state_variant);
-        
-        if (nm_interface->state_changed_cb) {
-            nm_interface->state_changed_cb(nm_interface, nm_interface->nm_state, nm_interface->user_data);
-        }
-    }
-}
-
-/* Create device info from D-Bus path */
-static NMDeviceInfo *
-nm_interface_create_device_info(NMInterface *nm_interface, const gchar *device_path)
-{
-    NMDeviceInfo *device_info;
-    GDBusProxy *device_proxy;
-    GVariant *variant;
-    GError *error = NULL;
-    guint device_type;
-    
-    /* Create device proxy */
-    device_proxy = g_dbus_proxy_new_sync(
-        nm_interface->connection,
-        G_DBUS_PROXY_FLAGS_NONE,
-        NULL,
-        NM_DBUS_SERVICE,
-        device_path,
-        NM_DBUS_INTERFACE_DEVICE,
-        NULL,
-        &error);
-    
-    if (error) {
-        g_warning("Failed to create device proxy for %s: %s", device_path, error->message);
-        g_error_free(error);
-        return NULL;
-    }
-    
-    device_info = g_new0(NMDeviceInfo, 1);
-    
-    /* Get device type */
-    variant = g_dbus_proxy_get_cached_property(device_proxy, "DeviceType");
-    if (variant) {
-        device_type = g_variant_get_uint32(variant);
-        g_variant_unref(variant);
-        
-        /* Map NetworkManager device types to our enum */
-        switch (device_type) {
-            case NM_DEVICE_TYPE_ETHERNET:
-                device_info->type = NM_DEVICE_TYPE_ETHERNET;
-                break;
-            case NM_DEVICE_TYPE_WIFI:
-                device_info->type = NM_DEVICE_TYPE_WIFI;
-                break;
-            case NM_DEVICE_TYPE_MODEM:
-                device_info->type = NM_DEVICE_TYPE_MODEM;
-                break;
-            case NM_DEVICE_TYPE_BT:
-                device_info->type = NM_DEVICE_TYPE_BT;
-                break;
-            default:
-                device_info->type = NM_DEVICE_TYPE_UNKNOWN;
-                break;
-        }
-    }
-    
-    /* Get interface name */
-    variant = g_dbus_proxy_get_cached_property(device_proxy, "Interface");
-    if (variant) {
-        device_info->interface = g_variant_dup_string(variant, NULL);
-        g_variant_unref(variant);
-    }
-    
-    /* Get state */
-    variant = g_dbus_proxy_get_cached_property(device_proxy, "State");
-    if (variant) {
-        device_info->state = g_variant_get_uint32(variant);
-        g_variant_unref(variant);
-    }
-    
-    /* Get managed status */
-    variant = g_dbus_proxy_get_cached_property(device_proxy, "Managed");
-    if (variant) {
-        device_info->managed = g_variant_get_boolean(variant);
-        g_variant_unref(variant);
-    }
-    
-    g_object_unref(device_proxy);
-    
-    return device_info;
-}
-
 /* Get device info */
 NMDeviceInfo *
 nm_interface_get_device_info(NMInterface *nm_interface, const gchar *device_path)
@@ -512,6 +495,7 @@ nm_interface_free_device_info(NMDeviceInfo *info)
     if (!info)
         return;
     
+    g_free(info->path);
     g_free(info->name);
     g_free(info->interface);
     
@@ -541,6 +525,51 @@ nm_interface_get_connections(NMInterface *nm_interface)
     return g_hash_table_get_values(nm_interface->connections);
 }
 
+/* Get connection info */
+NMConnectionInfo *
+nm_interface_get_connection_info(NMInterface *nm_interface, const gchar *connection_path)
+{
+    return g_hash_table_lookup(nm_interface->connections, connection_path);
+}
+
+/* Get active connections */
+GList *
+nm_interface_get_active_connections(NMInterface *nm_interface)
+{
+    return g_hash_table_get_values(nm_interface->active_connections);
+}
+
+NMActiveConnectionInfo *
+nm_interface_get_active_connection_info(NMInterface *nm_interface, const gchar *active_path)
+{
+    if (!active_path)
+        return NULL;
+
+    return g_hash_table_lookup(nm_interface->active_connections, active_path);
+}
+
+/* The active connection that owns the default route, if any */
+NMActiveConnectionInfo *
+nm_interface_get_primary_connection(NMInterface *nm_interface)
+{
+    return nm_interface_get_active_connection_info(nm_interface, nm_interface->primary_connection);
+}
+
+void
+nm_interface_free_active_connection_info(NMActiveConnectionInfo *info)
+{
+    if (!info)
+        return;
+    g_free(info->path);
+    g_free(info->connection);
+    g_free(info->uuid);
+    g_free(info->id);
+    g_free(info->type);
+    g_free(info->specific_object);
+    g_strfreev(info->devices);
+    g_free(info);
+}
+
 /* Get connection path by UUID */
 const gchar *
 nm_interface_get_connection_path(NMInterface *nm_interface, const gchar *uuid)
@@ -595,10 +624,9 @@ nm_interface_activate_connection(NMInterface *nm_interface,
                                 const gchar *device_path,
                                 GError **error)
 {
-    GVariant *result;
     GError *local_error = NULL;
     
-    if (!nm_interface || !nm_interface->nm_proxy) {
+    if (!nm_interface || !nm_interface->initialized) {
         g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
                     "NetworkManager interface not initialized");
         return FALSE;
@@ -610,44 +638,41 @@ nm_interface_activate_connection(NMInterface *nm_interface,
         return FALSE;
     }
     
-    result = g_dbus_proxy_call_sync(
-        nm_interface->nm_proxy,
-        "ActivateConnection",
-        g_variant_new("(ooo)", 
-                      connection_uuid,
-                      device_path,
-                      "/"),
-        G_DBUS_CALL_FLAGS_NONE,
-        30000,  /* 30 second timeout */
-        NULL,
-        &local_error);
-    
-    if (result) {
-        g_variant_unref(result);
+    if (nm_interface->backend->activate_connection(nm_interface, connection_uuid,
+                                                   device_path, &local_error))
         return TRUE;
-    }
     
     /* Provide more helpful error messages */
-    if (local_error) {
-        if (g_error_matches(local_error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT)) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT,
-                        "Connection attempt timed out. Please try again.");
-        } else if (strstr(local_error->message, "Secrets were required")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_AUTH_FAILED,
-                        "Authentication failed. Please check your password.");
-        } else if (strstr(local_error->message, "No suitable device")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
-                        "No suitable network device found");
-        } else {
-            g_propagate_error(error, local_error);
-            local_error = NULL;
-        }
-        g_clear_error(&local_error);
-    }
+    nm_interface_propagate_error(local_error, error);
     
     return FALSE;
 }
 
+/* Hand a finished settings dictionary to AddAndActivateConnection */
+static gboolean
+nm_interface_add_and_activate_dict(NMInterface *nm_interface,
+                                   GVariant *connection_dict,
+                                   const gchar *device_path,
+                                   const gchar *specific_object,
+                                   GError **error)
+{
+    GError *local_error = NULL;
+    gboolean success;
+    
+    g_variant_ref_sink(connection_dict);
+    success = nm_interface->backend->add_and_activate(nm_interface, connection_dict,
+                                                      device_path, specific_object,
+                                                      &local_error);
+    g_variant_unref(connection_dict);
+    
+    if (!success) {
+        /* Provide more helpful error messages */
+        nm_interface_propagate_error(local_error, error);
+    }
+    
+    return success;
+}
+
 gboolean
 nm_interface_add_and_activate_wired_connection(NMInterface *nm_interface,
                                                const gchar *device_path,
@@ -655,10 +680,8 @@ nm_interface_add_and_activate_wired_connection(NMInterface *nm_interface,
                                                GError **error)
 {
     GVariant *connection_dict;
-    GVariant *result;
-    GError *local_error = NULL;
 
-    if (!nm_interface || !nm_interface->nm_proxy) {
+    if (!nm_interface || !nm_interface->initialized) {
         g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
                     "NetworkManager interface not initialized");
         return FALSE;
@@ -673,44 +696,9 @@ nm_interface_add_and_activate_wired_connection(NMInterface *nm_interface,
     /* Build the connection settings */
     connection_dict = ethernet_create_connection_gvariant(id);
 
-    /* Call AddAndActivateConnection */
-    result = g_dbus_proxy_call_sync(
-        nm_interface->nm_proxy,
-        "AddAndActivateConnection",
-        g_variant_new("(a{sa{sv}}oo)",
-                     connection_dict,
-                     device_path,
-                     "/"), /* No specific object for wired */
-        G_DBUS_CALL_FLAGS_NONE,
-        30000,  /* 30 second timeout */
-        NULL,
-        &local_error);
-
-    if (result) {
-        /* The result contains the path of the new connection and active connection */
-        const gchar *connection_path, *active_path;
-        g_variant_get(result, "(&o&o)", &connection_path, &active_path);
-        g_debug("Created connection: %s, Active: %s", connection_path, active_path);
-        g_variant_unref(result);
-        return TRUE;
-    }
-
-    /* Provide more helpful error messages */
-    if (local_error) {
-        if (g_error_matches(local_error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT)) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT,
-                        "Connection attempt timed out. Please try again.");
-        } else if (strstr(local_error->message, "access-denied")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
-                        "Access denied. Please check your network permissions.");
-        } else {
-            g_propagate_error(error, local_error);
-            local_error = NULL;
-        }
-        g_clear_error(&local_error);
-    }
-
-    return FALSE;
+    /* No specific object for wired */
+    return nm_interface_add_and_activate_dict(nm_interface, connection_dict,
+                                              device_path, "/", error);
 }
 
 /* Add and activate a new connection */
@@ -723,14 +711,9 @@ nm_interface_add_and_activate_connection(NMInterface *nm_interface,
                                        const gchar *security,
                                        GError **error)
 {
-    GVariantBuilder connection_builder;
-    GVariantBuilder wireless_builder;
-    GVariantBuilder wireless_security_builder;
     GVariant *connection_dict;
-    GVariant *result;
-    GError *local_error = NULL;
     
-    if (!nm_interface || !nm_interface->nm_proxy) {
+    if (!nm_interface || !nm_interface->initialized) {
         g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
                     "NetworkManager interface not initialized");
         return FALSE;
@@ -743,105 +726,56 @@ nm_interface_add_and_activate_connection(NMInterface *nm_interface,
     }
     
     /* Build the connection settings */
-    g_variant_builder_init(&connection_builder, G_VARIANT_TYPE("a{sa{sv}}"));
-    
-    /* Connection section */
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "connection",
-        g_variant_builder_new(G_VARIANT_TYPE("a{sv}")),
-        "type", g_variant_new_string("802-11-wireless"),
-        "id", g_variant_new_string(ssid),
-        "autoconnect", g_variant_new_boolean(TRUE),
-        NULL);
-    
-    /* 802-11-wireless section */
-    g_variant_builder_init(&wireless_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&wireless_builder, "{sv}", "ssid",
-                         g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
-                                                  ssid, strlen(ssid), 1));
-    g_variant_builder_add(&wireless_builder, "{sv}", "mode", g_variant_new_string("infrastructure"));
+    connection_dict = wifi_create_connection_gvariant(ssid, security, password);
     
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "802-11-wireless", &wireless_builder);
-    
-/* 802-11-wireless-security section if password is provided */
-    if (password && *password) {
-        g_variant_builder_init(&wireless_security_builder, G_VARIANT_TYPE("a{sv}"));
-
-        if (g_strcmp0(security, "WPA") == 0 || g_strcmp0(security, "WPA2") == 0) {
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("wpa-psk"));
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "auth-alg", g_variant_new_string("open"));
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "psk", g_variant_new_string(password));
-
-        } else if (g_strcmp0(security, "WPA3") == 0) {
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("sae")); /* WPA3 supports SAE */
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "psk", g_variant_new_string(password));
-
-        } else if (g_strcmp0(security, "WEP") == 0) {
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("none"));
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "wep-key-type", g_variant_new_uint32(0));
-            g_variant_builder_add(&wireless_security_builder, "{sv}", "wep-key0", g_variant_new_string(password));
-        }
+    return nm_interface_add_and_activate_dict(nm_interface, connection_dict,
+                                              device_path, ap_path, error);
+}
 
-        g_variant_builder_add(&connection_builder, "{sa{sv}}", "802-11-wireless-security", &wireless_security_builder);
+/* Certificates are passed to NetworkManager as NUL-terminated file:// URIs */
+static GVariant *
+nm_interface_cert_variant(const gchar *path)
+{
+    gchar *uri = g_strconcat("file://", path, NULL);
+    GVariant *variant;
+
+    variant = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, uri, strlen(uri) + 1, 1);
+    g_free(uri);
+
+    return variant;
+}
+
+/* Build the 802-1x setting from the enterprise dialog's answers */
+static GVariant *
+nm_interface_dot1x_setting(EnterpriseAuthInfo *auth_info)
+{
+    GVariantBuilder dot1x_builder;
+    const gchar *eap[] = { auth_info->eap_method, NULL };
+
+    g_variant_builder_init(&dot1x_builder, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&dot1x_builder, "{sv}", "eap", g_variant_new_strv(eap, -1));
+    g_variant_builder_add(&dot1x_builder, "{sv}", "identity", g_variant_new_string(auth_info->identity));
+    if (auth_info->anonymous_identity) {
+        g_variant_builder_add(&dot1x_builder, "{sv}", "anonymous-identity", g_variant_new_string(auth_info->anonymous_identity));
     }
-    
-    /* IPv4 section - use automatic (DHCP) */
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv4",
-        g_variant_builder_new(G_VARIANT_TYPE("a{sv}")),
-        "method", g_variant_new_string("auto"),
-        NULL);
-    
-    /* IPv6 section - use automatic */
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv6",
-        g_variant_builder_new(G_VARIANT_TYPE("a{sv}")),
-        "method", g_variant_new_string("auto"),
-        NULL);
-    
-    connection_dict = g_variant_builder_end(&connection_builder);
-    
-    /* Call AddAndActivateConnection */
-    result = g_dbus_proxy_call_sync(
-        nm_interface->nm_proxy,
-        "AddAndActivateConnection",
-        g_variant_new("(a{sa{sv}}oo)",
-                     connection_dict,
-                     device_path,
-                     ap_path),
-        G_DBUS_CALL_FLAGS_NONE,
-        30000,  /* 30 second timeout */
-        NULL,
-        &local_error);
-    
-    if (result) {
-        /* The result contains the path of the new connection and active connection */
-        const gchar *connection_path, *active_path;
-        g_variant_get(result, "(&o&o)", &connection_path, &active_path);
-        g_debug("Created connection: %s, Active: %s", connection_path, active_path);
-        g_variant_unref(result);
-        return TRUE;
+    g_variant_builder_add(&dot1x_builder, "{sv}", "password", g_variant_new_string(auth_info->password));
+    if (auth_info->ca_cert) {
+        g_variant_builder_add(&dot1x_builder, "{sv}", "ca-cert", nm_interface_cert_variant(auth_info->ca_cert));
     }
-    
-    /* Provide more helpful error messages */
-    if (local_error) {
-        if (g_error_matches(local_error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT)) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT,
-                        "Connection attempt timed out. Please try again.");
-        } else if (strstr(local_error->message, "Secrets were required")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_AUTH_FAILED,
-                        "Authentication failed. Please check your password.");
-        } else if (strstr(local_error->message, "No suitable device")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
-                        "No suitable network device found");
-        } else if (strstr(local_error->message, "access-denied")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
-                        "Access denied. Please check your network permissions.");
-        } else {
-            g_propagate_error(error, local_error);
-            local_error = NULL;
-        }
-        g_clear_error(&local_error);
+    if (auth_info->client_cert) {
+        g_variant_builder_add(&dot1x_builder, "{sv}", "client-cert", nm_interface_cert_variant(auth_info->client_cert));
     }
-    
-    return FALSE;
+    if (auth_info->private_key) {
+        g_variant_builder_add(&dot1x_builder, "{sv}", "private-key", nm_interface_cert_variant(auth_info->private_key));
+    }
+    if (auth_info->private_key_password) {
+        g_variant_builder_add(&dot1x_builder, "{sv}", "private-key-password", g_variant_new_string(auth_info->private_key_password));
+    }
+    if (auth_info->phase2_auth) {
+        g_variant_builder_add(&dot1x_builder, "{sv}", "phase2-auth", g_variant_new_string(auth_info->phase2_auth));
+    }
+
+    return g_variant_builder_end(&dot1x_builder);
 }
 
 /* Add and activate a new enterprise connection */
@@ -853,14 +787,9 @@ nm_interface_add_and_activate_enterprise_connection(NMInterface *nm_interface,
                                                    EnterpriseAuthInfo *auth_info,
                                                    GError **error)
 {
-    GVariantBuilder connection_builder;
-    GVariantBuilder wireless_builder;
-    GVariantBuilder wireless_security_builder;
     GVariant *connection_dict;
-    GVariant *result;
-    GError *local_error = NULL;
     
-    if (!nm_interface || !nm_interface->nm_proxy) {
+    if (!nm_interface || !nm_interface->initialized) {
         g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
                     "NetworkManager interface not initialized");
         return FALSE;
@@ -873,108 +802,11 @@ nm_interface_add_and_activate_enterprise_connection(NMInterface *nm_interface,
     }
     
     /* Build the connection settings */
-    g_variant_builder_init(&connection_builder, G_VARIANT_TYPE("a{sa{sv}}"));
+    connection_dict = wifi_create_enterprise_connection_gvariant(ssid,
+                                                                 nm_interface_dot1x_setting(auth_info));
     
-    /* Connection section */
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "connection",
-        g_variant_builder_new(G_VARIANT_TYPE("a{sv}")),
-        "type", g_variant_new_string("802-11-wireless"),
-        "id", g_variant_new_string(ssid),
-        "autoconnect", g_variant_new_boolean(TRUE),
-        NULL);
-    
-    /* 802-11-wireless section */
-    g_variant_builder_init(&wireless_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&wireless_builder, "{sv}", "ssid",
-                         g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
-                                                  ssid, strlen(ssid), 1));
-    g_variant_builder_add(&wireless_builder, "{sv}", "mode", g_variant_new_string("infrastructure"));    
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "802-11-wireless", &wireless_builder);
-
-    /* 802-1x security settings */
-    g_variant_builder_init(&wireless_security_builder, G_VARIANT_TYPE("a{sv}"));
-    g_variant_builder_add(&wireless_security_builder, "{sv}", "key-mgmt", g_variant_new_string("wpa-eap"));
-    g_variant_builder_add(&wireless_security_builder, "{sv}", "eap", g_variant_new_string(auth_info->eap_method));
-    g_variant_builder_add(&wireless_security_builder, "{sv}", "identity", g_variant_new_string(auth_info->identity));
-    if (auth_info->anonymous_identity) {
-        g_variant_builder_add(&wireless_security_builder, "{sv}", "anonymous-identity", g_variant_new_string(auth_info->anonymous_identity));
-    }
-    g_variant_builder_add(&wireless_security_builder, "{sv}", "password", g_variant_new_string(auth_info->password));
-    if (auth_info->ca_cert) {
-        g_variant_builder_add(&wireless_security_builder, "{sv}", "ca-cert", g_variant_new_string(auth_info->ca_cert));
-    }
-    if (auth_info->client_cert) {
-        g_variant_builder_add(&wireless_security_builder, "{sv}", "client-cert", g_variant_new_string(auth_info->client_cert));
-    }
-    if (auth_info->private_key) {
-        g_variant_builder_add(&wireless_security_builder, "{sv}", "private-key", g_variant_new_string(auth_info->private_key));
-    }
-    if (auth_info->private_key_password) {
-        g_variant_builder_add(&wireless_security_builder, "{sv}", "private-key-password", g_variant_new_string(auth_info->private_key_password));
-    }
-    if (auth_info->phase2_auth) {
-        g_variant_builder_add(&wireless_security_builder, "{sv}", "phase2-auth", g_variant_new_string(auth_info->phase2_auth));
-    }
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "802-1x", &wireless_security_builder);
-    
-    /* IPv4 section - use automatic (DHCP) */
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv4",
-        g_variant_builder_new(G_VARIANT_TYPE("a{sv}")),
-        "method", g_variant_new_string("auto"),
-        NULL);
-    
-    /* IPv6 section - use automatic */
-    g_variant_builder_add(&connection_builder, "{sa{sv}}", "ipv6",
-        g_variant_builder_new(G_VARIANT_TYPE("a{sv}")),
-        "method", g_variant_new_string("auto"),
-        NULL);
-
-    connection_dict = g_variant_builder_end(&connection_builder);
-    
-    /* Call AddAndActivateConnection */
-    result = g_dbus_proxy_call_sync(
-        nm_interface->nm_proxy,
-        "AddAndActivateConnection",
-        g_variant_new("(a{sa{sv}}oo)",
-                     connection_dict,
-                     device_path,
-                     ap_path),
-        G_DBUS_CALL_FLAGS_NONE,
-        30000,  /* 30 second timeout */
-        NULL,
-        &local_error);
-    
-    if (result) {
-        /* The result contains the path of the new connection and active connection */
-        const gchar *connection_path, *active_path;
-        g_variant_get(result, "(&o&o)", &connection_path, &active_path);
-        g_debug("Created connection: %s, Active: %s", connection_path, active_path);
-        g_variant_unref(result);
-        return TRUE;
-    }
-    
-    /* Provide more helpful error messages */
-    if (local_error) {
-        if (g_error_matches(local_error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT)) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_TIMED_OUT,
-                        "Connection attempt timed out. Please try again.");
-        } else if (strstr(local_error->message, "Secrets were required")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_AUTH_FAILED,
-                        "Authentication failed. Please check your password.");
-        } else if (strstr(local_error->message, "No suitable device")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
-                        "No suitable network device found");
-        } else if (strstr(local_error->message, "access-denied")) {
-            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
-                        "Access denied. Please check your network permissions.");
-        } else {
-            g_propagate_error(error, local_error);
-            local_error = NULL;
-        }
-        g_clear_error(&local_error);
-    }
-    
-    return FALSE;
+    return nm_interface_add_and_activate_dict(nm_interface, connection_dict,
+                                              device_path, ap_path, error);
 }
 
 
@@ -1006,161 +838,56 @@ nm_interface_set_device_removed_cb(NMInterface *nm_interface,
     nm_interface->user_data = user_data;
 }
 
+guint
+nm_interface_add_changed_listener(NMInterface *nm_interface,
+                                  NMInterfaceChangeFlags mask,
+                                  NMChangedCallback callback,
+                                  gpointer user_data)
+{
+    NMInterfaceListener *listener;
+
+    g_return_val_if_fail(callback != NULL, 0);
 
-/* Function to get access point properties */
-static NMAccessPointInfo *
-nm_interface_get_ap_info(NMInterface *nm_interface, const gchar *ap_path)
+    listener = g_new0(NMInterfaceListener, 1);
+    listener->id = ++nm_interface->next_listener_id;
+    listener->mask = mask;
+    listener->callback = callback;
+    listener->user_data = user_data;
+    nm_interface->listeners = g_list_append(nm_interface->listeners, listener);
+
+    return listener->id;
+}
+
+void
+nm_interface_remove_changed_listener(NMInterface *nm_interface, guint listener_id)
 {
-    NMAccessPointInfo *ap_info = g_new0(NMAccessPointInfo, 1);
-    GDBusProxy *ap_proxy;
-    GVariant *variant;
-    GError *error = NULL;
-    
-    /* Store the AP path */
-    ap_info->path = g_strdup(ap_path);
-    
-    /* Create access point proxy */
-    ap_proxy = g_dbus_proxy_new_sync(
-        nm_interface->connection,
-        G_DBUS_PROXY_FLAGS_NONE,
-        NULL,
-        NM_DBUS_SERVICE,
-        ap_path,
-        NM_DBUS_INTERFACE_ACCESS_POINT,
-        NULL,
-        &error);
-    
-    if (error) {
-        g_warning("Failed to create access point proxy for %s: %s", ap_path, error->message);
-        g_error_free(error);
-        g_free(ap_info);
-        return NULL;
-    }
-    /* Get SSID */
-    variant = g_dbus_proxy_get_cached_property(ap_proxy, "Ssid");
-    if (variant) {
-        gsize length;
-        const guchar *ssid_data = g_variant_get_fixed_array(variant, &length, sizeof(guchar));
-        if (length > 0) {
-            ap_info->ssid = g_strndup((const gchar *)ssid_data, length);
+    GList *l;
+
+    for (l = nm_interface->listeners; l != NULL; l = l->next) {
+        NMInterfaceListener *listener = l->data;
+
+        if (listener->id != listener_id || listener->removed)
+            continue;
+
+        if (nm_interface->notify_depth > 0) {
+            listener->removed = TRUE;
+            nm_interface->listeners_removed = TRUE;
         } else {
-            ap_info->ssid = g_strdup("(hidden)");
+            nm_interface->listeners = g_list_delete_link(nm_interface->listeners, l);
+            g_free(listener);
         }
-        g_variant_unref(variant);
-    }
-    
-    /* Get signal strength */
-    variant = g_dbus_proxy_get_cached_property(ap_proxy, "Strength");
-    if (variant) {
-        ap_info->strength = g_variant_get_byte(variant);
-        g_variant_unref(variant);
-    }
-    
-    /* Get security type - check Flags, WpaFlags, and RsnFlags */
-    guint32 flags = 0;
-    guint32 wpa_flags = 0;
-    guint32 rsn_flags = 0;
-    
-    variant = g_dbus_proxy_get_cached_property(ap_proxy, "Flags");
-    if (variant) {
-        flags = g_variant_get_uint32(variant);
-        g_variant_unref(variant);
-    }
-    
-    variant = g_dbus_proxy_get_cached_property(ap_proxy, "WpaFlags");
-    if (variant) {
-        wpa_flags = g_variant_get_uint32(variant);
-        g_variant_unref(variant);
-    }
-    
-    variant = g_dbus_proxy_get_cached_property(ap_proxy, "RsnFlags");
-    if (variant) {
-        rsn_flags = g_variant_get_uint32(variant);
-        g_variant_unref(variant);
-    }
-    
-    /* Determine security type */
-    if ((flags == 0x01) && (wpa_flags == 0) && (rsn_flags == 0)) {
-        ap_info->security = g_strdup("None");
-    } else if ((rsn_flags & 0x00000200) || (wpa_flags & 0x00000200)) { /* 802.1X Enterprise */
-        ap_info->security = g_strdup("802.1X");
-    } else if (rsn_flags & 0x00000400) { /* SAE (WPA3) */
-        ap_info->security = g_strdup("WPA3");
-    } else if (rsn_flags & 0x00000100 || wpa_flags & 0x00000100) { /* WPA2 */
-        ap_info->security = g_strdup("WPA2");
-    } else if (wpa_flags != 0) { /* WPA */
-        ap_info->security = g_strdup("WPA");
-    } else if (flags & 0x01) { /* WEP */
-        ap_info->security = g_strdup("WEP");
-    } else {
-        ap_info->security = g_strdup("Unknown");
+        return;
     }
-    g_object_unref(ap_proxy);
-    return ap_info;
 }
 
 /* Get access points for a Wi-Fi device */
 GList *
 nm_interface_get_access_points(NMInterface *nm_interface, const gchar *device_path)
 {
-    GList *access_points = NULL;
-    GDBusProxy *wifi_proxy;
-    GVariant *result;
-    GVariantIter *iter;
-    const gchar *ap_path;
-    GError *error = NULL;
-
-    /* Create Wi-Fi device proxy */
-    wifi_proxy = g_dbus_proxy_new_sync(
-        nm_interface->connection,
-        G_DBUS_PROXY_FLAGS_NONE,
-        NULL,
-        NM_DBUS_SERVICE,
-        device_path,
-        NM_DBUS_INTERFACE_DEVICE_WIRELESS,
-        NULL,
-        &error);
-
-    if (error) {
-        g_warning("Failed to create Wi-Fi device proxy: %s", error->message);
-        g_error_free(error);
+    if (!nm_interface || !nm_interface->initialized || !device_path)
         return NULL;
-    }
-
-    /* Get all access points */
-    result = g_dbus_proxy_call_sync(
-        wifi_proxy,
-        "GetAllAccessPoints",
-        NULL,
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        &error);
-
-    if (error) {
-        g_warning("Failed to get access points: %s", error->message);
-        g_error_free(error);
-        g_object_unref(wifi_proxy);
-        return NULL;
-    }
 
-    if (result) {
-        g_variant_get(result, "(ao)", &iter);
-
-        while (g_variant_iter_next(iter, "o", &ap_path)) {
-            NMAccessPointInfo *ap_info = nm_interface_get_ap_info(nm_interface, ap_path);
-            if (ap_info) {
-                access_points = g_list_append(access_points, ap_info);
-            }
-        }
-
-        g_variant_iter_free(iter);
-        g_variant_unref(result);
-    }
-
-    g_object_unref(wifi_proxy);
-
-    return access_points;
+    return nm_interface->backend->get_access_points(nm_interface, device_path);
 }
 
 /* Free access point info */
@@ -1173,50 +900,71 @@ nm_interface_free_ap_info(NMAccessPointInfo *ap_info)
     g_free(ap_info->path);
     g_free(ap_info->ssid);
     g_free(ap_info->security);
+    g_free(ap_info->bssid);
     g_free(ap_info);
 }
 
+NMAccessPointInfo *
+nm_interface_copy_ap_info(const NMAccessPointInfo *ap_info)
+{
+    NMAccessPointInfo *copy;
+
+    if (!ap_info)
+        return NULL;
+
+    copy = g_new0(NMAccessPointInfo, 1);
+    copy->path = g_strdup(ap_info->path);
+    copy->ssid = g_strdup(ap_info->ssid);
+    copy->strength = ap_info->strength;
+    copy->security = g_strdup(ap_info->security);
+    copy->bssid = g_strdup(ap_info->bssid);
+    copy->frequency = ap_info->frequency;
+
+    return copy;
+}
+
+/* Band label for an AP frequency in MHz */
+const gchar *
+nm_interface_ap_band(guint32 frequency)
+{
+    if (frequency >= 5925)
+        return "6 GHz";
+    if (frequency >= 4910)
+        return "5 GHz";
+    if (frequency >= 2400 && frequency < 2500)
+        return "2.4 GHz";
+    return NULL;
+}
+
+/* IEEE 802.11 channel number for a frequency in MHz, 0 if unknown */
+guint
+nm_interface_ap_channel(guint32 frequency)
+{
+    if (frequency == 2484)
+        return 14;
+    if (frequency >= 2412 && frequency < 2484)
+        return (frequency - 2407) / 5;
+    if (frequency >= 5955 && frequency <= 7115)
+        return (frequency - 5950) / 5;
+    if (frequency >= 5000 && frequency <= 5895)
+        return (frequency - 5000) / 5;
+    /* 802.11j channels 182-196 count from 4000 MHz */
+    if (frequency >= 4910 && frequency <= 4980)
+        return (frequency - 4000) / 5;
+    return 0;
+}
+
 /* Request a Wi-Fi scan */
 gboolean
 nm_interface_request_scan(NMInterface *nm_interface, const gchar *device_path, GError **error)
 {
-    GDBusProxy *wifi_proxy;
-    GVariant *result;
-    gboolean success = FALSE;
-    
-    /* Create Wi-Fi device proxy */
-    wifi_proxy = g_dbus_proxy_new_sync(
-        nm_interface->connection,
-        G_DBUS_PROXY_FLAGS_NONE,
-        NULL,
-        NM_DBUS_SERVICE,
-        device_path,
-        NM_DBUS_INTERFACE_DEVICE_WIRELESS,
-        NULL,
-        &error);
-    
-    if (!wifi_proxy) {
+    if (!nm_interface || !nm_interface->initialized) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                    "NetworkManager interface not initialized");
         return FALSE;
     }
-    
-    /* Request scan */
-    result = g_dbus_proxy_call_sync(
-        wifi_proxy,
-        "RequestScan",
-        g_variant_new("(a{sv})", NULL),
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        error);
-    
-    if (result) {
-        g_variant_unref(result);
-        success = TRUE;
-    }
-    
-    g_object_unref(wifi_proxy);
-    
-    return success;
+
+    return nm_interface->backend->request_scan(nm_interface, device_path, error);
 }
 
 /* Deactivate connection */
@@ -1225,159 +973,11 @@ nm_interface_deactivate_connection(NMInterface *nm_interface,
                                   const gchar *active_path,
                                   GError **error)
 {
-    GVariant *result;
-    
-    result = g_dbus_proxy_call_sync(
-        nm_interface->nm_proxy,
-        "DeactivateConnection",
-        g_variant_new("(o)", active_path),
-        G_DBUS_CALL_FLAGS_NONE,
-        -1,
-        NULL,
-        error);
-    
-    if (result) {
-        g_variant_unref(result);
-        return TRUE;
-    }
-    
-    return FALSE;
-}
-
-/* Signal handler for device state changes */
-static void
-on_device_state_changed(GDBusConnection *connection,
-                       const gchar *sender_name,
-                       const gchar *object_path,
-                       const gchar *interface_name,
-                       const gchar *signal_name,
-                       GVariant *parameters,
-                       gpointer user_data)
-{
-    NMInterface *nm_interface = (NMInterface *)user_data;
-    NMDeviceInfo *device_info;
-    guint32 new_state, old_state, reason;
-    
-    /* Extract parameters */
-    g_variant_get(parameters, "(uuu)", &new_state, &old_state, &reason);
-    
-    /* Update device info */
-    device_info = g_hash_table_lookup(nm_interface->devices, object_path);
-    if (device_info) {
-        device_info->state = new_state;
-        
-        /* Notify callback if set */
-        if (nm_interface->device_added_cb) {
-            nm_interface->device_added_cb(nm_interface, device_info, nm_interface->user_data);
-        }
-    }
-    
-    g_debug("Device %s state changed from %u to %u (reason: %u)", 
-            object_path, old_state, new_state, reason);
-}
-
-/* Signal handler for device added */
-static void
-on_device_added(GDBusConnection *connection,
-               const gchar *sender_name,
-               const gchar *object_path,
-               const gchar *interface_name,
-               const gchar *signal_name,
-               GVariant *parameters,
-               gpointer user_data)
-{
-    NMInterface *nm_interface = (NMInterface *)user_data;
-    const gchar *device_path;
-    NMDeviceInfo *device_info;
-    
-    g_variant_get(parameters, "(&o)", &device_path);
-    
-    /* Create and add new device */
-    device_info = nm_interface_create_device_info(nm_interface, device_path);
-    if (device_info) {
-        g_hash_table_insert(nm_interface->devices, g_strdup(device_path), device_info);
-        
-        /* Notify callback if set */
-        if (nm_interface->device_added_cb) {
-            nm_interface->device_added_cb(nm_interface, device_info, nm_interface->user_data);
-        }
-    }
-}
-
-/* Signal handler for device removed */
-static void
-on_device_removed(GDBusConnection *connection,
-                 const gchar *sender_name,
-                 const gchar *object_path,
-                 const gchar *interface_name,
-                 const gchar *signal_name,
-                 GVariant *parameters,
-                 gpointer user_data)
-{
-    NMInterface *nm_interface = (NMInterface *)user_data;
-    const gchar *device_path;
-    NMDeviceInfo *device_info;
-    
-    g_variant_get(parameters, "(&o)", &device_path);
-    
-    /* Get device info before removing */
-    device_info = g_hash_table_lookup(nm_interface->devices, device_path);
-    if (device_info) {
-        /* Notify callback if set */
-        if (nm_interface->device_removed_cb) {
-            nm_interface->device_removed_cb(nm_interface, device_info, nm_interface->user_data);
-        }
-        
-        /* Remove from hash table */
-        g_hash_table_remove(nm_interface->devices, device_path);
-        nm_interface_free_device_info(device_info);
+    if (!nm_interface || !nm_interface->initialized) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                    "NetworkManager interface not initialized");
+        return FALSE;
     }
-}
 
-/* Setup D-Bus signal handlers */
-static void
-nm_interface_setup_signals(NMInterface *nm_interface)
-{
-    /* Subscribe to StateChanged signal */
-    g_signal_connect(nm_interface->nm_proxy, "g-properties-changed",
-                     G_CALLBACK(on_state_changed), nm_interface);
-    
-    /* Subscribe to DeviceAdded signal */
-    nm_interface->device_added_id = g_dbus_connection_signal_subscribe(
-        nm_interface->connection,
-        NM_DBUS_SERVICE,
-        NM_DBUS_INTERFACE,
-        "DeviceAdded",
-        NM_DBUS_PATH,
-        NULL,
-        G_DBUS_SIGNAL_FLAGS_NONE,
-        on_device_added,
-        nm_interface,
-        NULL);
-    
-    /* Subscribe to DeviceRemoved signal */
-    nm_interface->device_removed_id = g_dbus_connection_signal_subscribe(
-        nm_interface->connection,
-        NM_DBUS_SERVICE,
-        NM_DBUS_INTERFACE,
-        "DeviceRemoved",
-        NM_DBUS_PATH,
-        NULL,
-        G_DBUS_SIGNAL_FLAGS_NONE,
-        on_device_removed,
-        nm_interface,
-        NULL);
-    
-    /* Subscribe to device state changes for all devices */
-    nm_interface->state_changed_id = g_dbus_connection_signal_subscribe(
-        nm_interface->connection,
-        NM_DBUS_SERVICE,
-        NM_DBUS_INTERFACE_DEVICE,
-        "StateChanged",
-        NULL,  /* Match all device paths */
-        NULL,
-        G_DBUS_SIGNAL_FLAGS_NONE,
-        on_device_state_changed,
-        nm_interface,
-        NULL);
+    return nm_interface->backend->deactivate_connection(nm_interface, active_path, error);
 }
@@ -22,6 +22,7 @@ typedef struct _NMInterface NMInterface;
 typedef struct _NMDeviceInfo NMDeviceInfo;
 typedef struct _NMConnectionInfo NMConnectionInfo;
 typedef struct _NMAccessPointInfo NMAccessPointInfo;
+typedef struct _NMActiveConnectionInfo NMActiveConnectionInfo;
 
 /* Our simplified connection states */
 typedef enum {
@@ -34,12 +35,19 @@ typedef enum {
 
 /* Device information structure */
 struct _NMDeviceInfo {
+    gchar            *path;       /* D-Bus object path */
     gchar            *name;
     gchar            *interface;
     NMDeviceType      type;
     NMDeviceState     state;
     gboolean          managed;
     gboolean          available;
+
+    /* Kernel link state, kept by nm_interface_enable_link_monitor() */
+    gboolean          link_known;
+    gboolean          link_carrier;
+    guint64           link_rx_bytes;
+    guint64           link_tx_bytes;
     
     /* Type-specific data */
     union {
@@ -51,6 +59,7 @@ struct _NMDeviceInfo {
         struct {
             gchar    *active_ap;
             guint8    strength;
+            guint     bitrate;        /* kbit/s, 0 when not associated */
             GList    *access_points;  /* List of NMAccessPoint */
         } wifi;
         
@@ -77,15 +86,44 @@ struct _NMConnectionInfo {
 
 /* Access point information structure */
 struct _NMAccessPointInfo {
-    gchar  *path;      /* D-Bus object path */
-    gchar  *ssid;
-    guchar  strength;
-    gchar  *security;
+    gchar   *path;      /* D-Bus object path */
+    gchar   *ssid;
+    guchar   strength;
+    gchar   *security;
+    gchar   *bssid;
+    guint32  frequency; /* MHz */
+};
+
+/* Active connection information structure */
+struct _NMActiveConnectionInfo {
+    gchar                  *path;             /* D-Bus object path */
+    gchar                  *connection;       /* Settings connection path */
+    gchar                  *uuid;
+    gchar                  *id;
+    gchar                  *type;
+    gchar                  *specific_object;  /* Access point path for Wi-Fi */
+    gchar                 **devices;          /* Device paths */
+    NMActiveConnectionState state;
+    gboolean                is_default;
+    gboolean                vpn;
 };
 
+/* What changed, passed to change listeners */
+typedef enum {
+    NM_INTERFACE_CHANGED_STATE              = 1 << 0,
+    NM_INTERFACE_CHANGED_DEVICES            = 1 << 1,
+    NM_INTERFACE_CHANGED_ACCESS_POINTS      = 1 << 2,
+    NM_INTERFACE_CHANGED_CONNECTIONS        = 1 << 3,
+    NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS = 1 << 4,
+    NM_INTERFACE_CHANGED_ALL                = 0x1f
+} NMInterfaceChangeFlags;
+
 /* Callback types */
 typedef void (*NMInterfaceCallback)        (NMInterface *nm_interface,
                                            gpointer user_data);
+typedef void (*NMChangedCallback)          (NMInterface *nm_interface,
+                                           NMInterfaceChangeFlags changes,
+                                           gpointer user_data);
 typedef void (*NMDeviceCallback)           (NMInterface *nm_interface,
                                            NMDeviceInfo *device,
                                            gpointer user_data);
@@ -98,13 +136,23 @@ typedef void (*NMStateChangedCallback)     (NMInterface *nm_interface,
 
 /* NMInterface functions */
 NMInterface         *nm_interface_new                    (void);
+NMInterface         *nm_interface_new_for_backend        (const gchar *backend_name);
+NMInterface         *nm_interface_new_for_snapshot       (const gchar *filename);
 void                 nm_interface_free                   (NMInterface *nm_interface);
+const gchar         *nm_interface_get_backend_name       (NMInterface *nm_interface);
 
 /* Connection management */
 gboolean             nm_interface_init                   (NMInterface *nm_interface,
                                                          GError **error);
 void                 nm_interface_shutdown               (NMInterface *nm_interface);
 
+/* Global state */
+NMState              nm_interface_get_state              (NMInterface *nm_interface);
+NMConnectivityState  nm_interface_get_connectivity       (NMInterface *nm_interface);
+gboolean             nm_interface_save_snapshot          (NMInterface *nm_interface,
+                                                         const gchar *filename,
+                                                         GError **error);
+
 /* Device operations */
 GList               *nm_interface_get_devices            (NMInterface *nm_interface);
 NMDeviceInfo        *nm_interface_get_device_info        (NMInterface *nm_interface,
@@ -117,6 +165,13 @@ NMConnectionInfo    *nm_interface_get_connection_info    (NMInterface *nm_interf
                                                          const gchar *connection_path);
 void                 nm_interface_free_connection_info   (NMConnectionInfo *info);
 
+/* Active connection operations */
+GList               *nm_interface_get_active_connections (NMInterface *nm_interface);
+NMActiveConnectionInfo *nm_interface_get_active_connection_info (NMInterface *nm_interface,
+                                                         const gchar *active_path);
+NMActiveConnectionInfo *nm_interface_get_primary_connection (NMInterface *nm_interface);
+void                 nm_interface_free_active_connection_info (NMActiveConnectionInfo *info);
+
 gboolean             nm_interface_activate_connection    (NMInterface *nm_interface,
                                                          const gchar *connection_uuid,
                                                          const gchar *device_path,
@@ -153,6 +208,9 @@ gboolean             nm_interface_request_scan          (NMInterface *nm_interfa
                                                          const gchar *device_path,
                                                          GError **error);
 void                 nm_interface_free_ap_info          (NMAccessPointInfo *ap_info);
+NMAccessPointInfo   *nm_interface_copy_ap_info          (const NMAccessPointInfo *ap_info);
+const gchar         *nm_interface_ap_band               (guint32 frequency);
+guint                nm_interface_ap_channel            (guint32 frequency);
 
 /* Signal handlers */
 void                 nm_interface_set_state_changed_cb   (NMInterface *nm_interface,
@@ -165,6 +223,20 @@ void                 nm_interface_set_device_removed_cb  (NMInterface *nm_interf
                                                          NMDeviceCallback callback,
                                                          gpointer user_data);
 
+/* Change listeners; any number may be registered */
+guint                nm_interface_add_changed_listener   (NMInterface *nm_interface,
+                                                         NMInterfaceChangeFlags mask,
+                                                         NMChangedCallback callback,
+                                                         gpointer user_data);
+void                 nm_interface_remove_changed_listener (NMInterface *nm_interface,
+                                                         guint listener_id);
+
+/* Carrier and counters from rtnetlink, ahead of NetworkManager */
+gboolean             nm_interface_enable_link_monitor    (NMInterface *nm_interface,
+                                                         GError **error);
+void                 nm_interface_disable_link_monitor   (NMInterface *nm_interface);
+void                 nm_interface_refresh_links          (NMInterface *nm_interface);
+
 /* Utility functions */
 const gchar         *nm_interface_device_type_to_string  (NMDeviceType type);
 const gchar         *nm_interface_state_to_string        (XfceNMConnectionState state);
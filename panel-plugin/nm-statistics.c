@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "nm-interface-private.h"
+#include "nm-statistics.h"
+
+typedef struct {
+    guint                 id;
+    gchar                *device_path;
+    NMStatisticsCallback  callback;
+    gpointer              user_data;
+    gboolean              removed;      /* while samples are dispatched */
+} NMStatisticsWatch;
+
+static void
+nm_statistics_free_watch(NMStatisticsWatch *watch)
+{
+    g_free(watch->device_path);
+    g_free(watch);
+}
+
+/* A watched device */
+typedef struct {
+    guint               n_watches;
+    guint               refresh_rate;   /* as last set on the backend */
+
+    /* Ring of the most recent samples; the newest is at head - 1 */
+    NMStatisticsSample  samples[NM_STATISTICS_HISTORY];
+    guint               head;
+    guint               n_samples;
+} NMDeviceStatistics;
+
+static void
+nm_statistics_set_rate(NMInterface *nm_interface, const gchar *device_path,
+                       NMDeviceStatistics *statistics, guint rate)
+{
+    /* After shutdown there is no backend to tell */
+    if (!nm_interface->initialized || !nm_interface->backend->set_statistics_rate)
+        return;
+
+    if (nm_interface->backend->set_statistics_rate(nm_interface, device_path, rate))
+        statistics->refresh_rate = rate;
+}
+
+/*
+ * Call callback with every new sample of device_path. The first watcher of
+ * a device turns on NetworkManager's counters for it.
+ */
+guint
+nm_statistics_watch(NMInterface *nm_interface, const gchar *device_path,
+                    NMStatisticsCallback callback, gpointer user_data)
+{
+    NMStatisticsWatch *watch;
+    NMDeviceStatistics *statistics;
+
+    g_return_val_if_fail(device_path != NULL, 0);
+
+    if (!nm_interface->statistics)
+        nm_interface->statistics = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    statistics = g_hash_table_lookup(nm_interface->statistics, device_path);
+    if (!statistics) {
+        statistics = g_new0(NMDeviceStatistics, 1);
+        g_hash_table_insert(nm_interface->statistics, g_strdup(device_path), statistics);
+    }
+
+    if (statistics->n_watches++ == 0)
+        nm_statistics_set_rate(nm_interface, device_path, statistics, NM_STATISTICS_REFRESH_RATE);
+
+    watch = g_new0(NMStatisticsWatch, 1);
+    watch->id = ++nm_interface->next_statistics_watch_id;
+    watch->device_path = g_strdup(device_path);
+    watch->callback = callback;
+    watch->user_data = user_data;
+    nm_interface->statistics_watches = g_list_append(nm_interface->statistics_watches, watch);
+
+    return watch->id;
+}
+
+/* The last watcher of a device going sets its refresh rate back to 0 */
+void
+nm_statistics_unwatch(NMInterface *nm_interface, guint watch_id)
+{
+    NMStatisticsWatch *watch = NULL;
+    NMDeviceStatistics *statistics;
+    GList *l;
+
+    for (l = nm_interface->statistics_watches; l != NULL; l = l->next) {
+        NMStatisticsWatch *candidate = l->data;
+
+        if (candidate->id == watch_id && !candidate->removed) {
+            watch = candidate;
+            break;
+        }
+    }
+    if (!watch)
+        return;
+
+    statistics = g_hash_table_lookup(nm_interface->statistics, watch->device_path);
+    if (statistics && --statistics->n_watches == 0) {
+        nm_statistics_set_rate(nm_interface, watch->device_path, statistics, 0);
+        g_hash_table_remove(nm_interface->statistics, watch->device_path);
+    }
+
+    /* The dispatch loop may be holding on to the list */
+    if (nm_interface->statistics_dispatch_depth > 0) {
+        watch->removed = TRUE;
+        nm_interface->statistics_watches_removed = TRUE;
+        return;
+    }
+
+    nm_interface->statistics_watches = g_list_delete_link(nm_interface->statistics_watches, l);
+    nm_statistics_free_watch(watch);
+}
+
+/* Called by the backends with new counter values for a device */
+void
+nm_statistics_add_sample(NMInterface *nm_interface, const gchar *device_path,
+                         guint64 rx_bytes, guint64 tx_bytes)
+{
+    NMDeviceStatistics *statistics;
+    NMStatisticsSample *sample;
+    GList *l;
+
+    if (!nm_interface->statistics)
+        return;
+
+    /* Counters of devices nobody watches are of no interest */
+    statistics = g_hash_table_lookup(nm_interface->statistics, device_path);
+    if (!statistics)
+        return;
+
+    sample = &statistics->samples[statistics->head];
+    sample->time = g_get_monotonic_time();
+    sample->rx_bytes = rx_bytes;
+    sample->tx_bytes = tx_bytes;
+    sample->rx_rate = 0;
+    sample->tx_rate = 0;
+
+    if (statistics->n_samples > 0) {
+        NMStatisticsSample *previous = &statistics->samples[(statistics->head + NM_STATISTICS_HISTORY - 1) %
+                                                           NM_STATISTICS_HISTORY];
+        gdouble elapsed = (gdouble)(sample->time - previous->time) / G_USEC_PER_SEC;
+
+        /* Counters restart from 0 when a device is reset */
+        if (elapsed > 0 && rx_bytes >= previous->rx_bytes && tx_bytes >= previous->tx_bytes) {
+            sample->rx_rate = (rx_bytes - previous->rx_bytes) / elapsed;
+            sample->tx_rate = (tx_bytes - previous->tx_bytes) / elapsed;
+        }
+    }
+
+    statistics->head = (statistics->head + 1) % NM_STATISTICS_HISTORY;
+    statistics->n_samples = MIN(statistics->n_samples + 1, NM_STATISTICS_HISTORY);
+
+    /* Watchers may unwatch any watch, themselves included */
+    nm_interface->statistics_dispatch_depth++;
+    for (l = nm_interface->statistics_watches; l != NULL; l = l->next) {
+        NMStatisticsWatch *watch = l->data;
+
+        if (!watch->removed && watch->callback && g_strcmp0(watch->device_path, device_path) == 0)
+            watch->callback(nm_interface, device_path, sample, watch->user_data);
+    }
+
+    if (--nm_interface->statistics_dispatch_depth > 0 || !nm_interface->statistics_watches_removed)
+        return;
+
+    l = nm_interface->statistics_watches;
+    while (l != NULL) {
+        GList *next = l->next;
+        NMStatisticsWatch *watch = l->data;
+
+        if (watch->removed) {
+            nm_interface->statistics_watches = g_list_delete_link(nm_interface->statistics_watches, l);
+            nm_statistics_free_watch(watch);
+        }
+        l = next;
+    }
+    nm_interface->statistics_watches_removed = FALSE;
+}
+
+/*
+ * Copy up to n_samples of the most recent samples of a watched device into
+ * samples, oldest first. Returns the number copied.
+ */
+guint
+nm_statistics_get_history(NMInterface *nm_interface, const gchar *device_path,
+                          NMStatisticsSample *samples, guint n_samples)
+{
+    NMDeviceStatistics *statistics;
+    guint first, i;
+
+    if (!nm_interface->statistics)
+        return 0;
+
+    statistics = g_hash_table_lookup(nm_interface->statistics, device_path);
+    if (!statistics)
+        return 0;
+
+    n_samples = MIN(n_samples, statistics->n_samples);
+    first = (statistics->head + NM_STATISTICS_HISTORY - n_samples) % NM_STATISTICS_HISTORY;
+    for (i = 0; i < n_samples; i++)
+        samples[i] = statistics->samples[(first + i) % NM_STATISTICS_HISTORY];
+
+    return n_samples;
+}
+
+gboolean
+nm_statistics_get_latest(NMInterface *nm_interface, const gchar *device_path,
+                         NMStatisticsSample *sample)
+{
+    return nm_statistics_get_history(nm_interface, device_path, sample, 1) == 1;
+}
+
+/* The refresh rate last set for a device, 0 if it is not watched */
+guint
+nm_statistics_get_refresh_rate(NMInterface *nm_interface, const gchar *device_path)
+{
+    NMDeviceStatistics *statistics;
+
+    if (!nm_interface->statistics)
+        return 0;
+
+    statistics = g_hash_table_lookup(nm_interface->statistics, device_path);
+
+    return statistics ? statistics->refresh_rate : 0;
+}
+
+/*
+ * Set the refresh rate of watched devices that do not have it yet: the
+ * backend refuses devices it does not know, and a new backend starts with
+ * none set. device_path NULL resumes every watched device.
+ */
+void
+nm_statistics_resume(NMInterface *nm_interface, const gchar *device_path)
+{
+    NMDeviceStatistics *statistics;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    if (!nm_interface->statistics)
+        return;
+
+    if (device_path) {
+        statistics = g_hash_table_lookup(nm_interface->statistics, device_path);
+        if (statistics && statistics->n_watches > 0 && !statistics->refresh_rate)
+            nm_statistics_set_rate(nm_interface, device_path, statistics, NM_STATISTICS_REFRESH_RATE);
+        return;
+    }
+
+    g_hash_table_iter_init(&iter, nm_interface->statistics);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        statistics = value;
+        if (statistics->n_watches > 0 && !statistics->refresh_rate)
+            nm_statistics_set_rate(nm_interface, key, statistics, NM_STATISTICS_REFRESH_RATE);
+    }
+}
+
+/* Stop NetworkManager's counters before the backend goes away */
+void
+nm_statistics_stop(NMInterface *nm_interface)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    if (!nm_interface->statistics)
+        return;
+
+    g_hash_table_iter_init(&iter, nm_interface->statistics);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        NMDeviceStatistics *statistics = value;
+
+        if (statistics->refresh_rate)
+            nm_statistics_set_rate(nm_interface, key, statistics, 0);
+
+        /* The next backend starts without it either way */
+        statistics->refresh_rate = 0;
+    }
+}
+
+/* Drop every watch; the backend is already shut down */
+void
+nm_statistics_clear(NMInterface *nm_interface)
+{
+    g_list_free_full(nm_interface->statistics_watches, (GDestroyNotify)nm_statistics_free_watch);
+    nm_interface->statistics_watches = NULL;
+    g_clear_pointer(&nm_interface->statistics, g_hash_table_destroy);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __NM_STATISTICS_H__
+#define __NM_STATISTICS_H__
+
+#include "nm-interface.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Per-device traffic from NetworkManager's Device.Statistics interface.
+ * NetworkManager only refreshes the counters while a refresh rate is set,
+ * so the rate is set when a device gets its first watcher and put back to
+ * 0 when the last one goes. The recent samples of a watched device are
+ * kept in a fixed-size ring for graphs.
+ */
+
+/* Refresh rate asked of NetworkManager while a device is watched */
+#define NM_STATISTICS_REFRESH_RATE 1000
+
+/* Samples kept per watched device */
+#define NM_STATISTICS_HISTORY      120
+
+typedef struct {
+    gint64   time;       /* monotonic, in microseconds */
+    guint64  rx_bytes;
+    guint64  tx_bytes;
+    gdouble  rx_rate;    /* bytes per second since the previous sample */
+    gdouble  tx_rate;
+} NMStatisticsSample;
+
+typedef void (*NMStatisticsCallback) (NMInterface *nm_interface,
+                                      const gchar *device_path,
+                                      const NMStatisticsSample *sample,
+                                      gpointer user_data);
+
+guint     nm_statistics_watch       (NMInterface *nm_interface,
+                                     const gchar *device_path,
+                                     NMStatisticsCallback callback,
+                                     gpointer user_data);
+void      nm_statistics_unwatch     (NMInterface *nm_interface,
+                                     guint watch_id);
+guint     nm_statistics_get_history (NMInterface *nm_interface,
+                                     const gchar *device_path,
+                                     NMStatisticsSample *samples,
+                                     guint n_samples);
+gboolean  nm_statistics_get_latest  (NMInterface *nm_interface,
+                                     const gchar *device_path,
+                                     NMStatisticsSample *sample);
+
+G_END_DECLS
+
+#endif /* __NM_STATISTICS_H__ */
@@ -14,12 +14,81 @@
 #include "plugin.h"
 #include "nm-interface.h"
 #include "popup-window.h"
+#include "status-icon.h"
+#include "connection-tooltip.h"
+#include "traffic-label.h"
+#include "usage-ledger.h"
+
+/* Build the popup if it does not exist yet; NULL if that failed */
+static PopupWindow *
+networkmanager_plugin_get_popup(NetworkManagerPlugin *nm_plugin)
+{
+    if (!nm_plugin->popup_window)
+        nm_plugin->popup_window = (GtkWidget*)popup_window_new(nm_plugin);
+
+    return (PopupWindow *)nm_plugin->popup_window;
+}
+
+/* Pay for the popup while the panel is idle so the first click is fast */
+static gboolean
+on_prebuild_idle(gpointer user_data)
+{
+    NetworkManagerPlugin *nm_plugin = (NetworkManagerPlugin *)user_data;
+    PopupWindow *popup;
+
+    nm_plugin->prebuild_idle = 0;
+
+    popup = networkmanager_plugin_get_popup(nm_plugin);
+    if (!popup)
+        return G_SOURCE_REMOVE;
+
+    gtk_widget_realize(popup->window);
+    popup_window_prewarm(popup);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+networkmanager_plugin_read(NetworkManagerPlugin *nm_plugin)
+{
+    XfceRc *rc;
+    gchar *file;
+
+    nm_plugin->prebuild_popup = TRUE;
+    nm_plugin->scan_interval = 0;
+    nm_plugin->show_label = FALSE;
+    nm_plugin->label_interval = 2;
+    nm_plugin->link_monitor = TRUE;
+    nm_plugin->billing_day = 1;
+
+    file = xfce_panel_plugin_lookup_rc_file(nm_plugin->plugin);
+    if (!file)
+        return;
+
+    rc = xfce_rc_simple_open(file, TRUE);
+    g_free(file);
+    if (!rc)
+        return;
+
+    nm_plugin->prebuild_popup = xfce_rc_read_bool_entry(rc, "prebuild_popup", TRUE);
+    nm_plugin->scan_interval = MAX(xfce_rc_read_int_entry(rc, "scan_interval", 0), 0);
+    nm_plugin->show_label = xfce_rc_read_bool_entry(rc, "show_label", FALSE);
+    nm_plugin->label_interval = MAX(xfce_rc_read_int_entry(rc, "label_interval", 2), 1);
+    nm_plugin->link_monitor = xfce_rc_read_bool_entry(rc, "link_monitor", TRUE);
+    nm_plugin->billing_day = CLAMP(xfce_rc_read_int_entry(rc, "billing_day", 1), 1, 31);
+    nm_plugin->speed_test_endpoint = g_strdup(xfce_rc_read_entry(rc, "speed_test_endpoint", NULL));
+    xfce_rc_close(rc);
+}
 
 static void
 on_button_clicked(GtkButton *button, NetworkManagerPlugin *nm_plugin)
 {
     GdkRectangle rect;
     GtkAllocation allocation;
+    PopupWindow *popup = networkmanager_plugin_get_popup(nm_plugin);
+    
+    if (!popup)
+        return;
     
     /* Get button position for popup placement */
     gtk_widget_get_allocation(GTK_WIDGET(button), &allocation);
@@ -30,18 +99,20 @@ on_button_clicked(GtkButton *button, NetworkManagerPlugin *nm_plugin)
     rect.height = allocation.height;
     
     /* Toggle popup window */
-    popup_window_toggle(nm_plugin->popup_window, &rect);
+    popup_window_toggle(popup, &rect);
 }
 
 NetworkManagerPlugin *
 networkmanager_plugin_new(XfcePanelPlugin *plugin)
 {
     NetworkManagerPlugin *nm_plugin;
+    GtkWidget *box;
     GError *error = NULL;
 
     /* Allocate memory for the plugin structure */
     nm_plugin = g_new0(NetworkManagerPlugin, 1);
     nm_plugin->plugin = plugin;
+    networkmanager_plugin_read(nm_plugin);
 
     /* Initialize NetworkManager interface */
     nm_plugin->nm_interface = nm_interface_new();
@@ -64,14 +135,48 @@ networkmanager_plugin_new(XfcePanelPlugin *plugin)
             g_error_free(error);
         
         /* Continue with limited functionality */
+        nm_interface_free(nm_plugin->nm_interface);
         nm_plugin->nm_interface = NULL;
+    } else if (nm_plugin->link_monitor &&
+               !nm_interface_enable_link_monitor(nm_plugin->nm_interface, &error)) {
+        /* NetworkManager still reports carrier changes, only later */
+        g_debug("Link monitor not available: %s", error->message);
+        g_clear_error(&error);
     }
     /* Create the panel button */
     nm_plugin->button = gtk_button_new();
     gtk_button_set_relief(GTK_BUTTON(nm_plugin->button), GTK_RELIEF_NONE);
-    nm_plugin->icon = gtk_image_new_from_icon_name("network-wired", GTK_ICON_SIZE_MENU);
-    gtk_container_add(GTK_CONTAINER(nm_plugin->button), nm_plugin->icon);
+    box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+    gtk_container_add(GTK_CONTAINER(nm_plugin->button), box);
+    gtk_widget_show(box);
+
+    nm_plugin->icon = gtk_image_new();
+    gtk_box_pack_start(GTK_BOX(box), nm_plugin->icon, FALSE, FALSE, 0);
     gtk_widget_show(nm_plugin->icon);
+    nm_plugin->status_icon = status_icon_new(nm_plugin->icon, nm_plugin->nm_interface);
+
+    /* Optional receive and transmit rates next to the icon */
+    if (nm_plugin->show_label) {
+        nm_plugin->label = gtk_label_new(NULL);
+        gtk_box_pack_start(GTK_BOX(box), nm_plugin->label, FALSE, FALSE, 0);
+        gtk_widget_show(nm_plugin->label);
+        nm_plugin->traffic_label = traffic_label_new(nm_plugin->label, nm_plugin->nm_interface,
+                                                     nm_plugin->label_interval);
+    }
+    nm_plugin->connection_tooltip = connection_tooltip_new(nm_plugin->button, nm_plugin->nm_interface);
+
+    /* Data used by metered connections, kept across restarts */
+    if (nm_plugin->nm_interface) {
+        nm_plugin->usage_ledger = usage_ledger_new(NULL, &error);
+        if (nm_plugin->usage_ledger) {
+            usage_ledger_attach(nm_plugin->usage_ledger, nm_plugin->nm_interface);
+            connection_tooltip_set_usage_ledger(nm_plugin->connection_tooltip, nm_plugin->usage_ledger,
+                                                nm_plugin->billing_day);
+        } else {
+            g_warning("%s", error->message);
+            g_clear_error(&error);
+        }
+    }
     
     /* Connect button click signal */
     g_signal_connect(nm_plugin->button, "clicked",
@@ -84,8 +189,9 @@ networkmanager_plugin_new(XfcePanelPlugin *plugin)
     gtk_container_add(GTK_CONTAINER(plugin), nm_plugin->button);
     gtk_widget_show(nm_plugin->button);
     
-    /* Create popup window */
-    nm_plugin->popup_window = (GtkWidget*)popup_window_new(nm_plugin);
+    /* The popup is built lazily on first click unless prebuilding is on */
+    if (nm_plugin->prebuild_popup)
+        nm_plugin->prebuild_idle = g_idle_add_full(G_PRIORITY_LOW, on_prebuild_idle, nm_plugin, NULL);
 
     return nm_plugin;
 }
@@ -93,24 +199,58 @@ networkmanager_plugin_new(XfcePanelPlugin *plugin)
 void
 networkmanager_plugin_free(XfcePanelPlugin *plugin, NetworkManagerPlugin *nm_plugin)
 {
-    g_clear_object(&nm_plugin->nm_interface);
-    g_free(nm_plugin->current_connection);
-    g_free(nm_plugin->current_ssid);
+    if (nm_plugin->prebuild_idle)
+        g_source_remove(nm_plugin->prebuild_idle);
+
+    /* The popup, icon, tooltip, label and ledger listen to the interface, so they go first */
+    if (nm_plugin->popup_window)
+        popup_window_free((PopupWindow *)nm_plugin->popup_window);
+    status_icon_free(nm_plugin->status_icon);
+    connection_tooltip_free(nm_plugin->connection_tooltip);
+    traffic_label_free(nm_plugin->traffic_label);
+    usage_ledger_free(nm_plugin->usage_ledger);
+
+    g_clear_pointer(&nm_plugin->nm_interface, nm_interface_free);
 
     gtk_widget_destroy(nm_plugin->button);
+    g_free(nm_plugin->speed_test_endpoint);
     g_free(nm_plugin);
 }
 
 void
 networkmanager_plugin_save(XfcePanelPlugin *plugin, NetworkManagerPlugin *nm_plugin)
 {
-    // Save configuration settings
+    XfceRc *rc;
+    gchar *file;
+
+    file = xfce_panel_plugin_save_location(plugin, TRUE);
+    if (!file)
+        return;
+
+    rc = xfce_rc_simple_open(file, FALSE);
+    g_free(file);
+    if (!rc)
+        return;
+
+    xfce_rc_write_bool_entry(rc, "prebuild_popup", nm_plugin->prebuild_popup);
+    xfce_rc_write_int_entry(rc, "scan_interval", nm_plugin->scan_interval);
+    xfce_rc_write_bool_entry(rc, "show_label", nm_plugin->show_label);
+    xfce_rc_write_int_entry(rc, "label_interval", nm_plugin->label_interval);
+    xfce_rc_write_bool_entry(rc, "link_monitor", nm_plugin->link_monitor);
+    xfce_rc_write_int_entry(rc, "billing_day", nm_plugin->billing_day);
+    if (nm_plugin->speed_test_endpoint)
+        xfce_rc_write_entry(rc, "speed_test_endpoint", nm_plugin->speed_test_endpoint);
+    xfce_rc_close(rc);
 }
 
 gboolean
 networkmanager_plugin_size_changed(XfcePanelPlugin *plugin, gint size, NetworkManagerPlugin *nm_plugin)
 {
-    // Handle size change
+    /* One square button per row, wider with the label; the icon at the panel's icon size */
+    size /= xfce_panel_plugin_get_nrows(plugin);
+    gtk_widget_set_size_request(nm_plugin->button, nm_plugin->label ? -1 : size, size);
+    status_icon_set_size(nm_plugin->status_icon, xfce_panel_plugin_get_icon_size(plugin));
+
     return TRUE;
 }
 
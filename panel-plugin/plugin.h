@@ -29,20 +29,25 @@ typedef struct _NetworkManagerPlugin
     
     /* NetworkManager interface */
     gpointer         nm_interface;
-    
-    /* Current connection info */
-    gchar           *current_connection;
-    gchar           *current_ssid;
-    gint             signal_strength;
+    gpointer         status_icon;       /* StatusIcon showing its state on the button */
+    gpointer         connection_tooltip; /* ConnectionTooltip, built when shown */
+    gpointer         traffic_label;     /* TrafficLabel filling label, if show_label */
+    gpointer         usage_ledger;      /* UsageLedger of metered connections */
     
     /* Settings */
     gboolean         show_label;
     gboolean         show_notifications;
     gint             transparency;
-    gint             scan_interval;
+    gint             scan_interval;     /* seconds between rescans while the popup is open, 0 for none */
+    gint             label_interval;    /* seconds between traffic label updates */
+    gint             billing_day;       /* day of the month metered plans renew */
+    gchar           *speed_test_endpoint; /* tcp:// or http:// URL, NULL for no speed test */
+    gboolean         prebuild_popup;    /* build the popup at startup, not on first click */
+    gboolean         link_monitor;      /* follow carrier changes over rtnetlink */
     
     /* Update timeout */
     guint            update_timer;
+    guint            prebuild_idle;
     
 } NetworkManagerPlugin;
 
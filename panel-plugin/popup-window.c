@@ -12,43 +12,95 @@
 #endif
 
 #include "nm-interface.h"
+#include "network-list-model.h"
+#include "network-list-view.h"
+#include "icon-cache.h"
 #include "popup-window.h"
 #include "password-dialog.h"
 #include "notification.h"
+#include "utils.h"
 #include <string.h>
 
 /* CSS Provider */
 static GtkCssProvider *css_provider = NULL;
 
-#define POPUP_UPDATE_INTERVAL 5000  /* Update every 5 seconds */
+/* Compiled into the plugin from networkmanager.gresource.xml */
+#define POPUP_RESOURCE_PATH "/org/xfce/panel/networkmanager"
+
 #define POPUP_WIDTH 320
 #define POPUP_HEIGHT 400
 
+/* Row contents kept for reuse once their list box row is gone */
+#define POPUP_ROW_POOL_MAX 64
+
+/* Past this many rows the list only keeps widgets for the visible ones */
+#define POPUP_VIRTUAL_LIST_ENTER 200
+#define POPUP_VIRTUAL_LIST_LEAVE 150
+
+/*
+ * Widgets of one network row. The content box outlives the GtkListBoxRow
+ * holding it: when the row is destroyed the content is parked in the
+ * popup's row pool and later put into a new row for another entry.
+ */
+struct _NetworkRow {
+    PopupWindow       *popup;
+    GtkWidget         *row;           /* current GtkListBoxRow, or NULL when parked */
+    GtkWidget         *content;       /* ref held */
+    GtkWidget         *status_icon;
+    GtkWidget         *name_label;
+    GtkWidget         *count_button;  /* toggles the BSSID list */
+    GtkWidget         *signal_icon;
+    GtkWidget         *revealer;
+    GtkWidget         *bssid_box;
+
+    NetworkEntry      *entry;
+    gulong             changed_handler;
+    gboolean           fixed_height;  /* in the virtual list: no BSSID list */
+};
+
 /* Forward declarations */
 static void on_search_changed(GtkSearchEntry *entry, PopupWindow *popup);
-static GtkWidget *create_network_list_item(const gchar *ssid, gint strength, gboolean is_secure, gboolean is_connected);
+static GtkWidget *create_network_list_item(gpointer item, gpointer user_data);
+static void update_network_list_item(NetworkRow *network_row);
+static void network_list_header_func(GtkListBoxRow *row, GtkListBoxRow *before, gpointer user_data);
+static void on_nm_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data);
 static void on_network_item_clicked(GtkListBoxRow *row, gpointer user_data);
+static void popup_window_activate_entry(PopupWindow *popup, NetworkEntry *entry);
+static GtkWidget *create_virtual_row(gpointer user_data);
+static void bind_virtual_row(GtkWidget *row, gpointer item, gpointer user_data);
+static void network_row_free(NetworkRow *network_row);
+static void on_icon_cache_invalidated(gpointer user_data);
+static void popup_window_queue_update(PopupWindow *popup, PopupDirtyFlags flags);
+static void on_window_unmap(GtkWidget *widget, PopupWindow *popup);
+static void on_virtual_row_activated(gpointer item, gpointer user_data);
 static void start_loading_spinner(PopupWindow *popup);
 static void stop_loading_spinner(PopupWindow *popup);
 static void show_connection_error(PopupWindow *popup, const gchar *ssid, const gchar *error_message);
+static void popup_window_add_speed_test(PopupWindow *popup);
+static void popup_window_update_speed_test(PopupWindow *popup);
 
 PopupWindow *
 popup_window_new(NetworkManagerPlugin *plugin)
 {
     PopupWindow *popup;
+    GtkBuilder *builder;
+    GError *error = NULL;
+
+    builder = gtk_builder_new();
+    if (!gtk_builder_add_from_resource(builder, POPUP_RESOURCE_PATH "/popup-window.ui", &error)) {
+        g_warning("Failed to load popup UI: %s", error->message);
+        g_error_free(error);
+        g_object_unref(builder);
+        return NULL;
+    }
 
     popup = g_new0(PopupWindow, 1);
     popup->plugin = plugin;
     popup->nm_interface = plugin->nm_interface;
     popup->notification_manager = notification_manager_new();
-
-    GtkBuilder *builder;
-    gchar *ui_path;
-
-    builder = gtk_builder_new();
-    ui_path = g_build_filename(PACKAGE_DATA_DIR, "panel-plugin", "ui", "popup-window.ui", NULL);
-    gtk_builder_add_from_file(builder, ui_path, NULL);
-    g_free(ui_path);
+    popup->model = network_list_model_new();
+    popup->row_pool = g_ptr_array_new();
+    popup->dirty_rows = g_hash_table_new(NULL, NULL);
 
     popup->window = GTK_WIDGET(gtk_builder_get_object(builder, "popup_window"));
     popup->main_box = GTK_WIDGET(gtk_builder_get_object(builder, "main_box"));
@@ -59,23 +111,45 @@ popup_window_new(NetworkManagerPlugin *plugin)
     popup->scrolled_window = GTK_WIDGET(gtk_builder_get_object(builder, "scrolled_window"));
     popup->network_list = GTK_WIDGET(gtk_builder_get_object(builder, "network_list"));
 
+    /* The scrolled window wraps the list box in a viewport */
+    popup->list_viewport = g_object_ref(gtk_bin_get_child(GTK_BIN(popup->scrolled_window)));
+
     g_object_unref(builder);
 
+    /* search-changed is already debounced by GtkSearchEntry */
     g_signal_connect(popup->search_entry, "search-changed",
                      G_CALLBACK(on_search_changed), popup);
     g_signal_connect(popup->network_list, "row-activated",
                      G_CALLBACK(on_network_item_clicked), popup);
+    g_signal_connect(popup->window, "unmap",
+                     G_CALLBACK(on_window_unmap), popup);
+
+    /* The model sorts and filters; the list box only renders it */
+    gtk_list_box_bind_model(GTK_LIST_BOX(popup->network_list), G_LIST_MODEL(popup->model),
+                            create_network_list_item, popup, NULL);
+    gtk_list_box_set_header_func(GTK_LIST_BOX(popup->network_list),
+                                 network_list_header_func, popup, NULL);
+
+    /*
+     * Row icons are rendered once and shared. They are recolored for the
+     * list, not per row, so rows are not selectable: a click connects.
+     */
+    gtk_list_box_set_selection_mode(GTK_LIST_BOX(popup->network_list), GTK_SELECTION_NONE);
+    popup->icon_cache = icon_cache_new(popup->network_list, on_icon_cache_invalidated, popup);
+
+    if (popup->nm_interface)
+        popup->changed_listener = nm_interface_add_changed_listener(popup->nm_interface,
+                                                                    NM_INTERFACE_CHANGED_DEVICES |
+                                                                    NM_INTERFACE_CHANGED_ACCESS_POINTS |
+                                                                    NM_INTERFACE_CHANGED_CONNECTIONS |
+                                                                    NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS,
+                                                                    on_nm_changed, popup);
 
     /* Load CSS styling */
     if (!css_provider) {
+        /* Parse errors are reported through GtkCssProvider::parsing-error */
         css_provider = gtk_css_provider_new();
-        gchar *css_path = g_build_filename(PACKAGE_DATA_DIR, "panel-plugin", "style.css", NULL);
-        GError *css_error = NULL;
-        if (!gtk_css_provider_load_from_path(css_provider, css_path, &css_error)) {
-            g_warning("Failed to load CSS: %s", css_error ? css_error->message : "Unknown error");
-            g_clear_error(&css_error);
-        }
-        g_free(css_path);
+        gtk_css_provider_load_from_resource(css_provider, POPUP_RESOURCE_PATH "/style.css");
         
         gtk_style_context_add_provider_for_screen(
             gdk_screen_get_default(),
@@ -108,6 +182,9 @@ popup_window_new(NetworkManagerPlugin *plugin)
     /* Initially hide the spinner */
     gtk_widget_hide(popup->spinner);
 
+    if (plugin->speed_test_endpoint && *plugin->speed_test_endpoint)
+        popup_window_add_speed_test(popup);
+
     return popup;
 }
 
@@ -120,11 +197,64 @@ popup_window_free(PopupWindow *popup)
     if (popup->notification_manager)
         notification_manager_free(popup->notification_manager);
     
+    if (popup->changed_listener)
+        nm_interface_remove_changed_listener(popup->nm_interface, popup->changed_listener);
+    if (popup->refresh_idle)
+        g_source_remove(popup->refresh_idle);
+    if (popup->freshness_timer)
+        g_source_remove(popup->freshness_timer);
+    if (popup->tick_callback)
+        gtk_widget_remove_tick_callback(popup->window, popup->tick_callback);
+
+    speed_test_free(popup->speed_test);
+    g_free(popup->speed_test_uuid);
+
+    icon_cache_free(popup->icon_cache);
     gtk_widget_destroy(popup->window);
+    network_list_view_free(popup->list_view);
+    gtk_widget_destroy(popup->list_viewport);
+    g_object_unref(popup->list_viewport);
+    
+    /* Destroying the rows above parked their contents */
+    g_ptr_array_foreach(popup->row_pool, (GFunc)network_row_free, NULL);
+    g_ptr_array_free(popup->row_pool, TRUE);
+    g_hash_table_destroy(popup->dirty_rows);
+    g_object_unref(popup->model);
     g_free(popup->filter_text);
     g_free(popup);
 }
 
+static void popup_window_schedule_refresh(PopupWindow *popup);
+
+/*
+ * The list follows NetworkManager's change notifications. This only asks
+ * the Wi-Fi devices for a new scan; what it finds arrives the same way.
+ */
+static gboolean
+on_freshness_timeout(gpointer user_data)
+{
+    PopupWindow *popup = (PopupWindow *)user_data;
+    GList *devices, *device;
+
+    devices = nm_interface_get_devices(popup->nm_interface);
+    for (device = devices; device != NULL; device = device->next) {
+        NMDeviceInfo *device_info = device->data;
+        GError *error = NULL;
+
+        if (device_info->type != NM_DEVICE_TYPE_WIFI)
+            continue;
+
+        /* NetworkManager refuses scans that come too soon after the last one */
+        if (!nm_interface_request_scan(popup->nm_interface, device_info->path, &error)) {
+            g_debug("Scan on %s not started: %s", device_info->path, error->message);
+            g_error_free(error);
+        }
+    }
+    g_list_free(devices);
+
+    return G_SOURCE_CONTINUE;
+}
+
 void
 popup_window_show(PopupWindow *popup, GdkRectangle *button_rect)
 {
@@ -133,12 +263,20 @@ popup_window_show(PopupWindow *popup, GdkRectangle *button_rect)
                     button_rect->x, button_rect->y + button_rect->height);
     gtk_widget_show_all(popup->window);
 
-    popup_window_update_networks(popup);
+    /*
+     * Show the last known list right away and refresh it once the window
+     * has been drawn; the refresh is merged into the model in place.
+     */
+    if (popup->populated)
+        gtk_style_context_add_class(gtk_widget_get_style_context(popup->network_list), "nm-stale");
+    popup_window_schedule_refresh(popup);
+
+    /* Optional rescans; whole seconds let the wakeups share timer slots */
+    if (popup->nm_interface && popup->plugin->scan_interval > 0 && !popup->freshness_timer)
+        popup->freshness_timer = g_timeout_add_seconds(popup->plugin->scan_interval,
+                                                       on_freshness_timeout, popup);
 
-    /* Schedule regular updates of the network list */
-    popup->update_timer = g_timeout_add(POPUP_UPDATE_INTERVAL,
-                                        (GSourceFunc)popup_window_update_networks,
-                                        popup);
+    popup_window_update_speed_test(popup);
 }
 
 void
@@ -146,10 +284,10 @@ popup_window_hide(PopupWindow *popup)
 {
     gtk_widget_hide(popup->window);
 
-    if (popup->update_timer)
+    if (popup->freshness_timer)
     {
-        g_source_remove(popup->update_timer);
-        popup->update_timer = 0;
+        g_source_remove(popup->freshness_timer);
+        popup->freshness_timer = 0;
     }
 }
 
@@ -166,78 +304,193 @@ popup_window_toggle(PopupWindow *popup, GdkRectangle *button_rect)
     }
 }
 
+/* Swap the list box for the virtual list and back */
+static void
+popup_window_set_virtual(PopupWindow *popup, gboolean virtual)
+{
+    GtkContainer *scrolled_window = GTK_CONTAINER(popup->scrolled_window);
+
+    if (virtual == (popup->list_view != NULL))
+        return;
+
+    if (virtual) {
+        /* Unbinding drops the list box rows */
+        gtk_list_box_bind_model(GTK_LIST_BOX(popup->network_list), NULL, NULL, NULL, NULL);
+        gtk_container_remove(scrolled_window, popup->list_viewport);
+
+        popup->list_view = network_list_view_new(G_LIST_MODEL(popup->model),
+                                                 create_virtual_row, bind_virtual_row,
+                                                 on_virtual_row_activated, popup);
+        gtk_container_add(scrolled_window, network_list_view_get_widget(popup->list_view));
+    } else {
+        gtk_container_remove(scrolled_window, network_list_view_get_widget(popup->list_view));
+        g_clear_pointer(&popup->list_view, network_list_view_free);
+
+        gtk_container_add(scrolled_window, popup->list_viewport);
+        gtk_list_box_bind_model(GTK_LIST_BOX(popup->network_list), G_LIST_MODEL(popup->model),
+                                create_network_list_item, popup, NULL);
+    }
+}
+
+static void
+popup_window_update_list_mode(PopupWindow *popup)
+{
+    guint n_items = g_list_model_get_n_items(G_LIST_MODEL(popup->model));
+
+    if (!popup->list_view && n_items > POPUP_VIRTUAL_LIST_ENTER)
+        popup_window_set_virtual(popup, TRUE);
+    else if (popup->list_view && n_items < POPUP_VIRTUAL_LIST_LEAVE)
+        popup_window_set_virtual(popup, FALSE);
+}
+
+/* Refresh the model; rows only change where the model reports changes */
 void
 popup_window_update_networks(PopupWindow *popup)
 {
-    GList *devices, *device;
-    GList *access_points, *ap;
-    GtkWidget *list_item;
-    NMDeviceInfo *device_info;
-    gint count = 0;
-    
-    /* Clear existing items */
-    gtk_container_foreach(GTK_CONTAINER(popup->network_list), (GtkCallback)gtk_widget_destroy, NULL);
-    
-    /* Get all devices */
-    devices = nm_interface_get_devices(popup->nm_interface);
-    
-    /* Add header for Wi-Fi networks */
-    if (devices) {
-        GtkWidget *header = gtk_label_new(NULL);
-        gtk_label_set_markup(GTK_LABEL(header), "<b>Wi-Fi Networks</b>");
-        gtk_widget_set_halign(header, GTK_ALIGN_START);
-        gtk_widget_set_margin_start(header, 10);
-        gtk_widget_set_margin_top(header, 5);
-        gtk_widget_set_margin_bottom(header, 5);
-        gtk_container_add(GTK_CONTAINER(popup->network_list), header);
+    if (!popup->nm_interface)
+        return;
+
+    popup->widgets_created = 0;
+
+    network_list_model_refresh(popup->model, popup->nm_interface);
+    popup->populated = TRUE;
+    gtk_style_context_remove_class(gtk_widget_get_style_context(popup->network_list), "nm-stale");
+
+    popup_window_update_list_mode(popup);
+
+    g_debug("Network list refresh moved %u rows", network_list_model_get_n_moves(popup->model));
+    if (popup->list_view)
+        g_debug("Network list refresh: %u networks, %u rows realized, %u binds so far",
+                network_list_model_get_n_entries(popup->model),
+                network_list_view_get_n_realized(popup->list_view),
+                network_list_view_get_n_binds(popup->list_view));
+    else
+        g_debug("Network list refresh created %u widgets for %u networks",
+                popup->widgets_created, network_list_model_get_n_entries(popup->model));
+
+    g_debug("Icon cache: %u hits, %u misses",
+            icon_cache_get_hits(popup->icon_cache), icon_cache_get_misses(popup->icon_cache));
+    if (popup->row_pool_hits + popup->row_pool_misses > 0)
+        g_debug("Row pool: %u hits, %u misses (%.0f%% hit rate), %u parked, peak %u",
+                popup->row_pool_hits, popup->row_pool_misses,
+                100.0 * popup->row_pool_hits / (popup->row_pool_hits + popup->row_pool_misses),
+                popup->row_pool->len, popup->row_pool_peak);
+}
+
+static gboolean
+on_frame_tick(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+    PopupWindow *popup = (PopupWindow *)user_data;
+    PopupDirtyFlags dirty = popup->dirty;
+    GHashTableIter iter;
+    gpointer network_row;
+
+    g_debug("Frame %" G_GINT64_FORMAT ": applying %u queued updates",
+            gdk_frame_clock_get_frame_counter(frame_clock), popup->updates_queued);
+
+    /* The refresh marks the rows whose entries changed; they go below */
+    if (dirty & POPUP_DIRTY_NETWORKS)
+        popup_window_update_networks(popup);
+
+    g_hash_table_iter_init(&iter, popup->dirty_rows);
+    while (g_hash_table_iter_next(&iter, &network_row, NULL))
+        update_network_list_item(network_row);
+    g_hash_table_remove_all(popup->dirty_rows);
+
+    /* Cleared last so the refresh above does not queue another frame */
+    popup->tick_callback = 0;
+    popup->dirty = 0;
+    popup->updates_queued = 0;
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Record what needs updating and apply it all in the update phase of the
+ * next frame. Nothing runs while the window is unmapped; the work waits
+ * for the popup to be shown again.
+ */
+static void
+popup_window_queue_update(PopupWindow *popup, PopupDirtyFlags flags)
+{
+    popup->dirty |= flags;
+    popup->updates_queued++;
+
+    /* Right after showing, the refresh idle queues again once drawn */
+    if (popup->tick_callback || popup->refresh_idle || !gtk_widget_get_mapped(popup->window))
+        return;
+
+    popup->tick_callback = gtk_widget_add_tick_callback(popup->window, on_frame_tick, popup, NULL);
+}
+
+static void
+on_window_unmap(GtkWidget *widget, PopupWindow *popup)
+{
+    if (popup->tick_callback) {
+        gtk_widget_remove_tick_callback(popup->window, popup->tick_callback);
+        popup->tick_callback = 0;
     }
-    
-    for (device = devices; device != NULL; device = device->next) {
-        device_info = (NMDeviceInfo *)device->data;
-        
-        if (device_info->type == NM_DEVICE_TYPE_WIFI) {
-            /* Get all access points for Wi-Fi device */
-            access_points = nm_interface_get_access_points(popup->nm_interface, device_info->interface);
-            
-            for (ap = access_points; ap != NULL; ap = ap->next) {
-                NMAccessPointInfo *ap_info = (NMAccessPointInfo *)ap->data;
-                
-                if (ap_info && ap_info->ssid) {
-                    /* Check if this network should be shown based on filter */
-                    if (popup->filter_text && *popup->filter_text &&
-                        !g_strstr_len(ap_info->ssid, -1, popup->filter_text)) {
-                        continue;
-                    }
-                    
-                    gboolean is_secure = (g_strcmp0(ap_info->security, "None") != 0);
-                    list_item = create_network_list_item(ap_info->ssid, 
-                                                       ap_info->strength,
-                                                       is_secure, 
-                                                       FALSE);
-                    
-                    /* Store AP info for connection */
-                    g_object_set_data_full(G_OBJECT(list_item), "ap-info", 
-                                         ap_info, (GDestroyNotify)nm_interface_free_ap_info);
-                    g_object_set_data_full(G_OBJECT(list_item), "device-path", 
-                                         g_strdup(device_info->interface), g_free);
-                    gtk_container_add(GTK_CONTAINER(popup->network_list), list_item);
-                }
-            }
-            
-            g_list_free_full(access_points, g_free);
-        }
-        
-        /* Also show Ethernet connections */
-        if (device_info->type == NM_DEVICE_TYPE_ETHERNET && device_info->state == 100) {
-            list_item = create_network_list_item("Wired Connection", 100, FALSE, TRUE);
-            gtk_container_add(GTK_CONTAINER(popup->network_list), list_item);
-        }
+}
+
+static gboolean
+on_refresh_idle(gpointer user_data)
+{
+    PopupWindow *popup = (PopupWindow *)user_data;
+
+    popup->refresh_idle = 0;
+    popup_window_queue_update(popup, POPUP_DIRTY_NETWORKS);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Low priority, so a pending redraw of the window goes first */
+static void
+popup_window_schedule_refresh(PopupWindow *popup)
+{
+    if (!popup->refresh_idle)
+        popup->refresh_idle = g_idle_add_full(G_PRIORITY_LOW, on_refresh_idle, popup, NULL);
+}
+
+/* Bursts of NetworkManager signals collapse into one refresh per frame */
+static void
+on_nm_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data)
+{
+    popup_window_queue_update((PopupWindow *)user_data, POPUP_DIRTY_NETWORKS);
+}
+
+/* Fill the model before the popup is first shown */
+void
+popup_window_prewarm(PopupWindow *popup)
+{
+    if (!popup->populated)
+        popup_window_update_networks(popup);
+}
+
+/* "Wi-Fi Networks" goes above the first Wi-Fi row */
+static void
+network_list_header_func(GtkListBoxRow *row, GtkListBoxRow *before, gpointer user_data)
+{
+    NetworkRow *network_row = g_object_get_data(G_OBJECT(row), "network-row");
+    NetworkRow *before_row = before ? g_object_get_data(G_OBJECT(before), "network-row") : NULL;
+    GtkWidget *header;
+
+    if (network_entry_get_kind(network_row->entry) != NETWORK_ENTRY_WIFI ||
+        (before_row && network_entry_get_kind(before_row->entry) == NETWORK_ENTRY_WIFI)) {
+        gtk_list_box_row_set_header(row, NULL);
+        return;
     }
-    
-    g_list_free(devices);
-    
-    /* Show all items */
-    gtk_widget_show_all(popup->network_list);
+
+    if (gtk_list_box_row_get_header(row))
+        return;
+
+    header = gtk_label_new(NULL);
+    gtk_label_set_markup(GTK_LABEL(header), "<b>Wi-Fi Networks</b>");
+    gtk_widget_set_halign(header, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(header, 10);
+    gtk_widget_set_margin_top(header, 5);
+    gtk_widget_set_margin_bottom(header, 5);
+    gtk_widget_show(header);
+    gtk_list_box_row_set_header(row, header);
 }
 
 void
@@ -260,15 +513,156 @@ popup_window_set_transparency(PopupWindow *popup, gint transparency)
     gtk_widget_set_opacity(popup->window, (100.0 - transparency) / 100.0);
 }
 
-/* Create a network list item widget */
-static GtkWidget *
-create_network_list_item(const gchar *ssid, gint strength, gboolean is_secure, gboolean is_connected)
+static const gchar *
+network_status_icon_name(gboolean is_secure, gboolean is_connected)
 {
+    if (is_connected)
+        return "network-wireless-connected-symbolic";
+    if (is_secure)
+        return "network-wireless-encrypted-symbolic";
+    return "network-wireless-symbolic";
+}
+
+static const gchar *
+network_signal_icon_name(gint strength)
+{
+    if (strength >= 80)
+        return "network-wireless-signal-excellent-symbolic";
+    if (strength >= 60)
+        return "network-wireless-signal-good-symbolic";
+    if (strength >= 40)
+        return "network-wireless-signal-ok-symbolic";
+    if (strength >= 20)
+        return "network-wireless-signal-weak-symbolic";
+    return "network-wireless-signal-none-symbolic";
+}
+
+
+static void
+network_row_unbind(NetworkRow *network_row)
+{
+    g_hash_table_remove(network_row->popup->dirty_rows, network_row);
+    if (network_row->entry) {
+        g_signal_handler_disconnect(network_row->entry, network_row->changed_handler);
+        g_clear_object(&network_row->entry);
+    }
+}
+
+static void
+network_row_free(NetworkRow *network_row)
+{
+    network_row_unbind(network_row);
+    gtk_widget_destroy(network_row->content);
+    g_object_unref(network_row->content);
+    g_free(network_row);
+}
+
+static void
+on_network_entry_changed(NetworkEntry *entry, NetworkRow *network_row)
+{
+    g_hash_table_add(network_row->popup->dirty_rows, network_row);
+    popup_window_queue_update(network_row->popup, POPUP_DIRTY_ROWS);
+}
+
+/* One line per BSSID: address, band, channel and signal */
+static void
+fill_bssid_list(NetworkRow *network_row)
+{
+    GPtrArray *bssids;
+    GList *children, *l;
+    guint i;
+
+    children = gtk_container_get_children(GTK_CONTAINER(network_row->bssid_box));
+    for (l = children; l != NULL; l = l->next)
+        gtk_widget_destroy(GTK_WIDGET(l->data));
+    g_list_free(children);
+
+    bssids = network_entry_get_bssids(network_row->entry);
+    for (i = 0; i < bssids->len; i++) {
+        const NMAccessPointInfo *ap_info = g_ptr_array_index(bssids, i);
+        const gchar *band = nm_interface_ap_band(ap_info->frequency);
+        guint channel = nm_interface_ap_channel(ap_info->frequency);
+        GtkWidget *label;
+        gchar *text;
+
+        if (band && channel)
+            text = g_strdup_printf("%s  %s, channel %u  %u%%",
+                                   ap_info->bssid ? ap_info->bssid : "?", band, channel, ap_info->strength);
+        else
+            text = g_strdup_printf("%s  %u%%",
+                                   ap_info->bssid ? ap_info->bssid : "?", ap_info->strength);
+
+        label = gtk_label_new(text);
+        gtk_widget_set_halign(label, GTK_ALIGN_START);
+        gtk_style_context_add_class(gtk_widget_get_style_context(label), "dim-label");
+        gtk_box_pack_start(GTK_BOX(network_row->bssid_box), label, FALSE, FALSE, 0);
+        gtk_widget_show(label);
+        g_free(text);
+    }
+    g_ptr_array_unref(bssids);
+}
+
+static void
+on_count_button_toggled(GtkToggleButton *button, NetworkRow *network_row)
+{
+    gboolean expanded = gtk_toggle_button_get_active(button);
+
+    /* The list is only built while it is visible */
+    if (expanded)
+        fill_bssid_list(network_row);
+    gtk_revealer_set_reveal_child(GTK_REVEALER(network_row->revealer), expanded);
+}
+
+static void
+update_count_button(NetworkRow *network_row)
+{
+    guint n_bssids = network_entry_get_n_bssids(network_row->entry);
+    gchar *text;
+
+    gtk_widget_set_visible(network_row->count_button, n_bssids > 1);
+    if (n_bssids <= 1)
+        return;
+
+    text = g_strdup_printf("%u", n_bssids);
+    if (g_strcmp0(gtk_button_get_label(GTK_BUTTON(network_row->count_button)), text) != 0)
+        gtk_button_set_label(GTK_BUTTON(network_row->count_button), text);
+    g_free(text);
+}
+
+/* Point a row at another entry; entries that change later update it in place */
+static void
+network_row_bind(NetworkRow *network_row, NetworkEntry *entry)
+{
+    if (network_row->entry == entry)
+        return;
+    
+    network_row_unbind(network_row);
+    network_row->entry = g_object_ref(entry);
+    network_row->changed_handler = g_signal_connect(entry, "changed",
+                                                    G_CALLBACK(on_network_entry_changed), network_row);
+    update_network_list_item(network_row);
+}
+
+static void
+count_widget(GtkWidget *widget, gpointer user_data)
+{
+    guint *n_widgets = user_data;
+
+    (*n_widgets)++;
+    if (GTK_IS_CONTAINER(widget))
+        gtk_container_forall(GTK_CONTAINER(widget), count_widget, n_widgets);
+}
+
+/* Build the widgets of a row, not yet bound to an entry */
+static NetworkRow *
+network_row_new(PopupWindow *popup)
+{
+    NetworkRow *network_row;
+    GtkWidget *outer_box;
     GtkWidget *box;
-    GtkWidget *name_label;
-    GtkWidget *icon;
-    GtkWidget *signal_icon;
-    gchar *icon_name;
+    
+    network_row = g_new0(NetworkRow, 1);
+    network_row->popup = popup;
     
     /* Create horizontal box for the item */
     box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
@@ -278,62 +672,217 @@ create_network_list_item(const gchar *ssid, gint strength, gboolean is_secure, g
     gtk_widget_set_margin_bottom(box, 5);
     
     /* Connection status icon */
-    if (is_connected) {
-        icon = gtk_image_new_from_icon_name("network-wireless-connected-symbolic", GTK_ICON_SIZE_MENU);
-    } else if (is_secure) {
-        icon = gtk_image_new_from_icon_name("network-wireless-encrypted-symbolic", GTK_ICON_SIZE_MENU);
-    } else {
-        icon = gtk_image_new_from_icon_name("network-wireless-symbolic", GTK_ICON_SIZE_MENU);
-    }
-    gtk_box_pack_start(GTK_BOX(box), icon, FALSE, FALSE, 0);
+    network_row->status_icon = gtk_image_new();
+    gtk_box_pack_start(GTK_BOX(box), network_row->status_icon, FALSE, FALSE, 0);
     
     /* Network name */
-    name_label = gtk_label_new(ssid);
-    gtk_widget_set_halign(name_label, GTK_ALIGN_START);
-    gtk_label_set_ellipsize(GTK_LABEL(name_label), PANGO_ELLIPSIZE_END);
-    gtk_box_pack_start(GTK_BOX(box), name_label, TRUE, TRUE, 0);
+    network_row->name_label = gtk_label_new(NULL);
+    gtk_widget_set_halign(network_row->name_label, GTK_ALIGN_START);
+    gtk_label_set_ellipsize(GTK_LABEL(network_row->name_label), PANGO_ELLIPSIZE_END);
+    gtk_box_pack_start(GTK_BOX(box), network_row->name_label, TRUE, TRUE, 0);
     
     /* Signal strength icon */
-    if (strength >= 80) {
-        icon_name = "network-wireless-signal-excellent-symbolic";
-    } else if (strength >= 60) {
-        icon_name = "network-wireless-signal-good-symbolic";
-    } else if (strength >= 40) {
-        icon_name = "network-wireless-signal-ok-symbolic";
-    } else if (strength >= 20) {
-        icon_name = "network-wireless-signal-weak-symbolic";
+    network_row->signal_icon = gtk_image_new();
+    gtk_box_pack_end(GTK_BOX(box), network_row->signal_icon, FALSE, FALSE, 0);
+    
+    /* Number of BSSIDs, shown when there is more than one */
+    network_row->count_button = gtk_toggle_button_new();
+    gtk_button_set_relief(GTK_BUTTON(network_row->count_button), GTK_RELIEF_NONE);
+    gtk_widget_set_no_show_all(network_row->count_button, TRUE);
+    gtk_box_pack_end(GTK_BOX(box), network_row->count_button, FALSE, FALSE, 0);
+    g_signal_connect(network_row->count_button, "toggled",
+                     G_CALLBACK(on_count_button_toggled), network_row);
+    
+    /* The individual BSSIDs */
+    network_row->bssid_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+    gtk_widget_set_margin_start(network_row->bssid_box, 36);
+    gtk_widget_set_margin_bottom(network_row->bssid_box, 5);
+    network_row->revealer = gtk_revealer_new();
+    gtk_container_add(GTK_CONTAINER(network_row->revealer), network_row->bssid_box);
+    
+    outer_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_pack_start(GTK_BOX(outer_box), box, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(outer_box), network_row->revealer, FALSE, FALSE, 0);
+    
+    network_row->content = g_object_ref_sink(outer_box);
+    gtk_widget_show_all(network_row->content);
+    
+    /* Whatever the layout above, every widget of the row is new */
+    count_widget(network_row->content, &popup->widgets_created);
+    
+    return network_row;
+}
+
+/* Back to the state of a new row, ready for the pool */
+static void
+network_row_reset(NetworkRow *network_row)
+{
+    network_row_unbind(network_row);
+    
+    network_row->fixed_height = FALSE;
+    gtk_widget_set_sensitive(network_row->count_button, TRUE);
+    
+    /* Collapse without an animation, nobody is looking */
+    gtk_revealer_set_transition_type(GTK_REVEALER(network_row->revealer), GTK_REVEALER_TRANSITION_TYPE_NONE);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(network_row->count_button), FALSE);
+    gtk_revealer_set_transition_type(GTK_REVEALER(network_row->revealer), GTK_REVEALER_TRANSITION_TYPE_SLIDE_DOWN);
+}
+
+/* The row is going away: keep its content for the next one */
+static void
+on_network_row_destroy(GtkWidget *row, NetworkRow *network_row)
+{
+    PopupWindow *popup = network_row->popup;
+    
+    g_object_set_data(G_OBJECT(row), "network-row", NULL);
+    gtk_container_remove(GTK_CONTAINER(row), network_row->content);
+    network_row->row = NULL;
+    network_row_reset(network_row);
+    
+    if (popup->row_pool->len >= POPUP_ROW_POOL_MAX) {
+        network_row_free(network_row);
+        return;
+    }
+    
+    g_ptr_array_add(popup->row_pool, network_row);
+    popup->row_pool_peak = MAX(popup->row_pool_peak, popup->row_pool->len);
+}
+
+/* A parked row if there is one, a new one otherwise, in a new list box row */
+static NetworkRow *
+network_row_obtain(PopupWindow *popup)
+{
+    NetworkRow *network_row;
+    
+    if (popup->row_pool->len > 0) {
+        network_row = g_ptr_array_remove_index_fast(popup->row_pool, popup->row_pool->len - 1);
+        popup->row_pool_hits++;
     } else {
-        icon_name = "network-wireless-signal-none-symbolic";
+        network_row = network_row_new(popup);
+        popup->row_pool_misses++;
     }
-    signal_icon = gtk_image_new_from_icon_name(icon_name, GTK_ICON_SIZE_MENU);
-    gtk_box_pack_end(GTK_BOX(box), signal_icon, FALSE, FALSE, 0);
     
-    return box;
+    network_row->row = gtk_list_box_row_new();
+    gtk_container_add(GTK_CONTAINER(network_row->row), network_row->content);
+    g_object_set_data(G_OBJECT(network_row->row), "network-row", network_row);
+    g_signal_connect(network_row->row, "destroy",
+                     G_CALLBACK(on_network_row_destroy), network_row);
+    gtk_widget_show(network_row->row);
+    popup->widgets_created++;
+    
+    return network_row;
+}
+
+/* Create the list box row for a model entry */
+static GtkWidget *
+create_network_list_item(gpointer item, gpointer user_data)
+{
+    NetworkRow *network_row = network_row_obtain((PopupWindow *)user_data);
+    
+    network_row_bind(network_row, NETWORK_ENTRY(item));
+    
+    return network_row->row;
+}
+
+/* Rows of the virtual list all have one height, so they do not expand */
+static GtkWidget *
+create_virtual_row(gpointer user_data)
+{
+    NetworkRow *network_row = network_row_obtain((PopupWindow *)user_data);
+    
+    network_row->fixed_height = TRUE;
+    gtk_widget_set_sensitive(network_row->count_button, FALSE);
+    
+    return network_row->row;
+}
+
+static void
+bind_virtual_row(GtkWidget *row, gpointer item, gpointer user_data)
+{
+    network_row_bind(g_object_get_data(G_OBJECT(row), "network-row"), NETWORK_ENTRY(item));
+}
+
+static void
+on_virtual_row_activated(gpointer item, gpointer user_data)
+{
+    popup_window_activate_entry((PopupWindow *)user_data, NETWORK_ENTRY(item));
+}
+
+/* Update an existing row, touching only what changed */
+static void
+update_network_list_item(NetworkRow *network_row)
+{
+    NetworkEntry *entry = network_row->entry;
+    
+    if (g_strcmp0(gtk_label_get_text(GTK_LABEL(network_row->name_label)), network_entry_get_name(entry)) != 0)
+        gtk_label_set_text(GTK_LABEL(network_row->name_label), network_entry_get_name(entry));
+    
+    icon_cache_set_image(network_row->popup->icon_cache, network_row->status_icon,
+                         network_status_icon_name(network_entry_get_secure(entry),
+                                                  network_entry_get_connected(entry)),
+                         GTK_ICON_SIZE_MENU);
+    icon_cache_set_image(network_row->popup->icon_cache, network_row->signal_icon,
+                         network_signal_icon_name(network_entry_get_strength(entry)),
+                         GTK_ICON_SIZE_MENU);
+    
+    update_count_button(network_row);
+    if (!network_row->fixed_height && gtk_revealer_get_reveal_child(GTK_REVEALER(network_row->revealer)))
+        fill_bssid_list(network_row);
+}
+
+static void
+update_row_icons(GtkWidget *row, gpointer user_data)
+{
+    NetworkRow *network_row = g_object_get_data(G_OBJECT(row), "network-row");
+    
+    if (network_row && network_row->entry)
+        update_network_list_item(network_row);
+}
+
+/* The theme, scale or colors changed: every shown row needs new icons */
+static void
+on_icon_cache_invalidated(gpointer user_data)
+{
+    PopupWindow *popup = (PopupWindow *)user_data;
+    
+    if (popup->list_view)
+        gtk_container_foreach(GTK_CONTAINER(network_list_view_get_widget(popup->list_view)),
+                              update_row_icons, NULL);
+    else
+        gtk_container_foreach(GTK_CONTAINER(popup->network_list), update_row_icons, NULL);
 }
 
 /* Network item click handler */
 static void
 on_network_item_clicked(GtkListBoxRow *row, gpointer user_data)
 {
-    PopupWindow *popup = (PopupWindow *)user_data;
-    GtkWidget *child;
+    NetworkRow *network_row = g_object_get_data(G_OBJECT(row), "network-row");
+    
+    if (network_row)
+        popup_window_activate_entry((PopupWindow *)user_data, network_row->entry);
+}
+
+/* Connect to the network of an entry, asking for credentials if needed */
+static void
+popup_window_activate_entry(PopupWindow *popup, NetworkEntry *entry)
+{
     NMAccessPointInfo *ap_info;
-    const gchar *device_path;
+    gchar *device_path;
     GError *error = NULL;
     
-    child = gtk_bin_get_child(GTK_BIN(row));
-    ap_info = g_object_get_data(G_OBJECT(child), "ap-info");
-    device_path = g_object_get_data(G_OBJECT(child), "device-path");
+    if (popup->connecting) {
+        g_message("Connection attempt already in progress. Please wait...");
+        return;
+    }
+    
+    /* Dialogs below run a main loop, so refreshes may replace the entry's data */
+    ap_info = network_entry_dup_ap_info(entry);
+    device_path = g_strdup(network_entry_get_device_path(entry));
     
     if (ap_info && ap_info->ssid) {
         /* Check if we have an existing connection for this SSID */
         NMConnectionInfo *existing_conn = nm_interface_find_connection_by_ssid(popup->nm_interface, ap_info->ssid);
         
-        if (popup->connecting) {
-            g_message("Connection attempt already in progress. Please wait...");
-            return;
-        }
-        
         start_loading_spinner(popup);
         popup->connecting_to_ssid = g_strdup(ap_info->ssid);
         
@@ -390,6 +939,9 @@ on_network_item_clicked(GtkListBoxRow *row, gpointer user_data)
         g_free(popup->connecting_to_ssid);
         popup->connecting_to_ssid = NULL;
     }
+    
+    nm_interface_free_ap_info(ap_info);
+    g_free(device_path);
 }
 
 static void
@@ -445,6 +997,110 @@ on_search_changed(GtkSearchEntry *entry, PopupWindow *popup)
     text = gtk_entry_get_text(GTK_ENTRY(entry));
     popup->filter_text = g_strdup(text);
     
-    /* Update the network list with the new filter */
-    popup_window_update_networks(popup);
+    /* Only the cached entries are searched; NetworkManager is not asked */
+    network_list_model_set_filter(popup->model, popup->filter_text);
+    popup_window_update_list_mode(popup);
+}
+
+static void
+popup_window_show_speed_result(PopupWindow *popup, const SpeedTestResult *result)
+{
+    gchar *goodput = utils_format_bandwidth(result->goodput);
+    gchar *text = g_strdup_printf("%s/s, RTT %.1f ms \xc2\xb1 %.1f ms", goodput, result->rtt, result->jitter);
+
+    gtk_label_set_text(GTK_LABEL(popup->speed_test_label), text);
+    g_free(text);
+    g_free(goodput);
+}
+
+/* The last result of the primary connection, unless a test is running */
+static void
+popup_window_update_speed_test(PopupWindow *popup)
+{
+    NMActiveConnectionInfo *primary = NULL;
+    SpeedTestResult result;
+
+    if (!popup->speed_test_label || (popup->speed_test && speed_test_is_running(popup->speed_test)))
+        return;
+
+    if (popup->nm_interface)
+        primary = nm_interface_get_primary_connection(popup->nm_interface);
+
+    gtk_widget_set_sensitive(popup->speed_test_button, primary != NULL);
+    if (primary && speed_test_load_result(NULL, primary->uuid, &result))
+        popup_window_show_speed_result(popup, &result);
+    else
+        gtk_label_set_text(GTK_LABEL(popup->speed_test_label), "");
+}
+
+static void
+on_speed_test_done(SpeedTest *test, const SpeedTestResult *result, const GError *error, gpointer user_data)
+{
+    PopupWindow *popup = user_data;
+    GError *save_error = NULL;
+
+    gtk_widget_set_sensitive(popup->speed_test_button, TRUE);
+
+    if (!result) {
+        gtk_label_set_text(GTK_LABEL(popup->speed_test_label), error->message);
+        return;
+    }
+
+    popup_window_show_speed_result(popup, result);
+
+    if (!speed_test_save_result(NULL, popup->speed_test_uuid, popup->plugin->speed_test_endpoint,
+                                result, &save_error)) {
+        g_warning("Failed to save speed test result: %s", save_error->message);
+        g_error_free(save_error);
+    }
+}
+
+static void
+on_speed_test_clicked(GtkButton *button, PopupWindow *popup)
+{
+    NMActiveConnectionInfo *primary = NULL;
+    GError *error = NULL;
+
+    if (popup->nm_interface)
+        primary = nm_interface_get_primary_connection(popup->nm_interface);
+    if (!primary || !primary->uuid)
+        return;
+
+    if (!popup->speed_test) {
+        popup->speed_test = speed_test_new(popup->plugin->speed_test_endpoint, &error);
+        if (!popup->speed_test) {
+            gtk_label_set_text(GTK_LABEL(popup->speed_test_label), error->message);
+            g_error_free(error);
+            return;
+        }
+    }
+
+    g_free(popup->speed_test_uuid);
+    popup->speed_test_uuid = g_strdup(primary->uuid);
+
+    gtk_widget_set_sensitive(popup->speed_test_button, FALSE);
+    gtk_label_set_text(GTK_LABEL(popup->speed_test_label), "Testing\xe2\x80\xa6");
+    speed_test_start(popup->speed_test, on_speed_test_done, popup);
+}
+
+/* A button and result line under the network list */
+static void
+popup_window_add_speed_test(PopupWindow *popup)
+{
+    GtkWidget *box;
+
+    box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_style_context_add_class(gtk_widget_get_style_context(box), "nm-speed-test");
+
+    popup->speed_test_button = gtk_button_new_with_label("Test speed");
+    gtk_box_pack_start(GTK_BOX(box), popup->speed_test_button, FALSE, FALSE, 0);
+    g_signal_connect(popup->speed_test_button, "clicked", G_CALLBACK(on_speed_test_clicked), popup);
+
+    popup->speed_test_label = gtk_label_new(NULL);
+    gtk_label_set_ellipsize(GTK_LABEL(popup->speed_test_label), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_halign(popup->speed_test_label, GTK_ALIGN_START);
+    gtk_box_pack_start(GTK_BOX(box), popup->speed_test_label, TRUE, TRUE, 0);
+
+    gtk_box_pack_end(GTK_BOX(popup->main_box), box, FALSE, TRUE, 0);
+    gtk_widget_show_all(box);
 }
@@ -13,8 +13,19 @@
 #include <gtk/gtk.h>
 #include "plugin.h"
 #include "notification.h"
+#include "network-list-model.h"
+#include "network-list-view.h"
+#include "icon-cache.h"
+#include "speed-test.h"
 
 typedef struct _PopupWindow PopupWindow;
+typedef struct _NetworkRow NetworkRow;
+
+/* What the next frame of the popup has to update */
+typedef enum {
+    POPUP_DIRTY_NETWORKS = 1 << 0,  /* refresh the model from NMInterface */
+    POPUP_DIRTY_ROWS     = 1 << 1   /* rows in dirty_rows show stale entries */
+} PopupDirtyFlags;
 
 struct _PopupWindow {
     GtkWidget            *window;
@@ -34,12 +45,40 @@ struct _PopupWindow {
     /* Current filter */
     gchar                *filter_text;
     
-    /* Update timer */
-    guint                 update_timer;
+    /* Networks, shown by network_list or, for long lists, by list_view */
+    NetworkListModel     *model;
+    GtkWidget            *list_viewport;       /* network_list's parent, ref held */
+    NetworkListView      *list_view;
+    IconCache            *icon_cache;
+    
+    /* Parked NetworkRow contents and how well reuse works */
+    GPtrArray            *row_pool;
+    guint                 row_pool_hits;
+    guint                 row_pool_misses;
+    guint                 row_pool_peak;
+    guint                 widgets_created;     /* by the last refresh */
+    guint                 changed_listener;
+    guint                 refresh_idle;
+    gboolean              populated;           /* the model was filled once */
+    
+    /* Work batched until the next frame clock update phase */
+    PopupDirtyFlags       dirty;
+    GHashTable           *dirty_rows;          /* set of NetworkRow */
+    guint                 tick_callback;
+    guint                 updates_queued;
+    
+    /* Rescan timer while shown, if scan_interval is set */
+    guint                 freshness_timer;
     
     /* Connection state */
     gboolean              connecting;
     gchar                *connecting_to_ssid;
+
+    /* Speed test of the primary connection, if speed_test_endpoint is set */
+    GtkWidget            *speed_test_button;
+    GtkWidget            *speed_test_label;
+    SpeedTest            *speed_test;
+    gchar                *speed_test_uuid;     /* connection being tested */
 };
 
 /* Function prototypes */
@@ -51,6 +90,7 @@ void            popup_window_hide              (PopupWindow *popup);
 void            popup_window_toggle            (PopupWindow *popup,
                                                GdkRectangle *button_rect);
 void            popup_window_update_networks   (PopupWindow *popup);
+void            popup_window_prewarm           (PopupWindow *popup);
 void            popup_window_set_transparency  (PopupWindow *popup,
                                                gint transparency);
 
@@ -0,0 +1,806 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "speed-test.h"
+
+/* Reads or writes per main loop dispatch, so a fast link cannot starve the panel */
+#define SPEED_TEST_IO_PER_DISPATCH 16
+
+#define SPEED_TEST_HEADER_END "\r\n\r\n"
+
+#define SPEED_TEST_SERVER_RESPONSE \
+    "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\n\r\n"
+
+typedef enum {
+    SPEED_TEST_IDLE,
+    SPEED_TEST_RESOLVING,
+    SPEED_TEST_PINGING,
+    SPEED_TEST_STREAMING
+} SpeedTestPhase;
+
+struct _SpeedTest {
+    gchar               *endpoint;
+    GSocketConnectable  *connectable;
+    gchar               *request;         /* sent before reading, HTTP only */
+    guint                duration_ms;
+    guint                timeout_ms;
+
+    SpeedTestPhase       phase;
+    SpeedTestCallback    callback;
+    gpointer             user_data;
+    GCancellable        *cancellable;     /* while resolving */
+    GSocketAddressEnumerator *enumerator;
+    GSocketAddress      *address;
+    GError              *connect_error;   /* of the first address that failed */
+
+    GSocket             *socket;
+    GSource             *source;
+    guint                deadline;        /* timeout, then end of streaming */
+    gint64               connect_start;
+
+    gdouble              rtts[SPEED_TEST_PINGS];
+    guint                n_pings;
+
+    gsize                request_sent;
+    gchar                status[12];      /* "HTTP/1.x 2xx", as it arrives */
+    gsize                status_length;
+    gboolean             status_checked;
+    guint                header_matched;  /* characters of SPEED_TEST_HEADER_END seen */
+    gboolean             in_body;
+    guint64              bytes;
+    gint64               stream_start;
+
+    gchar               *buffer;          /* SPEED_TEST_BUFFER_SIZE, reused by every read */
+};
+
+struct _SpeedTestServer {
+    GSocket   *socket;
+    GSource   *source;
+    gboolean   http;
+    guint16    port;
+    GList     *clients;
+    gchar     *buffer;
+};
+
+typedef struct {
+    SpeedTestServer  *server;
+    GSocket          *socket;
+    GSource          *source;
+    guint             header_matched;  /* of the request, HTTP only */
+    gsize             response_sent;   /* of the response header, HTTP only */
+} SpeedTestClient;
+
+/* Advance *matched over data looking for the end of an HTTP header; returns the bytes consumed */
+static gsize
+speed_test_scan_header(const gchar *data, gsize length, guint *matched)
+{
+    gsize i;
+
+    for (i = 0; i < length && *matched < strlen(SPEED_TEST_HEADER_END); i++) {
+        if (data[i] == SPEED_TEST_HEADER_END[*matched])
+            (*matched)++;
+        else
+            *matched = data[i] == '\r' ? 1 : 0;
+    }
+
+    return i;
+}
+
+static void
+speed_test_watch(GSource **source, GSocket *socket, GIOCondition condition,
+                 GSocketSourceFunc func, gpointer user_data)
+{
+    if (*source) {
+        g_source_destroy(*source);
+        g_source_unref(*source);
+    }
+
+    *source = g_socket_create_source(socket, condition, NULL);
+    g_source_set_callback(*source, (GSourceFunc)func, user_data, NULL);
+    g_source_attach(*source, NULL);
+}
+
+static void
+speed_test_close(SpeedTest *test)
+{
+    if (test->source) {
+        g_source_destroy(test->source);
+        g_clear_pointer(&test->source, g_source_unref);
+    }
+
+    if (test->socket) {
+        g_socket_close(test->socket, NULL);
+        g_clear_object(&test->socket);
+    }
+}
+
+/* Back to idle, without calling back */
+static void
+speed_test_reset(SpeedTest *test)
+{
+    if (test->cancellable) {
+        g_cancellable_cancel(test->cancellable);
+        g_clear_object(&test->cancellable);
+    }
+
+    speed_test_close(test);
+    if (test->deadline) {
+        g_source_remove(test->deadline);
+        test->deadline = 0;
+    }
+
+    g_clear_object(&test->enumerator);
+    g_clear_object(&test->address);
+    g_clear_error(&test->connect_error);
+    test->phase = SPEED_TEST_IDLE;
+}
+
+/* The callback may free the test */
+static void
+speed_test_fail(SpeedTest *test, GError *error)
+{
+    speed_test_reset(test);
+    test->callback(test, NULL, error, test->user_data);
+    g_error_free(error);
+}
+
+static void
+speed_test_finish(SpeedTest *test)
+{
+    SpeedTestResult result;
+    gdouble elapsed = (gdouble)(g_get_monotonic_time() - test->stream_start) / G_USEC_PER_SEC;
+    guint i;
+
+    if (test->request && !test->in_body) {
+        speed_test_fail(test, g_error_new(G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                                          "%s closed the connection before sending data", test->endpoint));
+        return;
+    }
+
+    memset(&result, 0, sizeof(result));
+    result.bytes = test->bytes;
+    result.goodput = elapsed > 0 ? test->bytes / elapsed : 0;
+    result.time = g_get_real_time() / G_USEC_PER_SEC;
+
+    for (i = 0; i < test->n_pings; i++) {
+        result.rtt += test->rtts[i] / test->n_pings;
+        if (i > 0)
+            result.jitter += ABS(test->rtts[i] - test->rtts[i - 1]) / (test->n_pings - 1);
+    }
+
+    speed_test_reset(test);
+    test->callback(test, &result, NULL, test->user_data);
+}
+
+static gboolean
+on_deadline(gpointer user_data)
+{
+    SpeedTest *test = user_data;
+
+    test->deadline = 0;
+    speed_test_finish(test);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Resolving and connecting took too long */
+static gboolean
+on_timeout(gpointer user_data)
+{
+    SpeedTest *test = user_data;
+
+    test->deadline = 0;
+    speed_test_fail(test, g_error_new(G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                                      "%s did not answer in time", test->endpoint));
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Count the payload, skipping an HTTP response header */
+static gboolean
+speed_test_count(SpeedTest *test, const gchar *data, gsize length, GError **error)
+{
+    gsize consumed = 0;
+
+    if (test->request && !test->in_body) {
+        /* "HTTP/1.x 2xx ...", which may come in pieces */
+        if (!test->status_checked) {
+            gsize n = MIN(length, sizeof(test->status) - test->status_length);
+
+            memcpy(test->status + test->status_length, data, n);
+            test->status_length += n;
+
+            if (test->status_length == sizeof(test->status)) {
+                if (memcmp(test->status, "HTTP/1.", 7) != 0 || test->status[9] != '2') {
+                    g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                "%s did not answer with a success status", test->endpoint);
+                    return FALSE;
+                }
+                test->status_checked = TRUE;
+            }
+        }
+
+        consumed = speed_test_scan_header(data, length, &test->header_matched);
+        test->in_body = test->header_matched == strlen(SPEED_TEST_HEADER_END);
+
+        if (test->in_body && !test->status_checked) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                        "%s did not answer with a success status", test->endpoint);
+            return FALSE;
+        }
+    }
+
+    test->bytes += length - consumed;
+
+    return TRUE;
+}
+
+static gboolean
+on_readable(GSocket *socket, GIOCondition condition, gpointer user_data)
+{
+    SpeedTest *test = user_data;
+    GError *error = NULL;
+    guint i;
+
+    for (i = 0; i < SPEED_TEST_IO_PER_DISPATCH; i++) {
+        gssize n = g_socket_receive(socket, test->buffer, SPEED_TEST_BUFFER_SIZE, NULL, &error);
+
+        if (n < 0) {
+            if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free(error);
+                return G_SOURCE_CONTINUE;
+            }
+            speed_test_fail(test, error);
+            return G_SOURCE_REMOVE;
+        }
+
+        if (n == 0) {
+            speed_test_finish(test);
+            return G_SOURCE_REMOVE;
+        }
+
+        if (!speed_test_count(test, test->buffer, n, &error)) {
+            speed_test_fail(test, error);
+            return G_SOURCE_REMOVE;
+        }
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+on_writable(GSocket *socket, GIOCondition condition, gpointer user_data)
+{
+    SpeedTest *test = user_data;
+    gsize length = strlen(test->request);
+    GError *error = NULL;
+    gssize n;
+
+    n = g_socket_send(socket, test->request + test->request_sent, length - test->request_sent, NULL, &error);
+    if (n < 0) {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+            g_error_free(error);
+            return G_SOURCE_CONTINUE;
+        }
+        speed_test_fail(test, error);
+        return G_SOURCE_REMOVE;
+    }
+
+    test->request_sent += n;
+    if (test->request_sent < length)
+        return G_SOURCE_CONTINUE;
+
+    speed_test_watch(&test->source, socket, G_IO_IN, on_readable, test);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_connected (GSocket *socket, GIOCondition condition, gpointer user_data);
+static void     on_resolved  (GObject *source_object, GAsyncResult *result, gpointer user_data);
+
+/*
+ * Until one address of the endpoint has answered, a failed connect moves
+ * on to the next one; "localhost" often gives ::1 before 127.0.0.1.
+ */
+static void
+speed_test_try_next(SpeedTest *test, GError *error)
+{
+    if (test->n_pings > 0) {
+        speed_test_fail(test, error);
+        return;
+    }
+
+    g_debug("Speed test connection to %s failed: %s", test->endpoint, error->message);
+    if (test->connect_error)
+        g_error_free(error);
+    else
+        test->connect_error = error;
+
+    speed_test_close(test);
+    g_clear_object(&test->address);
+    test->phase = SPEED_TEST_RESOLVING;
+    test->cancellable = g_cancellable_new();
+    g_socket_address_enumerator_next_async(test->enumerator, test->cancellable, on_resolved, test);
+}
+
+static gboolean
+speed_test_connect(SpeedTest *test, GError **error)
+{
+    GError *local_error = NULL;
+
+    test->socket = g_socket_new(g_socket_address_get_family(test->address), G_SOCKET_TYPE_STREAM,
+                                G_SOCKET_PROTOCOL_TCP, error);
+    if (!test->socket)
+        return FALSE;
+
+    g_socket_set_blocking(test->socket, FALSE);
+
+    test->connect_start = g_get_monotonic_time();
+    if (!g_socket_connect(test->socket, test->address, NULL, &local_error)) {
+        if (!g_error_matches(local_error, G_IO_ERROR, G_IO_ERROR_PENDING)) {
+            g_propagate_error(error, local_error);
+            return FALSE;
+        }
+        g_error_free(local_error);
+    }
+
+    speed_test_watch(&test->source, test->socket, G_IO_OUT, on_connected, test);
+
+    return TRUE;
+}
+
+static gboolean
+on_connected(GSocket *socket, GIOCondition condition, gpointer user_data)
+{
+    SpeedTest *test = user_data;
+    GError *error = NULL;
+    gint64 now = g_get_monotonic_time();
+
+    if (!g_socket_check_connect_result(socket, &error)) {
+        speed_test_try_next(test, error);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* The handshake takes one round trip */
+    if (test->phase == SPEED_TEST_PINGING) {
+        test->rtts[test->n_pings++] = (gdouble)(now - test->connect_start) / 1000;
+        speed_test_close(test);
+
+        if (test->n_pings == SPEED_TEST_PINGS)
+            test->phase = SPEED_TEST_STREAMING;
+        if (!speed_test_connect(test, &error))
+            speed_test_fail(test, error);
+
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Connected; from here the test ends after duration_ms */
+    if (test->deadline)
+        g_source_remove(test->deadline);
+    test->stream_start = now;
+    test->deadline = g_timeout_add(test->duration_ms, on_deadline, test);
+
+    if (test->request)
+        speed_test_watch(&test->source, socket, G_IO_OUT, on_writable, test);
+    else
+        speed_test_watch(&test->source, socket, G_IO_IN, on_readable, test);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_resolved(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    GSocketAddressEnumerator *enumerator = G_SOCKET_ADDRESS_ENUMERATOR(source_object);
+    SpeedTest *test;
+    GSocketAddress *address;
+    GError *error = NULL;
+
+    address = g_socket_address_enumerator_next_finish(enumerator, result, &error);
+
+    /* Cancelled by speed_test_free(); the test is gone */
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        return;
+    }
+
+    test = user_data;
+    g_clear_object(&test->cancellable);
+
+    if (!address) {
+        /* Out of addresses: report why the first one failed */
+        if (!error && test->connect_error)
+            error = g_steal_pointer(&test->connect_error);
+        if (!error)
+            error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No address for %s", test->endpoint);
+        speed_test_fail(test, error);
+        return;
+    }
+
+    test->address = address;
+    test->phase = SPEED_TEST_PINGING;
+    if (!speed_test_connect(test, &error))
+        speed_test_try_next(test, error);
+}
+
+SpeedTest *
+speed_test_new(const gchar *endpoint, GError **error)
+{
+    SpeedTest *test;
+    GSocketConnectable *connectable;
+    const gchar *rest, *path;
+    gchar *host;
+    gboolean http;
+
+    if (g_str_has_prefix(endpoint, "tcp://")) {
+        http = FALSE;
+        rest = endpoint + strlen("tcp://");
+    } else if (g_str_has_prefix(endpoint, "http://")) {
+        http = TRUE;
+        rest = endpoint + strlen("http://");
+    } else {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "Unsupported speed test endpoint %s, use tcp://host:port or http://host/path", endpoint);
+        return NULL;
+    }
+
+    path = strchr(rest, '/');
+    host = path ? g_strndup(rest, path - rest) : g_strdup(rest);
+    if (!*host) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "Speed test endpoint %s has no host", endpoint);
+        g_free(host);
+        return NULL;
+    }
+
+    connectable = g_network_address_parse(host, http ? 80 : 0, error);
+    if (!connectable) {
+        g_free(host);
+        return NULL;
+    }
+
+    if (g_network_address_get_port(G_NETWORK_ADDRESS(connectable)) == 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "Speed test endpoint %s has no port", endpoint);
+        g_object_unref(connectable);
+        g_free(host);
+        return NULL;
+    }
+
+    test = g_new0(SpeedTest, 1);
+    test->endpoint = g_strdup(endpoint);
+    test->connectable = connectable;
+    test->duration_ms = SPEED_TEST_DURATION;
+    test->timeout_ms = SPEED_TEST_TIMEOUT;
+    test->buffer = g_malloc(SPEED_TEST_BUFFER_SIZE);
+
+    /* HTTP/1.0, so the body is neither chunked nor kept alive */
+    if (http)
+        test->request = g_strdup_printf("GET %s HTTP/1.0\r\n"
+                                        "Host: %s\r\n"
+                                        "User-Agent: xfce4-networkmanager-plugin\r\n"
+                                        "\r\n", path ? path : "/", host);
+    g_free(host);
+
+    return test;
+}
+
+/* A running test is cancelled without calling back */
+void
+speed_test_free(SpeedTest *test)
+{
+    if (!test)
+        return;
+
+    speed_test_reset(test);
+    g_object_unref(test->connectable);
+    g_free(test->endpoint);
+    g_free(test->request);
+    g_free(test->buffer);
+    g_free(test);
+}
+
+void
+speed_test_set_duration(SpeedTest *test, guint duration_ms)
+{
+    test->duration_ms = MAX(duration_ms, 1);
+}
+
+void
+speed_test_set_timeout(SpeedTest *test, guint timeout_ms)
+{
+    test->timeout_ms = MAX(timeout_ms, 1);
+}
+
+/*
+ * callback is called once, from the default main context. Resolving and
+ * connecting fail with G_IO_ERROR_TIMED_OUT after the timeout.
+ */
+void
+speed_test_start(SpeedTest *test, SpeedTestCallback callback, gpointer user_data)
+{
+    g_return_if_fail(test->phase == SPEED_TEST_IDLE);
+
+    test->callback = callback;
+    test->user_data = user_data;
+    test->n_pings = 0;
+    test->request_sent = 0;
+    test->status_length = 0;
+    test->status_checked = FALSE;
+    test->header_matched = 0;
+    test->in_body = FALSE;
+    test->bytes = 0;
+
+    test->phase = SPEED_TEST_RESOLVING;
+    test->deadline = g_timeout_add(test->timeout_ms, on_timeout, test);
+    test->cancellable = g_cancellable_new();
+    test->enumerator = g_socket_connectable_enumerate(test->connectable);
+    g_socket_address_enumerator_next_async(test->enumerator, test->cancellable, on_resolved, test);
+}
+
+gboolean
+speed_test_is_running(SpeedTest *test)
+{
+    return test->phase != SPEED_TEST_IDLE;
+}
+
+static gchar *
+speed_test_results_filename(const gchar *filename)
+{
+    if (filename)
+        return g_strdup(filename);
+
+    return g_build_filename(g_get_user_cache_dir(), "xfce4-networkmanager-plugin", "speed-tests.ini", NULL);
+}
+
+/* Replaces the previous result of uuid */
+gboolean
+speed_test_save_result(const gchar *filename, const gchar *uuid, const gchar *endpoint,
+                       const SpeedTestResult *result, GError **error)
+{
+    GKeyFile *key_file;
+    gchar *path, *dirname;
+    gboolean saved;
+
+    path = speed_test_results_filename(filename);
+    key_file = g_key_file_new();
+    g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL);
+
+    g_key_file_set_string(key_file, uuid, "Endpoint", endpoint);
+    g_key_file_set_int64(key_file, uuid, "Time", result->time);
+    g_key_file_set_uint64(key_file, uuid, "Bytes", result->bytes);
+    g_key_file_set_double(key_file, uuid, "Goodput", result->goodput);
+    g_key_file_set_double(key_file, uuid, "Rtt", result->rtt);
+    g_key_file_set_double(key_file, uuid, "Jitter", result->jitter);
+
+    dirname = g_path_get_dirname(path);
+    g_mkdir_with_parents(dirname, 0700);
+    g_free(dirname);
+
+    saved = g_key_file_save_to_file(key_file, path, error);
+
+    g_key_file_free(key_file);
+    g_free(path);
+
+    return saved;
+}
+
+gboolean
+speed_test_load_result(const gchar *filename, const gchar *uuid, SpeedTestResult *result)
+{
+    GKeyFile *key_file;
+    gchar *path;
+    gboolean found = FALSE;
+
+    path = speed_test_results_filename(filename);
+    key_file = g_key_file_new();
+
+    if (uuid && g_key_file_load_from_file(key_file, path, G_KEY_FILE_NONE, NULL) &&
+        g_key_file_has_group(key_file, uuid)) {
+        result->time = g_key_file_get_int64(key_file, uuid, "Time", NULL);
+        result->bytes = g_key_file_get_uint64(key_file, uuid, "Bytes", NULL);
+        result->goodput = g_key_file_get_double(key_file, uuid, "Goodput", NULL);
+        result->rtt = g_key_file_get_double(key_file, uuid, "Rtt", NULL);
+        result->jitter = g_key_file_get_double(key_file, uuid, "Jitter", NULL);
+        found = TRUE;
+    }
+
+    g_key_file_free(key_file);
+    g_free(path);
+
+    return found;
+}
+
+static void
+speed_test_client_close(SpeedTestClient *client)
+{
+    client->server->clients = g_list_remove(client->server->clients, client);
+
+    g_source_destroy(client->source);
+    g_source_unref(client->source);
+    g_socket_close(client->socket, NULL);
+    g_object_unref(client->socket);
+    g_free(client);
+}
+
+/* The response header, then the same buffer until the client goes away */
+static gboolean
+on_client_writable(GSocket *socket, GIOCondition condition, gpointer user_data)
+{
+    SpeedTestClient *client = user_data;
+    SpeedTestServer *server = client->server;
+    gsize response_length = strlen(SPEED_TEST_SERVER_RESPONSE);
+    GError *error = NULL;
+    guint i;
+
+    for (i = 0; i < SPEED_TEST_IO_PER_DISPATCH; i++) {
+        gboolean header = server->http && client->response_sent < response_length;
+        gssize n;
+
+        if (header)
+            n = g_socket_send(socket, SPEED_TEST_SERVER_RESPONSE + client->response_sent,
+                              response_length - client->response_sent, NULL, &error);
+        else
+            n = g_socket_send(socket, server->buffer, SPEED_TEST_BUFFER_SIZE, NULL, &error);
+
+        if (n < 0) {
+            if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+                g_error_free(error);
+                return G_SOURCE_CONTINUE;
+            }
+
+            /* Usually the client closing the connection */
+            g_error_free(error);
+            speed_test_client_close(client);
+            return G_SOURCE_REMOVE;
+        }
+
+        if (header)
+            client->response_sent += n;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Reads an HTTP request up to its blank line; the server's buffer is the payload */
+static gboolean
+on_client_readable(GSocket *socket, GIOCondition condition, gpointer user_data)
+{
+    SpeedTestClient *client = user_data;
+    GError *error = NULL;
+    gchar request[1024];
+
+    for (;;) {
+        gssize n = g_socket_receive(socket, request, sizeof(request), NULL, &error);
+
+        if (n < 0 && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+            g_error_free(error);
+            return G_SOURCE_CONTINUE;
+        }
+
+        /* Closed before asking for anything, as the latency probes do */
+        if (n <= 0) {
+            g_clear_error(&error);
+            speed_test_client_close(client);
+            return G_SOURCE_REMOVE;
+        }
+
+        speed_test_scan_header(request, n, &client->header_matched);
+        if (client->header_matched == strlen(SPEED_TEST_HEADER_END)) {
+            speed_test_watch(&client->source, socket, G_IO_OUT, on_client_writable, client);
+            return G_SOURCE_REMOVE;
+        }
+    }
+}
+
+static gboolean
+on_server_acceptable(GSocket *socket, GIOCondition condition, gpointer user_data)
+{
+    SpeedTestServer *server = user_data;
+
+    for (;;) {
+        SpeedTestClient *client;
+        GError *error = NULL;
+        GSocket *accepted;
+
+        accepted = g_socket_accept(socket, NULL, &error);
+        if (!accepted) {
+            if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+                g_warning("Speed test server failed to accept: %s", error->message);
+            g_error_free(error);
+            return G_SOURCE_CONTINUE;
+        }
+
+        g_socket_set_blocking(accepted, FALSE);
+
+        client = g_new0(SpeedTestClient, 1);
+        client->server = server;
+        client->socket = accepted;
+        server->clients = g_list_prepend(server->clients, client);
+
+        if (server->http)
+            speed_test_watch(&client->source, accepted, G_IO_IN, on_client_readable, client);
+        else
+            speed_test_watch(&client->source, accepted, G_IO_OUT, on_client_writable, client);
+    }
+}
+
+/* Listens on 127.0.0.1 only */
+SpeedTestServer *
+speed_test_server_new(guint16 port, gboolean http, GError **error)
+{
+    SpeedTestServer *server;
+    GSocketAddress *address, *local;
+    GInetAddress *loopback;
+    GSocket *socket;
+
+    socket = g_socket_new(G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, error);
+    if (!socket)
+        return NULL;
+
+    g_socket_set_blocking(socket, FALSE);
+
+    loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    address = g_inet_socket_address_new(loopback, port);
+    g_object_unref(loopback);
+
+    if (!g_socket_bind(socket, address, TRUE, error) || !g_socket_listen(socket, error)) {
+        g_object_unref(address);
+        g_object_unref(socket);
+        return NULL;
+    }
+    g_object_unref(address);
+
+    local = g_socket_get_local_address(socket, error);
+    if (!local) {
+        g_object_unref(socket);
+        return NULL;
+    }
+
+    server = g_new0(SpeedTestServer, 1);
+    server->socket = socket;
+    server->http = http;
+    server->port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(local));
+    server->buffer = g_malloc(SPEED_TEST_BUFFER_SIZE);
+    memset(server->buffer, 'x', SPEED_TEST_BUFFER_SIZE);
+    g_object_unref(local);
+
+    speed_test_watch(&server->source, socket, G_IO_IN, on_server_acceptable, server);
+
+    return server;
+}
+
+void
+speed_test_server_free(SpeedTestServer *server)
+{
+    if (!server)
+        return;
+
+    while (server->clients)
+        speed_test_client_close(server->clients->data);
+
+    g_source_destroy(server->source);
+    g_source_unref(server->source);
+    g_socket_close(server->socket, NULL);
+    g_object_unref(server->socket);
+    g_free(server->buffer);
+    g_free(server);
+}
+
+guint16
+speed_test_server_get_port(SpeedTestServer *server)
+{
+    return server->port;
+}
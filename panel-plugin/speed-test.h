@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __SPEED_TEST_H__
+#define __SPEED_TEST_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Throughput and latency against an endpoint, either "tcp://host:port",
+ * which is read from as soon as it accepts, or "http://host[:port]/path",
+ * whose response body is read. Latency is the time TCP takes to connect,
+ * taken SPEED_TEST_PINGS times; throughput is the payload read in the
+ * following stream. Everything runs on non-blocking GSockets from the
+ * default main context, reading into one large buffer.
+ */
+#define SPEED_TEST_PINGS        5
+#define SPEED_TEST_DURATION     5000          /* milliseconds of streaming */
+#define SPEED_TEST_TIMEOUT      10000         /* milliseconds to resolve and connect */
+#define SPEED_TEST_BUFFER_SIZE  (256 * 1024)
+
+typedef struct {
+    gdouble  goodput;       /* payload bytes per second */
+    gdouble  rtt;           /* mean connect time, in milliseconds */
+    gdouble  jitter;        /* mean change between consecutive connect times */
+    guint64  bytes;         /* payload read */
+    gint64   time;          /* when the test ended, seconds since the epoch */
+} SpeedTestResult;
+
+typedef struct _SpeedTest SpeedTest;
+typedef struct _SpeedTestServer SpeedTestServer;
+
+/* result is NULL if the test failed */
+typedef void (*SpeedTestCallback) (SpeedTest *test,
+                                   const SpeedTestResult *result,
+                                   const GError *error,
+                                   gpointer user_data);
+
+SpeedTest       *speed_test_new             (const gchar *endpoint,
+                                             GError **error);
+void             speed_test_free            (SpeedTest *test);
+void             speed_test_set_duration    (SpeedTest *test,
+                                             guint duration_ms);
+void             speed_test_set_timeout     (SpeedTest *test,
+                                             guint timeout_ms);
+void             speed_test_start           (SpeedTest *test,
+                                             SpeedTestCallback callback,
+                                             gpointer user_data);
+gboolean         speed_test_is_running      (SpeedTest *test);
+
+/* The latest result of each connection UUID; filename NULL for the cache file */
+gboolean         speed_test_save_result     (const gchar *filename,
+                                             const gchar *uuid,
+                                             const gchar *endpoint,
+                                             const SpeedTestResult *result,
+                                             GError **error);
+gboolean         speed_test_load_result     (const gchar *filename,
+                                             const gchar *uuid,
+                                             SpeedTestResult *result);
+
+/* A local endpoint streaming data to everyone who connects; port 0 picks one */
+SpeedTestServer *speed_test_server_new      (guint16 port,
+                                             gboolean http,
+                                             GError **error);
+void             speed_test_server_free     (SpeedTestServer *server);
+guint16          speed_test_server_get_port (SpeedTestServer *server);
+
+G_END_DECLS
+
+#endif /* __SPEED_TEST_H__ */
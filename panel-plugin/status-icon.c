@@ -8,9 +8,467 @@
  */
 
 #ifdef HAVE_CONFIG_H
-#include config.h
+#include <config.h>
 #endif
 
 #include "status-icon.h"
+#include "icon-atlas.h"
+#include "network-sort-policy.h"
 
-/* TODO: Implement status icon management */
+/* Swaps older than this no longer count towards the churn metric */
+#define STATUS_ICON_CHURN_WINDOW (3600 * G_USEC_PER_SEC)
+
+/* Time each frame of the Wi-Fi connecting animation is shown */
+#define STATUS_ICON_FRAME_INTERVAL 300
+
+typedef enum {
+    STATUS_ICON_OFFLINE,
+    STATUS_ICON_WIFI_SIGNAL_NONE,
+    STATUS_ICON_WIFI_SIGNAL_WEAK,
+    STATUS_ICON_WIFI_SIGNAL_OK,
+    STATUS_ICON_WIFI_SIGNAL_GOOD,
+    STATUS_ICON_WIFI_SIGNAL_EXCELLENT,
+    STATUS_ICON_WIFI_ACQUIRING,
+    STATUS_ICON_WIFI_NO_ROUTE,
+    STATUS_ICON_WIRED,
+    STATUS_ICON_WIRED_ACQUIRING,
+    STATUS_ICON_WIRED_NO_ROUTE,
+    STATUS_ICON_CELLULAR,
+    STATUS_ICON_CELLULAR_ACQUIRING,
+    STATUS_ICON_CELLULAR_NO_ROUTE,
+    STATUS_ICON_OTHER,
+    STATUS_ICON_OTHER_NO_ROUTE,
+    STATUS_ICON_N_ICONS
+} StatusIconId;
+
+static const gchar *status_icon_names[STATUS_ICON_N_ICONS] = {
+    "network-offline-symbolic",
+    "network-wireless-signal-none-symbolic",
+    "network-wireless-signal-weak-symbolic",
+    "network-wireless-signal-ok-symbolic",
+    "network-wireless-signal-good-symbolic",
+    "network-wireless-signal-excellent-symbolic",
+    "network-wireless-acquiring-symbolic",
+    "network-wireless-no-route-symbolic",
+    "network-wired-symbolic",
+    "network-wired-acquiring-symbolic",
+    "network-wired-no-route-symbolic",
+    "network-cellular-connected-symbolic",
+    "network-cellular-acquiring-symbolic",
+    "network-cellular-no-route-symbolic",
+    "network-transmit-receive-symbolic",
+    "network-no-route-symbolic"
+};
+
+/* Drawn over the corner of the icon; a VPN wins over an open network */
+typedef enum {
+    STATUS_ICON_EMBLEM_NONE,
+    STATUS_ICON_EMBLEM_OPEN,
+    STATUS_ICON_EMBLEM_VPN,
+    STATUS_ICON_N_EMBLEMS
+} StatusIconEmblem;
+
+static const gchar *status_icon_emblems[STATUS_ICON_N_EMBLEMS] = {
+    NULL,
+    "security-low-symbolic",
+    "network-vpn-symbolic"
+};
+
+struct _StatusIcon {
+    GtkWidget        *image;          /* not owned */
+    NMInterface      *nm_interface;
+    guint             changed_listener;
+
+    /* Every icon and emblem pair, at index id * STATUS_ICON_N_EMBLEMS + emblem */
+    IconAtlas        *atlas;
+
+    StatusIconKey     key;
+    gchar            *device_path;    /* the key's device, for hysteresis */
+    StatusIconId      icon;           /* derived from the key and shown */
+    StatusIconEmblem  emblem;
+    gboolean          shown;          /* icon and emblem are set */
+
+    guint             frame_timer;    /* connecting animation */
+    guint             frame;
+
+    GQueue           *swap_times;     /* monotonic time of each swap, oldest first */
+};
+
+static gboolean
+status_icon_device_activating(NMDeviceState state)
+{
+    return state >= NM_DEVICE_STATE_PREPARE && state < NM_DEVICE_STATE_ACTIVATED;
+}
+
+static StatusIconId
+status_icon_id_for_key(const StatusIconKey *key)
+{
+    gboolean limited = key->connectivity == NM_CONNECTIVITY_NONE ||
+                       key->connectivity == NM_CONNECTIVITY_PORTAL ||
+                       key->connectivity == NM_CONNECTIVITY_LIMITED;
+
+    switch (key->device_type) {
+    case NM_DEVICE_TYPE_WIFI:
+        if (status_icon_device_activating(key->device_state))
+            return STATUS_ICON_WIFI_ACQUIRING;
+        if (key->device_state != NM_DEVICE_STATE_ACTIVATED)
+            break;
+        if (limited)
+            return STATUS_ICON_WIFI_NO_ROUTE;
+        return STATUS_ICON_WIFI_SIGNAL_NONE + MIN(key->bucket, NETWORK_SORT_N_BUCKETS - 1);
+
+    case NM_DEVICE_TYPE_ETHERNET:
+        if (status_icon_device_activating(key->device_state))
+            return STATUS_ICON_WIRED_ACQUIRING;
+        if (key->device_state != NM_DEVICE_STATE_ACTIVATED)
+            break;
+        return limited ? STATUS_ICON_WIRED_NO_ROUTE : STATUS_ICON_WIRED;
+
+    case NM_DEVICE_TYPE_MODEM:
+        if (status_icon_device_activating(key->device_state))
+            return STATUS_ICON_CELLULAR_ACQUIRING;
+        if (key->device_state != NM_DEVICE_STATE_ACTIVATED)
+            break;
+        return limited ? STATUS_ICON_CELLULAR_NO_ROUTE : STATUS_ICON_CELLULAR;
+
+    case NM_DEVICE_TYPE_UNKNOWN:
+        break;
+
+    default:
+        if (key->device_state == NM_DEVICE_STATE_ACTIVATED)
+            return limited ? STATUS_ICON_OTHER_NO_ROUTE : STATUS_ICON_OTHER;
+        break;
+    }
+
+    return STATUS_ICON_OFFLINE;
+}
+
+static StatusIconEmblem
+status_icon_emblem_for_key(const StatusIconKey *key)
+{
+    if (key->device_state != NM_DEVICE_STATE_ACTIVATED)
+        return STATUS_ICON_EMBLEM_NONE;
+    if (key->vpn)
+        return STATUS_ICON_EMBLEM_VPN;
+    if (key->device_type == NM_DEVICE_TYPE_WIFI && !key->secure)
+        return STATUS_ICON_EMBLEM_OPEN;
+
+    return STATUS_ICON_EMBLEM_NONE;
+}
+
+/* The icon name for key; the emblem is drawn on top of it */
+const gchar *
+status_icon_name_for_key(const StatusIconKey *key)
+{
+    return status_icon_names[status_icon_id_for_key(key)];
+}
+
+/* Signal and security of the device's active access point */
+static void
+status_icon_read_active_ap(NMInterface *nm_interface, NMDeviceInfo *device_info,
+                           guint *strength, gboolean *secure)
+{
+    GList *access_points, *ap;
+
+    *strength = 0;
+    *secure = TRUE;
+
+    if (!device_info->specific.wifi.active_ap)
+        return;
+
+    access_points = nm_interface_get_access_points(nm_interface, device_info->path);
+    for (ap = access_points; ap != NULL; ap = ap->next) {
+        NMAccessPointInfo *ap_info = ap->data;
+
+        if (g_strcmp0(ap_info->path, device_info->specific.wifi.active_ap) == 0) {
+            *strength = ap_info->strength;
+            *secure = g_strcmp0(ap_info->security, "None") != 0;
+            break;
+        }
+    }
+    g_list_free_full(access_points, (GDestroyNotify)nm_interface_free_ap_info);
+}
+
+/* The primary connection's device, or else one that is connecting */
+static NMDeviceInfo *
+status_icon_find_device(NMInterface *nm_interface)
+{
+    NMActiveConnectionInfo *primary = nm_interface_get_primary_connection(nm_interface);
+    NMDeviceInfo *found = NULL;
+    GList *devices, *device;
+
+    if (primary && primary->devices && primary->devices[0]) {
+        found = nm_interface_get_device_info(nm_interface, primary->devices[0]);
+        if (found)
+            return found;
+    }
+
+    devices = nm_interface_get_devices(nm_interface);
+    for (device = devices; device != NULL; device = device->next) {
+        NMDeviceInfo *device_info = device->data;
+
+        if (status_icon_device_activating(device_info->state)) {
+            found = device_info;
+            break;
+        }
+    }
+    g_list_free(devices);
+
+    return found;
+}
+
+static gboolean
+status_icon_vpn_active(NMInterface *nm_interface)
+{
+    GList *actives, *l;
+    gboolean vpn = FALSE;
+
+    actives = nm_interface_get_active_connections(nm_interface);
+    for (l = actives; l != NULL; l = l->next) {
+        NMActiveConnectionInfo *active = l->data;
+
+        if ((active->vpn || g_strcmp0(active->type, "wireguard") == 0) &&
+            active->state == NM_ACTIVE_CONNECTION_STATE_ACTIVATED) {
+            vpn = TRUE;
+            break;
+        }
+    }
+    g_list_free(actives);
+
+    return vpn;
+}
+
+/* Rebuild the key from the interface's cached state */
+static void
+status_icon_read_key(StatusIcon *status_icon, NMInterfaceChangeFlags changes)
+{
+    StatusIconKey *key = &status_icon->key;
+    NMDeviceInfo *device_info;
+
+    key->connectivity = nm_interface_get_connectivity(status_icon->nm_interface);
+
+    device_info = status_icon_find_device(status_icon->nm_interface);
+    if (!device_info) {
+        key->device_type = NM_DEVICE_TYPE_UNKNOWN;
+        key->device_state = NM_DEVICE_STATE_UNKNOWN;
+        g_clear_pointer(&status_icon->device_path, g_free);
+    } else {
+        /* A new device, even of the same type, starts from its own signal */
+        gboolean same_device = g_strcmp0(status_icon->device_path, device_info->path) == 0;
+
+        if (!same_device) {
+            g_free(status_icon->device_path);
+            status_icon->device_path = g_strdup(device_info->path);
+        }
+
+        key->device_type = device_info->type;
+        key->device_state = device_info->state;
+
+        /* The kernel reports a pulled cable before NetworkManager does */
+        if (device_info->type == NM_DEVICE_TYPE_ETHERNET &&
+            device_info->link_known && !device_info->link_carrier)
+            key->device_state = NM_DEVICE_STATE_UNAVAILABLE;
+
+        if (device_info->type == NM_DEVICE_TYPE_WIFI &&
+            (!same_device || changes & (NM_INTERFACE_CHANGED_ACCESS_POINTS | NM_INTERFACE_CHANGED_DEVICES))) {
+            guint strength;
+
+            status_icon_read_active_ap(status_icon->nm_interface, device_info, &strength, &key->secure);
+            if (same_device)
+                network_sort_policy_update_bucket(&key->bucket, strength);
+            else
+                key->bucket = network_sort_policy_bucket(strength);
+        }
+    }
+
+    if (changes & NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS)
+        key->vpn = status_icon_vpn_active(status_icon->nm_interface);
+}
+
+static void
+status_icon_expire_swaps(StatusIcon *status_icon, gint64 now)
+{
+    while (!g_queue_is_empty(status_icon->swap_times) &&
+           now - *(gint64 *)g_queue_peek_head(status_icon->swap_times) > STATUS_ICON_CHURN_WINDOW)
+        g_free(g_queue_pop_head(status_icon->swap_times));
+}
+
+static void
+status_icon_count_swap(StatusIcon *status_icon)
+{
+    gint64 *now = g_new(gint64, 1);
+
+    *now = g_get_monotonic_time();
+    g_queue_push_tail(status_icon->swap_times, now);
+    status_icon_expire_swaps(status_icon, *now);
+}
+
+static void
+status_icon_show(StatusIcon *status_icon, StatusIconId icon, StatusIconEmblem emblem)
+{
+    cairo_surface_t *surface = icon_atlas_get(status_icon->atlas, icon * STATUS_ICON_N_EMBLEMS + emblem);
+
+    /* Let GtkImage show the theme's missing-image icon */
+    if (!surface) {
+        gtk_image_set_from_icon_name(GTK_IMAGE(status_icon->image), status_icon_names[icon],
+                                     GTK_ICON_SIZE_MENU);
+        gtk_image_set_pixel_size(GTK_IMAGE(status_icon->image), icon_atlas_get_size(status_icon->atlas));
+        return;
+    }
+
+    gtk_image_set_from_surface(GTK_IMAGE(status_icon->image), surface);
+}
+
+/* The connecting animation sweeps through the signal icons */
+static gboolean
+on_frame_timer(gpointer user_data)
+{
+    StatusIcon *status_icon = (StatusIcon *)user_data;
+
+    status_icon->frame = (status_icon->frame + 1) % NETWORK_SORT_N_BUCKETS;
+    status_icon_show(status_icon, STATUS_ICON_WIFI_SIGNAL_NONE + status_icon->frame,
+                     STATUS_ICON_EMBLEM_NONE);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Put the current icon, or animation frame, into the image */
+static void
+status_icon_show_current(StatusIcon *status_icon)
+{
+    if (status_icon->frame_timer)
+        status_icon_show(status_icon, STATUS_ICON_WIFI_SIGNAL_NONE + status_icon->frame,
+                         STATUS_ICON_EMBLEM_NONE);
+    else
+        status_icon_show(status_icon, status_icon->icon, status_icon->emblem);
+}
+
+/* Show the icon for the current key if it is not the one shown */
+static void
+status_icon_apply(StatusIcon *status_icon)
+{
+    StatusIconId icon = status_icon_id_for_key(&status_icon->key);
+    StatusIconEmblem emblem = status_icon_emblem_for_key(&status_icon->key);
+
+    if (status_icon->shown && icon == status_icon->icon && emblem == status_icon->emblem)
+        return;
+
+    if (icon == STATUS_ICON_WIFI_ACQUIRING && !status_icon->frame_timer) {
+        status_icon->frame = 0;
+        status_icon->frame_timer = g_timeout_add(STATUS_ICON_FRAME_INTERVAL, on_frame_timer, status_icon);
+    } else if (icon != STATUS_ICON_WIFI_ACQUIRING && status_icon->frame_timer) {
+        g_source_remove(status_icon->frame_timer);
+        status_icon->frame_timer = 0;
+    }
+
+    /* The first icon is not a swap */
+    if (status_icon->shown)
+        status_icon_count_swap(status_icon);
+
+    status_icon->icon = icon;
+    status_icon->emblem = emblem;
+    status_icon->shown = TRUE;
+    status_icon_show_current(status_icon);
+
+    g_debug("Status icon: %s%s%s (%u swaps in the last hour)", status_icon_names[icon],
+            status_icon_emblems[emblem] ? " + " : "",
+            status_icon_emblems[emblem] ? status_icon_emblems[emblem] : "",
+            status_icon_get_swaps_per_hour(status_icon));
+}
+
+/* Size or theme changed, the atlas has new surfaces */
+static void
+on_atlas_changed(gpointer user_data)
+{
+    StatusIcon *status_icon = (StatusIcon *)user_data;
+
+    if (status_icon->shown)
+        status_icon_show_current(status_icon);
+}
+
+static void
+on_nm_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data)
+{
+    StatusIcon *status_icon = (StatusIcon *)user_data;
+
+    status_icon_read_key(status_icon, changes);
+    status_icon_apply(status_icon);
+}
+
+/* Without an interface the icon just says offline */
+StatusIcon *
+status_icon_new(GtkWidget *image, NMInterface *nm_interface)
+{
+    StatusIcon *status_icon;
+
+    StatusIconId icon;
+    StatusIconEmblem emblem;
+
+    status_icon = g_new0(StatusIcon, 1);
+    status_icon->image = image;
+    status_icon->nm_interface = nm_interface;
+    status_icon->swap_times = g_queue_new();
+
+    status_icon->atlas = icon_atlas_new(image, on_atlas_changed, status_icon);
+    for (icon = 0; icon < STATUS_ICON_N_ICONS; icon++)
+        for (emblem = 0; emblem < STATUS_ICON_N_EMBLEMS; emblem++)
+            icon_atlas_add(status_icon->atlas, status_icon_names[icon], status_icon_emblems[emblem]);
+
+    if (nm_interface) {
+        status_icon_read_key(status_icon, NM_INTERFACE_CHANGED_ALL);
+        status_icon->changed_listener = nm_interface_add_changed_listener(nm_interface,
+                                                                          NM_INTERFACE_CHANGED_STATE |
+                                                                          NM_INTERFACE_CHANGED_DEVICES |
+                                                                          NM_INTERFACE_CHANGED_ACCESS_POINTS |
+                                                                          NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS,
+                                                                          on_nm_changed, status_icon);
+    }
+    status_icon_apply(status_icon);
+
+    return status_icon;
+}
+
+void
+status_icon_free(StatusIcon *status_icon)
+{
+    if (!status_icon)
+        return;
+
+    if (status_icon->changed_listener)
+        nm_interface_remove_changed_listener(status_icon->nm_interface, status_icon->changed_listener);
+    if (status_icon->frame_timer)
+        g_source_remove(status_icon->frame_timer);
+    icon_atlas_free(status_icon->atlas);
+    g_queue_free_full(status_icon->swap_times, g_free);
+    g_free(status_icon->device_path);
+    g_free(status_icon);
+}
+
+/* Render the icons for a new panel size; the image follows */
+void
+status_icon_set_size(StatusIcon *status_icon, gint pixel_size)
+{
+    icon_atlas_set_size(status_icon->atlas, pixel_size);
+}
+
+const gchar *
+status_icon_get_icon_name(StatusIcon *status_icon)
+{
+    return status_icon->shown ? status_icon_names[status_icon->icon] : NULL;
+}
+
+/* The emblem drawn over the icon, or NULL for none */
+const gchar *
+status_icon_get_emblem_name(StatusIcon *status_icon)
+{
+    return status_icon->shown ? status_icon_emblems[status_icon->emblem] : NULL;
+}
+
+/* Icon changes in the last hour, a measure of how restless the icon is */
+guint
+status_icon_get_swaps_per_hour(StatusIcon *status_icon)
+{
+    status_icon_expire_swaps(status_icon, g_get_monotonic_time());
+
+    return g_queue_get_length(status_icon->swap_times);
+}
@@ -11,10 +11,39 @@
 #define __STATUS_ICON_H__
 
 #include <gtk/gtk.h>
+#include "nm-interface.h"
 
 G_BEGIN_DECLS
 
-/* TODO: Implement status icon management */
+/*
+ * The panel button's icon, derived from NetworkManager's primary
+ * connection and updated from change notifications only. Every variant
+ * is pre-rendered for the panel's icon size, so the image is only handed
+ * another surface, and only when the derived icon differs from the one
+ * shown. A connecting Wi-Fi device animates through the signal icons.
+ */
+typedef struct _StatusIcon StatusIcon;
+
+/* What the icon is derived from */
+typedef struct {
+    NMDeviceType         device_type;   /* of the primary, or activating, device */
+    NMDeviceState        device_state;
+    guint                bucket;        /* Wi-Fi signal bucket, see network-sort-policy.h */
+    gboolean             secure;        /* the Wi-Fi network is not open */
+    NMConnectivityState  connectivity;
+    gboolean             vpn;           /* a VPN connection is up */
+} StatusIconKey;
+
+StatusIcon  *status_icon_new               (GtkWidget *image,
+                                            NMInterface *nm_interface);
+void         status_icon_free              (StatusIcon *status_icon);
+void         status_icon_set_size          (StatusIcon *status_icon,
+                                            gint pixel_size);
+const gchar *status_icon_get_icon_name     (StatusIcon *status_icon);
+const gchar *status_icon_get_emblem_name   (StatusIcon *status_icon);
+guint        status_icon_get_swaps_per_hour (StatusIcon *status_icon);
+
+const gchar *status_icon_name_for_key      (const StatusIconKey *key);
 
 G_END_DECLS
 
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "traffic-label.h"
+#include "utils.h"
+
+struct _TrafficLabel {
+    GtkWidget    *label;          /* not owned */
+    NMInterface  *nm_interface;
+    guint         changed_listener;
+
+    guint         interval;       /* seconds */
+    guint         timer;
+
+    gchar        *interface;      /* device being sampled, NULL for none */
+    gchar        *device_path;
+    gint          rx_fd;
+    gint          tx_fd;
+    gboolean      link_requested; /* a link dump was asked for last tick */
+
+    /* Previous sample, valid if have_sample */
+    gboolean      have_sample;
+    guint64       rx_bytes;
+    guint64       tx_bytes;
+    gint64        sample_time;
+};
+
+gint
+traffic_label_open_counter(const gchar *interface, const gchar *counter)
+{
+    gchar *filename;
+    gint fd;
+
+    if (!interface || strchr(interface, '/'))
+        return -1;
+
+    filename = g_strdup_printf("/sys/class/net/%s/statistics/%s", interface, counter);
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        g_debug("Failed to open %s: %s", filename, g_strerror(errno));
+    g_free(filename);
+
+    return fd;
+}
+
+/* Reads the counter from the start of the file, without allocating */
+gboolean
+traffic_label_read_counter(gint fd, guint64 *value)
+{
+    gchar buffer[32];
+    ssize_t length, i;
+    guint64 result = 0;
+
+    length = pread(fd, buffer, sizeof(buffer), 0);
+    if (length <= 0)
+        return FALSE;
+
+    for (i = 0; i < length && g_ascii_isdigit(buffer[i]); i++)
+        result = result * 10 + (buffer[i] - '0');
+
+    if (i == 0)
+        return FALSE;
+
+    *value = result;
+    return TRUE;
+}
+
+static void
+traffic_label_close(TrafficLabel *traffic_label)
+{
+    if (traffic_label->rx_fd >= 0)
+        close(traffic_label->rx_fd);
+    if (traffic_label->tx_fd >= 0)
+        close(traffic_label->tx_fd);
+
+    traffic_label->rx_fd = -1;
+    traffic_label->tx_fd = -1;
+    traffic_label->have_sample = FALSE;
+    traffic_label->link_requested = FALSE;
+    g_clear_pointer(&traffic_label->interface, g_free);
+    g_clear_pointer(&traffic_label->device_path, g_free);
+}
+
+static void
+traffic_label_set_text(TrafficLabel *traffic_label, const gchar *text)
+{
+    if (g_strcmp0(gtk_label_get_text(GTK_LABEL(traffic_label->label)), text) != 0)
+        gtk_label_set_text(GTK_LABEL(traffic_label->label), text);
+}
+
+/*
+ * With the link monitor on, the counters come from the link dump asked
+ * for on the previous tick, so the sysfs files are not read at all.
+ */
+static gboolean
+traffic_label_read_link(TrafficLabel *traffic_label, guint64 *rx_bytes, guint64 *tx_bytes)
+{
+    NMDeviceInfo *device_info = nm_interface_get_device_info(traffic_label->nm_interface,
+                                                             traffic_label->device_path);
+    gboolean requested = traffic_label->link_requested;
+
+    if (!device_info || !device_info->link_known) {
+        traffic_label->link_requested = FALSE;
+        return FALSE;
+    }
+
+    nm_interface_refresh_links(traffic_label->nm_interface);
+    traffic_label->link_requested = TRUE;
+
+    /* The counters at hand may be from long ago */
+    if (!requested) {
+        traffic_label->have_sample = FALSE;
+        return FALSE;
+    }
+
+    *rx_bytes = device_info->link_rx_bytes;
+    *tx_bytes = device_info->link_tx_bytes;
+    return TRUE;
+}
+
+static void
+traffic_label_sample(TrafficLabel *traffic_label)
+{
+    guint64 rx_bytes, tx_bytes;
+    gint64 now = g_get_monotonic_time();
+    gdouble elapsed;
+
+    if (!traffic_label_read_link(traffic_label, &rx_bytes, &tx_bytes)) {
+        if (traffic_label->link_requested)
+            return;
+
+        if (!traffic_label_read_counter(traffic_label->rx_fd, &rx_bytes) ||
+            !traffic_label_read_counter(traffic_label->tx_fd, &tx_bytes)) {
+            traffic_label->have_sample = FALSE;
+            return;
+        }
+    }
+
+    elapsed = (gdouble)(now - traffic_label->sample_time) / G_USEC_PER_SEC;
+
+    /* Counters go back to zero when the device is reset */
+    if (traffic_label->have_sample && elapsed > 0 &&
+        rx_bytes >= traffic_label->rx_bytes && tx_bytes >= traffic_label->tx_bytes) {
+        gchar *rx = utils_format_bandwidth((rx_bytes - traffic_label->rx_bytes) / elapsed);
+        gchar *tx = utils_format_bandwidth((tx_bytes - traffic_label->tx_bytes) / elapsed);
+        gchar *text = g_strdup_printf("\xe2\x86\x93 %s/s \xe2\x86\x91 %s/s", rx, tx);
+
+        traffic_label_set_text(traffic_label, text);
+        g_free(text);
+        g_free(tx);
+        g_free(rx);
+    }
+
+    traffic_label->rx_bytes = rx_bytes;
+    traffic_label->tx_bytes = tx_bytes;
+    traffic_label->sample_time = now;
+    traffic_label->have_sample = TRUE;
+}
+
+static gboolean
+on_sample_timer(gpointer user_data)
+{
+    traffic_label_sample((TrafficLabel *)user_data);
+
+    return G_SOURCE_CONTINUE;
+}
+
+/* Sample only while there is a device and the label can be seen */
+static void
+traffic_label_update_timer(TrafficLabel *traffic_label)
+{
+    gboolean wanted = traffic_label->interface && gtk_widget_get_mapped(traffic_label->label);
+
+    if (wanted && !traffic_label->timer) {
+        traffic_label->have_sample = FALSE;
+        traffic_label->link_requested = FALSE;
+        traffic_label_sample(traffic_label);
+        traffic_label->timer = g_timeout_add_seconds(traffic_label->interval, on_sample_timer, traffic_label);
+    } else if (!wanted && traffic_label->timer) {
+        g_source_remove(traffic_label->timer);
+        traffic_label->timer = 0;
+    }
+}
+
+/* Follow the primary connection's device */
+static void
+traffic_label_find_device(TrafficLabel *traffic_label)
+{
+    NMActiveConnectionInfo *primary = nm_interface_get_primary_connection(traffic_label->nm_interface);
+    NMDeviceInfo *device_info = NULL;
+
+    if (primary && primary->devices && primary->devices[0])
+        device_info = nm_interface_get_device_info(traffic_label->nm_interface, primary->devices[0]);
+
+    if (device_info ? g_strcmp0(device_info->interface, traffic_label->interface) == 0
+                    : traffic_label->interface == NULL)
+        return;
+
+    traffic_label_close(traffic_label);
+    traffic_label_set_text(traffic_label, "");
+
+    if (device_info && device_info->interface) {
+        traffic_label->rx_fd = traffic_label_open_counter(device_info->interface, "rx_bytes");
+        traffic_label->tx_fd = traffic_label_open_counter(device_info->interface, "tx_bytes");
+
+        if (traffic_label->rx_fd >= 0 && traffic_label->tx_fd >= 0) {
+            traffic_label->interface = g_strdup(device_info->interface);
+            traffic_label->device_path = g_strdup(device_info->path);
+        } else {
+            traffic_label_close(traffic_label);
+        }
+    }
+
+    if (traffic_label->timer) {
+        g_source_remove(traffic_label->timer);
+        traffic_label->timer = 0;
+    }
+    traffic_label_update_timer(traffic_label);
+}
+
+static void
+on_nm_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data)
+{
+    traffic_label_find_device((TrafficLabel *)user_data);
+}
+
+static void
+on_label_map_changed(GtkWidget *widget, TrafficLabel *traffic_label)
+{
+    traffic_label_update_timer(traffic_label);
+}
+
+TrafficLabel *
+traffic_label_new(GtkWidget *label, NMInterface *nm_interface, guint interval)
+{
+    TrafficLabel *traffic_label;
+
+    traffic_label = g_new0(TrafficLabel, 1);
+    traffic_label->label = label;
+    traffic_label->nm_interface = nm_interface;
+    traffic_label->interval = MAX(interval, 1);
+    traffic_label->rx_fd = -1;
+    traffic_label->tx_fd = -1;
+
+    g_signal_connect(label, "map", G_CALLBACK(on_label_map_changed), traffic_label);
+    g_signal_connect(label, "unmap", G_CALLBACK(on_label_map_changed), traffic_label);
+
+    if (nm_interface) {
+        traffic_label->changed_listener = nm_interface_add_changed_listener(nm_interface,
+                                                                            NM_INTERFACE_CHANGED_STATE |
+                                                                            NM_INTERFACE_CHANGED_DEVICES |
+                                                                            NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS,
+                                                                            on_nm_changed, traffic_label);
+        traffic_label_find_device(traffic_label);
+    }
+
+    return traffic_label;
+}
+
+void
+traffic_label_free(TrafficLabel *traffic_label)
+{
+    if (!traffic_label)
+        return;
+
+    if (traffic_label->changed_listener)
+        nm_interface_remove_changed_listener(traffic_label->nm_interface, traffic_label->changed_listener);
+    if (traffic_label->timer)
+        g_source_remove(traffic_label->timer);
+    g_signal_handlers_disconnect_by_data(traffic_label->label, traffic_label);
+    traffic_label_close(traffic_label);
+    g_free(traffic_label);
+}
+
+void
+traffic_label_set_interval(TrafficLabel *traffic_label, guint interval)
+{
+    interval = MAX(interval, 1);
+    if (interval == traffic_label->interval)
+        return;
+
+    traffic_label->interval = interval;
+    if (traffic_label->timer) {
+        g_source_remove(traffic_label->timer);
+        traffic_label->timer = 0;
+        traffic_label_update_timer(traffic_label);
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __TRAFFIC_LABEL_H__
+#define __TRAFFIC_LABEL_H__
+
+#include <gtk/gtk.h>
+#include "nm-interface.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Receive and transmit rates of the primary connection's device, shown in
+ * a label. The kernel's byte counters are kept open and read with pread
+ * every interval, or taken from the link monitor's dumps while it runs,
+ * and sampling stops while the label is not mapped.
+ */
+typedef struct _TrafficLabel TrafficLabel;
+
+TrafficLabel *traffic_label_new          (GtkWidget *label,
+                                          NMInterface *nm_interface,
+                                          guint interval);
+void          traffic_label_free         (TrafficLabel *traffic_label);
+void          traffic_label_set_interval (TrafficLabel *traffic_label,
+                                          guint interval);
+
+/* A statistics counter of an interface, such as rx_bytes; -1 on error */
+gint          traffic_label_open_counter (const gchar *interface,
+                                          const gchar *counter);
+gboolean      traffic_label_read_counter (gint fd,
+                                          guint64 *value);
+
+G_END_DECLS
+
+#endif /* __TRAFFIC_LABEL_H__ */
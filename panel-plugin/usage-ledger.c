@@ -0,0 +1,508 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+#include "usage-ledger.h"
+#include "nm-statistics.h"
+
+#define USAGE_LEDGER_MAGIC    "XNMUSAGE"
+#define USAGE_LEDGER_VERSION  1
+#define USAGE_LEDGER_UUID_MAX 40
+
+/* The file is a header followed by the records, 64 bytes each, in host byte order */
+typedef struct {
+    gchar    magic[8];
+    guint32  version;
+    guint32  n_records;
+    guint8   reserved[48];
+} UsageLedgerHeader;
+
+typedef struct {
+    gchar    uuid[USAGE_LEDGER_UUID_MAX];   /* empty for a free record */
+    guint32  day;
+    guint32  reserved;
+    guint64  rx_bytes;
+    guint64  tx_bytes;
+} UsageLedgerRecord;
+
+typedef struct {
+    UsageLedgerHeader  header;
+    UsageLedgerRecord  records[USAGE_LEDGER_RECORDS];
+} UsageLedgerFile;
+
+G_STATIC_ASSERT(sizeof(UsageLedgerHeader) == 64);
+G_STATIC_ASSERT(sizeof(UsageLedgerRecord) == 64);
+
+/* A device of an active metered connection */
+typedef struct {
+    UsageLedger  *ledger;
+    guint         watch_id;
+    gchar        *uuid;
+
+    /* Previous counters, valid if have_sample */
+    gboolean      have_sample;
+    guint64       rx_bytes;
+    guint64       tx_bytes;
+} UsageLedgerWatch;
+
+struct _UsageLedger {
+    gint              fd;
+    UsageLedgerFile  *file;         /* shared mapping of fd */
+    guint             hint;         /* record written last */
+
+    gboolean          dirty;
+    gint64            last_sync;    /* monotonic */
+    guint             sync_timer;
+    guint             n_syncs;
+
+    NMInterface      *nm_interface;
+    guint             changed_listener;
+    GHashTable       *watches;      /* device path -> UsageLedgerWatch */
+};
+
+static void
+usage_ledger_reset(UsageLedgerFile *file)
+{
+    memset(file, 0, sizeof(*file));
+    memcpy(file->header.magic, USAGE_LEDGER_MAGIC, sizeof(file->header.magic));
+    file->header.version = USAGE_LEDGER_VERSION;
+    file->header.n_records = USAGE_LEDGER_RECORDS;
+}
+
+/* A record whose UUID is not terminated was torn or corrupted; drop it */
+static gboolean
+usage_ledger_check_records(UsageLedgerFile *file)
+{
+    gboolean cleared = FALSE;
+    guint i;
+
+    for (i = 0; i < USAGE_LEDGER_RECORDS; i++) {
+        UsageLedgerRecord *record = &file->records[i];
+
+        if (memchr(record->uuid, '\0', sizeof(record->uuid)) == NULL) {
+            memset(record, 0, sizeof(*record));
+            cleared = TRUE;
+        }
+    }
+
+    return cleared;
+}
+
+/*
+ * Open or create the ledger; filename NULL means usage.ledger in the
+ * plugin's cache directory. A file with another layout starts over empty.
+ * The file is locked, so a second ledger on it fails rather than counting
+ * the same traffic twice.
+ */
+UsageLedger *
+usage_ledger_new(const gchar *filename, GError **error)
+{
+    UsageLedger *ledger;
+    UsageLedgerFile *file;
+    gchar *default_filename = NULL, *dirname;
+    gboolean damaged = FALSE;
+    struct stat st;
+    gint fd, saved_errno;
+
+    if (!filename)
+        filename = default_filename = g_build_filename(g_get_user_cache_dir(), "xfce4-networkmanager-plugin",
+                                                       "usage.ledger", NULL);
+
+    dirname = g_path_get_dirname(filename);
+    g_mkdir_with_parents(dirname, 0700);
+    g_free(dirname);
+
+    fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0)
+        goto error;
+
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        if (errno != EWOULDBLOCK)
+            goto error;
+
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                    "Usage ledger %s is in use by another instance", filename);
+        close(fd);
+        g_free(default_filename);
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0)
+        goto error;
+
+    if (st.st_size != sizeof(UsageLedgerFile) && ftruncate(fd, sizeof(UsageLedgerFile)) < 0)
+        goto error;
+
+    file = mmap(NULL, sizeof(UsageLedgerFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED)
+        goto error;
+
+    if (memcmp(file->header.magic, USAGE_LEDGER_MAGIC, sizeof(file->header.magic)) != 0 ||
+        file->header.version != USAGE_LEDGER_VERSION ||
+        file->header.n_records != USAGE_LEDGER_RECORDS) {
+        if (st.st_size != 0)
+            g_warning("Usage ledger %s has an unknown layout, starting over", filename);
+        usage_ledger_reset(file);
+    } else if (usage_ledger_check_records(file)) {
+        g_warning("Usage ledger %s has damaged records, dropped them", filename);
+        damaged = TRUE;
+    }
+
+    ledger = g_new0(UsageLedger, 1);
+    ledger->fd = fd;
+    ledger->file = file;
+    ledger->last_sync = g_get_monotonic_time();
+    ledger->dirty = damaged;
+    g_free(default_filename);
+
+    return ledger;
+
+error:
+    saved_errno = errno;
+    g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+                "Failed to open usage ledger %s: %s", filename, g_strerror(saved_errno));
+    if (fd >= 0)
+        close(fd);
+    g_free(default_filename);
+
+    return NULL;
+}
+
+void
+usage_ledger_free(UsageLedger *ledger)
+{
+    if (!ledger)
+        return;
+
+    if (ledger->changed_listener)
+        nm_interface_remove_changed_listener(ledger->nm_interface, ledger->changed_listener);
+    g_clear_pointer(&ledger->watches, g_hash_table_destroy);
+
+    usage_ledger_sync(ledger);
+    munmap(ledger->file, sizeof(UsageLedgerFile));
+    close(ledger->fd);
+    g_free(ledger);
+}
+
+/* Write dirty pages back now */
+void
+usage_ledger_sync(UsageLedger *ledger)
+{
+    if (ledger->sync_timer) {
+        g_source_remove(ledger->sync_timer);
+        ledger->sync_timer = 0;
+    }
+
+    if (!ledger->dirty)
+        return;
+
+    if (msync(ledger->file, sizeof(UsageLedgerFile), MS_SYNC) < 0)
+        g_warning("Failed to write usage ledger: %s", g_strerror(errno));
+
+    ledger->dirty = FALSE;
+    ledger->last_sync = g_get_monotonic_time();
+    ledger->n_syncs++;
+}
+
+guint
+usage_ledger_get_n_syncs(UsageLedger *ledger)
+{
+    return ledger->n_syncs;
+}
+
+static gboolean
+on_sync_timer(gpointer user_data)
+{
+    UsageLedger *ledger = user_data;
+
+    ledger->sync_timer = 0;
+    usage_ledger_sync(ledger);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Sync once USAGE_LEDGER_SYNC_INTERVAL has passed since the last sync */
+static void
+usage_ledger_mark_dirty(UsageLedger *ledger)
+{
+    gint64 wait;
+
+    ledger->dirty = TRUE;
+    if (ledger->sync_timer)
+        return;
+
+    wait = ledger->last_sync + USAGE_LEDGER_SYNC_INTERVAL * G_USEC_PER_SEC - g_get_monotonic_time();
+    ledger->sync_timer = g_timeout_add(MAX(wait, 0) / 1000, on_sync_timer, ledger);
+}
+
+/* The record of uuid on day, taking a free one or the oldest day's if it has none */
+static UsageLedgerRecord *
+usage_ledger_claim(UsageLedger *ledger, const gchar *uuid, guint32 day)
+{
+    UsageLedgerRecord *records = ledger->file->records;
+    UsageLedgerRecord *record;
+    guint i, victim = 0;
+    gboolean have_free = FALSE;
+
+    record = &records[ledger->hint];
+    if (record->day == day && strcmp(record->uuid, uuid) == 0)
+        return record;
+
+    for (i = 0; i < USAGE_LEDGER_RECORDS; i++) {
+        record = &records[i];
+
+        if (record->uuid[0] == '\0') {
+            if (!have_free) {
+                victim = i;
+                have_free = TRUE;
+            }
+            continue;
+        }
+
+        if (record->day == day && strcmp(record->uuid, uuid) == 0) {
+            ledger->hint = i;
+            return record;
+        }
+
+        if (!have_free && record->day < records[victim].day)
+            victim = i;
+    }
+
+    record = &records[victim];
+    memset(record, 0, sizeof(*record));
+    g_strlcpy(record->uuid, uuid, sizeof(record->uuid));
+    record->day = day;
+    ledger->hint = victim;
+
+    return record;
+}
+
+void
+usage_ledger_add(UsageLedger *ledger, const gchar *uuid, guint32 day,
+                 guint64 rx_bytes, guint64 tx_bytes)
+{
+    UsageLedgerRecord *record;
+    gchar key[USAGE_LEDGER_UUID_MAX];
+
+    if (!uuid || !*uuid || (rx_bytes == 0 && tx_bytes == 0))
+        return;
+
+    /* Compare as stored */
+    g_strlcpy(key, uuid, sizeof(key));
+
+    record = usage_ledger_claim(ledger, key, day);
+    record->rx_bytes += rx_bytes;
+    record->tx_bytes += tx_bytes;
+
+    usage_ledger_mark_dirty(ledger);
+}
+
+/* Totals of uuid from first_day to last_day, inclusive */
+void
+usage_ledger_get_usage(UsageLedger *ledger, const gchar *uuid, guint32 first_day, guint32 last_day,
+                       guint64 *rx_bytes, guint64 *tx_bytes)
+{
+    gchar key[USAGE_LEDGER_UUID_MAX];
+    guint64 rx = 0, tx = 0;
+    guint i;
+
+    g_strlcpy(key, uuid ? uuid : "", sizeof(key));
+
+    for (i = 0; key[0] && i < USAGE_LEDGER_RECORDS; i++) {
+        const UsageLedgerRecord *record = &ledger->file->records[i];
+
+        if (record->day >= first_day && record->day <= last_day && strcmp(record->uuid, key) == 0) {
+            rx += record->rx_bytes;
+            tx += record->tx_bytes;
+        }
+    }
+
+    if (rx_bytes)
+        *rx_bytes = rx;
+    if (tx_bytes)
+        *tx_bytes = tx;
+}
+
+guint32
+usage_ledger_today(void)
+{
+    GDateTime *now = g_date_time_new_now_local();
+    GDate date;
+
+    g_date_clear(&date, 1);
+    g_date_set_dmy(&date, g_date_time_get_day_of_month(now), g_date_time_get_month(now),
+                   g_date_time_get_year(now));
+    g_date_time_unref(now);
+
+    return g_date_get_julian(&date);
+}
+
+/* Day billing_day of a month, or its last day if it is shorter */
+static guint32
+usage_ledger_period_start(GDateYear year, GDateMonth month, guint billing_day)
+{
+    GDate date;
+
+    g_date_clear(&date, 1);
+    g_date_set_dmy(&date, MIN(billing_day, g_date_get_days_in_month(month, year)), month, year);
+
+    return g_date_get_julian(&date);
+}
+
+/* The billing period containing day, for a plan that renews on billing_day of each month */
+void
+usage_ledger_billing_period(guint32 day, guint billing_day, guint32 *first_day, guint32 *last_day)
+{
+    GDate date;
+    GDateYear year;
+    GDateMonth month;
+    guint32 start;
+
+    billing_day = CLAMP(billing_day, 1, 31);
+
+    g_date_clear(&date, 1);
+    g_date_set_julian(&date, day);
+    year = g_date_get_year(&date);
+    month = g_date_get_month(&date);
+
+    start = usage_ledger_period_start(year, month, billing_day);
+    if (start > day) {
+        /* Still in the period that began last month */
+        if (month == G_DATE_JANUARY) {
+            month = G_DATE_DECEMBER;
+            year--;
+        } else {
+            month--;
+        }
+        start = usage_ledger_period_start(year, month, billing_day);
+    }
+
+    if (month == G_DATE_DECEMBER) {
+        month = G_DATE_JANUARY;
+        year++;
+    } else {
+        month++;
+    }
+
+    *first_day = start;
+    *last_day = usage_ledger_period_start(year, month, billing_day) - 1;
+}
+
+/* Connection types billed by volume */
+gboolean
+usage_ledger_is_metered_type(const gchar *connection_type)
+{
+    return g_strcmp0(connection_type, "gsm") == 0 || g_strcmp0(connection_type, "cdma") == 0;
+}
+
+static void
+usage_ledger_watch_free(UsageLedgerWatch *watch)
+{
+    nm_statistics_unwatch(watch->ledger->nm_interface, watch->watch_id);
+    g_free(watch->uuid);
+    g_free(watch);
+}
+
+static void
+on_statistics_sample(NMInterface *nm_interface, const gchar *device_path,
+                     const NMStatisticsSample *sample, gpointer user_data)
+{
+    UsageLedgerWatch *watch = user_data;
+
+    /* Counters restart from 0 when a device is reset */
+    if (watch->have_sample) {
+        guint64 rx = sample->rx_bytes >= watch->rx_bytes ? sample->rx_bytes - watch->rx_bytes : sample->rx_bytes;
+        guint64 tx = sample->tx_bytes >= watch->tx_bytes ? sample->tx_bytes - watch->tx_bytes : sample->tx_bytes;
+
+        usage_ledger_add(watch->ledger, watch->uuid, usage_ledger_today(), rx, tx);
+    }
+
+    watch->rx_bytes = sample->rx_bytes;
+    watch->tx_bytes = sample->tx_bytes;
+    watch->have_sample = TRUE;
+}
+
+/* Watch the device of every activated metered connection, and nothing else */
+static void
+usage_ledger_update_watches(UsageLedger *ledger)
+{
+    GHashTable *wanted;
+    GHashTableIter iter;
+    GList *actives, *l;
+    gpointer key, value;
+
+    wanted = g_hash_table_new(g_str_hash, g_str_equal);
+
+    actives = nm_interface_get_active_connections(ledger->nm_interface);
+    for (l = actives; l != NULL; l = l->next) {
+        NMActiveConnectionInfo *active = l->data;
+
+        if (active->state == NM_ACTIVE_CONNECTION_STATE_ACTIVATED && active->uuid &&
+            usage_ledger_is_metered_type(active->type) && active->devices && active->devices[0])
+            g_hash_table_insert(wanted, active->devices[0], active->uuid);
+    }
+    g_list_free(actives);
+
+    g_hash_table_iter_init(&iter, ledger->watches);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        UsageLedgerWatch *watch = value;
+
+        if (g_strcmp0(g_hash_table_lookup(wanted, key), watch->uuid) != 0)
+            g_hash_table_iter_remove(&iter);
+    }
+
+    g_hash_table_iter_init(&iter, wanted);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        UsageLedgerWatch *watch;
+
+        if (g_hash_table_contains(ledger->watches, key))
+            continue;
+
+        watch = g_new0(UsageLedgerWatch, 1);
+        watch->ledger = ledger;
+        watch->uuid = g_strdup(value);
+        watch->watch_id = nm_statistics_watch(ledger->nm_interface, key, on_statistics_sample, watch);
+        g_hash_table_insert(ledger->watches, g_strdup(key), watch);
+    }
+
+    g_hash_table_destroy(wanted);
+}
+
+static void
+on_nm_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data)
+{
+    usage_ledger_update_watches((UsageLedger *)user_data);
+}
+
+/* Call once; the ledger must be freed before nm_interface */
+void
+usage_ledger_attach(UsageLedger *ledger, NMInterface *nm_interface)
+{
+    g_return_if_fail(ledger->nm_interface == NULL);
+
+    ledger->nm_interface = nm_interface;
+    ledger->watches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                            (GDestroyNotify)usage_ledger_watch_free);
+    ledger->changed_listener = nm_interface_add_changed_listener(nm_interface,
+                                                                 NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS,
+                                                                 on_nm_changed, ledger);
+    usage_ledger_update_watches(ledger);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __USAGE_LEDGER_H__
+#define __USAGE_LEDGER_H__
+
+#include "nm-interface.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Data used per connection UUID and day, for metered (mobile) connections.
+ * The records have a fixed size and live in a file of fixed length that is
+ * memory-mapped, so updates are plain stores; the file is msync()ed at most
+ * once every USAGE_LEDGER_SYNC_INTERVAL seconds and when the ledger is
+ * freed. When every record is taken the oldest day is reused.
+ */
+
+/* Records in the file; about 64 KiB */
+#define USAGE_LEDGER_RECORDS        1024
+
+#define USAGE_LEDGER_SYNC_INTERVAL  60   /* seconds */
+
+typedef struct _UsageLedger UsageLedger;
+
+UsageLedger *usage_ledger_new             (const gchar *filename,
+                                           GError **error);
+void         usage_ledger_free            (UsageLedger *ledger);
+void         usage_ledger_add             (UsageLedger *ledger,
+                                           const gchar *uuid,
+                                           guint32 day,
+                                           guint64 rx_bytes,
+                                           guint64 tx_bytes);
+void         usage_ledger_sync            (UsageLedger *ledger);
+guint        usage_ledger_get_n_syncs     (UsageLedger *ledger);
+
+/* Days are Julian days in local time, see GDate */
+guint32      usage_ledger_today           (void);
+void         usage_ledger_billing_period  (guint32 day,
+                                           guint billing_day,
+                                           guint32 *first_day,
+                                           guint32 *last_day);
+void         usage_ledger_get_usage       (UsageLedger *ledger,
+                                           const gchar *uuid,
+                                           guint32 first_day,
+                                           guint32 last_day,
+                                           guint64 *rx_bytes,
+                                           guint64 *tx_bytes);
+
+/* Record the traffic of active metered connections from device statistics */
+void         usage_ledger_attach          (UsageLedger *ledger,
+                                           NMInterface *nm_interface);
+gboolean     usage_ledger_is_metered_type (const gchar *connection_type);
+
+G_END_DECLS
+
+#endif /* __USAGE_LEDGER_H__ */
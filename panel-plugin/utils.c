@@ -11,8 +11,29 @@
 #include config.h
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "utils.h"
 
+/* Room for about 30 interfaces; grows when the file does not fit */
+#define UTILS_NET_DEV_BUFFER_SIZE 4096
+
+/* Header lines of /proc/net/dev before the first interface */
+#define UTILS_NET_DEV_HEADER_LINES 2
+
+struct _UtilsNetDevReader {
+    gint        fd;
+    gchar      *buffer;
+    gsize       buffer_size;
+
+    GArray     *interfaces;     /* UtilsNetDevStats in file order */
+    GHashTable *by_ifindex;     /* ifindex -> position + 1 */
+};
+
 gchar *
 utils_format_bandwidth(guint64 bytes)
 {
@@ -51,3 +72,245 @@ utils_program_exists(const gchar *program)
 
     return exists;
 }
+
+UtilsNetDevReader *
+utils_net_dev_reader_new(const gchar *filename, GError **error)
+{
+    UtilsNetDevReader *reader;
+    gint fd;
+
+    if (!filename)
+        filename = "/proc/net/dev";
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        gint saved_errno = errno;
+
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+                    "Failed to open %s: %s", filename, g_strerror(saved_errno));
+        return NULL;
+    }
+
+    reader = g_new0(UtilsNetDevReader, 1);
+    reader->fd = fd;
+    reader->buffer_size = UTILS_NET_DEV_BUFFER_SIZE;
+    reader->buffer = g_malloc(reader->buffer_size);
+    reader->interfaces = g_array_new(FALSE, TRUE, sizeof(UtilsNetDevStats));
+    reader->by_ifindex = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    return reader;
+}
+
+void
+utils_net_dev_reader_free(UtilsNetDevReader *reader)
+{
+    if (!reader)
+        return;
+
+    close(reader->fd);
+    g_free(reader->buffer);
+    g_array_free(reader->interfaces, TRUE);
+    g_hash_table_destroy(reader->by_ifindex);
+    g_free(reader);
+}
+
+/* The whole file into the buffer, NUL-terminated; returns its length or -1 */
+static gssize
+utils_net_dev_reader_read(UtilsNetDevReader *reader, GError **error)
+{
+    gsize length = 0;
+
+    for (;;) {
+        gssize n;
+
+        if (length == reader->buffer_size - 1) {
+            reader->buffer_size *= 2;
+            reader->buffer = g_realloc(reader->buffer, reader->buffer_size);
+        }
+
+        n = pread(reader->fd, reader->buffer + length, reader->buffer_size - 1 - length, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            gint saved_errno = errno;
+
+            g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved_errno),
+                        "Failed to read interface counters: %s", g_strerror(saved_errno));
+            return -1;
+        }
+        if (n == 0)
+            break;
+
+        length += n;
+    }
+
+    reader->buffer[length] = '\0';
+    return length;
+}
+
+static inline const gchar *
+utils_scan_u64(const gchar *p, const gchar *end, guint64 *value)
+{
+    guint64 result = 0;
+
+    while (p < end && *p == ' ')
+        p++;
+    while (p < end && *p >= '0' && *p <= '9')
+        result = result * 10 + (guint64)(*p++ - '0');
+
+    *value = result;
+    return p;
+}
+
+/*
+ * The slot for the interface on the position'th line. Interfaces usually
+ * come in the same order every time, so that slot is checked first; the
+ * table is only reshuffled, or grown, when they do not. A name can come
+ * back with another index, so it is resolved again whenever it moves.
+ */
+static UtilsNetDevStats *
+utils_net_dev_reader_slot(UtilsNetDevReader *reader, guint position,
+                          const gchar *name, gsize name_length, gboolean *reshuffled)
+{
+    UtilsNetDevStats *slot;
+    UtilsNetDevStats moved;
+    guint i;
+
+    name_length = MIN(name_length, UTILS_NET_DEV_NAME_MAX - 1);
+
+    if (position < reader->interfaces->len) {
+        slot = &g_array_index(reader->interfaces, UtilsNetDevStats, position);
+        if (strncmp(slot->name, name, name_length) == 0 && slot->name[name_length] == '\0')
+            return slot;
+    }
+
+    *reshuffled = TRUE;
+
+    for (i = position + 1; i < reader->interfaces->len; i++) {
+        slot = &g_array_index(reader->interfaces, UtilsNetDevStats, i);
+        if (strncmp(slot->name, name, name_length) == 0 && slot->name[name_length] == '\0') {
+            moved = *slot;
+            moved.ifindex = if_nametoindex(moved.name);
+            g_array_remove_index(reader->interfaces, i);
+            g_array_insert_val(reader->interfaces, position, moved);
+            return &g_array_index(reader->interfaces, UtilsNetDevStats, position);
+        }
+    }
+
+    /* A new interface */
+    memset(&moved, 0, sizeof(moved));
+    memcpy(moved.name, name, name_length);
+    moved.ifindex = if_nametoindex(moved.name);
+    g_array_insert_val(reader->interfaces, MIN(position, reader->interfaces->len), moved);
+
+    return &g_array_index(reader->interfaces, UtilsNetDevStats, position);
+}
+
+/* Read and parse the counters of every interface */
+gboolean
+utils_net_dev_reader_update(UtilsNetDevReader *reader, GError **error)
+{
+    const gchar *p, *end, *line_end;
+    gboolean reshuffled = FALSE;
+    guint position = 0, header = 0;
+    gssize length;
+
+    length = utils_net_dev_reader_read(reader, error);
+    if (length < 0)
+        return FALSE;
+
+    p = reader->buffer;
+    end = reader->buffer + length;
+
+    for (; p < end; p = line_end + 1) {
+        const gchar *name, *colon;
+        UtilsNetDevStats *slot;
+        guint64 columns[16];
+        guint i;
+
+        line_end = memchr(p, '\n', end - p);
+        if (!line_end)
+            line_end = end;
+
+        if (header < UTILS_NET_DEV_HEADER_LINES) {
+            header++;
+            continue;
+        }
+
+        /* "  eth0: rx_bytes rx_packets ... tx_bytes tx_packets ..." */
+        name = p;
+        while (name < line_end && *name == ' ')
+            name++;
+        colon = memchr(name, ':', line_end - name);
+        if (!colon || colon == name)
+            continue;
+
+        p = colon + 1;
+        for (i = 0; i < G_N_ELEMENTS(columns); i++)
+            p = utils_scan_u64(p, line_end, &columns[i]);
+
+        slot = utils_net_dev_reader_slot(reader, position++, name, colon - name, &reshuffled);
+
+        /* Counters only go back when the interface was deleted and made again */
+        if (columns[0] < slot->rx_bytes || columns[8] < slot->tx_bytes) {
+            guint ifindex = if_nametoindex(slot->name);
+
+            if (ifindex != slot->ifindex) {
+                slot->ifindex = ifindex;
+                reshuffled = TRUE;
+            }
+        }
+
+        slot->rx_bytes = columns[0];
+        slot->rx_packets = columns[1];
+        slot->tx_bytes = columns[8];
+        slot->tx_packets = columns[9];
+    }
+
+    /* Interfaces not seen this time have drifted to the end */
+    if (position < reader->interfaces->len) {
+        g_array_set_size(reader->interfaces, position);
+        reshuffled = TRUE;
+    }
+
+    if (reshuffled) {
+        guint i;
+
+        g_hash_table_remove_all(reader->by_ifindex);
+        for (i = 0; i < reader->interfaces->len; i++) {
+            guint ifindex = g_array_index(reader->interfaces, UtilsNetDevStats, i).ifindex;
+
+            if (ifindex)
+                g_hash_table_insert(reader->by_ifindex, GUINT_TO_POINTER(ifindex), GUINT_TO_POINTER(i + 1));
+        }
+    }
+
+    return TRUE;
+}
+
+guint
+utils_net_dev_reader_get_n_interfaces(UtilsNetDevReader *reader)
+{
+    return reader->interfaces->len;
+}
+
+/* Valid until the next update */
+const UtilsNetDevStats *
+utils_net_dev_reader_get(UtilsNetDevReader *reader, guint index)
+{
+    g_return_val_if_fail(index < reader->interfaces->len, NULL);
+
+    return &g_array_index(reader->interfaces, UtilsNetDevStats, index);
+}
+
+/* Valid until the next update; NULL if there is no such interface */
+const UtilsNetDevStats *
+utils_net_dev_reader_lookup(UtilsNetDevReader *reader, guint ifindex)
+{
+    guint position = GPOINTER_TO_UINT(g_hash_table_lookup(reader->by_ifindex, GUINT_TO_POINTER(ifindex)));
+
+    if (position == 0)
+        return NULL;
+
+    return &g_array_index(reader->interfaces, UtilsNetDevStats, position - 1);
+}
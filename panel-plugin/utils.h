@@ -19,6 +19,36 @@ gchar    *utils_format_bandwidth     (guint64 bytes);
 gchar    *utils_format_time_span     (guint64 seconds);
 gboolean  utils_program_exists       (const gchar *program);
 
+/*
+ * Counters of every interface from one read of /proc/net/dev. The file is
+ * kept open and read into a buffer reused between updates, and the
+ * columns are parsed in place into a table that only allocates when an
+ * interface appears.
+ */
+#define UTILS_NET_DEV_NAME_MAX 16   /* IFNAMSIZ */
+
+typedef struct {
+    gchar    name[UTILS_NET_DEV_NAME_MAX];
+    guint    ifindex;               /* 0 if the interface is already gone */
+    guint64  rx_bytes;
+    guint64  rx_packets;
+    guint64  tx_bytes;
+    guint64  tx_packets;
+} UtilsNetDevStats;
+
+typedef struct _UtilsNetDevReader UtilsNetDevReader;
+
+UtilsNetDevReader      *utils_net_dev_reader_new      (const gchar *filename,
+                                                       GError **error);
+void                    utils_net_dev_reader_free     (UtilsNetDevReader *reader);
+gboolean                utils_net_dev_reader_update   (UtilsNetDevReader *reader,
+                                                       GError **error);
+guint                   utils_net_dev_reader_get_n_interfaces (UtilsNetDevReader *reader);
+const UtilsNetDevStats *utils_net_dev_reader_get      (UtilsNetDevReader *reader,
+                                                       guint index);
+const UtilsNetDevStats *utils_net_dev_reader_lookup   (UtilsNetDevReader *reader,
+                                                       guint ifindex);
+
 G_END_DECLS
 
 #endif /* __UTILS_H__ */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Cost of one tick of multi-interface counters: a single read and parse of
+ * a /proc/net/dev style file with UtilsNetDevReader, against two pread()s
+ * per interface on kept-open per-counter files, as the traffic label does
+ * with sysfs. Hosts with 1,000 interfaces are rare, so both layouts are
+ * generated in a temporary directory; the numbers measure the syscall count
+ * and parsing, not the kernel's cost of producing the real files.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "traffic-label.h"
+#include "utils.h"
+
+#define TICKS 2000
+
+static const guint sizes[] = { 10, 100, 1000 };
+
+/* Per-counter files need two descriptors per interface */
+static gboolean
+bench_raise_fd_limit(guint needed)
+{
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return FALSE;
+
+    if (limit.rlim_cur < needed) {
+        limit.rlim_cur = MIN(limit.rlim_max, (rlim_t)needed);
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0)
+            return FALSE;
+    }
+
+    return limit.rlim_cur >= needed;
+}
+
+static void
+bench_write_counter(const gchar *dir, const gchar *name, guint64 value)
+{
+    gchar *filename = g_build_filename(dir, name, NULL);
+    gchar *contents = g_strdup_printf("%" G_GUINT64_FORMAT "\n", value);
+
+    g_file_set_contents(filename, contents, -1, NULL);
+    g_free(contents);
+    g_free(filename);
+}
+
+static void
+bench_size(guint n_interfaces)
+{
+    UtilsNetDevReader *reader;
+    GString *net_dev;
+    GError *error = NULL;
+    gchar *dir, *filename;
+    gint *fds;
+    gint64 start, net_dev_us, sysfs_us;
+    guint64 sum = 0, value;
+    guint i, tick;
+
+    if (!bench_raise_fd_limit(2 * n_interfaces + 64)) {
+        g_print("%5u interfaces: skipped, not enough file descriptors\n", n_interfaces);
+        return;
+    }
+
+    dir = g_dir_make_tmp("bench-net-dev-XXXXXX", NULL);
+    g_assert(dir != NULL);
+
+    net_dev = g_string_new("Inter-|   Receive                                                |  Transmit\n"
+                           " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n");
+    fds = g_new(gint, 2 * n_interfaces);
+
+    for (i = 0; i < n_interfaces; i++) {
+        guint64 rx = G_GUINT64_CONSTANT(1000000000) + i * 7919, tx = G_GUINT64_CONSTANT(200000000) + i * 104729;
+        gchar *name = g_strdup_printf("veth%u", i);
+        gchar *if_dir = g_build_filename(dir, name, NULL);
+
+        g_string_append_printf(net_dev,
+                               "%6s: %" G_GUINT64_FORMAT " %u 0 0 0 0 0 0 %" G_GUINT64_FORMAT " %u 0 0 0 0 0 0\n",
+                               name, rx, i * 13, tx, i * 11);
+
+        g_mkdir(if_dir, 0700);
+        bench_write_counter(if_dir, "rx_bytes", rx);
+        bench_write_counter(if_dir, "tx_bytes", tx);
+        g_free(if_dir);
+
+        /* Not under /sys, so open the copies directly */
+        filename = g_build_filename(dir, name, "rx_bytes", NULL);
+        fds[2 * i] = g_open(filename, O_RDONLY, 0);
+        g_free(filename);
+        filename = g_build_filename(dir, name, "tx_bytes", NULL);
+        fds[2 * i + 1] = g_open(filename, O_RDONLY, 0);
+        g_free(filename);
+        g_free(name);
+    }
+
+    filename = g_build_filename(dir, "dev", NULL);
+    g_file_set_contents(filename, net_dev->str, net_dev->len, NULL);
+
+    reader = utils_net_dev_reader_new(filename, &error);
+    g_assert_no_error(error);
+
+    /* The first update fills the table; later ones are the steady state */
+    utils_net_dev_reader_update(reader, NULL);
+    g_assert(utils_net_dev_reader_get_n_interfaces(reader) == n_interfaces);
+
+    start = g_get_monotonic_time();
+    for (tick = 0; tick < TICKS; tick++) {
+        utils_net_dev_reader_update(reader, NULL);
+        for (i = 0; i < n_interfaces; i++)
+            sum += utils_net_dev_reader_get(reader, i)->rx_bytes;
+    }
+    net_dev_us = g_get_monotonic_time() - start;
+
+    start = g_get_monotonic_time();
+    for (tick = 0; tick < TICKS; tick++) {
+        for (i = 0; i < 2 * n_interfaces; i++) {
+            if (traffic_label_read_counter(fds[i], &value))
+                sum += value;
+        }
+    }
+    sysfs_us = g_get_monotonic_time() - start;
+
+    g_print("%5u interfaces: net/dev %9.1f us/tick  per-file %9.1f us/tick  (%.1fx)\n",
+            n_interfaces, (gdouble)net_dev_us / TICKS, (gdouble)sysfs_us / TICKS,
+            net_dev_us ? (gdouble)sysfs_us / net_dev_us : 0.0);
+
+    /* Keep the reads from being optimized away */
+    if (sum == 0)
+        g_print("(no counters read)\n");
+
+    utils_net_dev_reader_free(reader);
+    g_unlink(filename);
+    g_free(filename);
+
+    for (i = 0; i < n_interfaces; i++) {
+        gchar *name = g_strdup_printf("veth%u", i);
+        gchar *if_dir = g_build_filename(dir, name, NULL);
+        gchar *rx = g_build_filename(if_dir, "rx_bytes", NULL);
+        gchar *tx = g_build_filename(if_dir, "tx_bytes", NULL);
+
+        close(fds[2 * i]);
+        close(fds[2 * i + 1]);
+        g_unlink(rx);
+        g_unlink(tx);
+        g_rmdir(if_dir);
+        g_free(tx);
+        g_free(rx);
+        g_free(if_dir);
+        g_free(name);
+    }
+    g_rmdir(dir);
+
+    g_free(fds);
+    g_string_free(net_dev, TRUE);
+    g_free(dir);
+}
+
+int main(int argc, char *argv[])
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(sizes); i++)
+        bench_size(sizes[i]);
+
+    return EXIT_SUCCESS;
+}
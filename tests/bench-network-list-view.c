@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Shows a long network list in a popup-sized window, once with a
+ * GtkListBox bound to the model and once with NetworkListView, and
+ * reports the time to first layout, the row widgets that exist and, for
+ * the virtual list, the binds needed to scroll from top to bottom.
+ */
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+
+#include "network-list-model.h"
+#include "network-list-view.h"
+
+#define N_NETWORKS  500
+#define POPUP_WIDTH 320
+#define POPUP_HEIGHT 400
+#define EXIT_SKIP   77
+
+static NetworkListModel *
+bench_model(void)
+{
+    NetworkListModel *model = network_list_model_new();
+    guint i;
+
+    network_list_model_begin_update(model);
+    for (i = 0; i < N_NETWORKS; i++) {
+        NMAccessPointInfo *ap_info = g_new0(NMAccessPointInfo, 1);
+
+        ap_info->path = g_strdup_printf("/ap/%u", i);
+        ap_info->ssid = g_strdup_printf("Network %04u", i);
+        ap_info->strength = i % 101;
+        ap_info->security = g_strdup(i % 3 ? "WPA2" : "None");
+        network_list_model_add_access_point(model, "/dev/wlan0", ap_info, FALSE);
+    }
+    network_list_model_end_update(model);
+
+    return model;
+}
+
+/* Same shape as a popup row: two icons and a label in a box */
+static GtkWidget *
+bench_create_row(gpointer user_data)
+{
+    GtkWidget *row = gtk_list_box_row_new();
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 10);
+
+    gtk_box_pack_start(GTK_BOX(box), gtk_image_new_from_icon_name("network-wireless-symbolic",
+                                                                  GTK_ICON_SIZE_MENU), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), gtk_label_new(NULL), TRUE, TRUE, 0);
+    gtk_box_pack_end(GTK_BOX(box), gtk_image_new_from_icon_name("network-wireless-signal-good-symbolic",
+                                                                GTK_ICON_SIZE_MENU), FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(row), box);
+    gtk_widget_show_all(row);
+
+    return row;
+}
+
+static void
+bench_bind_row(GtkWidget *row, gpointer item, gpointer user_data)
+{
+    GtkWidget *box = gtk_bin_get_child(GTK_BIN(row));
+    GList *children = gtk_container_get_children(GTK_CONTAINER(box));
+
+    gtk_label_set_text(GTK_LABEL(g_list_nth_data(children, 1)),
+                       network_entry_get_name(NETWORK_ENTRY(item)));
+    g_list_free(children);
+}
+
+static GtkWidget *
+bench_create_list_box_row(gpointer item, gpointer user_data)
+{
+    GtkWidget *row = bench_create_row(user_data);
+
+    bench_bind_row(row, item, user_data);
+    return row;
+}
+
+static void
+bench_activate(gpointer item, gpointer user_data)
+{
+}
+
+static GtkWidget *
+bench_window(GtkWidget **scrolled_window)
+{
+    GtkWidget *window = gtk_offscreen_window_new();
+
+    *scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(*scrolled_window),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_size_request(*scrolled_window, POPUP_WIDTH, POPUP_HEIGHT);
+    gtk_container_add(GTK_CONTAINER(window), *scrolled_window);
+
+    return window;
+}
+
+static void
+bench_flush(void)
+{
+    while (gtk_events_pending())
+        gtk_main_iteration();
+}
+
+static void
+bench_list_box(NetworkListModel *model)
+{
+    GtkWidget *window, *scrolled_window, *list_box;
+    gint64 start, elapsed;
+    GList *rows;
+
+    window = bench_window(&scrolled_window);
+    list_box = gtk_list_box_new();
+    gtk_container_add(GTK_CONTAINER(scrolled_window), list_box);
+
+    start = g_get_monotonic_time();
+    gtk_list_box_bind_model(GTK_LIST_BOX(list_box), G_LIST_MODEL(model),
+                            bench_create_list_box_row, NULL, NULL);
+    gtk_widget_show_all(window);
+    bench_flush();
+    elapsed = g_get_monotonic_time() - start;
+
+    rows = gtk_container_get_children(GTK_CONTAINER(list_box));
+    g_print("list box      first layout %8.2f ms  rows %4u\n",
+            elapsed / 1000.0, g_list_length(rows));
+    g_list_free(rows);
+
+    gtk_widget_destroy(window);
+}
+
+static void
+bench_virtual(NetworkListModel *model)
+{
+    GtkWidget *window, *scrolled_window;
+    NetworkListView *view;
+    GtkAdjustment *vadjustment;
+    gint64 start, elapsed, scroll_elapsed;
+    guint binds_before;
+    gdouble value, upper, page;
+
+    window = bench_window(&scrolled_window);
+    view = network_list_view_new(G_LIST_MODEL(model), bench_create_row, bench_bind_row,
+                                 bench_activate, NULL);
+
+    start = g_get_monotonic_time();
+    gtk_container_add(GTK_CONTAINER(scrolled_window), network_list_view_get_widget(view));
+    gtk_widget_show_all(window);
+    bench_flush();
+    elapsed = g_get_monotonic_time() - start;
+
+    /* Scroll through the whole list a row's worth of pixels at a time */
+    vadjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled_window));
+    upper = gtk_adjustment_get_upper(vadjustment);
+    page = gtk_adjustment_get_page_size(vadjustment);
+    binds_before = network_list_view_get_n_binds(view);
+
+    start = g_get_monotonic_time();
+    for (value = 0; value <= upper - page; value += 16) {
+        gtk_adjustment_set_value(vadjustment, value);
+        bench_flush();
+    }
+    scroll_elapsed = g_get_monotonic_time() - start;
+
+    g_print("virtual list  first layout %8.2f ms  rows %4u  scroll %8.2f ms, %u binds\n",
+            elapsed / 1000.0, network_list_view_get_n_realized(view),
+            scroll_elapsed / 1000.0, network_list_view_get_n_binds(view) - binds_before);
+
+    gtk_container_remove(GTK_CONTAINER(scrolled_window), network_list_view_get_widget(view));
+    network_list_view_free(view);
+    gtk_widget_destroy(window);
+}
+
+int main(int argc, char *argv[])
+{
+    NetworkListModel *model;
+
+    if (!gtk_init_check(&argc, &argv)) {
+        g_printerr("No display, skipping\n");
+        return EXIT_SKIP;
+    }
+
+    model = bench_model();
+    g_print("%u networks in a %dx%d viewport\n", N_NETWORKS, POPUP_WIDTH, POPUP_HEIGHT);
+
+    bench_list_box(model);
+    bench_virtual(model);
+
+    g_object_unref(model);
+
+    return EXIT_SUCCESS;
+}
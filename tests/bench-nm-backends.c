@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Compares the NMInterface backends against the same live NetworkManager:
+ * startup time (new + init), resident memory added by the backend and the
+ * cost of one full refresh (devices, access points and connections, i.e.
+ * what the popup reads every time it redraws its list).
+ *
+ * Each backend runs in its own child process so the RSS figures do not
+ * include the other backend's caches.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "nm-interface.h"
+
+#define REFRESH_ITERATIONS 200
+#define EXIT_SKIP          77
+
+static glong
+bench_rss_kib(void)
+{
+    gchar *contents = NULL;
+    glong pages = 0, resident = 0;
+
+    if (g_file_get_contents("/proc/self/statm", &contents, NULL, NULL)) {
+        sscanf(contents, "%ld %ld", &pages, &resident);
+        g_free(contents);
+    }
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static guint
+bench_refresh(NMInterface *nm_interface)
+{
+    GList *devices, *l;
+    GList *connections;
+    guint n_aps = 0;
+
+    devices = nm_interface_get_devices(nm_interface);
+    for (l = devices; l != NULL; l = l->next) {
+        NMDeviceInfo *device_info = l->data;
+
+        if (device_info->type == NM_DEVICE_TYPE_WIFI) {
+            GList *aps = nm_interface_get_access_points(nm_interface, device_info->path);
+            n_aps += g_list_length(aps);
+            g_list_free_full(aps, (GDestroyNotify)nm_interface_free_ap_info);
+        }
+    }
+    g_list_free(devices);
+
+    connections = nm_interface_get_connections(nm_interface);
+    g_list_free(connections);
+
+    return n_aps;
+}
+
+static int
+bench_backend(const gchar *backend_name)
+{
+    NMInterface *nm_interface;
+    GError *error = NULL;
+    gint64 start, startup_us, refresh_us;
+    glong rss_before, rss_after;
+    guint n_devices, n_aps = 0;
+    GList *devices;
+    guint i;
+
+    rss_before = bench_rss_kib();
+    start = g_get_monotonic_time();
+
+    nm_interface = nm_interface_new_for_backend(backend_name);
+    if (!nm_interface_init(nm_interface, &error)) {
+        g_printerr("%s: NetworkManager not available: %s\n", backend_name, error->message);
+        g_error_free(error);
+        nm_interface_free(nm_interface);
+        return EXIT_SKIP;
+    }
+
+    startup_us = g_get_monotonic_time() - start;
+    rss_after = bench_rss_kib();
+
+    devices = nm_interface_get_devices(nm_interface);
+    n_devices = g_list_length(devices);
+    g_list_free(devices);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < REFRESH_ITERATIONS; i++) {
+        n_aps = bench_refresh(nm_interface);
+    }
+    refresh_us = (g_get_monotonic_time() - start) / REFRESH_ITERATIONS;
+
+    g_print("%-6s startup %8.2f ms  rss %+6ld KiB  refresh %8.1f us  (%u devices, %u APs)\n",
+            backend_name, startup_us / 1000.0, rss_after - rss_before,
+            (gdouble)refresh_us, n_devices, n_aps);
+
+    nm_interface_free(nm_interface);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    const gchar *backends[] = { "dbus", "libnm", NULL };
+    gboolean any_ran = FALSE;
+    guint i;
+
+    if (argc > 1)
+        return bench_backend(argv[1]);
+
+    for (i = 0; backends[i] != NULL; i++) {
+        gchar *child_argv[] = { argv[0], (gchar *)backends[i], NULL };
+        GError *error = NULL;
+        gint status;
+
+        if (!g_spawn_sync(NULL, child_argv, NULL, G_SPAWN_CHILD_INHERITS_STDIN,
+                          NULL, NULL, NULL, NULL, &status, &error)) {
+            g_printerr("Failed to run %s benchmark: %s\n", backends[i], error->message);
+            g_error_free(error);
+            return EXIT_FAILURE;
+        }
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS)
+            any_ran = TRUE;
+    }
+
+    return any_ran ? EXIT_SUCCESS : EXIT_SKIP;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Builds the popup's widget tree and style sheet the old way, from the
+ * source files on disk, and from the compiled-in resource bundle, and
+ * reports the average time of each.
+ */
+
+#include <gtk/gtk.h>
+#include <stdlib.h>
+
+#define N_ROUNDS      50
+#define RESOURCE_PATH "/org/xfce/panel/networkmanager"
+#define EXIT_SKIP     77
+
+typedef gboolean (*LoadFunc) (GtkBuilder *builder, GtkCssProvider *provider, GError **error);
+
+static gboolean
+load_from_files(GtkBuilder *builder, GtkCssProvider *provider, GError **error)
+{
+    return gtk_builder_add_from_file(builder, POPUP_UI_FILE, error) &&
+           gtk_css_provider_load_from_path(provider, STYLE_CSS_FILE, error);
+}
+
+static gboolean
+load_from_resources(GtkBuilder *builder, GtkCssProvider *provider, GError **error)
+{
+    if (!gtk_builder_add_from_resource(builder, RESOURCE_PATH "/popup-window.ui", error))
+        return FALSE;
+
+    gtk_css_provider_load_from_resource(provider, RESOURCE_PATH "/style.css");
+    return TRUE;
+}
+
+static gboolean
+bench_load(const gchar *name, LoadFunc load, guint rounds)
+{
+    gint64 start, elapsed = 0;
+    guint i;
+
+    for (i = 0; i < rounds; i++) {
+        GtkBuilder *builder = gtk_builder_new();
+        GtkCssProvider *provider = gtk_css_provider_new();
+        GError *error = NULL;
+
+        start = g_get_monotonic_time();
+        if (!load(builder, provider, &error)) {
+            g_printerr("%s: %s\n", name, error->message);
+            g_error_free(error);
+            g_object_unref(provider);
+            g_object_unref(builder);
+            return FALSE;
+        }
+        elapsed += g_get_monotonic_time() - start;
+
+        gtk_widget_destroy(GTK_WIDGET(gtk_builder_get_object(builder, "popup_window")));
+        g_object_unref(provider);
+        g_object_unref(builder);
+    }
+
+    if (rounds > 1)
+        g_print("%-10s %8.3f ms per popup\n", name, elapsed / 1000.0 / rounds);
+
+    return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!gtk_init_check(&argc, &argv)) {
+        g_printerr("No display, skipping\n");
+        return EXIT_SKIP;
+    }
+
+    /* One unreported round each so both start with warm caches */
+    if (!bench_load("files", load_from_files, 1) || !bench_load("resources", load_from_resources, 1))
+        return EXIT_FAILURE;
+
+    g_print("UI and style sheet, %d rounds\n", N_ROUNDS);
+    if (!bench_load("files", load_from_files, N_ROUNDS) ||
+        !bench_load("resources", load_from_resources, N_ROUNDS))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * Records NetworkManager state for the mock backend.
+ *
+ *   nm-snapshot dump FILE            write the live state to FILE
+ *   nm-snapshot generate N FILE [SEED]
+ *                                    write a synthetic state with N APs
+ *
+ * Generated states depend only on N and SEED, so profiles can be repeated.
+ *
+ * Load the result into the plugin with XFCE_NM_SNAPSHOT=FILE.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "nm-interface.h"
+
+#define DEFAULT_SEED 20231
+
+static const gchar *security_types[] = { "None", "WEP", "WPA", "WPA2", "WPA3", "802.1X" };
+
+static int
+snapshot_dump(const gchar *filename)
+{
+    NMInterface *nm_interface;
+    GError *error = NULL;
+
+    nm_interface = nm_interface_new();
+    if (!nm_interface_init(nm_interface, &error) ||
+        !nm_interface_save_snapshot(nm_interface, filename, &error)) {
+        g_printerr("Failed to dump NetworkManager state: %s\n", error->message);
+        g_error_free(error);
+        nm_interface_free(nm_interface);
+        return EXIT_FAILURE;
+    }
+
+    nm_interface_free(nm_interface);
+    return EXIT_SUCCESS;
+}
+
+static int
+snapshot_generate(guint n_aps, const gchar *filename, guint32 seed)
+{
+    GRand *rand = g_rand_new_with_seed(seed);
+    GString *contents;
+    GError *error = NULL;
+    guint i;
+
+    contents = g_string_new("[NetworkManager]\n"
+                            "State=70\n"
+                            "Connectivity=4\n"
+                            "WirelessEnabled=true\n"
+                            "NetworkingEnabled=true\n\n"
+                            "[Device /org/freedesktop/NetworkManager/Devices/1]\n"
+                            "Interface=wlan0\n"
+                            "Type=2\n"
+                            "State=30\n"
+                            "Managed=true\n"
+                            "AccessPoints=");
+
+    for (i = 0; i < n_aps; i++)
+        g_string_append_printf(contents, "/org/freedesktop/NetworkManager/AccessPoint/%u;", i);
+    g_string_append(contents, "\n\n");
+
+    for (i = 0; i < n_aps; i++) {
+        g_string_append_printf(contents,
+                               "[AccessPoint /org/freedesktop/NetworkManager/AccessPoint/%u]\n"
+                               "Ssid=Network %u\n"
+                               "Strength=%u\n"
+                               "Security=%s\n"
+                               "Bssid=02:00:00:00:%02x:%02x\n"
+                               "Frequency=%u\n\n",
+                               i, i, g_rand_int_range(rand, 0, 101),
+                               security_types[i % G_N_ELEMENTS(security_types)],
+                               (i >> 8) & 0xff, i & 0xff,
+                               i % 2 ? 5180 + 20 * (i % 8) : 2412 + 25 * (i % 3));
+    }
+    g_rand_free(rand);
+
+    if (!g_file_set_contents(filename, contents->str, contents->len, &error)) {
+        g_printerr("Failed to write %s: %s\n", filename, error->message);
+        g_error_free(error);
+        g_string_free(contents, TRUE);
+        return EXIT_FAILURE;
+    }
+
+    g_string_free(contents, TRUE);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && g_strcmp0(argv[1], "dump") == 0)
+        return snapshot_dump(argv[2]);
+
+    if ((argc == 4 || argc == 5) && g_strcmp0(argv[1], "generate") == 0)
+        return snapshot_generate(atoi(argv[2]), argv[3],
+                                 argc == 5 ? (guint32)strtoul(argv[4], NULL, 10) : DEFAULT_SEED);
+
+    g_printerr("Usage: %s dump FILE\n"
+               "       %s generate N FILE [SEED]\n", argv[0], argv[0]);
+    return EXIT_FAILURE;
+}
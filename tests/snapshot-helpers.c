@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <glib.h>
+#include <unistd.h>
+
+#include "snapshot-helpers.h"
+
+const gchar snapshot_office_wifi[] =
+    "[NetworkManager]\n"
+    "State=70\n"
+    "Connectivity=4\n"
+    "PrimaryConnection=" SNAPSHOT_ACTIVE_PATH "\n"
+    "\n"
+    "[Device " SNAPSHOT_WIFI_DEVICE "]\n"
+    "Interface=nm-test-wlan0\n"
+    "Type=2\n"
+    "State=100\n"
+    "ActiveAccessPoint=/org/freedesktop/NetworkManager/AccessPoint/1\n"
+    "Bitrate=866700\n"
+    "AccessPoints=/org/freedesktop/NetworkManager/AccessPoint/1;\n"
+    "\n"
+    "[AccessPoint /org/freedesktop/NetworkManager/AccessPoint/1]\n"
+    "Ssid=Office & Lab\n"
+    "Strength=72\n"
+    "Security=WPA2\n"
+    "Frequency=5180\n"
+    "\n"
+    "[Connection /org/freedesktop/NetworkManager/Settings/1]\n"
+    "Uuid=6c2b4a6e-5e5d-4c8e-9a43-0a4d1f6f2c11\n"
+    "Id=Office & Lab\n"
+    "Type=802-11-wireless\n"
+    "\n"
+    "[ActiveConnection " SNAPSHOT_ACTIVE_PATH "]\n"
+    "Connection=/org/freedesktop/NetworkManager/Settings/1\n"
+    "Devices=" SNAPSHOT_WIFI_DEVICE ";\n"
+    "State=2\n"
+    "Vpn=false\n";
+
+/* contents in a new temporary file; the caller unlinks and frees the name */
+gchar *
+write_snapshot(const gchar *contents)
+{
+    GError *error = NULL;
+    gchar *filename;
+    gint fd;
+
+    fd = g_file_open_tmp("nm-snapshot-XXXXXX.ini", &filename, &error);
+    g_assert_no_error(error);
+    close(fd);
+
+    g_file_set_contents(filename, contents, -1, &error);
+    g_assert_no_error(error);
+
+    return filename;
+}
+
+NMInterface *
+load_snapshot(const gchar *filename)
+{
+    NMInterface *nm_interface;
+    GError *error = NULL;
+
+    nm_interface = nm_interface_new_for_snapshot(filename);
+    g_assert_cmpstr(nm_interface_get_backend_name(nm_interface), ==, "mock");
+    g_assert_true(nm_interface_init(nm_interface, &error));
+    g_assert_no_error(error);
+
+    return nm_interface;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef __SNAPSHOT_HELPERS_H__
+#define __SNAPSHOT_HELPERS_H__
+
+#include "nm-interface.h"
+
+G_BEGIN_DECLS
+
+/* Mock backend states for the tests, loaded with nm_interface_new_for_snapshot */
+
+#define SNAPSHOT_WIFI_DEVICE "/org/freedesktop/NetworkManager/Devices/2"
+#define SNAPSHOT_ACTIVE_PATH "/org/freedesktop/NetworkManager/ActiveConnection/1"
+
+/* Connected to "Office & Lab" over SNAPSHOT_WIFI_DEVICE at 72% on 5180 MHz, 866.7 Mbit/s */
+extern const gchar snapshot_office_wifi[];
+
+gchar       *write_snapshot (const gchar *contents);
+NMInterface *load_snapshot  (const gchar *filename);
+
+G_END_DECLS
+
+#endif /* __SNAPSHOT_HELPERS_H__ */
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/*
+ * A loopback endpoint for trying the speed test offline.
+ *
+ *   speed-test-server [--http] [PORT]
+ *
+ * Prints the endpoint to put in speed_test_endpoint and streams data to
+ * every client until interrupted.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "speed-test.h"
+
+int main(int argc, char *argv[])
+{
+    SpeedTestServer *server;
+    GMainLoop *loop;
+    GError *error = NULL;
+    gboolean http = FALSE;
+    guint64 port = 0;
+    gchar *end;
+    gint i;
+
+    for (i = 1; i < argc; i++) {
+        if (g_strcmp0(argv[i], "--http") == 0) {
+            http = TRUE;
+            continue;
+        }
+
+        /* Digits only: strtoull would also take signs and blanks */
+        port = g_ascii_strtoull(argv[i], &end, 10);
+        if (!g_ascii_isdigit(argv[i][0]) || *end != '\0' || port > G_MAXUINT16) {
+            g_printerr("Usage: %s [--http] [PORT]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    server = speed_test_server_new(port, http, &error);
+    if (!server) {
+        g_printerr("Failed to start the server: %s\n", error->message);
+        g_error_free(error);
+        return EXIT_FAILURE;
+    }
+
+    if (http)
+        g_print("http://127.0.0.1:%u/\n", speed_test_server_get_port(server));
+    else
+        g_print("tcp://127.0.0.1:%u\n", speed_test_server_get_port(server));
+
+    loop = g_main_loop_new(NULL, FALSE);
+    g_main_loop_run(loop);
+
+    g_main_loop_unref(loop);
+    speed_test_server_free(server);
+
+    return EXIT_SUCCESS;
+}
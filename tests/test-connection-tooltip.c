@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "nm-interface-private.h"
+#include "connection-tooltip.h"
+#include "snapshot-helpers.h"
+
+static gboolean have_display;
+
+static void
+test_markup(void)
+{
+    NMInterface *nm_interface;
+    ConnectionTooltip *tooltip;
+    GtkWidget *button;
+    gchar *filename, *markup;
+
+    if (!have_display) {
+        g_test_skip("No display");
+        return;
+    }
+
+    filename = write_snapshot(snapshot_office_wifi);
+    nm_interface = load_snapshot(filename);
+
+    button = g_object_ref_sink(gtk_button_new());
+    tooltip = connection_tooltip_new(button, nm_interface);
+    g_assert_true(gtk_widget_get_has_tooltip(button));
+
+    /* The name is escaped; the connection was up before we started, so no uptime */
+    markup = connection_tooltip_get_markup(tooltip);
+    g_assert_nonnull(strstr(markup, "<b>Office &amp; Lab</b>"));
+    g_assert_nonnull(strstr(markup, "Device: nm-test-wlan0 (Wi-Fi)"));
+    g_assert_nonnull(strstr(markup, "Signal: 72%"));
+    g_assert_nonnull(strstr(markup, "Bitrate: 866 Mbit/s"));
+    g_assert_null(strstr(markup, "Connected for"));
+    g_assert_true(pango_parse_markup(markup, -1, 0, NULL, NULL, NULL, NULL));
+    g_free(markup);
+
+    /* Coming up again after we started gives an uptime */
+    nm_interface_set_primary_connection(nm_interface, NULL);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+    markup = connection_tooltip_get_markup(tooltip);
+    g_assert_cmpstr(markup, ==, "Not connected");
+    g_free(markup);
+
+    nm_interface_set_primary_connection(nm_interface, SNAPSHOT_ACTIVE_PATH);
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+    markup = connection_tooltip_get_markup(tooltip);
+    g_assert_nonnull(strstr(markup, "Connected for 0 sec"));
+    g_free(markup);
+
+    connection_tooltip_free(tooltip);
+    g_object_unref(button);
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+}
+
+int main(int argc, char *argv[])
+{
+    have_display = gtk_init_check(&argc, &argv);
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/connection-tooltip/markup", test_markup);
+
+    return g_test_run();
+}
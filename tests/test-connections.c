@@ -8,12 +8,205 @@
  */
 
 #include <glib.h>
+#include <string.h>
+
+#include "nm-connection.h"
+#include "connection-types/ethernet.h"
+#include "connection-types/mobile.h"
+#include "connection-types/vpn.h"
+#include "connection-types/wifi.h"
+
+/*
+ * Returns the setting instance stored in the profile (a new reference).
+ * The profile must not have been serialized yet, so that the children are
+ * still the very instances that were added.
+ */
+static GVariant *
+get_setting(GVariant *profile, const gchar *name)
+{
+    gsize i;
+
+    for (i = 0; i < g_variant_n_children(profile); i++) {
+        GVariant *entry = g_variant_get_child_value(profile, i);
+        GVariant *key = g_variant_get_child_value(entry, 0);
+        GVariant *value = NULL;
+
+        if (g_strcmp0(g_variant_get_string(key, NULL), name) == 0)
+            value = g_variant_get_child_value(entry, 1);
+
+        g_variant_unref(key);
+        g_variant_unref(entry);
+
+        if (value)
+            return value;
+    }
+
+    return NULL;
+}
+
+static gchar *
+get_string(GVariant *profile, const gchar *setting_name, const gchar *key)
+{
+    GVariant *setting = get_setting(profile, setting_name);
+    gchar *value = NULL;
+
+    if (setting) {
+        g_variant_lookup(setting, key, "s", &value);
+        g_variant_unref(setting);
+    }
+
+    return value;
+}
+
+static void
+check_common_sections(GVariant *profile, const gchar *type, const gchar *id)
+{
+    GVariant *ipv4, *ipv6;
+    gchar *value;
+
+    g_assert_true(g_variant_is_floating(profile));
+    g_assert_true(g_variant_is_of_type(profile, G_VARIANT_TYPE("a{sa{sv}}")));
+
+    value = get_string(profile, "connection", "type");
+    g_assert_cmpstr(value, ==, type);
+    g_free(value);
+
+    value = get_string(profile, "connection", "id");
+    g_assert_cmpstr(value, ==, id);
+    g_free(value);
+
+    value = get_string(profile, "connection", "uuid");
+    g_assert_nonnull(value);
+    g_assert_cmpuint(strlen(value), ==, 36);
+    g_free(value);
+
+    /* The ip sections are the shared constants, not copies */
+    ipv4 = get_setting(profile, "ipv4");
+    ipv6 = get_setting(profile, "ipv6");
+    g_assert_true(ipv4 == nm_profile_ipv4_auto());
+    g_assert_true(ipv6 == nm_profile_ipv6_auto());
+    g_variant_unref(ipv4);
+    g_variant_unref(ipv6);
+}
+
+static void
+test_profile_types(void)
+{
+    GVariant *profile;
+    gchar *value;
+
+    profile = g_variant_ref_sink(ethernet_create_connection_gvariant("Wired"));
+    check_common_sections(profile, "802-3-ethernet", "Wired");
+    g_variant_unref(profile);
+
+    profile = g_variant_ref_sink(vpn_create_connection_gvariant("Work", "vpn.example.com"));
+    check_common_sections(profile, "vpn", "Work");
+    value = get_string(profile, "vpn", "remote");
+    g_assert_cmpstr(value, ==, "vpn.example.com");
+    g_free(value);
+    g_variant_unref(profile);
+
+    profile = g_variant_ref_sink(mobile_create_connection_gvariant("Mobile", "internet"));
+    check_common_sections(profile, "gsm", "Mobile");
+    value = get_string(profile, "gsm", "apn");
+    g_assert_cmpstr(value, ==, "internet");
+    g_free(value);
+    g_variant_unref(profile);
+}
+
+static void
+test_profile_wifi(void)
+{
+    GVariantBuilder dot1x;
+    GVariant *profile;
+    GVariant *security;
+    gchar *value;
+
+    profile = g_variant_ref_sink(wifi_create_connection_gvariant("Office", "WPA2", "secret"));
+    check_common_sections(profile, "802-11-wireless", "Office");
+    value = get_string(profile, "802-11-wireless-security", "key-mgmt");
+    g_assert_cmpstr(value, ==, "wpa-psk");
+    g_free(value);
+    g_variant_unref(profile);
+
+    /* Open networks carry no security section */
+    profile = g_variant_ref_sink(wifi_create_connection_gvariant("Cafe", "None", NULL));
+    check_common_sections(profile, "802-11-wireless", "Cafe");
+    security = get_setting(profile, "802-11-wireless-security");
+    g_assert_null(security);
+    g_variant_unref(profile);
+
+    g_variant_builder_init(&dot1x, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&dot1x, "{sv}", "identity", g_variant_new_string("user"));
+    profile = g_variant_ref_sink(wifi_create_enterprise_connection_gvariant("Campus",
+                                                                           g_variant_builder_end(&dot1x)));
+    check_common_sections(profile, "802-11-wireless", "Campus");
+    value = get_string(profile, "802-11-wireless-security", "key-mgmt");
+    g_assert_cmpstr(value, ==, "wpa-eap");
+    g_free(value);
+    value = get_string(profile, "802-1x", "identity");
+    g_assert_cmpstr(value, ==, "user");
+    g_free(value);
+    g_variant_unref(profile);
+}
+
+static void
+test_profile_explicit_ip(void)
+{
+    NMProfileBuilder builder;
+    GVariantBuilder ipv4;
+    GVariant *profile;
+    gchar *value;
+
+    nm_profile_builder_init(&builder, "802-3-ethernet", "Static");
+    g_variant_builder_init(&ipv4, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&ipv4, "{sv}", "method", g_variant_new_string("manual"));
+    nm_profile_builder_add_section(&builder, "ipv4", &ipv4);
+    profile = g_variant_ref_sink(nm_profile_builder_end(&builder));
+
+    value = get_string(profile, "ipv4", "method");
+    g_assert_cmpstr(value, ==, "manual");
+    g_free(value);
+    g_assert_cmpuint(g_variant_n_children(profile), ==, 3);
+    g_variant_unref(profile);
+}
+
+/*
+ * Build and drop many profiles, including abandoned ones. Run under
+ * "meson test --setup valgrind" to have leaks reported as failures.
+ */
+static void
+test_profile_leaks(void)
+{
+    guint i;
+
+    for (i = 0; i < 1000; i++) {
+        NMProfileBuilder builder;
+        GVariant *profile;
+
+        profile = g_variant_ref_sink(wifi_create_connection_gvariant("Office", "WPA2", "secret"));
+        g_variant_unref(profile);
+
+        /* Floating results passed on unsunk are freed by the consumer */
+        g_variant_unref(g_variant_ref_sink(ethernet_create_connection_gvariant("Wired")));
+
+        nm_profile_builder_init(&builder, "vpn", "Abandoned");
+        nm_profile_builder_clear(&builder);
+    }
+
+    /* The shared sections survive every profile that referenced them */
+    g_assert_true(g_variant_is_of_type(nm_profile_ipv4_auto(), G_VARIANT_TYPE_VARDICT));
+    g_assert_false(g_variant_is_floating(nm_profile_ipv4_auto()));
+}
 
 int main(int argc, char *argv[])
 {
     g_test_init(&argc, &argv, NULL);
-    
-    /* TODO: Add test cases */
-    
+
+    g_test_add_func("/connections/profile/types", test_profile_types);
+    g_test_add_func("/connections/profile/wifi", test_profile_wifi);
+    g_test_add_func("/connections/profile/explicit-ip", test_profile_explicit_ip);
+    g_test_add_func("/connections/profile/leaks", test_profile_leaks);
+
     return g_test_run();
 }
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <gtk/gtk.h>
+
+#include "icon-atlas.h"
+#include "icon-cache.h"
+
+static gboolean have_display;
+
+static void
+on_invalidated(gpointer user_data)
+{
+    (*(guint *)user_data)++;
+}
+
+static void
+test_shared(void)
+{
+    GtkWidget *widget, *image1, *image2;
+    IconCache *cache;
+    cairo_surface_t *surface;
+
+    if (!have_display) {
+        g_test_skip("No display");
+        return;
+    }
+
+    widget = g_object_ref_sink(gtk_label_new(NULL));
+    cache = icon_cache_new(widget, NULL, NULL);
+
+    surface = icon_cache_lookup(cache, "image-missing", GTK_ICON_SIZE_MENU);
+    g_assert_true(icon_cache_lookup(cache, "image-missing", GTK_ICON_SIZE_MENU) == surface);
+    g_assert_cmpuint(icon_cache_get_misses(cache), ==, 1);
+    g_assert_cmpuint(icon_cache_get_hits(cache), ==, 1);
+
+    /* Another size is another entry */
+    icon_cache_lookup(cache, "image-missing", GTK_ICON_SIZE_DIALOG);
+    g_assert_cmpuint(icon_cache_get_misses(cache), ==, 2);
+
+    /* Images showing one icon share its surface */
+    image1 = g_object_ref_sink(gtk_image_new());
+    image2 = g_object_ref_sink(gtk_image_new());
+    icon_cache_set_image(cache, image1, "image-missing", GTK_ICON_SIZE_MENU);
+    icon_cache_set_image(cache, image2, "image-missing", GTK_ICON_SIZE_MENU);
+    if (surface) {
+        g_assert_true(gtk_image_get_storage_type(GTK_IMAGE(image1)) == GTK_IMAGE_SURFACE);
+        g_assert_true(gtk_image_get_storage_type(GTK_IMAGE(image2)) == GTK_IMAGE_SURFACE);
+    }
+    g_assert_cmpuint(icon_cache_get_misses(cache), ==, 2);
+
+    g_object_unref(image1);
+    g_object_unref(image2);
+    icon_cache_free(cache);
+    g_object_unref(widget);
+}
+
+static void
+test_invalidate(void)
+{
+    GtkWidget *widget;
+    IconCache *cache;
+    guint invalidations = 0;
+
+    if (!have_display) {
+        g_test_skip("No display");
+        return;
+    }
+
+    widget = g_object_ref_sink(gtk_label_new(NULL));
+    cache = icon_cache_new(widget, on_invalidated, &invalidations);
+
+    /* Nothing cached, nothing to tell */
+    icon_cache_invalidate(cache);
+    g_assert_cmpuint(invalidations, ==, 0);
+
+    icon_cache_lookup(cache, "image-missing", GTK_ICON_SIZE_MENU);
+    icon_cache_invalidate(cache);
+    g_assert_cmpuint(invalidations, ==, 1);
+
+    /* Rendered again after an invalidation */
+    icon_cache_lookup(cache, "image-missing", GTK_ICON_SIZE_MENU);
+    g_assert_cmpuint(icon_cache_get_misses(cache), ==, 2);
+
+    /* A color change invalidates, other style changes do not */
+    gtk_style_context_add_class(gtk_widget_get_style_context(widget), "nm-test");
+    g_signal_emit_by_name(widget, "style-updated");
+    g_assert_cmpuint(invalidations, ==, 1);
+
+    icon_cache_free(cache);
+    g_object_unref(widget);
+}
+
+static void
+test_atlas_size(void)
+{
+    GtkWidget *widget;
+    IconAtlas *atlas;
+    cairo_surface_t *plain, *emblemed;
+    guint changes = 0, plain_index, emblemed_index;
+
+    if (!have_display) {
+        g_test_skip("No display");
+        return;
+    }
+
+    widget = g_object_ref_sink(gtk_label_new(NULL));
+    atlas = icon_atlas_new(widget, on_invalidated, &changes);
+
+    plain_index = icon_atlas_add(atlas, "image-missing", NULL);
+    emblemed_index = icon_atlas_add(atlas, "image-missing", "image-missing");
+    plain = icon_atlas_get(atlas, plain_index);
+    emblemed = icon_atlas_get(atlas, emblemed_index);
+
+    /* Getting a variant renders nothing */
+    g_assert_true(icon_atlas_get(atlas, plain_index) == plain);
+    g_assert_cmpuint(icon_atlas_get_n_renders(atlas), ==, 0);
+    if (plain && emblemed)
+        g_assert_true(plain != emblemed);
+
+    /* The same size again is free */
+    icon_atlas_set_size(atlas, icon_atlas_get_size(atlas));
+    g_assert_cmpuint(icon_atlas_get_n_renders(atlas), ==, 0);
+    g_assert_cmpuint(changes, ==, 0);
+
+    /* A new size renders the whole set once */
+    icon_atlas_set_size(atlas, 32);
+    g_assert_cmpuint(icon_atlas_get_n_renders(atlas), ==, 1);
+    g_assert_cmpuint(changes, ==, 1);
+    if (icon_atlas_get(atlas, plain_index))
+        g_assert_cmpint(cairo_image_surface_get_width(icon_atlas_get(atlas, emblemed_index)), >=, 32);
+
+    icon_atlas_free(atlas);
+    g_object_unref(widget);
+}
+
+int main(int argc, char *argv[])
+{
+    have_display = gtk_init_check(&argc, &argv);
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/icon-cache/shared", test_shared);
+    g_test_add_func("/icon-cache/invalidate", test_invalidate);
+    g_test_add_func("/icon-atlas/size", test_atlas_size);
+
+    return g_test_run();
+}
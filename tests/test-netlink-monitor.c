@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "netlink-monitor.h"
+#include "nm-interface.h"
+#include "snapshot-helpers.h"
+
+#define LOOPBACK_DEVICE "/org/freedesktop/NetworkManager/Devices/1"
+#define TIMEOUT_USEC    (5 * G_USEC_PER_SEC)
+#define SETTLE_USEC     (G_USEC_PER_SEC / 5)
+
+typedef struct {
+    guint    ifindex;
+    guint    n_seen;      /* messages about ifindex */
+    guint64  tx_bytes;
+} LoopbackState;
+
+static void
+on_link(NetlinkMonitor *monitor, const NetlinkLink *link, gpointer user_data)
+{
+    LoopbackState *state = user_data;
+
+    if (link->ifindex != state->ifindex)
+        return;
+
+    state->n_seen++;
+    if (link->have_stats)
+        state->tx_bytes = link->tx_bytes;
+}
+
+/* Iterate the default context until *counter moves past start or time runs out */
+static void
+wait_for(guint *counter, guint start, gint64 timeout)
+{
+    gint64 deadline = g_get_monotonic_time() + timeout;
+
+    while (*counter == start && g_get_monotonic_time() < deadline) {
+        if (!g_main_context_iteration(NULL, FALSE))
+            g_usleep(1000);
+    }
+}
+
+static NetlinkMonitor *
+new_monitor_or_skip(NetlinkLinkFunc callback, gpointer user_data)
+{
+    NetlinkMonitor *monitor;
+    GError *error = NULL;
+
+    monitor = netlink_monitor_new(callback, user_data, &error);
+    if (!monitor) {
+        g_test_skip(error->message);
+        g_error_free(error);
+    }
+
+    return monitor;
+}
+
+/* Sends a datagram to ourselves over lo */
+static void
+send_loopback_datagram(void)
+{
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    gchar payload[512];
+    gint fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    g_assert_cmpint(fd, >=, 0);
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    g_assert_cmpint(bind(fd, (struct sockaddr *)&address, sizeof(address)), ==, 0);
+    g_assert_cmpint(getsockname(fd, (struct sockaddr *)&address, &length), ==, 0);
+
+    memset(payload, 'x', sizeof(payload));
+    g_assert_cmpint(sendto(fd, payload, sizeof(payload), 0, (struct sockaddr *)&address, length), ==,
+                    sizeof(payload));
+    close(fd);
+}
+
+static void
+test_loopback(void)
+{
+    NetlinkMonitor *monitor;
+    const NetlinkLink *link;
+    LoopbackState state = { 0 };
+    guint64 tx_bytes;
+    guint seen;
+
+    state.ifindex = if_nametoindex("lo");
+    if (state.ifindex == 0) {
+        g_test_skip("No loopback interface");
+        return;
+    }
+
+    monitor = new_monitor_or_skip(on_link, &state);
+    if (!monitor)
+        return;
+
+    /* The initial dump describes lo */
+    wait_for(&state.n_seen, 0, TIMEOUT_USEC);
+    g_assert_cmpuint(state.n_seen, >, 0);
+
+    link = netlink_monitor_lookup(monitor, state.ifindex);
+    g_assert_nonnull(link);
+    g_assert_true(link == netlink_monitor_lookup_name(monitor, "lo"));
+    g_assert_cmpstr(link->name, ==, "lo");
+    g_assert_false(link->removed);
+    g_assert_true(link->have_stats);
+    if (!link->up) {
+        netlink_monitor_free(monitor);
+        g_test_skip("lo is down");
+        return;
+    }
+    g_assert_true(link->carrier);
+
+    /* Fresh counters on request, including our traffic */
+    tx_bytes = state.tx_bytes;
+    send_loopback_datagram();
+
+    seen = state.n_seen;
+    g_assert_true(netlink_monitor_request_dump(monitor, NULL));
+    wait_for(&state.n_seen, seen, TIMEOUT_USEC);
+    g_assert_cmpuint(state.n_seen, >, seen);
+    g_assert_cmpuint(state.tx_bytes, >=, tx_bytes + 512);
+
+    g_assert_null(netlink_monitor_lookup_name(monitor, "nm-test-none"));
+
+    netlink_monitor_free(monitor);
+}
+
+static void
+on_devices_changed(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data)
+{
+    (*(guint *)user_data)++;
+}
+
+/* A device on lo gets its carrier and counters from the kernel */
+static void
+test_device_table(void)
+{
+    NMInterface *nm_interface;
+    NMDeviceInfo *device_info;
+    GError *error = NULL;
+    gchar *filename;
+    guint n_changes = 0;
+
+    if (if_nametoindex("lo") == 0) {
+        g_test_skip("No loopback interface");
+        return;
+    }
+
+    filename = write_snapshot("[NetworkManager]\n"
+                              "State=70\n"
+                              "\n"
+                              "[Device " LOOPBACK_DEVICE "]\n"
+                              "Interface=lo\n"
+                              "Type=1\n"
+                              "State=100\n"
+                              "Managed=true\n");
+    nm_interface = load_snapshot(filename);
+
+    device_info = nm_interface_get_device_info(nm_interface, LOOPBACK_DEVICE);
+    g_assert_nonnull(device_info);
+    g_assert_false(device_info->link_known);
+
+    /* A fresh network namespace may not have used lo yet */
+    send_loopback_datagram();
+
+    if (!nm_interface_enable_link_monitor(nm_interface, &error)) {
+        g_test_skip(error->message);
+        g_clear_error(&error);
+    } else {
+        nm_interface_add_changed_listener(nm_interface, NM_INTERFACE_CHANGED_DEVICES,
+                                          on_devices_changed, &n_changes);
+        wait_for(&n_changes, 0, TIMEOUT_USEC);
+
+        g_assert_cmpuint(n_changes, ==, 1);
+        g_assert_true(device_info->link_known);
+        g_assert_cmpuint(device_info->link_rx_bytes, >, 0);
+
+        /* Only carrier changes are announced, not counters */
+        nm_interface_refresh_links(nm_interface);
+        wait_for(&n_changes, 1, SETTLE_USEC);
+        g_assert_cmpuint(n_changes, ==, 1);
+
+        nm_interface_disable_link_monitor(nm_interface);
+        g_assert_false(device_info->link_known);
+    }
+
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/netlink-monitor/loopback", test_loopback);
+    g_test_add_func("/netlink-monitor/device-table", test_device_table);
+
+    return g_test_run();
+}
@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <glib.h>
+
+#include "network-list-model.h"
+
+#define WIFI_DEVICE "/org/freedesktop/NetworkManager/Devices/2"
+
+typedef struct {
+    guint emissions;
+    guint position;
+    guint removed;
+    guint added;
+} ItemsChanged;
+
+static void
+on_items_changed(GListModel *list, guint position, guint removed, guint added, ItemsChanged *changed)
+{
+    changed->emissions++;
+    changed->position = position;
+    changed->removed = removed;
+    changed->added = added;
+}
+
+static void
+add_ap(NetworkListModel *model, const gchar *path, const gchar *ssid, guint strength, gboolean connected)
+{
+    NMAccessPointInfo *ap_info = g_new0(NMAccessPointInfo, 1);
+
+    ap_info->path = g_strdup(path);
+    ap_info->ssid = g_strdup(ssid);
+    ap_info->strength = strength;
+    ap_info->security = g_strdup("WPA2");
+
+    network_list_model_add_access_point(model, WIFI_DEVICE, ap_info, connected);
+}
+
+static const gchar *
+name_at(NetworkListModel *model, guint position)
+{
+    NetworkEntry *entry = g_list_model_get_item(G_LIST_MODEL(model), position);
+    const gchar *name = network_entry_get_name(entry);
+
+    /* The model still holds a reference */
+    g_object_unref(entry);
+    return name;
+}
+
+static void
+fill_model(NetworkListModel *model)
+{
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "Office", 40, FALSE);
+    add_ap(model, "/ap/2", "Cafe", 80, FALSE);
+    add_ap(model, "/ap/3", "Home", 20, TRUE);
+    add_ap(model, "/ap/4", "Library", 60, FALSE);
+    network_list_model_end_update(model);
+}
+
+static void
+test_sorted(void)
+{
+    NetworkListModel *model = network_list_model_new();
+
+    fill_model(model);
+
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 4);
+    g_assert_cmpstr(name_at(model, 0), ==, "Home");
+    g_assert_cmpstr(name_at(model, 1), ==, "Cafe");
+    g_assert_cmpstr(name_at(model, 2), ==, "Library");
+    g_assert_cmpstr(name_at(model, 3), ==, "Office");
+
+    g_object_unref(model);
+}
+
+static void
+test_minimal_range(void)
+{
+    NetworkListModel *model = network_list_model_new();
+    ItemsChanged changed = { 0 };
+
+    fill_model(model);
+    g_signal_connect(model, "items-changed", G_CALLBACK(on_items_changed), &changed);
+
+    /* Nothing changed: no signal */
+    fill_model(model);
+    g_assert_cmpuint(changed.emissions, ==, 0);
+
+    /* Library drops below Office: only those two rows are replaced */
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "Office", 40, FALSE);
+    add_ap(model, "/ap/2", "Cafe", 80, FALSE);
+    add_ap(model, "/ap/3", "Home", 20, TRUE);
+    add_ap(model, "/ap/4", "Library", 30, FALSE);
+    network_list_model_end_update(model);
+    g_assert_cmpuint(changed.emissions, ==, 1);
+    g_assert_cmpuint(changed.position, ==, 2);
+    g_assert_cmpuint(changed.removed, ==, 2);
+    g_assert_cmpuint(changed.added, ==, 2);
+
+    /* An AP disappearing removes one row */
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "Office", 40, FALSE);
+    add_ap(model, "/ap/3", "Home", 20, TRUE);
+    add_ap(model, "/ap/4", "Library", 30, FALSE);
+    network_list_model_end_update(model);
+    g_assert_cmpuint(changed.emissions, ==, 2);
+    g_assert_cmpuint(changed.position, ==, 1);
+    g_assert_cmpuint(changed.removed, ==, 1);
+    g_assert_cmpuint(changed.added, ==, 0);
+
+    g_object_unref(model);
+}
+
+static void
+on_entry_changed(NetworkEntry *entry, guint *count)
+{
+    (*count)++;
+}
+
+static void
+test_entry_changed(void)
+{
+    NetworkListModel *model = network_list_model_new();
+    ItemsChanged changed = { 0 };
+    NetworkEntry *entry;
+    guint entry_changes = 0;
+
+    fill_model(model);
+    g_signal_connect(model, "items-changed", G_CALLBACK(on_items_changed), &changed);
+
+    entry = g_list_model_get_item(G_LIST_MODEL(model), 1);
+    g_signal_connect(entry, "changed", G_CALLBACK(on_entry_changed), &entry_changes);
+
+    /* Cafe gets weaker but keeps its place: the row updates in place */
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "Office", 40, FALSE);
+    add_ap(model, "/ap/2", "Cafe", 70, FALSE);
+    add_ap(model, "/ap/3", "Home", 20, TRUE);
+    add_ap(model, "/ap/4", "Library", 60, FALSE);
+    network_list_model_end_update(model);
+
+    g_assert_cmpuint(changed.emissions, ==, 0);
+    g_assert_cmpuint(entry_changes, ==, 1);
+    g_assert_cmpuint(network_entry_get_strength(entry), ==, 70);
+
+    g_object_unref(entry);
+    g_object_unref(model);
+}
+
+static void
+update_pair(NetworkListModel *model, guint strength_a, guint strength_b)
+{
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "Alpha", strength_a, FALSE);
+    add_ap(model, "/ap/2", "Bravo", strength_b, FALSE);
+    network_list_model_end_update(model);
+}
+
+static void
+test_hysteresis(void)
+{
+    NetworkListModel *model = network_list_model_new();
+    ItemsChanged changed = { 0 };
+
+    /* Same bucket: by name */
+    update_pair(model, 50, 58);
+    g_assert_cmpstr(name_at(model, 0), ==, "Alpha");
+    g_signal_connect(model, "items-changed", G_CALLBACK(on_items_changed), &changed);
+
+    /* Just over the bucket edge is not enough to move */
+    update_pair(model, 50, 62);
+    g_assert_cmpuint(changed.emissions, ==, 0);
+    g_assert_cmpuint(network_list_model_get_n_moves(model), ==, 0);
+
+    /* Well over it is */
+    update_pair(model, 50, 66);
+    g_assert_cmpuint(changed.emissions, ==, 1);
+    g_assert_cmpuint(network_list_model_get_n_moves(model), ==, 1);
+    g_assert_cmpstr(name_at(model, 0), ==, "Bravo");
+
+    /* Dropping back just under the edge keeps it there */
+    update_pair(model, 50, 57);
+    g_assert_cmpuint(changed.emissions, ==, 1);
+    g_assert_cmpuint(network_list_model_get_n_moves(model), ==, 0);
+    g_assert_cmpstr(name_at(model, 0), ==, "Bravo");
+
+    update_pair(model, 50, 50);
+    g_assert_cmpuint(changed.emissions, ==, 2);
+    g_assert_cmpstr(name_at(model, 0), ==, "Alpha");
+
+    g_object_unref(model);
+}
+
+/* One network jumping to the top is one move, not one per row it passes */
+static void
+test_moves(void)
+{
+    NetworkListModel *model = network_list_model_new();
+
+    fill_model(model);
+    g_assert_cmpuint(network_list_model_get_n_moves(model), ==, 0);
+
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "Office", 95, FALSE);
+    add_ap(model, "/ap/2", "Cafe", 80, FALSE);
+    add_ap(model, "/ap/3", "Home", 20, TRUE);
+    add_ap(model, "/ap/4", "Library", 60, FALSE);
+    network_list_model_end_update(model);
+
+    g_assert_cmpstr(name_at(model, 1), ==, "Office");
+    g_assert_cmpstr(name_at(model, 2), ==, "Cafe");
+    g_assert_cmpstr(name_at(model, 3), ==, "Library");
+    g_assert_cmpuint(network_list_model_get_n_moves(model), ==, 1);
+
+    g_object_unref(model);
+}
+
+static void
+test_known(void)
+{
+    NetworkListModel *model = network_list_model_new();
+
+    network_list_model_begin_update(model);
+    network_list_model_add_known(model, "Library", 100);
+    network_list_model_add_known(model, "Home", 200);
+    add_ap(model, "/ap/1", "Office", 40, FALSE);
+    add_ap(model, "/ap/2", "Cafe", 80, FALSE);
+    add_ap(model, "/ap/3", "Home", 10, FALSE);
+    add_ap(model, "/ap/4", "Library", 20, FALSE);
+    network_list_model_end_update(model);
+
+    /* Saved networks first, most recently used on top */
+    g_assert_cmpstr(name_at(model, 0), ==, "Home");
+    g_assert_cmpstr(name_at(model, 1), ==, "Library");
+    g_assert_cmpstr(name_at(model, 2), ==, "Cafe");
+    g_assert_cmpstr(name_at(model, 3), ==, "Office");
+
+    /* Forgetting a network puts it back among the others */
+    network_list_model_begin_update(model);
+    network_list_model_add_known(model, "Library", 100);
+    add_ap(model, "/ap/1", "Office", 40, FALSE);
+    add_ap(model, "/ap/2", "Cafe", 80, FALSE);
+    add_ap(model, "/ap/3", "Home", 10, FALSE);
+    add_ap(model, "/ap/4", "Library", 20, FALSE);
+    network_list_model_end_update(model);
+    g_assert_cmpstr(name_at(model, 0), ==, "Library");
+    g_assert_cmpstr(name_at(model, 3), ==, "Home");
+
+    g_object_unref(model);
+}
+
+static void
+test_filter(void)
+{
+    NetworkListModel *model = network_list_model_new();
+
+    fill_model(model);
+
+    network_list_model_set_filter(model, "o");
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 2);
+    g_assert_cmpstr(name_at(model, 0), ==, "Home");
+    g_assert_cmpstr(name_at(model, 1), ==, "Office");
+    g_assert_cmpuint(network_list_model_get_n_entries(model), ==, 4);
+
+    network_list_model_set_filter(model, NULL);
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 4);
+
+    g_object_unref(model);
+}
+
+static void
+test_filter_casefold(void)
+{
+    NetworkListModel *model = network_list_model_new();
+
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "CAF\xc3\x89", 50, FALSE);
+    add_ap(model, "/ap/2", "Office", 40, FALSE);
+    network_list_model_end_update(model);
+
+    network_list_model_set_filter(model, "caf\xc3\xa9");
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 1);
+    g_assert_cmpstr(name_at(model, 0), ==, "CAF\xc3\x89");
+
+    /* Decomposed e + combining acute matches the precomposed name */
+    network_list_model_set_filter(model, "cafe\xcc\x81");
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 1);
+
+    network_list_model_set_filter(model, "OFF");
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 1);
+    g_assert_cmpstr(name_at(model, 0), ==, "Office");
+
+    g_object_unref(model);
+}
+
+static void
+test_filter_incremental(void)
+{
+    NetworkListModel *model = network_list_model_new();
+    ItemsChanged changed = { 0 };
+
+    fill_model(model);
+    g_signal_connect(model, "items-changed", G_CALLBACK(on_items_changed), &changed);
+
+    /* Home, Cafe, Library, Office: "o" hides Cafe and Library, one run */
+    network_list_model_set_filter(model, "o");
+    g_assert_cmpuint(changed.emissions, ==, 1);
+    g_assert_cmpuint(changed.position, ==, 1);
+    g_assert_cmpuint(changed.removed, ==, 2);
+    g_assert_cmpuint(changed.added, ==, 0);
+
+    /* "of" hides Home only */
+    network_list_model_set_filter(model, "of");
+    g_assert_cmpuint(changed.emissions, ==, 2);
+    g_assert_cmpuint(changed.position, ==, 0);
+    g_assert_cmpuint(changed.removed, ==, 1);
+    g_assert_cmpuint(changed.added, ==, 0);
+
+    /* Back to "o" brings Home back in front of Office */
+    network_list_model_set_filter(model, "o");
+    g_assert_cmpuint(changed.emissions, ==, 3);
+    g_assert_cmpuint(changed.position, ==, 0);
+    g_assert_cmpuint(changed.removed, ==, 0);
+    g_assert_cmpuint(changed.added, ==, 1);
+    g_assert_cmpstr(name_at(model, 0), ==, "Home");
+    g_assert_cmpstr(name_at(model, 1), ==, "Office");
+
+    /* Clearing it inserts Cafe and Library as one run */
+    network_list_model_set_filter(model, "");
+    g_assert_cmpuint(changed.emissions, ==, 4);
+    g_assert_cmpuint(changed.position, ==, 1);
+    g_assert_cmpuint(changed.added, ==, 2);
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 4);
+
+    g_object_unref(model);
+}
+
+static void
+add_bssid(NetworkListModel *model, const gchar *path, const gchar *ssid, const gchar *security, guint strength)
+{
+    NMAccessPointInfo *ap_info = g_new0(NMAccessPointInfo, 1);
+
+    ap_info->path = g_strdup(path);
+    ap_info->ssid = g_strdup(ssid);
+    ap_info->strength = strength;
+    ap_info->security = g_strdup(security);
+
+    network_list_model_add_access_point(model, WIFI_DEVICE, ap_info, FALSE);
+}
+
+static void
+test_grouped(void)
+{
+    NetworkListModel *model = network_list_model_new();
+    NetworkEntry *corp;
+    GPtrArray *bssids;
+
+    network_list_model_begin_update(model);
+    add_bssid(model, "/ap/1", "Corp", "WPA2", 30);
+    add_bssid(model, "/ap/2", "Corp", "WPA2", 70);
+    add_bssid(model, "/ap/3", "Corp", "WPA2", 50);
+    add_bssid(model, "/ap/4", "Corp", "None", 90);
+    network_list_model_end_update(model);
+
+    /* Same SSID with different security stays apart */
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 2);
+
+    corp = g_list_model_get_item(G_LIST_MODEL(model), 1);
+    g_assert_cmpuint(network_entry_get_n_bssids(corp), ==, 3);
+    g_assert_cmpuint(network_entry_get_strength(corp), ==, 70);
+    g_assert_cmpstr(network_entry_get_ap_info(corp)->path, ==, "/ap/2");
+
+    bssids = network_entry_get_bssids(corp);
+    g_assert_cmpuint(bssids->len, ==, 3);
+    g_assert_cmpstr(((NMAccessPointInfo *)g_ptr_array_index(bssids, 2))->path, ==, "/ap/1");
+    g_ptr_array_unref(bssids);
+
+    /* The best BSSID weakens: the next strongest takes over */
+    network_list_model_begin_update(model);
+    add_bssid(model, "/ap/1", "Corp", "WPA2", 30);
+    add_bssid(model, "/ap/2", "Corp", "WPA2", 20);
+    add_bssid(model, "/ap/3", "Corp", "WPA2", 50);
+    add_bssid(model, "/ap/4", "Corp", "None", 90);
+    network_list_model_end_update(model);
+    g_assert_cmpuint(network_entry_get_strength(corp), ==, 50);
+
+    /* The best BSSID goes away */
+    network_list_model_begin_update(model);
+    add_bssid(model, "/ap/1", "Corp", "WPA2", 30);
+    add_bssid(model, "/ap/2", "Corp", "WPA2", 20);
+    add_bssid(model, "/ap/4", "Corp", "None", 90);
+    network_list_model_end_update(model);
+    g_assert_cmpuint(network_entry_get_n_bssids(corp), ==, 2);
+    g_assert_cmpuint(network_entry_get_strength(corp), ==, 30);
+
+    /* And then the whole network */
+    network_list_model_begin_update(model);
+    add_bssid(model, "/ap/4", "Corp", "None", 90);
+    network_list_model_end_update(model);
+    g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(model)), ==, 1);
+
+    g_object_unref(corp);
+    g_object_unref(model);
+}
+
+static void
+test_wired(void)
+{
+    NetworkListModel *model = network_list_model_new();
+    NetworkEntry *entry;
+
+    network_list_model_begin_update(model);
+    add_ap(model, "/ap/1", "Office", 40, FALSE);
+    network_list_model_add_wired(model, "/org/freedesktop/NetworkManager/Devices/1", TRUE);
+    network_list_model_end_update(model);
+
+    entry = g_list_model_get_item(G_LIST_MODEL(model), 0);
+    g_assert_cmpint(network_entry_get_kind(entry), ==, NETWORK_ENTRY_WIRED);
+    g_assert_null(network_entry_get_ap_info(entry));
+    g_object_unref(entry);
+
+    g_object_unref(model);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/network-list-model/sorted", test_sorted);
+    g_test_add_func("/network-list-model/minimal-range", test_minimal_range);
+    g_test_add_func("/network-list-model/entry-changed", test_entry_changed);
+    g_test_add_func("/network-list-model/hysteresis", test_hysteresis);
+    g_test_add_func("/network-list-model/moves", test_moves);
+    g_test_add_func("/network-list-model/known", test_known);
+    g_test_add_func("/network-list-model/filter", test_filter);
+    g_test_add_func("/network-list-model/filter-casefold", test_filter_casefold);
+    g_test_add_func("/network-list-model/filter-incremental", test_filter_incremental);
+    g_test_add_func("/network-list-model/grouped", test_grouped);
+    g_test_add_func("/network-list-model/wired", test_wired);
+
+    return g_test_run();
+}
@@ -8,12 +8,328 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
+
+#include "nm-interface-private.h"
+#include "nm-statistics.h"
+#include "snapshot-helpers.h"
+
+#define WIFI_DEVICE "/org/freedesktop/NetworkManager/Devices/2"
+#define WIRED_DEVICE "/org/freedesktop/NetworkManager/Devices/1"
+#define ACTIVE_PATH "/org/freedesktop/NetworkManager/ActiveConnection/1"
+#define LATE_DEVICE "/org/freedesktop/NetworkManager/Devices/7"
+
+static const gchar *snapshot_data =
+    "[NetworkManager]\n"
+    "State=70\n"
+    "Connectivity=4\n"
+    "WirelessEnabled=true\n"
+    "NetworkingEnabled=true\n"
+    "PrimaryConnection=" ACTIVE_PATH "\n"
+    "\n"
+    "[Device " WIRED_DEVICE "]\n"
+    "Interface=eth0\n"
+    "Type=1\n"
+    "State=30\n"
+    "Managed=true\n"
+    "\n"
+    "[Device " WIFI_DEVICE "]\n"
+    "Interface=wlan0\n"
+    "Type=2\n"
+    "State=100\n"
+    "Managed=true\n"
+    "ActiveAccessPoint=/org/freedesktop/NetworkManager/AccessPoint/1\n"
+    "AccessPoints=/org/freedesktop/NetworkManager/AccessPoint/1;/org/freedesktop/NetworkManager/AccessPoint/2;\n"
+    "\n"
+    "[AccessPoint /org/freedesktop/NetworkManager/AccessPoint/1]\n"
+    "Ssid=Office\n"
+    "Strength=72\n"
+    "Security=WPA2\n"
+    "Bssid=00:11:22:33:44:55\n"
+    "Frequency=5180\n"
+    "\n"
+    "[AccessPoint /org/freedesktop/NetworkManager/AccessPoint/2]\n"
+    "Ssid=Cafe\n"
+    "Strength=31\n"
+    "Security=None\n"
+    "\n"
+    "[Connection /org/freedesktop/NetworkManager/Settings/1]\n"
+    "Uuid=6c2b4a6e-5e5d-4c8e-9a43-0a4d1f6f2c11\n"
+    "Id=Office\n"
+    "Type=802-11-wireless\n"
+    "Timestamp=1700000000\n"
+    "\n"
+    "[ActiveConnection " ACTIVE_PATH "]\n"
+    "Connection=/org/freedesktop/NetworkManager/Settings/1\n"
+    "SpecificObject=/org/freedesktop/NetworkManager/AccessPoint/1\n"
+    "Devices=" WIFI_DEVICE ";\n"
+    "State=2\n"
+    "Default=true\n"
+    "Vpn=false\n";
+
+static void
+check_snapshot_state(NMInterface *nm_interface)
+{
+    NMDeviceInfo *device_info;
+    NMActiveConnectionInfo *primary;
+    GList *devices, *aps;
+    NMAccessPointInfo *ap_info;
+
+    g_assert_cmpint(nm_interface_get_state(nm_interface), ==, NM_STATE_CONNECTED_GLOBAL);
+    g_assert_cmpint(nm_interface_get_connectivity(nm_interface), ==, NM_CONNECTIVITY_FULL);
+
+    devices = nm_interface_get_devices(nm_interface);
+    g_assert_cmpuint(g_list_length(devices), ==, 2);
+    g_list_free(devices);
+
+    device_info = nm_interface_get_device_info(nm_interface, WIFI_DEVICE);
+    g_assert_nonnull(device_info);
+    g_assert_cmpint(device_info->type, ==, NM_DEVICE_TYPE_WIFI);
+    g_assert_cmpstr(device_info->interface, ==, "wlan0");
+    g_assert_cmpstr(device_info->specific.wifi.active_ap, ==,
+                    "/org/freedesktop/NetworkManager/AccessPoint/1");
+
+    aps = nm_interface_get_access_points(nm_interface, WIFI_DEVICE);
+    g_assert_cmpuint(g_list_length(aps), ==, 2);
+    ap_info = aps->data;
+    g_assert_cmpstr(ap_info->ssid, ==, "Office");
+    g_assert_cmpuint(ap_info->strength, ==, 72);
+    g_assert_cmpstr(ap_info->security, ==, "WPA2");
+    g_assert_cmpstr(ap_info->bssid, ==, "00:11:22:33:44:55");
+    g_assert_cmpuint(ap_info->frequency, ==, 5180);
+    g_assert_cmpstr(nm_interface_ap_band(ap_info->frequency), ==, "5 GHz");
+    g_assert_cmpuint(nm_interface_ap_channel(ap_info->frequency), ==, 36);
+    g_assert_cmpuint(nm_interface_ap_channel(2437), ==, 6);
+    g_assert_cmpuint(nm_interface_ap_channel(4920), ==, 184);
+    g_assert_cmpstr(nm_interface_ap_band(4920), ==, "5 GHz");
+    g_assert_cmpuint(nm_interface_ap_channel(4990), ==, 0);
+    g_list_free_full(aps, (GDestroyNotify)nm_interface_free_ap_info);
+
+    g_assert_null(nm_interface_get_access_points(nm_interface, WIRED_DEVICE));
+
+    g_assert_nonnull(nm_interface_find_connection_by_ssid(nm_interface, "Office"));
+
+    primary = nm_interface_get_primary_connection(nm_interface);
+    g_assert_nonnull(primary);
+    g_assert_cmpstr(primary->id, ==, "Office");
+    g_assert_cmpstr(primary->uuid, ==, "6c2b4a6e-5e5d-4c8e-9a43-0a4d1f6f2c11");
+    g_assert_cmpint(primary->state, ==, NM_ACTIVE_CONNECTION_STATE_ACTIVATED);
+    g_assert_true(primary->is_default);
+    g_assert_cmpstr(primary->devices[0], ==, WIFI_DEVICE);
+}
+
+static void
+test_snapshot_load(void)
+{
+    gchar *filename = write_snapshot(snapshot_data);
+    NMInterface *nm_interface = load_snapshot(filename);
+
+    check_snapshot_state(nm_interface);
+
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+}
+
+static void
+test_snapshot_round_trip(void)
+{
+    gchar *filename = write_snapshot(snapshot_data);
+    gchar *copy = write_snapshot("");
+    NMInterface *nm_interface = load_snapshot(filename);
+    GError *error = NULL;
+
+    g_assert_true(nm_interface_save_snapshot(nm_interface, copy, &error));
+    g_assert_no_error(error);
+    nm_interface_free(nm_interface);
+
+    nm_interface = load_snapshot(copy);
+    check_snapshot_state(nm_interface);
+    nm_interface_free(nm_interface);
+
+    g_unlink(copy);
+    g_unlink(filename);
+    g_free(copy);
+    g_free(filename);
+}
+
+static void
+test_snapshot_many_access_points(void)
+{
+    GString *contents = g_string_new("[NetworkManager]\nState=70\n\n");
+    NMInterface *nm_interface;
+    gchar *filename;
+    GList *aps;
+    guint i;
+
+    g_string_append(contents, "[Device " WIFI_DEVICE "]\nType=2\nAccessPoints=");
+    for (i = 0; i < 1000; i++)
+        g_string_append_printf(contents, "/ap/%u;", i);
+    g_string_append(contents, "\n\n");
+    for (i = 0; i < 1000; i++)
+        g_string_append_printf(contents, "[AccessPoint /ap/%u]\nSsid=net-%04u\nStrength=%u\n\n",
+                               i, i, i % 101);
+
+    filename = write_snapshot(contents->str);
+    nm_interface = load_snapshot(filename);
+
+    aps = nm_interface_get_access_points(nm_interface, WIFI_DEVICE);
+    g_assert_cmpuint(g_list_length(aps), ==, 1000);
+    g_assert_cmpstr(((NMAccessPointInfo *)g_list_last(aps)->data)->ssid, ==, "net-0999");
+    g_assert_cmpstr(((NMAccessPointInfo *)aps->data)->security, ==, "None");
+    g_list_free_full(aps, (GDestroyNotify)nm_interface_free_ap_info);
+
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+    g_string_free(contents, TRUE);
+}
+
+static void
+test_snapshot_missing_file(void)
+{
+    NMInterface *nm_interface;
+    GError *error = NULL;
+
+    nm_interface = nm_interface_new_for_snapshot("/nonexistent/snapshot.ini");
+    g_assert_false(nm_interface_init(nm_interface, &error));
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+    g_error_free(error);
+    nm_interface_free(nm_interface);
+}
+
+static void
+on_statistics_sample(NMInterface *nm_interface, const gchar *device_path,
+                     const NMStatisticsSample *sample, gpointer user_data)
+{
+    (*(guint *)user_data)++;
+}
+
+static void
+test_statistics(void)
+{
+    NMInterface *nm_interface;
+    NMStatisticsSample history[NM_STATISTICS_HISTORY];
+    NMDeviceInfo *late_device;
+    gchar *filename = write_snapshot(snapshot_data);
+    guint first, second, n_samples = 0, i;
+
+    nm_interface = load_snapshot(filename);
+
+    /* Nobody watching: no refresh rate, samples are dropped */
+    nm_statistics_add_sample(nm_interface, WIFI_DEVICE, 100, 100);
+    g_assert_cmpuint(nm_statistics_get_history(nm_interface, WIFI_DEVICE, history, 1), ==, 0);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, WIFI_DEVICE), ==, 0);
+
+    first = nm_statistics_watch(nm_interface, WIFI_DEVICE, on_statistics_sample, &n_samples);
+    second = nm_statistics_watch(nm_interface, WIFI_DEVICE, NULL, NULL);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, WIFI_DEVICE), ==, NM_STATISTICS_REFRESH_RATE);
+
+    /* The ring keeps the newest samples, oldest first */
+    for (i = 0; i < NM_STATISTICS_HISTORY + 10; i++)
+        nm_statistics_add_sample(nm_interface, WIFI_DEVICE, i * 1000, i * 10);
+    g_assert_cmpuint(n_samples, ==, NM_STATISTICS_HISTORY + 10);
+    g_assert_cmpuint(nm_statistics_get_history(nm_interface, WIFI_DEVICE, history, NM_STATISTICS_HISTORY),
+                     ==, NM_STATISTICS_HISTORY);
+    g_assert_cmpuint(history[0].rx_bytes, ==, 10 * 1000);
+    g_assert_cmpuint(history[NM_STATISTICS_HISTORY - 1].rx_bytes, ==, (NM_STATISTICS_HISTORY + 9) * 1000);
+
+    /* A counter reset gives no rate rather than a huge one */
+    nm_statistics_add_sample(nm_interface, WIFI_DEVICE, 0, 0);
+    g_assert_true(nm_statistics_get_latest(nm_interface, WIFI_DEVICE, history));
+    g_assert_cmpfloat(history[0].rx_rate, ==, 0);
+
+    /* The rate stays until the last watcher goes */
+    nm_statistics_unwatch(nm_interface, first);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, WIFI_DEVICE), ==, NM_STATISTICS_REFRESH_RATE);
+    nm_statistics_unwatch(nm_interface, second);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, WIFI_DEVICE), ==, 0);
+    g_assert_cmpuint(nm_statistics_get_history(nm_interface, WIFI_DEVICE, history, 1), ==, 0);
+
+    /* A device watched before it appears gets its rate when it does */
+    nm_statistics_watch(nm_interface, LATE_DEVICE, NULL, NULL);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, LATE_DEVICE), ==, 0);
+    late_device = g_new0(NMDeviceInfo, 1);
+    late_device->path = g_strdup(LATE_DEVICE);
+    late_device->interface = g_strdup("eth1");
+    late_device->type = NM_DEVICE_TYPE_ETHERNET;
+    nm_interface_notify_device_added(nm_interface, late_device);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, LATE_DEVICE), ==, NM_STATISTICS_REFRESH_RATE);
+
+    /* Watches survive a restart of the backend */
+    nm_statistics_watch(nm_interface, WIFI_DEVICE, NULL, NULL);
+    nm_interface_shutdown(nm_interface);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, WIFI_DEVICE), ==, 0);
+    g_assert_true(nm_interface_init(nm_interface, NULL));
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, WIFI_DEVICE), ==, NM_STATISTICS_REFRESH_RATE);
+
+    /* Watches left behind are dropped with the interface */
+    nm_statistics_watch(nm_interface, WIRED_DEVICE, NULL, NULL);
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+}
+
+typedef struct {
+    guint calls;
+    guint victim;       /* listener to remove when called */
+} ListenerData;
+
+static void
+on_changed_remove_victim(NMInterface *nm_interface, NMInterfaceChangeFlags changes, gpointer user_data)
+{
+    ListenerData *data = user_data;
+
+    data->calls++;
+    if (data->victim) {
+        nm_interface_remove_changed_listener(nm_interface, data->victim);
+        data->victim = 0;
+    }
+}
+
+static void
+test_listener_removal(void)
+{
+    NMInterface *nm_interface;
+    ListenerData first = { 0 }, second = { 0 }, third = { 0 };
+    gchar *filename = write_snapshot(snapshot_data);
+    guint second_id;
+
+    nm_interface = load_snapshot(filename);
+
+    nm_interface_add_changed_listener(nm_interface, NM_INTERFACE_CHANGED_STATE, on_changed_remove_victim, &first);
+    second_id = nm_interface_add_changed_listener(nm_interface, NM_INTERFACE_CHANGED_STATE,
+                                                  on_changed_remove_victim, &second);
+    third.victim = nm_interface_add_changed_listener(nm_interface, NM_INTERFACE_CHANGED_STATE,
+                                                     on_changed_remove_victim, &third);
+    first.victim = second_id;
+
+    /* The first listener drops the second before it runs, the third drops itself */
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_STATE);
+    g_assert_cmpuint(first.calls, ==, 1);
+    g_assert_cmpuint(second.calls, ==, 0);
+    g_assert_cmpuint(third.calls, ==, 1);
+    g_assert_cmpuint(g_list_length(nm_interface->listeners), ==, 1);
+
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_STATE);
+    g_assert_cmpuint(first.calls, ==, 2);
+    g_assert_cmpuint(third.calls, ==, 1);
+
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+}
 
 int main(int argc, char *argv[])
 {
     g_test_init(&argc, &argv, NULL);
-    
-    /* TODO: Add test cases */
-    
+
+    g_test_add_func("/nm-interface/snapshot/load", test_snapshot_load);
+    g_test_add_func("/nm-interface/snapshot/round-trip", test_snapshot_round_trip);
+    g_test_add_func("/nm-interface/snapshot/many-access-points", test_snapshot_many_access_points);
+    g_test_add_func("/nm-interface/snapshot/missing-file", test_snapshot_missing_file);
+    g_test_add_func("/nm-interface/statistics", test_statistics);
+    g_test_add_func("/nm-interface/listener-removal", test_listener_removal);
+
     return g_test_run();
 }
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "speed-test.h"
+
+#define CONNECTION_UUID "3b1f7c52-6a9d-4e08-b2f3-81c6d0a9e4b7"
+#define TEST_DURATION   300                     /* milliseconds */
+#define TIMEOUT_USEC    (10 * G_USEC_PER_SEC)
+
+typedef struct {
+    gboolean         done;
+    gboolean         ok;
+    SpeedTestResult  result;
+    GError          *error;
+} Outcome;
+
+static void
+on_done(SpeedTest *test, const SpeedTestResult *result, const GError *error, gpointer user_data)
+{
+    Outcome *outcome = user_data;
+
+    outcome->done = TRUE;
+    outcome->ok = result != NULL;
+    if (result)
+        outcome->result = *result;
+    else
+        outcome->error = g_error_copy(error);
+}
+
+/* Runs the test against endpoint to completion; timeout_ms 0 keeps the default */
+static void
+run_test(const gchar *endpoint, guint timeout_ms, Outcome *outcome)
+{
+    SpeedTest *test;
+    GError *error = NULL;
+    gint64 deadline = g_get_monotonic_time() + TIMEOUT_USEC;
+
+    test = speed_test_new(endpoint, &error);
+    g_assert_no_error(error);
+
+    speed_test_set_duration(test, TEST_DURATION);
+    if (timeout_ms)
+        speed_test_set_timeout(test, timeout_ms);
+    speed_test_start(test, on_done, outcome);
+    g_assert_true(speed_test_is_running(test));
+
+    while (!outcome->done && g_get_monotonic_time() < deadline)
+        g_main_context_iteration(NULL, TRUE);
+
+    g_assert_true(outcome->done);
+    g_assert_false(speed_test_is_running(test));
+    speed_test_free(test);
+}
+
+static SpeedTestServer *
+start_server(gboolean http)
+{
+    SpeedTestServer *server;
+    GError *error = NULL;
+
+    server = speed_test_server_new(0, http, &error);
+    if (!server) {
+        g_test_skip(error->message);
+        g_error_free(error);
+    }
+
+    return server;
+}
+
+static void
+test_endpoint(void)
+{
+    const gchar *invalid[] = { "", "ftp://localhost:21/", "tcp://localhost", "http://", "localhost:80" };
+    GError *error = NULL;
+    SpeedTest *test;
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(invalid); i++) {
+        test = speed_test_new(invalid[i], &error);
+        g_assert_null(test);
+        g_assert_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+        g_clear_error(&error);
+    }
+
+    test = speed_test_new("http://localhost/1GB.bin", &error);
+    g_assert_no_error(error);
+    g_assert_false(speed_test_is_running(test));
+    speed_test_free(test);
+}
+
+static void
+test_loopback(gconstpointer data)
+{
+    gboolean http = GPOINTER_TO_INT(data);
+    SpeedTestServer *server;
+    Outcome outcome = { 0 };
+    gchar *endpoint;
+
+    server = start_server(http);
+    if (!server)
+        return;
+
+    endpoint = http ? g_strdup_printf("http://127.0.0.1:%u/", speed_test_server_get_port(server))
+                    : g_strdup_printf("tcp://127.0.0.1:%u", speed_test_server_get_port(server));
+    run_test(endpoint, 0, &outcome);
+
+    g_assert_true(outcome.ok);
+    g_assert_cmpuint(outcome.result.bytes, >, 0);
+    g_assert_cmpfloat(outcome.result.goodput, >, 0);
+    g_assert_cmpfloat(outcome.result.rtt, >=, 0);
+    g_assert_cmpfloat(outcome.result.jitter, >=, 0);
+    g_assert_cmpint(outcome.result.time, >, 0);
+
+    g_free(endpoint);
+    speed_test_server_free(server);
+}
+
+/* A port nobody listens on any more */
+static void
+test_refused(void)
+{
+    SpeedTestServer *server;
+    Outcome outcome = { 0 };
+    gchar *endpoint;
+
+    server = start_server(FALSE);
+    if (!server)
+        return;
+
+    endpoint = g_strdup_printf("tcp://127.0.0.1:%u", speed_test_server_get_port(server));
+    speed_test_server_free(server);
+
+    run_test(endpoint, 0, &outcome);
+    g_assert_false(outcome.ok);
+    g_assert_error(outcome.error, G_IO_ERROR, G_IO_ERROR_CONNECTION_REFUSED);
+
+    g_clear_error(&outcome.error);
+    g_free(endpoint);
+}
+
+/* "localhost" may give ::1 first, where the server does not listen */
+static void
+test_localhost(void)
+{
+    SpeedTestServer *server;
+    Outcome outcome = { 0 };
+    gchar *endpoint;
+
+    server = start_server(FALSE);
+    if (!server)
+        return;
+
+    endpoint = g_strdup_printf("tcp://localhost:%u", speed_test_server_get_port(server));
+    run_test(endpoint, 0, &outcome);
+    g_assert_no_error(outcome.error);
+    g_assert_true(outcome.ok);
+    g_assert_cmpuint(outcome.result.bytes, >, 0);
+
+    g_free(endpoint);
+    speed_test_server_free(server);
+}
+
+/*
+ * A listener that never accepts, with its backlog taken, drops the SYNs
+ * of further connections, so connecting hangs until the timeout.
+ */
+static void
+test_timeout(void)
+{
+    GSocket *listener, *filler;
+    GSocketAddress *address, *bound;
+    GInetAddress *loopback;
+    Outcome outcome = { 0 };
+    GError *error = NULL;
+    gchar *endpoint;
+
+    listener = g_socket_new(G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, &error);
+    g_assert_no_error(error);
+    loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    address = g_inet_socket_address_new(loopback, 0);
+    g_assert_true(g_socket_bind(listener, address, TRUE, &error));
+    g_socket_set_listen_backlog(listener, 0);
+    g_assert_true(g_socket_listen(listener, &error));
+    bound = g_socket_get_local_address(listener, &error);
+    g_assert_no_error(error);
+
+    filler = g_socket_new(G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, &error);
+    g_assert_no_error(error);
+    g_socket_set_blocking(filler, FALSE);
+    g_socket_connect(filler, bound, NULL, NULL);
+    g_usleep(G_USEC_PER_SEC / 20);
+
+    endpoint = g_strdup_printf("tcp://127.0.0.1:%u",
+                               g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(bound)));
+    run_test(endpoint, 300, &outcome);
+
+    if (outcome.ok)
+        g_test_skip("The kernel accepted a connection past the backlog");
+    else
+        g_assert_error(outcome.error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+
+    g_clear_error(&outcome.error);
+    g_free(endpoint);
+    g_object_unref(filler);
+    g_object_unref(bound);
+    g_object_unref(address);
+    g_object_unref(loopback);
+    g_object_unref(listener);
+}
+
+/* Serves the pings, then a response whose status line comes in two pieces */
+static gpointer
+split_status_server(gpointer data)
+{
+    GSocket *listener = data;
+    GSocket *client;
+    gchar request[1024], body[1000];
+    guint i;
+
+    for (i = 0; i < SPEED_TEST_PINGS; i++) {
+        client = g_socket_accept(listener, NULL, NULL);
+        g_assert_nonnull(client);
+        g_object_unref(client);
+    }
+
+    client = g_socket_accept(listener, NULL, NULL);
+    g_assert_nonnull(client);
+    g_socket_receive(client, request, sizeof(request), NULL, NULL);
+
+    memset(body, 'x', sizeof(body));
+    g_socket_send(client, "HTTP/1.0 2", 10, NULL, NULL);
+    g_usleep(G_USEC_PER_SEC / 20);
+    g_socket_send(client, "00 OK\r\n\r\n", 9, NULL, NULL);
+    g_socket_send(client, body, sizeof(body), NULL, NULL);
+    g_socket_close(client, NULL);
+    g_object_unref(client);
+
+    return NULL;
+}
+
+static void
+test_split_status(void)
+{
+    GSocket *listener;
+    GSocketAddress *address, *bound;
+    GInetAddress *loopback;
+    GThread *thread;
+    Outcome outcome = { 0 };
+    GError *error = NULL;
+    gchar *endpoint;
+
+    listener = g_socket_new(G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, &error);
+    g_assert_no_error(error);
+    loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    address = g_inet_socket_address_new(loopback, 0);
+    g_assert_true(g_socket_bind(listener, address, TRUE, &error));
+    g_assert_true(g_socket_listen(listener, &error));
+    bound = g_socket_get_local_address(listener, &error);
+    g_assert_no_error(error);
+
+    thread = g_thread_new("split-status", split_status_server, listener);
+    endpoint = g_strdup_printf("http://127.0.0.1:%u/",
+                               g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(bound)));
+    run_test(endpoint, 0, &outcome);
+    g_thread_join(thread);
+
+    g_assert_no_error(outcome.error);
+    g_assert_true(outcome.ok);
+    g_assert_cmpuint(outcome.result.bytes, ==, 1000);
+
+    g_free(endpoint);
+    g_object_unref(bound);
+    g_object_unref(address);
+    g_object_unref(loopback);
+    g_object_unref(listener);
+}
+
+static void
+test_results(void)
+{
+    SpeedTestResult result = { 12.5e6, 3.25, 0.5, 62500000, 1700000000 };
+    SpeedTestResult loaded;
+    GError *error = NULL;
+    gchar *filename;
+    gint fd;
+
+    fd = g_file_open_tmp("speed-tests-XXXXXX.ini", &filename, &error);
+    g_assert_no_error(error);
+    close(fd);
+
+    g_assert_false(speed_test_load_result(filename, CONNECTION_UUID, &loaded));
+
+    g_assert_true(speed_test_save_result(filename, CONNECTION_UUID, "tcp://127.0.0.1:5201", &result, &error));
+    g_assert_no_error(error);
+
+    g_assert_true(speed_test_load_result(filename, CONNECTION_UUID, &loaded));
+    g_assert_cmpfloat_with_epsilon(loaded.goodput, result.goodput, 1e-6);
+    g_assert_cmpfloat_with_epsilon(loaded.rtt, result.rtt, 1e-6);
+    g_assert_cmpfloat_with_epsilon(loaded.jitter, result.jitter, 1e-6);
+    g_assert_cmpuint(loaded.bytes, ==, result.bytes);
+    g_assert_cmpint(loaded.time, ==, result.time);
+
+    g_assert_false(speed_test_load_result(filename, "unknown", &loaded));
+
+    g_unlink(filename);
+    g_free(filename);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/speed-test/endpoint", test_endpoint);
+    g_test_add_data_func("/speed-test/loopback-tcp", GINT_TO_POINTER(FALSE), test_loopback);
+    g_test_add_data_func("/speed-test/loopback-http", GINT_TO_POINTER(TRUE), test_loopback);
+    g_test_add_func("/speed-test/refused", test_refused);
+    g_test_add_func("/speed-test/localhost", test_localhost);
+    g_test_add_func("/speed-test/timeout", test_timeout);
+    g_test_add_func("/speed-test/split-status", test_split_status);
+    g_test_add_func("/speed-test/results", test_results);
+
+    return g_test_run();
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+
+#include "nm-interface-private.h"
+#include "status-icon.h"
+#include "snapshot-helpers.h"
+
+static gboolean have_display;
+
+static void
+test_key_names(void)
+{
+    StatusIconKey key = { 0 };
+
+    /* Nothing connected */
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-offline-symbolic");
+
+    key.device_type = NM_DEVICE_TYPE_WIFI;
+    key.device_state = NM_DEVICE_STATE_CONFIG;
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-wireless-acquiring-symbolic");
+
+    key.device_state = NM_DEVICE_STATE_ACTIVATED;
+    key.connectivity = NM_CONNECTIVITY_FULL;
+    key.bucket = 4;
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-wireless-signal-excellent-symbolic");
+    key.bucket = 1;
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-wireless-signal-weak-symbolic");
+
+    key.connectivity = NM_CONNECTIVITY_PORTAL;
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-wireless-no-route-symbolic");
+
+    /* The bucket means nothing for wired devices */
+    key.device_type = NM_DEVICE_TYPE_ETHERNET;
+    key.connectivity = NM_CONNECTIVITY_FULL;
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-wired-symbolic");
+    key.bucket = 3;
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-wired-symbolic");
+
+    /* A device that has dropped off is offline */
+    key.device_state = NM_DEVICE_STATE_DISCONNECTED;
+    g_assert_cmpstr(status_icon_name_for_key(&key), ==, "network-offline-symbolic");
+}
+
+static void
+test_from_snapshot(void)
+{
+    NMInterface *nm_interface;
+    StatusIcon *status_icon;
+    GtkWidget *image;
+    gchar *filename;
+
+    if (!have_display) {
+        g_test_skip("No display");
+        return;
+    }
+
+    filename = write_snapshot(snapshot_office_wifi);
+    nm_interface = load_snapshot(filename);
+
+    image = g_object_ref_sink(gtk_image_new());
+    status_icon = status_icon_new(image, nm_interface);
+
+    g_assert_cmpstr(status_icon_get_icon_name(status_icon), ==, "network-wireless-signal-good-symbolic");
+    g_assert_cmpuint(status_icon_get_swaps_per_hour(status_icon), ==, 0);
+
+    /* A notification that changes nothing the icon shows swaps nothing */
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ALL);
+    g_assert_cmpuint(status_icon_get_swaps_per_hour(status_icon), ==, 0);
+
+    status_icon_free(status_icon);
+    g_object_unref(image);
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+}
+
+#define VPN_ACTIVE_PATH "/org/freedesktop/NetworkManager/ActiveConnection/2"
+
+/* The VPN emblem waits for the VPN to finish activating */
+static void
+test_vpn_activated(void)
+{
+    NMInterface *nm_interface;
+    NMActiveConnectionInfo *vpn;
+    StatusIcon *status_icon;
+    GtkWidget *image;
+    gchar *contents, *filename;
+
+    if (!have_display) {
+        g_test_skip("No display");
+        return;
+    }
+
+    contents = g_strconcat(snapshot_office_wifi,
+                           "\n"
+                           "[ActiveConnection " VPN_ACTIVE_PATH "]\n"
+                           "Id=Work VPN\n"
+                           "Type=vpn\n"
+                           "State=1\n"
+                           "Vpn=true\n", NULL);
+    filename = write_snapshot(contents);
+    nm_interface = load_snapshot(filename);
+
+    image = g_object_ref_sink(gtk_image_new());
+    status_icon = status_icon_new(image, nm_interface);
+    g_assert_null(status_icon_get_emblem_name(status_icon));
+
+    /* What the backends do when the State property changes */
+    vpn = g_hash_table_lookup(nm_interface->active_connections, VPN_ACTIVE_PATH);
+    g_assert_nonnull(vpn);
+    vpn->state = NM_ACTIVE_CONNECTION_STATE_ACTIVATED;
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+
+    g_assert_cmpstr(status_icon_get_emblem_name(status_icon), ==, "network-vpn-symbolic");
+    g_assert_cmpstr(status_icon_get_icon_name(status_icon), ==, "network-wireless-signal-good-symbolic");
+
+    status_icon_free(status_icon);
+    g_object_unref(image);
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_free(filename);
+    g_free(contents);
+}
+
+int main(int argc, char *argv[])
+{
+    have_display = gtk_init_check(&argc, &argv);
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/status-icon/key-names", test_key_names);
+    g_test_add_func("/status-icon/from-snapshot", test_from_snapshot);
+    g_test_add_func("/status-icon/vpn-activated", test_vpn_activated);
+
+    return g_test_run();
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "traffic-label.h"
+
+static void
+test_counter(void)
+{
+    gchar *contents = NULL;
+    guint64 before, value, again;
+    gint fd;
+
+    if (!g_file_get_contents("/sys/class/net/lo/statistics/rx_bytes", &contents, NULL, NULL)) {
+        g_test_skip("No sysfs counters for lo");
+        return;
+    }
+    before = g_ascii_strtoull(contents, NULL, 10);
+    g_free(contents);
+
+    fd = traffic_label_open_counter("lo", "rx_bytes");
+    g_assert_cmpint(fd, >=, 0);
+
+    /* The same descriptor reads the current value every time */
+    g_assert_true(traffic_label_read_counter(fd, &value));
+    g_assert_cmpuint(value, >=, before);
+    g_assert_true(traffic_label_read_counter(fd, &again));
+    g_assert_cmpuint(again, >=, value);
+
+    close(fd);
+
+    /* Names are not paths */
+    g_assert_cmpint(traffic_label_open_counter("../lo", "rx_bytes"), ==, -1);
+    g_assert_cmpint(traffic_label_open_counter("nm-test-none", "rx_bytes"), ==, -1);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/traffic-label/counter", test_counter);
+
+    return g_test_run();
+}
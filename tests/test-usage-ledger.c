@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nm-interface-private.h"
+#include "usage-ledger.h"
+
+#define MODEM_DEVICE "/org/freedesktop/NetworkManager/Devices/3"
+#define MODEM_UUID   "0f6a3c2e-8d1b-4b7e-a1c4-5e2f9d8b7a61"
+#define OTHER_UUID   "7d4e1a90-2b3c-4f5d-8e6a-9c0b1d2e3f4a"
+
+static gchar *
+temp_filename(void)
+{
+    GError *error = NULL;
+    gchar *filename;
+    gint fd;
+
+    fd = g_file_open_tmp("usage-XXXXXX.ledger", &filename, &error);
+    g_assert_no_error(error);
+    close(fd);
+
+    return filename;
+}
+
+static UsageLedger *
+open_ledger(const gchar *filename)
+{
+    UsageLedger *ledger;
+    GError *error = NULL;
+
+    ledger = usage_ledger_new(filename, &error);
+    g_assert_no_error(error);
+    g_assert_nonnull(ledger);
+
+    return ledger;
+}
+
+static guint32
+julian(GDateDay day, GDateMonth month, GDateYear year)
+{
+    GDate date;
+
+    g_date_clear(&date, 1);
+    g_date_set_dmy(&date, day, month, year);
+
+    return g_date_get_julian(&date);
+}
+
+static void
+test_persist(void)
+{
+    gchar *filename = temp_filename();
+    UsageLedger *ledger;
+    guint32 day = julian(10, G_DATE_MARCH, 2024);
+    guint64 rx, tx;
+    GStatBuf st;
+
+    ledger = open_ledger(filename);
+    usage_ledger_add(ledger, MODEM_UUID, day, 1000, 100);
+    usage_ledger_add(ledger, MODEM_UUID, day, 500, 50);
+    usage_ledger_add(ledger, MODEM_UUID, day + 1, 7, 3);
+    usage_ledger_add(ledger, OTHER_UUID, day, 1, 1);
+
+    /* Not synced before the interval is up */
+    g_assert_cmpuint(usage_ledger_get_n_syncs(ledger), ==, 0);
+    usage_ledger_free(ledger);
+
+    g_assert_cmpint(g_stat(filename, &st), ==, 0);
+    g_assert_cmpint(st.st_size, ==, 64 * (USAGE_LEDGER_RECORDS + 1));
+
+    ledger = open_ledger(filename);
+    usage_ledger_get_usage(ledger, MODEM_UUID, day, day, &rx, &tx);
+    g_assert_cmpuint(rx, ==, 1500);
+    g_assert_cmpuint(tx, ==, 150);
+    usage_ledger_get_usage(ledger, MODEM_UUID, day, day + 1, &rx, &tx);
+    g_assert_cmpuint(rx, ==, 1507);
+    g_assert_cmpuint(tx, ==, 153);
+    usage_ledger_get_usage(ledger, "unknown", day, day + 1, &rx, &tx);
+    g_assert_cmpuint(rx + tx, ==, 0);
+    usage_ledger_free(ledger);
+
+    /* Anything else in the file is replaced by an empty ledger */
+    g_file_set_contents(filename, "garbage", -1, NULL);
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*unknown layout*");
+    ledger = open_ledger(filename);
+    g_test_assert_expected_messages();
+    usage_ledger_get_usage(ledger, MODEM_UUID, 0, G_MAXUINT32, &rx, &tx);
+    g_assert_cmpuint(rx + tx, ==, 0);
+    usage_ledger_free(ledger);
+
+    g_unlink(filename);
+    g_free(filename);
+}
+
+/* Records with an unterminated UUID are dropped, the rest are kept */
+static void
+test_damaged(void)
+{
+    gchar *filename = temp_filename();
+    gchar garbage[40];
+    UsageLedger *ledger;
+    guint32 day = julian(10, G_DATE_MARCH, 2024);
+    guint64 rx, tx;
+    gint fd;
+
+    ledger = open_ledger(filename);
+    usage_ledger_add(ledger, MODEM_UUID, day, 1000, 100);
+    usage_ledger_add(ledger, OTHER_UUID, day, 7, 3);
+    usage_ledger_free(ledger);
+
+    /* The first record, right after the header, holds MODEM_UUID */
+    memset(garbage, 'x', sizeof(garbage));
+    fd = open(filename, O_WRONLY);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpint(pwrite(fd, garbage, sizeof(garbage), 64), ==, sizeof(garbage));
+    close(fd);
+
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "*damaged records*");
+    ledger = open_ledger(filename);
+    g_test_assert_expected_messages();
+
+    usage_ledger_get_usage(ledger, MODEM_UUID, day, day, &rx, &tx);
+    g_assert_cmpuint(rx + tx, ==, 0);
+    usage_ledger_get_usage(ledger, OTHER_UUID, day, day, &rx, &tx);
+    g_assert_cmpuint(rx, ==, 7);
+    g_assert_cmpuint(tx, ==, 3);
+    usage_ledger_free(ledger);
+
+    g_unlink(filename);
+    g_free(filename);
+}
+
+/* A second ledger on the same file would count the same traffic again */
+static void
+test_locked(void)
+{
+    gchar *filename = temp_filename();
+    UsageLedger *ledger, *second;
+    GError *error = NULL;
+
+    ledger = open_ledger(filename);
+    second = usage_ledger_new(filename, &error);
+    g_assert_null(second);
+    g_assert_error(error, G_IO_ERROR, G_IO_ERROR_BUSY);
+    g_clear_error(&error);
+    usage_ledger_free(ledger);
+
+    /* Free again once the first one is gone */
+    ledger = open_ledger(filename);
+    usage_ledger_free(ledger);
+
+    g_unlink(filename);
+    g_free(filename);
+}
+
+/* Past the capacity the oldest days make room */
+static void
+test_bounded(void)
+{
+    gchar *filename = temp_filename();
+    UsageLedger *ledger;
+    guint32 first = julian(1, G_DATE_JANUARY, 2020);
+    guint64 rx, tx;
+    guint i;
+
+    ledger = open_ledger(filename);
+    for (i = 0; i < USAGE_LEDGER_RECORDS + 10; i++)
+        usage_ledger_add(ledger, MODEM_UUID, first + i, 1, 0);
+
+    usage_ledger_get_usage(ledger, MODEM_UUID, first, first + 9, &rx, &tx);
+    g_assert_cmpuint(rx, ==, 0);
+    usage_ledger_get_usage(ledger, MODEM_UUID, first, G_MAXUINT32, &rx, &tx);
+    g_assert_cmpuint(rx, ==, USAGE_LEDGER_RECORDS);
+    usage_ledger_free(ledger);
+
+    g_unlink(filename);
+    g_free(filename);
+}
+
+static void
+test_billing_period(void)
+{
+    guint32 first, last;
+
+    usage_ledger_billing_period(julian(5, G_DATE_MARCH, 2024), 1, &first, &last);
+    g_assert_cmpuint(first, ==, julian(1, G_DATE_MARCH, 2024));
+    g_assert_cmpuint(last, ==, julian(31, G_DATE_MARCH, 2024));
+
+    /* Renewing on the 31st renews on the last day of shorter months */
+    usage_ledger_billing_period(julian(15, G_DATE_FEBRUARY, 2024), 31, &first, &last);
+    g_assert_cmpuint(first, ==, julian(31, G_DATE_JANUARY, 2024));
+    g_assert_cmpuint(last, ==, julian(28, G_DATE_FEBRUARY, 2024));
+
+    usage_ledger_billing_period(julian(29, G_DATE_FEBRUARY, 2024), 31, &first, &last);
+    g_assert_cmpuint(first, ==, julian(29, G_DATE_FEBRUARY, 2024));
+    g_assert_cmpuint(last, ==, julian(30, G_DATE_MARCH, 2024));
+
+    /* Across the new year */
+    usage_ledger_billing_period(julian(3, G_DATE_JANUARY, 2025), 15, &first, &last);
+    g_assert_cmpuint(first, ==, julian(15, G_DATE_DECEMBER, 2024));
+    g_assert_cmpuint(last, ==, julian(14, G_DATE_JANUARY, 2025));
+}
+
+#define MODEM_ACTIVE_PATH "/org/freedesktop/NetworkManager/ActiveConnection/3"
+
+/* A gsm connection on MODEM_DEVICE in the given active connection state */
+static NMInterface *
+load_modem(const gchar *snapshot, NMActiveConnectionState state)
+{
+    NMInterface *nm_interface;
+    GError *error = NULL;
+    gchar *contents;
+
+    contents = g_strdup_printf("[NetworkManager]\n"
+                               "State=70\n"
+                               "\n"
+                               "[Device " MODEM_DEVICE "]\n"
+                               "Interface=wwan0\n"
+                               "Type=8\n"
+                               "State=100\n"
+                               "\n"
+                               "[Connection /org/freedesktop/NetworkManager/Settings/3]\n"
+                               "Uuid=" MODEM_UUID "\n"
+                               "Id=Mobile\n"
+                               "Type=gsm\n"
+                               "\n"
+                               "[ActiveConnection " MODEM_ACTIVE_PATH "]\n"
+                               "Connection=/org/freedesktop/NetworkManager/Settings/3\n"
+                               "Devices=" MODEM_DEVICE ";\n"
+                               "State=%d\n", state);
+    g_file_set_contents(snapshot, contents, -1, &error);
+    g_assert_no_error(error);
+    g_free(contents);
+
+    nm_interface = nm_interface_new_for_snapshot(snapshot);
+    g_assert_true(nm_interface_init(nm_interface, &error));
+    g_assert_no_error(error);
+
+    return nm_interface;
+}
+
+/* Device statistics of an active gsm connection land on today */
+static void
+test_statistics(void)
+{
+    gchar *snapshot = temp_filename();
+    gchar *filename = temp_filename();
+    NMInterface *nm_interface;
+    UsageLedger *ledger;
+    guint32 today = usage_ledger_today();
+    guint64 rx, tx;
+
+    nm_interface = load_modem(snapshot, NM_ACTIVE_CONNECTION_STATE_ACTIVATED);
+
+    ledger = open_ledger(filename);
+    usage_ledger_attach(ledger, nm_interface);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, MODEM_DEVICE), >, 0);
+
+    /* The first sample is the baseline */
+    nm_statistics_add_sample(nm_interface, MODEM_DEVICE, 10000, 2000);
+    nm_statistics_add_sample(nm_interface, MODEM_DEVICE, 13000, 2500);
+    nm_statistics_add_sample(nm_interface, MODEM_DEVICE, 14000, 2600);
+
+    usage_ledger_get_usage(ledger, MODEM_UUID, today, today, &rx, &tx);
+    g_assert_cmpuint(rx, ==, 4000);
+    g_assert_cmpuint(tx, ==, 600);
+
+    /* Freeing the ledger stops the device's counters */
+    usage_ledger_free(ledger);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, MODEM_DEVICE), ==, 0);
+
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_unlink(snapshot);
+    g_free(filename);
+    g_free(snapshot);
+}
+
+/* A connection still activating when the ledger attaches is counted once it is up */
+static void
+test_activated(void)
+{
+    gchar *snapshot = temp_filename();
+    gchar *filename = temp_filename();
+    NMInterface *nm_interface;
+    NMActiveConnectionInfo *active;
+    UsageLedger *ledger;
+    guint32 today = usage_ledger_today();
+    guint64 rx, tx;
+
+    nm_interface = load_modem(snapshot, NM_ACTIVE_CONNECTION_STATE_ACTIVATING);
+
+    ledger = open_ledger(filename);
+    usage_ledger_attach(ledger, nm_interface);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, MODEM_DEVICE), ==, 0);
+
+    /* What the backends do when the State property changes */
+    active = g_hash_table_lookup(nm_interface->active_connections, MODEM_ACTIVE_PATH);
+    g_assert_nonnull(active);
+    active->state = NM_ACTIVE_CONNECTION_STATE_ACTIVATED;
+    nm_interface_notify_changed(nm_interface, NM_INTERFACE_CHANGED_ACTIVE_CONNECTIONS);
+    g_assert_cmpuint(nm_statistics_get_refresh_rate(nm_interface, MODEM_DEVICE), >, 0);
+
+    nm_statistics_add_sample(nm_interface, MODEM_DEVICE, 500, 100);
+    nm_statistics_add_sample(nm_interface, MODEM_DEVICE, 1500, 300);
+
+    usage_ledger_get_usage(ledger, MODEM_UUID, today, today, &rx, &tx);
+    g_assert_cmpuint(rx, ==, 1000);
+    g_assert_cmpuint(tx, ==, 200);
+
+    usage_ledger_free(ledger);
+    nm_interface_free(nm_interface);
+    g_unlink(filename);
+    g_unlink(snapshot);
+    g_free(filename);
+    g_free(snapshot);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/usage-ledger/persist", test_persist);
+    g_test_add_func("/usage-ledger/damaged", test_damaged);
+    g_test_add_func("/usage-ledger/locked", test_locked);
+    g_test_add_func("/usage-ledger/bounded", test_bounded);
+    g_test_add_func("/usage-ledger/billing-period", test_billing_period);
+    g_test_add_func("/usage-ledger/statistics", test_statistics);
+    g_test_add_func("/usage-ledger/activated", test_activated);
+
+    return g_test_run();
+}
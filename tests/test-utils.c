@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2023 XFCE4 NetworkManager Plugin Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#define NET_DEV_HEADER \
+    "Inter-|   Receive                                                |  Transmit\n" \
+    " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+
+/* In place, like the kernel: the reader keeps its descriptor open */
+static void
+write_net_dev(const gchar *filename, const gchar *lines)
+{
+    gchar *contents = g_strconcat(NET_DEV_HEADER, lines, NULL);
+    gsize length = strlen(contents);
+    gint fd;
+
+    fd = g_open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpint(write(fd, contents, length), ==, (gssize)length);
+    close(fd);
+    g_free(contents);
+}
+
+static void
+test_net_dev(void)
+{
+    UtilsNetDevReader *reader;
+    const UtilsNetDevStats *stats;
+    GError *error = NULL;
+    gchar *dir, *filename;
+
+    dir = g_dir_make_tmp("test-utils-XXXXXX", NULL);
+    g_assert_nonnull(dir);
+    filename = g_build_filename(dir, "dev", NULL);
+
+    write_net_dev(filename,
+                  "    lo:  1000      10    0    0    0     0          0         0     1000      10    0    0    0     0       0          0\n"
+                  "nm-test0:12345678901234 99 0 0 0 0 0 0 42 7 0 0 0 0 0 0\n");
+
+    reader = utils_net_dev_reader_new(filename, &error);
+    g_assert_no_error(error);
+    g_assert_true(utils_net_dev_reader_update(reader, &error));
+    g_assert_no_error(error);
+    g_assert_cmpuint(utils_net_dev_reader_get_n_interfaces(reader), ==, 2);
+
+    stats = utils_net_dev_reader_get(reader, 0);
+    g_assert_cmpstr(stats->name, ==, "lo");
+    g_assert_cmpuint(stats->rx_bytes, ==, 1000);
+    g_assert_cmpuint(stats->tx_packets, ==, 10);
+
+    /* No space after the colon once the counters get wide */
+    stats = utils_net_dev_reader_get(reader, 1);
+    g_assert_cmpstr(stats->name, ==, "nm-test0");
+    g_assert_cmpuint(stats->rx_bytes, ==, G_GUINT64_CONSTANT(12345678901234));
+    g_assert_cmpuint(stats->rx_packets, ==, 99);
+    g_assert_cmpuint(stats->tx_bytes, ==, 42);
+    g_assert_cmpuint(stats->tx_packets, ==, 7);
+    g_assert_cmpuint(stats->ifindex, ==, 0);
+
+    if (if_nametoindex("lo") != 0)
+        g_assert_true(utils_net_dev_reader_lookup(reader, if_nametoindex("lo")) == utils_net_dev_reader_get(reader, 0));
+
+    /* Interfaces come, go and change places between reads */
+    write_net_dev(filename,
+                  "nm-test0: 50 5 0 0 0 0 0 0 60 6 0 0 0 0 0 0\n"
+                  "nm-test1: 1 1 0 0 0 0 0 0 2 2 0 0 0 0 0 0\n");
+
+    g_assert_true(utils_net_dev_reader_update(reader, &error));
+    g_assert_cmpuint(utils_net_dev_reader_get_n_interfaces(reader), ==, 2);
+    g_assert_cmpstr(utils_net_dev_reader_get(reader, 0)->name, ==, "nm-test0");
+    g_assert_cmpuint(utils_net_dev_reader_get(reader, 0)->tx_bytes, ==, 60);
+    g_assert_cmpstr(utils_net_dev_reader_get(reader, 1)->name, ==, "nm-test1");
+    g_assert_cmpuint(utils_net_dev_reader_get(reader, 1)->tx_packets, ==, 2);
+    if (if_nametoindex("lo") != 0)
+        g_assert_null(utils_net_dev_reader_lookup(reader, if_nametoindex("lo")));
+
+    utils_net_dev_reader_free(reader);
+
+    g_unlink(filename);
+    g_rmdir(dir);
+    g_free(filename);
+    g_free(dir);
+
+    g_assert_null(utils_net_dev_reader_new("/nonexistent/net/dev", &error));
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+    g_clear_error(&error);
+}
+
+static void
+test_net_dev_proc(void)
+{
+    UtilsNetDevReader *reader;
+    guint ifindex = if_nametoindex("lo");
+    const UtilsNetDevStats *stats;
+    GError *error = NULL;
+
+    if (!g_file_test("/proc/net/dev", G_FILE_TEST_EXISTS) || ifindex == 0) {
+        g_test_skip("No /proc/net/dev or no lo");
+        return;
+    }
+
+    reader = utils_net_dev_reader_new(NULL, &error);
+    g_assert_no_error(error);
+    g_assert_true(utils_net_dev_reader_update(reader, &error));
+    g_assert_no_error(error);
+
+    stats = utils_net_dev_reader_lookup(reader, ifindex);
+    g_assert_nonnull(stats);
+    g_assert_cmpstr(stats->name, ==, "lo");
+
+    utils_net_dev_reader_free(reader);
+}
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/utils/net-dev", test_net_dev);
+    g_test_add_func("/utils/net-dev/proc", test_net_dev_proc);
+
+    return g_test_run();
+}